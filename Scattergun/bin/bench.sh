@@ -0,0 +1,302 @@
+#!/bin/bash
+# vi: set ts=4:
+# Copyright 2016 Digital Aggregates Corporation, Colorado, USA.
+# "Digital Aggregates Corporation" is a registered trademark.
+# Licensed under the terms of the GNU GPL v2.
+# mailto:coverclock@diag.com
+# https://github.com/coverclock/com-diag-scattergun
+#
+# USAGE
+#
+# bench.sh [ -b BASELINE ] [ -c CPUS ] [ -n TRIALS ] [ -t PERCENT ] [ -z BYTES ] [ DIRECTORY ]
+#
+# EXAMPLES
+#
+# bench.sh -n 5 -c 2,3 bench-mercury
+#
+# bench.sh -b bench/baseline.csv -t 10
+#
+# cp bench-mercury/summary.csv bench/baseline.csv
+#
+# ABSTRACT
+#
+# Runs a fixed matrix of throughput benchmarks: the generators (bytes,
+# cmrand48, crandom, every baseline algorithm, faults), the seventool modes
+# and its shared memory ring, rate at several read sizes against an emulated
+# serial device, and the filters and test engines on a standard corpus. No
+# hardware is needed; cases whose tool is missing or whose instruction the
+# processor lacks are skipped. Every case runs TRIALS times (default 3) pinned
+# to CPUS (default the last two processors) with taskset, moving BYTES bytes
+# (default 16777216). Each trial is recorded in DIRECTORY/trials.csv, and the
+# median of each case in DIRECTORY/summary.csv. If a BASELINE summary is given,
+# each case is compared against it in DIRECTORY/compare.csv, and the script
+# exits with 1 if any case is more than PERCENT percent (default 5) slower.
+#
+
+RC=0
+ZERO=$(basename $0)
+LABEL=${ZERO%\.sh}
+HOSTNAME=$(uname -n)
+SYSTEM=$(uname -r)
+ISO8601=$(date -u +%Y-%m-%dT%H:%M:%S)
+
+BASELINE=""
+CPUS=""
+TRIALS=3
+PERCENT=5
+BYTES=16777216
+
+while getopts "b:c:n:t:z:" OPT; do
+	case ${OPT} in
+	b) BASELINE=${OPTARG};;
+	c) CPUS=${OPTARG};;
+	n) TRIALS=${OPTARG};;
+	t) PERCENT=${OPTARG};;
+	z) BYTES=${OPTARG};;
+	*) echo "usage: ${ZERO} [ -b BASELINE ] [ -c CPUS ] [ -n TRIALS ] [ -t PERCENT ] [ -z BYTES ] [ DIRECTORY ]" 1>&2; exit 1;;
+	esac
+done
+shift $(( ${OPTIND} - 1 ))
+
+SAVE=${1-"${LABEL}_${HOSTNAME}_${SYSTEM}_${ISO8601}"}
+TRIALSCSV="${SAVE}/trials.csv"
+SUMMARYCSV="${SAVE}/summary.csv"
+COMPARECSV="${SAVE}/compare.csv"
+CORPUS="${SAVE}/corpus.dat"
+KEY="${SAVE}/key.dat"
+LINK="${SAVE}/emulator.pty"
+RING="/${LABEL}-$$"
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin ${SAVE}"
+
+mkdir -p ${SAVE}
+
+##################################################
+
+# Pin every case to the same processors, two of them if there are two, so
+# that a producer and the consumer it is piped to do not share one.
+
+PROCESSORS=$(nproc)
+if [[ -z "${CPUS}" ]]; then
+	if (( ${PROCESSORS} > 1 )); then
+		CPUS="$(( ${PROCESSORS} - 2 )),$(( ${PROCESSORS} - 1 ))"
+	else
+		CPUS="0"
+	fi
+fi
+
+if command -v taskset > /dev/null; then
+	PIN="taskset -c ${CPUS}"
+else
+	PIN=""
+	CPUS="none"
+fi
+
+echo "${ZERO}: host=\"${HOSTNAME}\" system=\"${SYSTEM}\" processors=${PROCESSORS} cpus=\"${CPUS}\" trials=${TRIALS} bytes=${BYTES} percent=${PERCENT}"
+
+echo "case,trial,bytes,nanoseconds,status" > ${TRIALSCSV}
+
+# Run COMMAND TRIALS times and record how long each trial took to move SIZE
+# bytes. COMMAND runs with pipefail, so that it fails if any part of a
+# pipeline does. A case whose first trial fails is abandoned.
+
+bench() {
+	local NAME=$1
+	local SIZE=$2
+	local COMMAND=$3
+	local TRIAL=0
+	local BEGIN=0
+	local END=0
+	local STATUS=0
+	for (( TRIAL = 1; TRIAL <= ${TRIALS}; ++TRIAL )); do
+		BEGIN=$(date +%s%N)
+		${PIN} bash -o pipefail -c "${COMMAND}" > /dev/null 2> ${SAVE}/${NAME}.err
+		STATUS=$?
+		END=$(date +%s%N)
+		echo "${NAME},${TRIAL},${SIZE},$(( ${END} - ${BEGIN} )),${STATUS}" >> ${TRIALSCSV}
+		if (( ${STATUS} != 0 )); then
+			echo "${ZERO}: case=\"${NAME}\" trial=${TRIAL} status=${STATUS}" 1>&2
+			RC=1
+			break
+		fi
+	done
+	echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) case ${NAME}"
+}
+
+# Benchmark a producer by how long it takes to emit BYTES bytes, or fewer for
+# a slow one. The producer being killed by SIGPIPE (status 141) when head has
+# had enough is how it is meant to stop; failing any other way, or ending
+# before it has emitted all of the bytes, fails the trial.
+
+produce() {
+	local SIZE=${3-${BYTES}}
+	bench $1 ${SIZE} "COUNT=\$( { $2 || (( \$? == 141 )); } | head -c ${SIZE} | wc -c ) && (( \${COUNT} == ${SIZE} )) || { echo \"$1: bytes=\${COUNT:-0} expected=${SIZE}\" 1>&2; false; }"
+}
+
+# Benchmark a filter or test engine by how long it takes to consume the corpus.
+
+consume() {
+	bench $1 ${BYTES} "$2 < ${CORPUS}"
+}
+
+##################################################
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin generators"
+
+command -v bytes > /dev/null && produce bytes "bytes"
+command -v cmrand48 > /dev/null && produce cmrand48 "cmrand48 0xDEADBEEF"
+command -v crandom > /dev/null && produce crandom "crandom 0xDEADBEEF"
+
+if command -v baseline > /dev/null; then
+	for ALGORITHM in mrand48 random splitmix64 xoshiro256 pcg64 philox; do
+		produce baseline-${ALGORITHM} "baseline -a ${ALGORITHM} -s 0xDEADBEEF"
+	done
+fi
+
+if command -v faults > /dev/null; then
+	produce faults-bias "faults -s 0xDEADBEEF -d bias:0.501"
+	produce faults-stuck "faults -s 0xDEADBEEF -d stuck:0x01:1"
+fi
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) end generators"
+
+##################################################
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin seventool"
+
+if command -v seventool > /dev/null; then
+	produce seventool-fail "seventool"
+	seventool -R -x > /dev/null 2>&1 && produce seventool-rdrand "seventool -R"
+	seventool -S -x > /dev/null 2>&1 && produce seventool-rdseed "seventool -S" $(( ${BYTES} / 16 ))
+	# The producer stops as soon as it is told to (see ring_cancel), so
+	# what is timed is the ring, not its teardown. The consumer reports
+	# how many bytes it read, so that it is not piped through another.
+	if command -v ringtool > /dev/null; then
+		bench seventool-ring ${BYTES} "ringtool -c ${RING} && { seventool -m ${RING} & PID=\$!; COUNT=\$(ringtool -v -r -t ${BYTES} ${RING} 2>&1 > /dev/null | awk '\$2 == \"total\" { print \$3; }'); kill \${PID}; wait; ringtool -u ${RING}; (( \${COUNT:-0} == ${BYTES} )) || { echo \"seventool-ring: bytes=\${COUNT:-0} expected=${BYTES}\" 1>&2; false; }; }"
+	fi
+fi
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) end seventool"
+
+##################################################
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin rate"
+
+# The emulator stands in for a TrueRNGpro on a pseudo-terminal with no limit
+# on its bit rate, so what is measured is the serial read path itself.
+
+if command -v emulator > /dev/null && command -v rate > /dev/null; then
+	for SIZE in 64 512 4096 65536; do
+		bench rate-${SIZE} ${BYTES} "rm -f ${LINK}; emulator -l ${LINK} -b 0 -t $(( ${BYTES} + 65536 )) & while [[ ! -e ${LINK} ]]; do sleep 0.01; done; rate -f ${LINK} -T -r ${SIZE} -t ${BYTES}; kill %1 2> /dev/null; wait"
+	done
+	rm -f ${LINK}
+fi
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) end rate"
+
+##################################################
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin engines"
+
+# The standard corpus is the reproducible Philox corpus for seed zero, so that
+# every host runs the engines on exactly the same data.
+
+if command -v corpus > /dev/null; then
+	corpus -s 0 -t ${BYTES} ${CORPUS}
+	corpus -s 1 -t 65536 ${KEY}
+else
+	head -c ${BYTES} /dev/urandom > ${CORPUS}
+	head -c 65536 /dev/urandom > ${KEY}
+fi
+
+if command -v debias > /dev/null; then
+	consume debias-vonneumann "debias"
+	consume debias-peres "debias -p 3"
+fi
+command -v debias-bmi2 > /dev/null && consume debias-bmi2 "debias-bmi2"
+
+command -v toeplitz > /dev/null && consume toeplitz "toeplitz -k ${KEY}"
+command -v toeplitz-pclmul > /dev/null && consume toeplitz-pclmul "toeplitz-pclmul -k ${KEY}"
+
+if command -v conditioner > /dev/null; then
+	for ALGORITHM in sha256 sha3 blake2s; do
+		consume conditioner-${ALGORITHM} "conditioner -a ${ALGORITHM} -r 256"
+	done
+fi
+command -v conditioner-shani > /dev/null && consume conditioner-shani "conditioner-shani -r 256"
+
+command -v rate > /dev/null && consume rate "rate -r 65536"
+[[ -x /usr/bin/rngtest ]] && consume rngtest "/usr/bin/rngtest -c $(( ${BYTES} / 2500 )); (( \$? <= 1 ))"
+[[ -x /usr/bin/ent ]] && consume ent "/usr/bin/ent"
+
+rm -f ${CORPUS} ${KEY}
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) end engines"
+
+##################################################
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin summary"
+
+# The median trial of each case, with the fastest and slowest, and the
+# throughput in bytes per second at the median.
+
+tail -n +2 ${TRIALSCSV} | awk -F, '$5 == 0' | sort -t, -k1,1 -k4,4n | awk -F, '
+	function emit() {
+		if (count > 0) {
+			median = times[int((count + 1) / 2)];
+			printf("%s,%d,%.0f,%.0f,%.0f,%.0f,%.0f\n", name, count, size, times[1], median, times[count], (size * 1000000000.0) / median);
+		}
+	}
+	BEGIN { print "case,trials,bytes,fastest,median,slowest,rate"; }
+	$1 != name { emit(); name = $1; count = 0; }
+	{ times[++count] = $4; size = $3; }
+	END { emit(); }
+' > ${SUMMARYCSV}
+
+column -t -s, ${SUMMARYCSV} 2> /dev/null || cat ${SUMMARYCSV}
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) end summary"
+
+##################################################
+
+if [[ -z "${BASELINE}" ]]; then
+	:
+elif [[ ! -r ${BASELINE} ]]; then
+	echo "${ZERO}: baseline=\"${BASELINE}\" missing" 1>&2
+else
+
+	echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin compare ${BASELINE}"
+
+	# A case is a regression if its median rate has fallen by more than the
+	# threshold, and an improvement if it has risen by more than it. Cases
+	# run with a different number of bytes are not compared, since the cost
+	# of starting up is amortized differently.
+
+	awk -F, -v percent=${PERCENT} '
+		FNR == 1 { next; }
+		NR == FNR { baseline[$1] = $7; bytes[$1] = $3; next; }
+		!($1 in baseline) { printf("%s,,%s,,new\n", $1, $7); next; }
+		bytes[$1] != $3 { printf("%s,%s,%s,,bytes\n", $1, baseline[$1], $7); next; }
+		{
+			change = (($7 - baseline[$1]) * 100.0) / baseline[$1];
+			verdict = (change < -percent) ? "regression" : (change > percent) ? "improvement" : "same";
+			printf("%s,%s,%s,%.1f,%s\n", $1, baseline[$1], $7, change, verdict);
+		}
+		BEGIN { print "case,baseline,rate,change,verdict"; }
+	' ${BASELINE} ${SUMMARYCSV} > ${COMPARECSV}
+
+	column -t -s, ${COMPARECSV} 2> /dev/null || cat ${COMPARECSV}
+
+	if grep -q ',regression$' ${COMPARECSV}; then
+		RC=1
+	fi
+
+	echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) end compare ${BASELINE}"
+
+fi
+
+##################################################
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) end ${SAVE} ${RC}"
+
+exit ${RC}
@@ -35,6 +35,11 @@ lsmod | grep bcm2708_rng
 
 lsmod | grep intel-rng
 
+# Kernel hardware random number generator framework (see hwrngtool)
+
+[[ -r /sys/class/misc/hw_random/rng_available ]] && echo rng_available=$(cat /sys/class/misc/hw_random/rng_available)
+[[ -r /sys/class/misc/hw_random/rng_current ]] && echo rng_current=$(cat /sys/class/misc/hw_random/rng_current)
+
 # Intel rdrand (Bull Mountain): Ivy Bridge CPUs
 
 cat /proc/cpuinfo | grep rdrand
@@ -75,6 +80,16 @@ fi
 
 ##################################################
 
+# The compiled probe detects and benchmarks every source as one JSON document.
+
+if PROBE=$(command -v probe); then
+	echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) probe"
+	${PROBE} -o ${LABEL}-${STAMP}.json || RC=1
+	echo ${LABEL}-${STAMP}.json
+fi
+
+##################################################
+
 echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) end ${RC}"
 
 exit ${RC}
@@ -33,4 +33,11 @@ SECOND=$(( ${TOTAL} / 8 ))
 echo ${ZERO}: ${AVAILABLE} ${FIRST} ${TOTAL} ${SECOND}
 
 dd if=${SOURCE} of=/dev/null bs=${FIRST} count=1 iflag=fullblock
+
+# The compiled consumer also reports the latency of each read.
+
+if [[ "${SINK}" == "/dev/null" ]] && CONSUMER=$(command -v consumer); then
+	exec ${CONSUMER} -n 1 -m ${SOURCE} -z ${SECOND} -t ${COUNT} -H
+fi
+
 time dd if=${SOURCE} of=${SINK} bs=${SECOND} count=${COUNT} iflag=fullblock
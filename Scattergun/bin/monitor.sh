@@ -8,6 +8,12 @@ PERIOD=${1-"0.25"}
 POOLFILE="/proc/sys/kernel/random/poolsize"
 ENTRFILE="/proc/sys/kernel/random/entropy_avail"
 
+# The compiled monitor samples the pool without forking and without drift.
+
+if MONITOR=$(command -v monitor); then
+	exec ${MONITOR} -g ${PERIOD}
+fi
+
 read POOLSIZE < ${POOLFILE}
 
 GRAPH='===================================================================================================='
@@ -8,18 +8,49 @@
 #
 # USAGE
 #
-# scattergun.sh [ DIRECTORY ]
+# scattergun.sh [ -r | --resume ] [ -n | --no-cache ] [ DIRECTORY ]
 #
 # EXAMPLES
 #
 # dd if=/dev/random | scattergun.sh random-test
 #
+# dd if=/dev/random | scattergun.sh --resume random-test
+#
 # ABSTRACT
 #
 # Runs a battery of tests on a random number generator by
 # reading ramdom bits from standard input. Saves generated
 # data files and other artifacts in the specified directory.
 # Creates the directory if it doesn't already exist.
+#
+# Every step of every stage is run under timeline (if it is
+# on the PATH) and recorded in DIRECTORY/timeline.csv with its
+# start and end, wall clock, user, and system times, maximum
+# resident set size, and bytes consumed. The steps are totaled
+# by stage in DIRECTORY/stages.csv, and each stage is compared
+# against the same stage in the timeline.csv of every sibling
+# of DIRECTORY (that is, the earlier runs) in
+# DIRECTORY/history.csv; both are displayed at the end.
+#
+# The run is checkpointed as it goes so that it can be resumed
+# with -r or --resume (in the latest run for this host if no
+# DIRECTORY is given) after a reboot or after the source drops
+# out. Each capture keeps the whole blocks it already has and
+# reads only the rest. Each step that finished is recorded in
+# DIRECTORY/checkpoint and is not run again; its output, saved
+# in DIRECTORY/STAGE-STEP.out, is displayed instead. The
+# dieharder tests are run one at a time so that every finished
+# test is kept. A step that was interrupted starts over.
+#
+# The result of every step that tests a capture is cached in
+# SCATTERGUN_CACHE (default ~/.cache/scattergun) unless -n or
+# --no-cache is given. It is keyed by the digest of the capture
+# (see digest), the command with the capture taken out of it,
+# and the digests of the programs the command names, and for
+# the SP 800-90B steps of every file in the NIST tree whose
+# modules the scripts import, so that testing identical data
+# again with the same engine and parameters displays the
+# earlier result instead, and changing any of them does not.
 # 
 
 RC=0
@@ -28,12 +59,170 @@ LABEL=${ZERO%\.sh}
 HOSTNAME=$(uname -n)
 SYSTEM=$(uname -r)
 ISO8601=$(date -u +%Y-%m-%dT%H:%M:%S)
-SAVE=${1-"${LABEL}_${HOSTNAME}_${SYSTEM}_${ISO8601}"}
+RESUME=0
+CACHE=${SCATTERGUN_CACHE-"${HOME}/.cache/${LABEL}"}
+
+while (( $# > 0 )); do
+	case "$1" in
+	-r|--resume) RESUME=1; shift;;
+	-n|--no-cache) CACHE=""; shift;;
+	--) shift; break;;
+	-*) echo "usage: ${ZERO} [ -r | --resume ] [ -n | --no-cache ] [ DIRECTORY ]" 1>&2; exit 1;;
+	*) break;;
+	esac
+done
+
+if (( ${RESUME} )) && (( $# == 0 )); then
+	SAVE=$(ls -1td ${LABEL}_${HOSTNAME}_${SYSTEM}_*/checkpoint 2> /dev/null | head -1)
+	if [[ -z "${SAVE}" ]]; then
+		echo "${ZERO}: no run to resume" 1>&2
+		exit 1
+	fi
+	SAVE=$(dirname ${SAVE})
+else
+	SAVE=${1-"${LABEL}_${HOSTNAME}_${SYSTEM}_${ISO8601}"}
+fi
 
 echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin ${SAVE}"
 
 mkdir -p ${SAVE}
 
+SAVED=$(cd ${SAVE}; pwd)
+CHECKPOINT="${SAVED}/checkpoint"
+TIMELINECSV="${SAVED}/timeline.csv"
+STAGESCSV="${SAVE}/stages.csv"
+HISTORYCSV="${SAVE}/history.csv"
+TIMELINE=$(command -v timeline)
+DIGEST=$(command -v digest)
+
+if (( ${RESUME} )); then
+	touch ${CHECKPOINT}
+	echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) resume ${SAVE} $(wc -l < ${CHECKPOINT})"
+else
+	rm -f ${SAVED}/*.out ${TIMELINECSV}
+	: > ${CHECKPOINT}
+fi
+
+# Run a COMMAND as STEP of STAGE, appending its record to the timeline. FILE,
+# if not empty, is the data the step produced or consumed. Without timeline
+# only the wall clock time is recorded, and the shell's time does the rest.
+
+measure() {
+	local STAGE=$1
+	local STEP=$2
+	local FILE=$3
+	local BEGIN=""
+	local START=0
+	local STATUS=0
+	shift 3
+	if [[ -n "${TIMELINE}" ]]; then
+		${TIMELINE} -o ${TIMELINECSV} -s ${STAGE} -n ${STEP} ${FILE:+-f ${FILE}} "$@"
+		return $?
+	fi
+	[[ -s ${TIMELINECSV} ]] || echo "stage,step,start,end,wall,user,system,maxrss,bytes,status,command" > ${TIMELINECSV}
+	BEGIN=$(date -u +%Y-%m-%dT%H:%M:%S.%3N)
+	START=$(date +%s%N)
+	time "$@"
+	STATUS=$?
+	echo "${STAGE},${STEP},${BEGIN},$(date -u +%Y-%m-%dT%H:%M:%S.%3N),$(awk -v N=$(( $(date +%s%N) - ${START} )) 'BEGIN { printf "%.3f", N / 1000000000.0 }'),,,,$( [[ -n "${FILE}" ]] && stat -c %s ${FILE} 2> /dev/null ),${STATUS},\"$*\"" >> ${TIMELINECSV}
+	return ${STATUS}
+}
+
+# Describe a COMMAND that tests FILE without naming FILE: the command with
+# FILE taken out of it, followed by the digest of every program it names and,
+# if DEPENDS names a directory, of every file beneath it (like the modules a
+# script imports) other than version control and compiled bytecode.
+
+identify() {
+	local FILE=$1
+	local WORD=""
+	local PROGRAM=""
+	shift 1
+	echo "${*//${FILE}/@}"
+	for WORD in $*; do
+		if [[ "${WORD}" == "${FILE}" ]]; then
+			continue
+		elif [[ -f ${WORD} ]]; then
+			PROGRAM=${WORD}
+		else
+			PROGRAM=$(type -P -- "${WORD}")
+		fi
+		[[ -n "${PROGRAM}" ]] && ${DIGEST} ${PROGRAM}
+	done
+	if [[ -d "${DEPENDS}" ]]; then
+		( cd ${DEPENDS} && find . \( -name .git -o -name __pycache__ \) -prune -o -type f ! -name '*.pyc' -print0 | LC_ALL=C sort -z | xargs -0 -r ${DIGEST} )
+	fi
+}
+
+# Measure a COMMAND as STEP of STAGE unless an earlier run of the same
+# directory finished it, or unless it has already been run on the same data
+# in FILE with the same programs and parameters, in which case its cached
+# output and status are used. Its output, both standard output and standard
+# error (to which some programs, like rngtest, write their results), is kept
+# so that it can be displayed again when it is skipped. A step that was killed is not checkpointed, nor
+# is its result cached.
+
+step() {
+	local STAGE=$1
+	local STEP=$2
+	local FILE=$3
+	local OUTPUT="${SAVED}/${STAGE}-${STEP}.out"
+	local ENTRY=""
+	local STATUS=0
+	shift 3
+	if (( ${RESUME} )) && grep -q -x "${STAGE} ${STEP}" ${CHECKPOINT}; then
+		echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) resume ${STAGE} ${STEP}"
+		[[ -f ${OUTPUT} ]] && cat ${OUTPUT}
+		return 0
+	fi
+	if [[ -n "${CACHE}" ]] && [[ -n "${DIGEST}" ]] && [[ -f "${FILE}" ]]; then
+		ENTRY="${CACHE}/$(${DIGEST} ${FILE} | cut -c1-64)/$(identify "${FILE}" "$@" | ${DIGEST} | cut -c1-64)"
+	fi
+	if [[ -n "${ENTRY}" ]] && [[ -f ${ENTRY}.status ]] && [[ -s ${ENTRY}.out ]]; then
+		echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) cache ${STAGE} ${STEP} ${ENTRY}"
+		cp ${ENTRY}.out ${OUTPUT}
+		cat ${OUTPUT}
+		echo "${STAGE} ${STEP}" >> ${CHECKPOINT}
+		return $(< ${ENTRY}.status)
+	fi
+	measure ${STAGE} ${STEP} "${FILE}" "$@" 2>&1 | tee ${OUTPUT}
+	STATUS=${PIPESTATUS[0]}
+	(( ${STATUS} < 128 )) || return ${STATUS}
+	echo "${STAGE} ${STEP}" >> ${CHECKPOINT}
+	# The status is written last, so an entry without one is never used. Nor
+	# is an entry without output, which is not cached, since every test prints
+	# its results and an entry made before standard error was kept may not.
+	if [[ -n "${ENTRY}" ]] && [[ -s ${OUTPUT} ]] && mkdir -p $(dirname ${ENTRY}); then
+		identify "${FILE}" "$@" > ${ENTRY}.key
+		cp ${OUTPUT} ${ENTRY}.out
+		echo ${STATUS} > ${ENTRY}.status
+	fi
+	return ${STATUS}
+}
+
+# Capture COUNT blocks of SIZE bytes from standard input into DATA for STAGE.
+# When resuming, the whole blocks of a partial capture are kept (the offset
+# into the capture is its size) and only the rest are read.
+
+capture() {
+	local STAGE=$1
+	local DATA=$2
+	local SIZE=$3
+	local COUNT=$4
+	local HAVE=0
+	if (( ${RESUME} )) && [[ -f ${DATA} ]]; then
+		HAVE=$(( $(stat -c %s ${DATA}) / ${SIZE} ))
+	fi
+	if (( ${HAVE} >= ${COUNT} )); then
+		echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) resume ${STAGE} capture"
+		return 0
+	fi
+	if (( ${HAVE} > 0 )); then
+		echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) resume ${STAGE} capture $(( ${HAVE} * ${SIZE} ))"
+	fi
+	measure ${STAGE} capture ${DATA} dd of=${DATA} bs=${SIZE} count=$(( ${COUNT} - ${HAVE} )) seek=${HAVE} iflag=fullblock
+}
+
 ##################################################
 
 echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin png"
@@ -47,8 +236,9 @@ elif [[ ! -x /usr/bin/pnmtopng ]]; then
 else
 	DATA="${SAVE}/rawtoppm.dat"
 	IMAGE="${SAVE}/rawtoppm.png"
-	time dd of=${DATA} bs=3 count=65536 iflag=fullblock
-	/usr/bin/rawtoppm -rgb 256 256 < ${DATA} | /usr/bin/pnmtopng > ${IMAGE}
+	capture png ${DATA} 3 65536
+	# The image is a file, not output, so it is never served from the cache.
+	CACHE="" step png image ${DATA} bash -c "/usr/bin/rawtoppm -rgb 256 256 < ${DATA} | /usr/bin/pnmtopng > ${IMAGE}"
 fi
 
 echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) end png"
@@ -64,8 +254,8 @@ echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin rngtest"
 if [[ -x /usr/bin/rngtest ]]; then
 	DATA="${SAVE}/rngtest.dat"
 	BLOCKSIZE=$(( 20000 / 8 ))
-	time dd of=${DATA} bs=${BLOCKSIZE} count=1000 iflag=fullblock
-	time /usr/bin/rngtest -c 1000 < ${DATA}
+	capture rngtest ${DATA} ${BLOCKSIZE} 1000
+	step rngtest test ${DATA} bash -c "/usr/bin/rngtest -c 1000 < ${DATA}"
 fi
 
 echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) end rngtest"
@@ -79,12 +269,12 @@ echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin ent"
 
 if [[ -x /usr/bin/ent ]]; then
 	DATA="${SAVE}/ent.dat"
-	time dd of=${DATA} bs=1024 count=4096 iflag=fullblock
-	time /usr/bin/ent ${DATA}
+	capture ent ${DATA} 1024 4096
+	step ent test ${DATA} /usr/bin/ent ${DATA}
 elif [[ -x ${HOME}/bin/ent ]]; then
 	DATA="${SAVE}/ent.dat"
-	time dd of=${DATA} bs=1024 count=4096 iflag=fullblock
-	time ${HOME}/bin/ent ${DATA}
+	capture ent ${DATA} 1024 4096
+	step ent test ${DATA} ${HOME}/bin/ent ${DATA}
 else
 	:
 fi
@@ -102,9 +292,9 @@ NISTCODE=$(which iid_main.py)
 if [[ ! -z "${NISTCODE}" ]]; then
 	NISTPATH=$(dirname ${NISTCODE})
 	DATA="$(pwd)/${SAVE}/sp800.dat"
-	time dd of=${DATA} bs=1024 count=4096 iflag=fullblock
-	( cd ${NISTPATH}; time python iid_main.py ${DATA} 8 1000 -v )
-	( cd ${NISTPATH}; time python noniid_main.py ${DATA} 8 -v )
+	capture sp800 ${DATA} 1024 4096
+	( cd ${NISTPATH}; DEPENDS="${NISTPATH}" step sp800 iid ${DATA} python iid_main.py ${DATA} 8 1000 -v )
+	( cd ${NISTPATH}; DEPENDS="${NISTPATH}" step sp800 noniid ${DATA} python noniid_main.py ${DATA} 8 -v )
 fi
 
 echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) end SP800-90B"
@@ -115,14 +305,105 @@ echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin dieharder"
 
 # sudo apt-get install dieharder
 
+# The -a option runs every test once, except that it sweeps the ntuple (-n)
+# of four of them: rgb_bitdist (200) from 1 to 12, rgb_minimum_distance (201)
+# and rgb_permutations (202) from 2 to 5, and rgb_lagged_sum (204) from 0 to
+# 32. Each test, and each ntuple of those four, is run by itself, which
+# together is the same as -a, but lets a resumed run skip the ones that
+# already finished.
+
+ntuples() {
+	case $1 in
+	200) seq 1 12;;
+	201|202) seq 2 5;;
+	204) seq 0 32;;
+	*) ;;
+	esac
+}
+
 if [[ -x /usr/bin/dieharder ]]; then
-	dieharder -a -g 200
+	TESTS=$(/usr/bin/dieharder -l | awk '$1 == "-d" { print $2; }')
+	if [[ -z "${TESTS}" ]]; then
+		step dieharder all "" dieharder -a -g 200
+	else
+		for TEST in ${TESTS}; do
+			NTUPLES=$(ntuples ${TEST})
+			if [[ -z "${NTUPLES}" ]]; then
+				step dieharder test-${TEST} "" dieharder -d ${TEST} -g 200
+			else
+				for NTUPLE in ${NTUPLES}; do
+					step dieharder test-${TEST}-${NTUPLE} "" dieharder -d ${TEST} -n ${NTUPLE} -g 200
+				done
+			fi
+		done
+	fi
 fi
 
 echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) end dieharder"
 
 ##################################################
 
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) begin timeline"
+
+# Total each stage, in the order in which the stages ran, along with its share
+# of the wall clock time of the whole run.
+
+if [[ -s ${TIMELINECSV} ]]; then
+	awk -F, '
+		FNR == 1 { next }
+		!($1 in wall) { order[++stages] = $1 }
+		{ ++steps[$1]; wall[$1] += $5; user[$1] += $6; sys[$1] += $7; bytes[$1] += $9; total += $5 }
+		($8 > maxrss[$1]) { maxrss[$1] = $8 }
+		END {
+			print "stage,steps,wall,user,system,maxrss,bytes,share"
+			for (ii = 1; ii <= stages; ++ii) {
+				ss = order[ii]
+				printf "%s,%d,%.3f,%.3f,%.3f,%d,%.0f,%.1f\n", ss, steps[ss], wall[ss], user[ss], sys[ss], maxrss[ss], bytes[ss], (total > 0) ? (wall[ss] * 100.0 / total) : 0
+			}
+		}
+	' ${TIMELINECSV} > ${STAGESCSV}
+	column -s, -t < ${STAGESCSV} 2> /dev/null || cat ${STAGESCSV}
+fi
+
+# Compare the wall clock time of each stage against the latest earlier run
+# that had it, and against the mean of all of the earlier runs that had it.
+
+PREVIOUS=""
+for FILE in $(ls -1tr $(dirname ${TIMELINECSV})/../*/timeline.csv 2> /dev/null); do
+	[[ ${FILE} -ef ${TIMELINECSV} ]] || PREVIOUS="${PREVIOUS} ${FILE}"
+done
+
+if [[ -s ${TIMELINECSV} ]]; then
+	awk -F, -v CURRENT=${TIMELINECSV} '
+		FNR == 1 { if (FILENAME != CURRENT) { runs[++count] = FILENAME }; next }
+		(FILENAME != CURRENT) { past[FILENAME, $1] += $5; next }
+		!($1 in wall) { order[++stages] = $1 }
+		{ wall[$1] += $5 }
+		END {
+			print "stage,wall,runs,previous,mean,change"
+			for (ii = 1; ii <= stages; ++ii) {
+				ss = order[ii]
+				found = 0; sum = 0; last = 0
+				for (jj = 1; jj <= count; ++jj) {
+					if ((runs[jj], ss) in past) { ++found; last = past[runs[jj], ss]; sum += last }
+				}
+				if (found == 0) {
+					printf "%s,%.3f,0,,,new\n", ss, wall[ss]
+				} else if (last <= 0) {
+					printf "%s,%.3f,%d,%.3f,%.3f,\n", ss, wall[ss], found, last, sum / found
+				} else {
+					printf "%s,%.3f,%d,%.3f,%.3f,%+.1f%%\n", ss, wall[ss], found, last, sum / found, (wall[ss] - last) * 100.0 / last
+				}
+			}
+		}
+	' ${PREVIOUS} ${TIMELINECSV} > ${HISTORYCSV}
+	column -s, -t < ${HISTORYCSV} 2> /dev/null || cat ${HISTORYCSV}
+fi
+
+echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) end timeline"
+
+##################################################
+
 echo "${ZERO}: $(date -u +%Y-%m-%dT%H:%M:%S) end ${SAVE} ${RC}"
 
 exit ${RC}
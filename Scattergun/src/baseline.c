@@ -0,0 +1,267 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Baseline<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * baseline [ -h ] [ -v ] [ -n ] [ -a ALGORITHM ] [ -s SEED ] [ -z BYTES ] [ -t BYTES ]
+ *
+ * OPTIONS
+ *
+ * -a ALGORITHM    Use mrand48, random, splitmix64, xoshiro256 (default), pcg64, or philox.
+ * -h              Display this menu.
+ * -n              Generate without writing, to measure the generator alone.
+ * -s SEED         Seed the generator with SEED.
+ * -t BYTES        Stop after BYTES in all (default never).
+ * -v              Display verbose output to stderr.
+ * -z BYTES        Fill and write BYTES at a time (default 1048576).
+ *
+ * EXAMPLES
+ *
+ * baseline -a pcg64 | dd of=random.dat bs=4096 count=1024 iflag=fullblock
+ *
+ * baseline -a mrand48 -s 0xDEADBEEF | scattergun.sh scattergun_mercury_cmrand48
+ *
+ * baseline -n -a philox -t 10000000000
+ *
+ * ABSTRACT
+ *
+ * Continuously writes the output of a pseudo-random number generator to
+ * standard output, filling and writing a large buffer at a time, so that the
+ * baselines against which the hardware entropy sources are compared can be
+ * produced much faster than the tests that consume them. The mrand48 and
+ * random algorithms produce the same bytes as cmrand48 and crandom, which
+ * this replaces. The others (SplitMix64, xoshiro256**, PCG64, and
+ * Philox4x32-10) each run several streams side by side in a form that the
+ * compiler turns into SIMD code. When done the throughput is displayed on
+ * standard error. This is part of the Scattergun project.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include "prng.h"
+
+static const char * program = "baseline";
+static int done = 0;
+
+static void handler(int signum)
+{
+    if (signum == SIGPIPE) {
+        done = !0;
+    } else if (signum == SIGINT) {
+        done = !0;
+    } else if (signum == SIGTERM) {
+        done = !0;
+    } else {
+        /* Do nothing. */
+    }
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [ -h ] [ -v ] [ -n ] [ -a ALGORITHM ] [ -s SEED ] [ -z BYTES ] [ -t BYTES ]\n", program);
+    fprintf(stderr, "       -a ALGORITHM    Use mrand48, random, splitmix64, xoshiro256 (default), pcg64, or philox.\n");
+    fprintf(stderr, "       -h              Display this menu.\n");
+    fprintf(stderr, "       -n              Generate without writing, to measure the generator alone.\n");
+    fprintf(stderr, "       -s SEED         Seed the generator with SEED.\n");
+    fprintf(stderr, "       -t BYTES        Stop after BYTES in all (default never).\n");
+    fprintf(stderr, "       -v              Display verbose output to stderr.\n");
+    fprintf(stderr, "       -z BYTES        Fill and write BYTES at a time (default 1048576).\n");
+}
+
+/**
+ * Return the value of the monotonic clock in seconds.
+ * @return the value of the monotonic clock in seconds.
+ */
+static double now(void)
+{
+    struct timespec ts = { 0 };
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+}
+
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int verbose = 0;
+    int discard = 0;
+    int algorithm = PRNG_XOSHIRO256;
+    uint64_t seed = 0;
+    size_t size = 1048576;
+    unsigned long long limit = 0;
+    unsigned long long total = 0;
+    size_t length = 0;
+    size_t written = 0;
+    ssize_t rc = 0;
+    uint8_t * buffer = (uint8_t *)0;
+    struct prng prng;
+    struct sigaction action = { 0 };
+    double start = 0.0;
+    double seconds = 0.0;
+    double generating = 0.0;
+    double before = 0.0;
+    char * end = (char *)0;
+    int opt;
+    extern char * optarg;
+    extern int optind;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "a:hns:t:vz:")) >= 0) {
+
+        switch (opt) {
+
+        case 'a':
+            algorithm = prng_parse(optarg);
+            if (algorithm < 0) {
+                error = !0;
+            }
+            break;
+
+        case 'h':
+            usage();
+            return 0;
+
+        case 'n':
+            discard = !0;
+            break;
+
+        case 's':
+            seed = strtoull(optarg, &end, 0);
+            if (*end != '\0') {
+                error = !0;
+            }
+            break;
+
+        case 't':
+            limit = strtoull(optarg, &end, 0);
+            if ((*end != '\0') || (limit == 0)) {
+                error = !0;
+            }
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        case 'z':
+            size = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (size == 0)) {
+                error = !0;
+            }
+            break;
+
+        default:
+            error = !0;
+            break;
+
+        }
+
+    }
+
+    if (optind < argc) {
+        error = !0;
+    }
+
+    if (error) {
+        usage();
+        return 1;
+    }
+
+    do {
+
+        action.sa_handler = handler;
+        action.sa_flags = 0;
+        if (sigaction(SIGPIPE, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+        if (sigaction(SIGINT, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+        if (sigaction(SIGTERM, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+
+        buffer = (uint8_t *)malloc(size);
+        if (buffer == (uint8_t *)0) {
+            perror("malloc");
+            break;
+        }
+
+        prng_init(&prng, algorithm, seed);
+
+        if (verbose) {
+            fprintf(stderr, "%s: algorithm    \"%s\"\n", program, PRNG_NAMES[algorithm]);
+            fprintf(stderr, "%s: seed         0x%llx\n", program, (unsigned long long)seed);
+            fprintf(stderr, "%s: lanes        %d\n", program, PRNG_LANES);
+            fprintf(stderr, "%s: size         %zu\n", program, size);
+            fprintf(stderr, "%s: limit        %llu\n", program, limit);
+        }
+
+        start = now();
+        while (!done) {
+            length = size;
+            if ((limit > 0) && (length > (limit - total))) { length = limit - total; }
+            if (length == 0) {
+                break;
+            }
+            before = now();
+            prng_fill(&prng, buffer, length);
+            generating += now() - before;
+            if (discard) {
+                total += length;
+                continue;
+            }
+            for (written = 0; written < length; written += rc) {
+                rc = write(STDOUT_FILENO, buffer + written, length - written);
+                if (rc > 0) {
+                    /* Do nothing. */
+                } else if ((rc < 0) && (errno == EINTR) && (!done)) {
+                    rc = 0;
+                } else {
+                    break;
+                }
+            }
+            total += written;
+            if (written < length) {
+                if ((rc < 0) && (errno != EPIPE)) { perror("write"); }
+                break;
+            }
+        }
+        seconds = now() - start;
+
+        fprintf(stderr, "%s: algorithm=\"%s\" bytes=%llu seconds=%.6f rate=%.0f generated=%.0f\n", program,
+            PRNG_NAMES[algorithm], total, seconds,
+            (seconds > 0.0) ? (total / seconds) : 0.0,
+            (generating > 0.0) ? (total / generating) : 0.0);
+
+        xc = 0;
+
+    } while (0);
+
+    if (buffer != (uint8_t *)0) {
+        free(buffer);
+    }
+
+    return xc;
+}
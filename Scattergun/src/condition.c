@@ -0,0 +1,603 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Condition<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ */
+
+#include <string.h>
+#include <errno.h>
+#include "condition.h"
+#if defined(SCATTERGUN_HAS_SHANI)
+#   include <immintrin.h>
+#endif
+
+#define LANES CONDITION_LANES
+
+const char * CONDITION_NAMES[CONDITION_ALGORITHMS] = { "sha256", "sha3", "blake2s", };
+
+#if defined(SCATTERGUN_HAS_SHANI)
+const char * CONDITION_KERNEL = "shani";
+#else
+const char * CONDITION_KERNEL = "lanes";
+#endif
+
+/*
+ * SHA-256 and BLAKE2s share their initial values.
+ */
+static const uint32_t H[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint8_t SIGMA[10][16] = {
+    {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15, },
+    { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3, },
+    { 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4, },
+    {  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8, },
+    {  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13, },
+    {  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9, },
+    { 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11, },
+    { 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10, },
+    {  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5, },
+    { 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0, },
+};
+
+static const uint64_t RC[24] = {
+    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL, 0x8000000080008000ULL,
+    0x000000000000808bULL, 0x0000000080000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+    0x000000000000008aULL, 0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+    0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+    0x8000000000008002ULL, 0x8000000000000080ULL, 0x000000000000800aULL, 0x800000008000000aULL,
+    0x8000000080008081ULL, 0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL,
+};
+
+/*
+ * These are the Keccak rotation offsets indexed by X + 5Y.
+ */
+static const int RHO[25] = {
+     0,  1, 62, 28, 27,
+    36, 44,  6, 55, 20,
+     3, 10, 43, 25, 39,
+    41, 45, 15, 21,  8,
+    18,  2, 61, 56, 14,
+};
+
+enum {
+    SHA256_RATE = 64,
+    BLAKE2S_RATE = 64,
+    SHA3_RATE = 136,
+};
+
+#define ROTR32(_X_, _N_) (((_X_) >> (_N_)) | ((_X_) << (32 - (_N_))))
+#define ROTL64(_X_, _N_) (((_X_) << (_N_)) | ((_X_) >> ((64 - (_N_)) & 63)))
+
+static inline uint32_t load32be(const uint8_t * bp)
+{
+    return ((uint32_t)bp[0] << 24) | ((uint32_t)bp[1] << 16) | ((uint32_t)bp[2] << 8) | (uint32_t)bp[3];
+}
+
+static inline uint32_t load32le(const uint8_t * bp)
+{
+    return ((uint32_t)bp[3] << 24) | ((uint32_t)bp[2] << 16) | ((uint32_t)bp[1] << 8) | (uint32_t)bp[0];
+}
+
+static inline uint64_t load64le(const uint8_t * bp)
+{
+    return ((uint64_t)load32le(bp + 4) << 32) | load32le(bp);
+}
+
+/**
+ * Copy the part of a block that lies in a chunk of it into the chunk,
+ * filling the rest of the chunk with zeros.
+ * @param block points to the block.
+ * @param size is the size of the block.
+ * @param offset is the offset of the chunk in the block.
+ * @param rate is the size of the chunk.
+ * @param chunk points to the chunk.
+ */
+static void gather(const uint8_t * block, size_t size, size_t offset, size_t rate, uint8_t * chunk)
+{
+    size_t length = 0;
+
+    if (offset < size) {
+        length = size - offset;
+        if (length > rate) { length = rate; }
+        memcpy(chunk, block + offset, length);
+    }
+
+    memset(chunk + length, 0, rate - length);
+}
+
+/**
+ * Pad the chunk of a SHA-256 message at the specified offset.
+ * @param size is the size of the message.
+ * @param offset is the offset of the chunk in the message.
+ * @param last is true if this is the final chunk.
+ * @param chunk points to the chunk.
+ */
+static void sha256_pad(size_t size, size_t offset, int last, uint8_t * chunk)
+{
+    uint64_t bits = (uint64_t)size * 8;
+    int ii;
+
+    if ((size >= offset) && (size < (offset + SHA256_RATE))) {
+        chunk[size - offset] = 0x80;
+    }
+
+    if (last) {
+        for (ii = 0; ii < 8; ++ii) {
+            chunk[SHA256_RATE - 1 - ii] = bits >> (ii * 8);
+        }
+    }
+}
+
+#if defined(SCATTERGUN_HAS_SHANI)
+
+/**
+ * Compress sixty-four byte chunks into one SHA-256 state using the SHA
+ * extensions.
+ * @param state points to the eight word state.
+ * @param data points to the chunks.
+ * @param chunks is the number of chunks.
+ */
+static void sha256_shani(uint32_t * state, const uint8_t * data, size_t chunks)
+{
+    const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i state0;
+    __m128i state1;
+    __m128i save0;
+    __m128i save1;
+    __m128i message;
+    __m128i temporary;
+    __m128i words[4];
+    int ii;
+
+    /*
+     * The instructions want the state as ABEF and CDGH.
+     */
+
+    temporary = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xb1);
+    state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1b);
+    state0 = _mm_alignr_epi8(temporary, state1, 8);
+    state1 = _mm_blend_epi16(state1, temporary, 0xf0);
+
+    while (chunks-- > 0) {
+
+        save0 = state0;
+        save1 = state1;
+
+        for (ii = 0; ii < 4; ++ii) {
+            words[ii] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + (ii * 16))), MASK);
+        }
+
+        /*
+         * Each pass does four rounds and extends the schedule by the four
+         * words needed twelve rounds later.
+         */
+
+        for (ii = 0; ii < 16; ++ii) {
+            message = _mm_add_epi32(words[ii & 3], _mm_loadu_si128((const __m128i *)&K[ii * 4]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, message);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(message, 0x0e));
+            if (ii < 12) {
+                temporary = _mm_add_epi32(_mm_sha256msg1_epu32(words[ii & 3], words[(ii + 1) & 3]), _mm_alignr_epi8(words[(ii + 3) & 3], words[(ii + 2) & 3], 4));
+                words[ii & 3] = _mm_sha256msg2_epu32(temporary, words[(ii + 3) & 3]);
+            }
+        }
+
+        state0 = _mm_add_epi32(state0, save0);
+        state1 = _mm_add_epi32(state1, save1);
+        data += SHA256_RATE;
+
+    }
+
+    temporary = _mm_shuffle_epi32(state0, 0x1b);
+    state1 = _mm_shuffle_epi32(state1, 0xb1);
+    _mm_storeu_si128((__m128i *)&state[0], _mm_blend_epi16(temporary, state1, 0xf0));
+    _mm_storeu_si128((__m128i *)&state[4], _mm_alignr_epi8(state1, temporary, 8));
+}
+
+/**
+ * Hash one block with SHA-256 using the SHA extensions.
+ * @param block points to the block.
+ * @param size is the size of the block.
+ * @param digest points to the digest.
+ */
+static void sha256_one(const uint8_t * block, size_t size, uint8_t * digest)
+{
+    uint32_t state[8];
+    uint8_t tail[2 * SHA256_RATE];
+    size_t full = size / SHA256_RATE;
+    size_t offset = full * SHA256_RATE;
+    size_t chunks = ((size + 8) / SHA256_RATE) + 1 - full;
+    size_t ii;
+
+    memcpy(state, H, sizeof(state));
+    sha256_shani(state, block, full);
+
+    for (ii = 0; ii < chunks; ++ii) {
+        gather(block, size, offset + (ii * SHA256_RATE), SHA256_RATE, tail + (ii * SHA256_RATE));
+        sha256_pad(size, offset + (ii * SHA256_RATE), ii == (chunks - 1), tail + (ii * SHA256_RATE));
+    }
+    sha256_shani(state, tail, chunks);
+
+    for (ii = 0; ii < 8; ++ii) {
+        digest[ii * 4] = state[ii] >> 24;
+        digest[ii * 4 + 1] = state[ii] >> 16;
+        digest[ii * 4 + 2] = state[ii] >> 8;
+        digest[ii * 4 + 3] = state[ii];
+    }
+
+    memset(state, 0, sizeof(state));
+    memset(tail, 0, sizeof(tail));
+}
+
+#endif
+
+/**
+ * Hash LANES blocks with SHA-256 side by side.
+ * @param blocks points to the blocks.
+ * @param size is the size of each block.
+ * @param digests points to the digests.
+ */
+static void sha256_lanes(const uint8_t * const * blocks, size_t size, uint8_t * const * digests)
+{
+    uint32_t s[8][LANES];
+    uint32_t v[8][LANES];
+    uint32_t w[64][LANES];
+    uint8_t chunk[SHA256_RATE];
+    size_t chunks = ((size + 8) / SHA256_RATE) + 1;
+    size_t cc;
+    int lane;
+    int ii;
+
+    for (ii = 0; ii < 8; ++ii) {
+        for (lane = 0; lane < LANES; ++lane) {
+            s[ii][lane] = H[ii];
+        }
+    }
+
+    for (cc = 0; cc < chunks; ++cc) {
+
+        for (lane = 0; lane < LANES; ++lane) {
+            gather(blocks[lane], size, cc * SHA256_RATE, SHA256_RATE, chunk);
+            sha256_pad(size, cc * SHA256_RATE, cc == (chunks - 1), chunk);
+            for (ii = 0; ii < 16; ++ii) {
+                w[ii][lane] = load32be(chunk + (ii * 4));
+            }
+        }
+
+        for (ii = 16; ii < 64; ++ii) {
+            for (lane = 0; lane < LANES; ++lane) {
+                uint32_t t1 = ROTR32(w[ii - 2][lane], 17) ^ ROTR32(w[ii - 2][lane], 19) ^ (w[ii - 2][lane] >> 10);
+                uint32_t t2 = ROTR32(w[ii - 15][lane], 7) ^ ROTR32(w[ii - 15][lane], 18) ^ (w[ii - 15][lane] >> 3);
+                w[ii][lane] = t1 + w[ii - 7][lane] + t2 + w[ii - 16][lane];
+            }
+        }
+
+        memcpy(v, s, sizeof(v));
+
+        for (ii = 0; ii < 64; ++ii) {
+            for (lane = 0; lane < LANES; ++lane) {
+                uint32_t a = v[0][lane];
+                uint32_t e = v[4][lane];
+                uint32_t t1 = v[7][lane] + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) + ((e & v[5][lane]) ^ (~e & v[6][lane])) + K[ii] + w[ii][lane];
+                uint32_t t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) + ((a & v[1][lane]) ^ (a & v[2][lane]) ^ (v[1][lane] & v[2][lane]));
+                v[7][lane] = v[6][lane];
+                v[6][lane] = v[5][lane];
+                v[5][lane] = e;
+                v[4][lane] = v[3][lane] + t1;
+                v[3][lane] = v[2][lane];
+                v[2][lane] = v[1][lane];
+                v[1][lane] = a;
+                v[0][lane] = t1 + t2;
+            }
+        }
+
+        for (ii = 0; ii < 8; ++ii) {
+            for (lane = 0; lane < LANES; ++lane) {
+                s[ii][lane] += v[ii][lane];
+            }
+        }
+
+    }
+
+    for (lane = 0; lane < LANES; ++lane) {
+        for (ii = 0; ii < 8; ++ii) {
+            digests[lane][ii * 4] = s[ii][lane] >> 24;
+            digests[lane][ii * 4 + 1] = s[ii][lane] >> 16;
+            digests[lane][ii * 4 + 2] = s[ii][lane] >> 8;
+            digests[lane][ii * 4 + 3] = s[ii][lane];
+        }
+    }
+
+    memset(s, 0, sizeof(s));
+    memset(v, 0, sizeof(v));
+    memset(w, 0, sizeof(w));
+    memset(chunk, 0, sizeof(chunk));
+}
+
+/**
+ * Hash LANES blocks with BLAKE2s-256, unkeyed, side by side.
+ * @param blocks points to the blocks.
+ * @param size is the size of each block.
+ * @param digests points to the digests.
+ */
+static void blake2s_lanes(const uint8_t * const * blocks, size_t size, uint8_t * const * digests)
+{
+    static const int G[8][4] = {
+        { 0, 4,  8, 12, }, { 1, 5,  9, 13, }, { 2, 6, 10, 14, }, { 3, 7, 11, 15, },
+        { 0, 5, 10, 15, }, { 1, 6, 11, 12, }, { 2, 7,  8, 13, }, { 3, 4,  9, 14, },
+    };
+    uint32_t h[8][LANES];
+    uint32_t v[16][LANES];
+    uint32_t m[16][LANES];
+    uint8_t chunk[BLAKE2S_RATE];
+    size_t chunks = (size > 0) ? ((size + BLAKE2S_RATE - 1) / BLAKE2S_RATE) : 1;
+    uint64_t counter = 0;
+    size_t cc;
+    int round;
+    int lane;
+    int ii;
+
+    for (ii = 0; ii < 8; ++ii) {
+        for (lane = 0; lane < LANES; ++lane) {
+            h[ii][lane] = H[ii];
+        }
+    }
+    for (lane = 0; lane < LANES; ++lane) {
+        h[0][lane] ^= 0x01010000 ^ CONDITION_DIGEST;
+    }
+
+    for (cc = 0; cc < chunks; ++cc) {
+
+        for (lane = 0; lane < LANES; ++lane) {
+            gather(blocks[lane], size, cc * BLAKE2S_RATE, BLAKE2S_RATE, chunk);
+            for (ii = 0; ii < 16; ++ii) {
+                m[ii][lane] = load32le(chunk + (ii * 4));
+            }
+        }
+
+        counter = (cc == (chunks - 1)) ? size : ((cc + 1) * BLAKE2S_RATE);
+
+        for (lane = 0; lane < LANES; ++lane) {
+            for (ii = 0; ii < 8; ++ii) {
+                v[ii][lane] = h[ii][lane];
+                v[ii + 8][lane] = H[ii];
+            }
+            v[12][lane] ^= (uint32_t)counter;
+            v[13][lane] ^= (uint32_t)(counter >> 32);
+            if (cc == (chunks - 1)) {
+                v[14][lane] = ~v[14][lane];
+            }
+        }
+
+        for (round = 0; round < 10; ++round) {
+            for (ii = 0; ii < 8; ++ii) {
+                const int a = G[ii][0];
+                const int b = G[ii][1];
+                const int c = G[ii][2];
+                const int d = G[ii][3];
+                const int x = SIGMA[round][ii * 2];
+                const int y = SIGMA[round][ii * 2 + 1];
+                for (lane = 0; lane < LANES; ++lane) {
+                    v[a][lane] = v[a][lane] + v[b][lane] + m[x][lane];
+                    v[d][lane] = ROTR32(v[d][lane] ^ v[a][lane], 16);
+                    v[c][lane] = v[c][lane] + v[d][lane];
+                    v[b][lane] = ROTR32(v[b][lane] ^ v[c][lane], 12);
+                    v[a][lane] = v[a][lane] + v[b][lane] + m[y][lane];
+                    v[d][lane] = ROTR32(v[d][lane] ^ v[a][lane], 8);
+                    v[c][lane] = v[c][lane] + v[d][lane];
+                    v[b][lane] = ROTR32(v[b][lane] ^ v[c][lane], 7);
+                }
+            }
+        }
+
+        for (ii = 0; ii < 8; ++ii) {
+            for (lane = 0; lane < LANES; ++lane) {
+                h[ii][lane] ^= v[ii][lane] ^ v[ii + 8][lane];
+            }
+        }
+
+    }
+
+    for (lane = 0; lane < LANES; ++lane) {
+        for (ii = 0; ii < 8; ++ii) {
+            digests[lane][ii * 4] = h[ii][lane];
+            digests[lane][ii * 4 + 1] = h[ii][lane] >> 8;
+            digests[lane][ii * 4 + 2] = h[ii][lane] >> 16;
+            digests[lane][ii * 4 + 3] = h[ii][lane] >> 24;
+        }
+    }
+
+    memset(h, 0, sizeof(h));
+    memset(v, 0, sizeof(v));
+    memset(m, 0, sizeof(m));
+    memset(chunk, 0, sizeof(chunk));
+}
+
+/**
+ * Hash LANES blocks with SHA3-256 side by side.
+ * @param blocks points to the blocks.
+ * @param size is the size of each block.
+ * @param digests points to the digests.
+ */
+static void sha3_lanes(const uint8_t * const * blocks, size_t size, uint8_t * const * digests)
+{
+    uint64_t a[25][LANES];
+    uint64_t b[25][LANES];
+    uint64_t c[5][LANES];
+    uint64_t d[5][LANES];
+    uint8_t chunk[SHA3_RATE];
+    size_t chunks = (size / SHA3_RATE) + 1;
+    size_t cc;
+    int round;
+    int lane;
+    int x;
+    int y;
+    int ii;
+
+    memset(a, 0, sizeof(a));
+
+    for (cc = 0; cc < chunks; ++cc) {
+
+        for (lane = 0; lane < LANES; ++lane) {
+            gather(blocks[lane], size, cc * SHA3_RATE, SHA3_RATE, chunk);
+            if (cc == (chunks - 1)) {
+                chunk[size - (cc * SHA3_RATE)] |= 0x06;
+                chunk[SHA3_RATE - 1] |= 0x80;
+            }
+            for (ii = 0; ii < (SHA3_RATE / 8); ++ii) {
+                a[ii][lane] ^= load64le(chunk + (ii * 8));
+            }
+        }
+
+        for (round = 0; round < 24; ++round) {
+
+            for (x = 0; x < 5; ++x) {
+                for (lane = 0; lane < LANES; ++lane) {
+                    c[x][lane] = a[x][lane] ^ a[x + 5][lane] ^ a[x + 10][lane] ^ a[x + 15][lane] ^ a[x + 20][lane];
+                }
+            }
+            for (x = 0; x < 5; ++x) {
+                for (lane = 0; lane < LANES; ++lane) {
+                    d[x][lane] = c[(x + 4) % 5][lane] ^ ROTL64(c[(x + 1) % 5][lane], 1);
+                }
+            }
+
+            /*
+             * Theta, then rho and pi into B.
+             */
+
+            for (y = 0; y < 5; ++y) {
+                for (x = 0; x < 5; ++x) {
+                    const int from = x + (5 * y);
+                    const int to = y + (5 * (((2 * x) + (3 * y)) % 5));
+                    const int r = RHO[from];
+                    for (lane = 0; lane < LANES; ++lane) {
+                        uint64_t t = a[from][lane] ^ d[x][lane];
+                        b[to][lane] = ROTL64(t, r);
+                    }
+                }
+            }
+
+            /*
+             * Chi and iota.
+             */
+
+            for (y = 0; y < 25; y += 5) {
+                for (x = 0; x < 5; ++x) {
+                    for (lane = 0; lane < LANES; ++lane) {
+                        a[y + x][lane] = b[y + x][lane] ^ (~b[y + ((x + 1) % 5)][lane] & b[y + ((x + 2) % 5)][lane]);
+                    }
+                }
+            }
+            for (lane = 0; lane < LANES; ++lane) {
+                a[0][lane] ^= RC[round];
+            }
+
+        }
+
+    }
+
+    for (lane = 0; lane < LANES; ++lane) {
+        for (ii = 0; ii < CONDITION_DIGEST; ++ii) {
+            digests[lane][ii] = a[ii / 8][lane] >> ((ii % 8) * 8);
+        }
+    }
+
+    memset(a, 0, sizeof(a));
+    memset(b, 0, sizeof(b));
+    memset(c, 0, sizeof(c));
+    memset(d, 0, sizeof(d));
+    memset(chunk, 0, sizeof(chunk));
+}
+
+int condition_parse(const char * name)
+{
+    int ii;
+
+    for (ii = 0; ii < CONDITION_ALGORITHMS; ++ii) {
+        if (strcmp(name, CONDITION_NAMES[ii]) == 0) {
+            return ii;
+        }
+    }
+
+    errno = EINVAL;
+
+    return -1;
+}
+
+void condition_blocks(enum condition_algorithm algorithm, const void * input, size_t size, size_t count, void * output)
+{
+    const uint8_t * in = (const uint8_t *)input;
+    uint8_t * out = (uint8_t *)output;
+    const uint8_t * blocks[LANES];
+    uint8_t * digests[LANES];
+    uint8_t spare[LANES][CONDITION_DIGEST];
+    size_t base = 0;
+    size_t length = 0;
+    int lane;
+
+    for (base = 0; base < count; base += length) {
+
+#if defined(SCATTERGUN_HAS_SHANI)
+        if (algorithm == CONDITION_SHA256) {
+            sha256_one(in + (base * size), size, out + (base * CONDITION_DIGEST));
+            length = 1;
+            continue;
+        }
+#endif
+
+        /*
+         * If there are fewer than LANES blocks left, the spare lanes hash
+         * the first block again and their digests are discarded.
+         */
+
+        length = ((count - base) < LANES) ? (count - base) : LANES;
+        for (lane = 0; lane < LANES; ++lane) {
+            if (lane < length) {
+                blocks[lane] = in + ((base + lane) * size);
+                digests[lane] = out + ((base + lane) * CONDITION_DIGEST);
+            } else {
+                blocks[lane] = in + (base * size);
+                digests[lane] = spare[lane];
+            }
+        }
+
+        switch (algorithm) {
+        case CONDITION_SHA256:
+            sha256_lanes(blocks, size, digests);
+            break;
+        case CONDITION_SHA3:
+            sha3_lanes(blocks, size, digests);
+            break;
+        case CONDITION_BLAKE2S:
+            blake2s_lanes(blocks, size, digests);
+            break;
+        default:
+            memset(out + (base * CONDITION_DIGEST), 0, length * CONDITION_DIGEST);
+            break;
+        }
+
+    }
+
+    memset(spare, 0, sizeof(spare));
+}
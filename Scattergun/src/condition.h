@@ -0,0 +1,78 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+#ifndef _H_COM_DIAG_SCATTERGUN_CONDITION_
+#define _H_COM_DIAG_SCATTERGUN_CONDITION_
+
+/**
+ * @file
+ * Condition<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * Implements the conditioning of raw entropy by hashing blocks of input into
+ * thirty-two byte digests with SHA-256 (FIPS 180-4), SHA3-256 (FIPS 202), or
+ * BLAKE2s-256 (RFC 7693). SHA-256 and SHA3-256 are among the vetted
+ * conditioning components of NIST SP 800-90B 3.1.5.1.1; BLAKE2s is not, so
+ * its output may only be credited with the entropy assessed for it. Blocks
+ * of equal size are hashed CONDITION_LANES at a time, with the state of each
+ * kept as an array indexed by lane so that the compiler can generate SIMD
+ * code that hashes them all at once on any architecture without intrinsics.
+ * If built with SCATTERGUN_HAS_SHANI, SHA-256 instead uses the SHA
+ * extensions of Intel and AMD processors one block at a time, which is
+ * faster still. This is part of the Scattergun project.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * This is the number of bytes in a digest.
+ */
+#define CONDITION_DIGEST 32
+
+/**
+ * This is the number of blocks each algorithm hashes side by side.
+ */
+#define CONDITION_LANES 8
+
+enum condition_algorithm {
+    CONDITION_SHA256 = 0,
+    CONDITION_SHA3 = 1,
+    CONDITION_BLAKE2S = 2,
+    CONDITION_ALGORITHMS = 3,
+};
+
+/**
+ * These are the names of the algorithms indexed by algorithm.
+ */
+extern const char * CONDITION_NAMES[CONDITION_ALGORITHMS];
+
+/**
+ * This is the name of the SHA-256 implementation, "shani" or "lanes".
+ */
+extern const char * CONDITION_KERNEL;
+
+/**
+ * Return the algorithm with the specified name.
+ * @param name is the name of the algorithm.
+ * @return the algorithm, or <0 with errno set for failure.
+ */
+extern int condition_parse(const char * name);
+
+/**
+ * Hash each of an array of blocks of the same size into its own digest.
+ * @param algorithm is the algorithm.
+ * @param input points to the blocks, one after another.
+ * @param size is the size of each block in bytes.
+ * @param count is the number of blocks.
+ * @param output points to the count digests of CONDITION_DIGEST bytes.
+ */
+extern void condition_blocks(enum condition_algorithm algorithm, const void * input, size_t size, size_t count, void * output);
+
+#endif
@@ -0,0 +1,293 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Conditioner<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * conditioner [ -h ] [ -v ] [ -a ALGORITHM ] [ -r BYTES ] [ -b BLOCKS ]
+ *
+ * OPTIONS
+ *
+ * -a ALGORITHM    Hash with sha256 (default), sha3, or blake2s.
+ * -b BLOCKS       Read and hash BLOCKS blocks at a time (default 4096).
+ * -h              Display this menu.
+ * -r BYTES        Hash every BYTES bytes into 32 bytes (default 64).
+ * -v              Display verbose output to stderr.
+ *
+ * EXAMPLES
+ *
+ * cat /dev/TrueRNGpro | conditioner -r 128 | rngtest
+ *
+ * quantistool -U 0 | conditioner -a sha3 -r 64 > conditioned.dat
+ *
+ * baseline -t 1000000000 | conditioner -a blake2s > /dev/null
+ *
+ * ABSTRACT
+ *
+ * Reads blocks of BYTES bytes from standard input, hashes each into a
+ * thirty-two byte digest, and writes the digests to standard output, as a
+ * pipe stage that conditions raw entropy the same way feeder does inline
+ * (see condition.h). The compression ratio is BYTES to 32: for the output to
+ * be credited with full entropy under SP 800-90B, each block must carry at
+ * least 256 bits (plus a small margin) of assessed min-entropy. Many blocks
+ * are read at a time so that they can be hashed several at once. A partial
+ * block at the end is discarded. When done the throughput is displayed on
+ * standard error, in bytes per second and, on processors with a time stamp
+ * counter, in input bytes per cycle. This is part of the Scattergun project.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include "condition.h"
+
+static const char * program = "conditioner";
+static int done = 0;
+
+static void handler(int signum)
+{
+    if (signum == SIGPIPE) {
+        done = !0;
+    } else if (signum == SIGINT) {
+        done = !0;
+    } else if (signum == SIGTERM) {
+        done = !0;
+    } else {
+        /* Do nothing. */
+    }
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [ -h ] [ -v ] [ -a ALGORITHM ] [ -r BYTES ] [ -b BLOCKS ]\n", program);
+    fprintf(stderr, "       -a ALGORITHM    Hash with sha256 (default), sha3, or blake2s.\n");
+    fprintf(stderr, "       -b BLOCKS       Read and hash BLOCKS blocks at a time (default 4096).\n");
+    fprintf(stderr, "       -h              Display this menu.\n");
+    fprintf(stderr, "       -r BYTES        Hash every BYTES bytes into 32 bytes (default 64).\n");
+    fprintf(stderr, "       -v              Display verbose output to stderr.\n");
+}
+
+/**
+ * Return the value of the monotonic clock in seconds.
+ * @return the value of the monotonic clock in seconds.
+ */
+static double now(void)
+{
+    struct timespec ts = { 0 };
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+}
+
+/**
+ * Return the value of the processor's time stamp counter.
+ * @return the number of cycles, or zero if there is no counter.
+ */
+static uint64_t cycles(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    uint32_t low;
+    uint32_t high;
+
+    asm volatile ("rdtsc" : "=a" (low), "=d" (high));
+
+    return ((uint64_t)high << 32) | low;
+#else
+    return 0;
+#endif
+}
+
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int verbose = 0;
+    int algorithm = CONDITION_SHA256;
+    size_t ratio = 2 * CONDITION_DIGEST;
+    size_t batch = 4096;
+    size_t length = 0;
+    size_t blocks = 0;
+    size_t bytes = 0;
+    size_t written = 0;
+    ssize_t rc = 0;
+    uint8_t * input = (uint8_t *)0;
+    uint8_t * output = (uint8_t *)0;
+    unsigned long long total = 0;
+    unsigned long long hashed = 0;
+    unsigned long long conditioned = 0;
+    uint64_t spent = 0;
+    uint64_t before = 0;
+    struct sigaction action = { 0 };
+    double start = 0.0;
+    double seconds = 0.0;
+    char * end = (char *)0;
+    int opt;
+    extern char * optarg;
+    extern int optind;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "a:b:hr:v")) >= 0) {
+
+        switch (opt) {
+
+        case 'a':
+            algorithm = condition_parse(optarg);
+            if (algorithm < 0) {
+                error = !0;
+            }
+            break;
+
+        case 'b':
+            batch = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (batch == 0)) {
+                error = !0;
+            }
+            break;
+
+        case 'h':
+            usage();
+            return 0;
+
+        case 'r':
+            ratio = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (ratio < CONDITION_DIGEST)) {
+                error = !0;
+            }
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        default:
+            error = !0;
+            break;
+
+        }
+
+    }
+
+    if ((optind < argc) || error) {
+        usage();
+        return 1;
+    }
+
+    do {
+
+        action.sa_handler = handler;
+        action.sa_flags = 0;
+        if (sigaction(SIGPIPE, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+        if (sigaction(SIGINT, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+        if (sigaction(SIGTERM, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+
+        input = (uint8_t *)malloc(batch * ratio);
+        output = (uint8_t *)malloc(batch * CONDITION_DIGEST);
+        if ((input == (uint8_t *)0) || (output == (uint8_t *)0)) {
+            perror("malloc");
+            break;
+        }
+
+        if (verbose) {
+            fprintf(stderr, "%s: algorithm    \"%s\"\n", program, CONDITION_NAMES[algorithm]);
+            fprintf(stderr, "%s: kernel       \"%s\"\n", program, CONDITION_KERNEL);
+            fprintf(stderr, "%s: lanes        %d\n", program, CONDITION_LANES);
+            fprintf(stderr, "%s: ratio        %zu\n", program, ratio);
+            fprintf(stderr, "%s: batch        %zu\n", program, batch);
+        }
+
+        start = now();
+        while (!done) {
+
+            /*
+             * Hash whatever whole blocks have arrived rather than waiting
+             * for a whole batch, so that a slow source is not held up.
+             */
+
+            rc = read(STDIN_FILENO, input + length, (batch * ratio) - length);
+            if (rc > 0) {
+                length += rc;
+                total += rc;
+            } else if ((rc < 0) && (errno == EINTR) && (!done)) {
+                continue;
+            } else {
+                if (rc < 0) { perror("read"); }
+                break;
+            }
+
+            blocks = length / ratio;
+            if (blocks == 0) {
+                continue;
+            }
+
+            before = cycles();
+            condition_blocks(algorithm, input, ratio, blocks, output);
+            spent += cycles() - before;
+            hashed += blocks * ratio;
+
+            length -= blocks * ratio;
+            memmove(input, input + (blocks * ratio), length);
+
+            bytes = blocks * CONDITION_DIGEST;
+            for (written = 0; written < bytes; written += rc) {
+                rc = write(STDOUT_FILENO, output + written, bytes - written);
+                if (rc > 0) {
+                    /* Do nothing. */
+                } else if ((rc < 0) && (errno == EINTR) && (!done)) {
+                    rc = 0;
+                } else {
+                    break;
+                }
+            }
+            conditioned += written;
+            if (written < bytes) {
+                if ((rc < 0) && (errno != EPIPE)) { perror("write"); }
+                break;
+            }
+
+        }
+        seconds = now() - start;
+
+        fprintf(stderr, "%s: algorithm=\"%s\" kernel=\"%s\" ratio=%zu bytes=%llu conditioned=%llu seconds=%.6f rate=%.0f bytespercycle=%.3f\n", program,
+            CONDITION_NAMES[algorithm], CONDITION_KERNEL, ratio, total, conditioned, seconds,
+            (seconds > 0.0) ? (total / seconds) : 0.0,
+            (spent > 0) ? ((double)hashed / spent) : 0.0);
+
+        xc = 0;
+
+    } while (0);
+
+    if (input != (uint8_t *)0) {
+        memset(input, 0, batch * ratio);
+        free(input);
+    }
+    if (output != (uint8_t *)0) {
+        memset(output, 0, batch * CONDITION_DIGEST);
+        free(output);
+    }
+
+    return xc;
+}
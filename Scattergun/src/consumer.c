@@ -0,0 +1,641 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Consumer<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * consumer [ -h ] [ -v ] [ -H ] [ -n THREADS ] [ -m METHOD[,METHOD...] ] [ -z BYTES[:BYTES] ] [ -d SECONDS | -t CALLS ] [ -p SECONDS ]
+ *
+ * OPTIONS
+ *
+ * -H              Display a latency histogram for each method.
+ * -d SECONDS      Stop after SECONDS (default 10).
+ * -h              Display this menu.
+ * -m METHODS      Use these methods in turn (default getrandom,urandom,random).
+ * -n THREADS      Run THREADS consumer threads (default 8).
+ * -p SECONDS      Display the aggregate throughput every SECONDS.
+ * -t CALLS        Stop after CALLS calls in all (instead of -d).
+ * -v              Display verbose output to stderr.
+ * -z BYTES:BYTES  Request between BYTES and BYTES bytes per call (default 32).
+ *
+ * METHODS
+ *
+ * getrandom       getrandom(2) with no flags.
+ * nonblock        getrandom(2) with GRND_NONBLOCK.
+ * grndrandom      getrandom(2) with GRND_RANDOM.
+ * both            getrandom(2) with GRND_RANDOM and GRND_NONBLOCK.
+ * random          read(2) of /dev/random.
+ * urandom         read(2) of /dev/urandom.
+ * /PATH           read(2) of any other path.
+ *
+ * EXAMPLES
+ *
+ * consumer -n 256 -d 60 -H
+ *
+ * consumer -n 64 -m random -z 1:512 -p 1
+ *
+ * consumer -n 1 -m /dev/hwrng -z 4096 -t 100
+ *
+ * ABSTRACT
+ *
+ * Generates a load on the kernel random number generator from many threads
+ * at once, so that the latency seen by its consumers can be measured while a
+ * feeder, truerngd, or rngd is keeping the pool filled. Each thread makes
+ * calls using each of the methods in turn, starting at a different method
+ * than its neighbor, requesting a number of bytes drawn uniformly from the
+ * range, and records the latency of each call in its own histogram, so the
+ * threads do not contend for anything but the kernel. A call that returns
+ * fewer bytes than requested is counted as short, and one that would block
+ * is counted separately from other errors. When done the histograms of all
+ * the threads are merged and, for each method, the number of calls and bytes,
+ * the throughput, and the mean, median, 99th and 99.9th percentile, and worst
+ * latency are displayed, followed by the aggregate throughput. Percentiles
+ * are the upper bounds of the power of two nanosecond buckets in which they
+ * fall. This is part of the Scattergun project.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+#if !defined(GRND_NONBLOCK)
+#   define GRND_NONBLOCK 0x0001
+#endif
+
+#if !defined(GRND_RANDOM)
+#   define GRND_RANDOM 0x0002
+#endif
+
+enum {
+    METHODS = 8,        /* Most methods. */
+    BUCKETS = 40,       /* Power of two nanosecond buckets. */
+    MAXIMUM = 1 << 20,  /* Largest request in bytes. */
+};
+
+/**
+ * This is how a method gets its bytes.
+ */
+struct method {
+    const char * name;
+    int flags;          /* For getrandom. */
+    int fd;             /* For read, or <0 for getrandom. */
+};
+
+/**
+ * These are the measurements of one method by one thread, or of all threads
+ * once merged. Calls and bytes are also read by the main thread while the
+ * consumer threads are running.
+ */
+struct measure {
+    uint64_t calls;
+    uint64_t bytes;
+    uint64_t shorts;
+    uint64_t wouldblock;
+    uint64_t errors;
+    uint64_t nanoseconds;
+    uint64_t worst;
+    uint64_t histogram[BUCKETS];
+};
+
+/**
+ * This is the state of one consumer thread.
+ */
+struct consumer {
+    pthread_t thread;
+    int index;
+    unsigned int seed;
+    struct measure measures[METHODS];
+};
+
+static const char * program = "consumer";
+static int done = 0;
+static struct method methods[METHODS];
+static int nmethods = 0;
+static size_t smallest = 32;
+static size_t largest = 32;
+static uint64_t limit = 0;
+static uint64_t started = 0;
+
+static void handler(int signum)
+{
+    if (signum == SIGINT) {
+        done = !0;
+    } else if (signum == SIGTERM) {
+        done = !0;
+    } else {
+        /* Do nothing. */
+    }
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [ -h ] [ -v ] [ -H ] [ -n THREADS ] [ -m METHOD[,METHOD...] ] [ -z BYTES[:BYTES] ] [ -d SECONDS | -t CALLS ] [ -p SECONDS ]\n", program);
+    fprintf(stderr, "       -H              Display a latency histogram for each method.\n");
+    fprintf(stderr, "       -d SECONDS      Stop after SECONDS (default 10).\n");
+    fprintf(stderr, "       -h              Display this menu.\n");
+    fprintf(stderr, "       -m METHODS      Use these methods in turn (default getrandom,urandom,random).\n");
+    fprintf(stderr, "       -n THREADS      Run THREADS consumer threads (default 8).\n");
+    fprintf(stderr, "       -p SECONDS      Display the aggregate throughput every SECONDS.\n");
+    fprintf(stderr, "       -t CALLS        Stop after CALLS calls in all (instead of -d).\n");
+    fprintf(stderr, "       -v              Display verbose output to stderr.\n");
+    fprintf(stderr, "       -z BYTES:BYTES  Request between BYTES and BYTES bytes per call (default 32).\n");
+    fprintf(stderr, "       METHODS are getrandom, nonblock, grndrandom, both, random, urandom, or /PATH.\n");
+}
+
+/**
+ * Return the value of the monotonic clock in nanoseconds.
+ * @return the value of the monotonic clock in nanoseconds.
+ */
+static uint64_t now(void)
+{
+    struct timespec ts = { 0 };
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/**
+ * Add a method to the list of methods.
+ * @param name is the name of the method.
+ * @return 0 for success, <0 for failure.
+ */
+static int method(const char * name)
+{
+    struct method * mp = (struct method *)0;
+    const char * path = (const char *)0;
+
+    if (nmethods >= METHODS) {
+        errno = E2BIG;
+        return -1;
+    }
+
+    mp = &(methods[nmethods]);
+    mp->name = name;
+    mp->flags = 0;
+    mp->fd = -1;
+
+    if (strcmp(name, "getrandom") == 0) {
+        /* Do nothing. */
+    } else if (strcmp(name, "nonblock") == 0) {
+        mp->flags = GRND_NONBLOCK;
+    } else if (strcmp(name, "grndrandom") == 0) {
+        mp->flags = GRND_RANDOM;
+    } else if (strcmp(name, "both") == 0) {
+        mp->flags = GRND_RANDOM | GRND_NONBLOCK;
+    } else if (strcmp(name, "random") == 0) {
+        path = "/dev/random";
+    } else if (strcmp(name, "urandom") == 0) {
+        path = "/dev/urandom";
+    } else if (name[0] == '/') {
+        path = name;
+    } else {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (path != (const char *)0) {
+        mp->fd = open(path, O_RDONLY);
+        if (mp->fd < 0) {
+            return -1;
+        }
+    } else {
+#if !defined(SYS_getrandom)
+        errno = ENOSYS;
+        return -1;
+#endif
+    }
+
+    ++nmethods;
+
+    return 0;
+}
+
+/**
+ * Consume entropy using each method in turn until done.
+ * @param argp points to the state of the thread.
+ * @return NULL.
+ */
+static void * consume(void * argp)
+{
+    struct consumer * cp = (struct consumer *)argp;
+    struct method * mp = (struct method *)0;
+    struct measure * sp = (struct measure *)0;
+    uint8_t * buffer = (uint8_t *)0;
+    size_t size = 0;
+    ssize_t rc = 0;
+    uint64_t before = 0;
+    uint64_t latency = 0;
+    int turn = 0;
+    int bucket = 0;
+
+    buffer = (uint8_t *)malloc(largest);
+    if (buffer == (uint8_t *)0) {
+        perror("malloc");
+        return (void *)0;
+    }
+
+    turn = cp->index % nmethods;
+
+    while (!done) {
+
+        /*
+         * The total number of calls is shared by all threads; each one
+         * claims the next call before making it.
+         */
+
+        if (limit > 0) {
+            if (__atomic_fetch_add(&started, 1, __ATOMIC_RELAXED) >= limit) {
+                break;
+            }
+        }
+
+        size = smallest;
+        if (largest > smallest) {
+            size += rand_r(&(cp->seed)) % (largest - smallest + 1);
+        }
+
+        mp = &(methods[turn]);
+        sp = &(cp->measures[turn]);
+        turn = (turn + 1) % nmethods;
+
+        before = now();
+        if (mp->fd < 0) {
+#if defined(SYS_getrandom)
+            rc = syscall(SYS_getrandom, buffer, size, mp->flags);
+#endif
+        } else {
+            rc = read(mp->fd, buffer, size);
+        }
+        latency = now() - before;
+
+        if (rc > 0) {
+            __atomic_store_n(&(sp->calls), sp->calls + 1, __ATOMIC_RELAXED);
+            __atomic_store_n(&(sp->bytes), sp->bytes + rc, __ATOMIC_RELAXED);
+            if ((size_t)rc < size) { ++(sp->shorts); }
+        } else if ((rc < 0) && (errno == EAGAIN)) {
+            ++(sp->wouldblock);
+            continue;
+        } else if ((rc < 0) && (errno == EINTR)) {
+            continue;
+        } else {
+            ++(sp->errors);
+            continue;
+        }
+
+        sp->nanoseconds += latency;
+        if (latency > sp->worst) { sp->worst = latency; }
+        for (bucket = 0; (bucket < (BUCKETS - 1)) && (latency >= (1ULL << bucket)); ++bucket) {
+            continue;
+        }
+        ++(sp->histogram[bucket]);
+
+    }
+
+    memset(buffer, 0, largest);
+    free(buffer);
+
+    return (void *)0;
+}
+
+/**
+ * Return the upper bound of the bucket in which a percentile falls.
+ * @param sp points to the merged measurements.
+ * @param fraction is the percentile as a fraction.
+ * @return the upper bound in nanoseconds.
+ */
+static uint64_t percentile(const struct measure * sp, double fraction)
+{
+    uint64_t target = 0;
+    uint64_t count = 0;
+    int bucket = 0;
+
+    target = (sp->calls * fraction) + 0.5;
+    if (target == 0) { target = 1; }
+
+    for (bucket = 0; bucket < BUCKETS; ++bucket) {
+        count += sp->histogram[bucket];
+        if (count >= target) { break; }
+    }
+    if (bucket >= (BUCKETS - 1)) {
+        return sp->worst;
+    }
+
+    return 1ULL << bucket;
+}
+
+/**
+ * Display the measurements of a method, and optionally its histogram.
+ * @param name is the name of the method.
+ * @param sp points to the merged measurements.
+ * @param seconds is the duration of the run.
+ * @param histogram if true displays the histogram.
+ */
+static void display(const char * name, const struct measure * sp, double seconds, int histogram)
+{
+    static const char GRAPH[] = "==================================================";
+    uint64_t most = 0;
+    int width = 0;
+    int bucket = 0;
+
+    printf("%s: method=\"%s\" calls=%llu bytes=%llu short=%llu wouldblock=%llu errors=%llu rate=%.0f mean=%.3fus p50<=%.3fus p99<=%.3fus p999<=%.3fus worst=%.3fus\n",
+        program, name,
+        (unsigned long long)sp->calls, (unsigned long long)sp->bytes,
+        (unsigned long long)sp->shorts, (unsigned long long)sp->wouldblock, (unsigned long long)sp->errors,
+        (seconds > 0.0) ? (sp->bytes / seconds) : 0.0,
+        (sp->calls > 0) ? ((sp->nanoseconds / 1000.0) / sp->calls) : 0.0,
+        percentile(sp, 0.50) / 1000.0, percentile(sp, 0.99) / 1000.0, percentile(sp, 0.999) / 1000.0,
+        sp->worst / 1000.0);
+
+    if (!histogram) {
+        return;
+    }
+
+    for (bucket = 0; bucket < BUCKETS; ++bucket) {
+        if (sp->histogram[bucket] > most) { most = sp->histogram[bucket]; }
+    }
+
+    for (bucket = 0; bucket < BUCKETS; ++bucket) {
+        if (sp->histogram[bucket] == 0) {
+            continue;
+        }
+        width = (sp->histogram[bucket] * (sizeof(GRAPH) - 1)) / most;
+        if (width == 0) { width = 1; }
+        printf("%s: %-12s <%12.3fus %10llu %.*s\n", program, name, (1ULL << bucket) / 1000.0, (unsigned long long)sp->histogram[bucket], width, GRAPH);
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    static char METHODLIST[] = "getrandom,urandom,random";
+    int xc = 1;
+    int error = 0;
+    int verbose = 0;
+    int histogram = 0;
+    unsigned long threads = 8;
+    double duration = 10.0;
+    double period = 0.0;
+    double seconds = 0.0;
+    char * list = (char *)0;
+    char * name = (char *)0;
+    char * here = (char *)0;
+    char * end = (char *)0;
+    struct consumer * consumers = (struct consumer *)0;
+    struct measure total = { 0 };
+    struct measure merged = { 0 };
+    struct sigaction action = { 0 };
+    uint64_t start = 0;
+    uint64_t stop = 0;
+    uint64_t mark = 0;
+    uint64_t bytes = 0;
+    uint64_t calls = 0;
+    uint64_t prior = 0;
+    struct timespec nap = { 0 };
+    unsigned long created = 0;
+    int opt;
+    int ii;
+    int jj;
+    int kk;
+    extern char * optarg;
+    extern int optind;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "Hd:hm:n:p:t:vz:")) >= 0) {
+
+        switch (opt) {
+
+        case 'H':
+            histogram = !0;
+            break;
+
+        case 'd':
+            duration = strtod(optarg, &end);
+            if ((*end != '\0') || (duration <= 0.0)) {
+                error = !0;
+            }
+            break;
+
+        case 'h':
+            usage();
+            return 0;
+
+        case 'm':
+            list = optarg;
+            break;
+
+        case 'n':
+            threads = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (threads == 0)) {
+                error = !0;
+            }
+            break;
+
+        case 'p':
+            period = strtod(optarg, &end);
+            if ((*end != '\0') || (period <= 0.0)) {
+                error = !0;
+            }
+            break;
+
+        case 't':
+            limit = strtoull(optarg, &end, 0);
+            if ((*end != '\0') || (limit == 0)) {
+                error = !0;
+            }
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        case 'z':
+            smallest = strtoul(optarg, &end, 0);
+            if (*end == ':') {
+                largest = strtoul(end + 1, &end, 0);
+            } else {
+                largest = smallest;
+            }
+            if ((*end != '\0') || (smallest == 0) || (largest < smallest) || (largest > MAXIMUM)) {
+                error = !0;
+            }
+            break;
+
+        default:
+            error = !0;
+            break;
+
+        }
+
+    }
+
+    if (optind < argc) {
+        error = !0;
+    }
+
+    if (error) {
+        usage();
+        return 1;
+    }
+
+    do {
+
+        action.sa_handler = handler;
+        action.sa_flags = 0;
+        if (sigaction(SIGINT, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+        if (sigaction(SIGTERM, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+
+        if (list == (char *)0) {
+            list = METHODLIST;
+        }
+        for (name = strtok_r(list, ",", &here); name != (char *)0; name = strtok_r((char *)0, ",", &here)) {
+            if (method(name) < 0) {
+                perror(name);
+                error = !0;
+                break;
+            }
+        }
+        if (error) {
+            break;
+        }
+        if (nmethods == 0) {
+            usage();
+            break;
+        }
+
+        consumers = (struct consumer *)calloc(threads, sizeof(struct consumer));
+        if (consumers == (struct consumer *)0) {
+            perror("calloc");
+            break;
+        }
+
+        if (verbose) {
+            fprintf(stderr, "%s: threads      %lu\n", program, threads);
+            for (ii = 0; ii < nmethods; ++ii) {
+                fprintf(stderr, "%s: method       \"%s\"\n", program, methods[ii].name);
+            }
+            fprintf(stderr, "%s: smallest     %zu\n", program, smallest);
+            fprintf(stderr, "%s: largest      %zu\n", program, largest);
+            if (limit > 0) {
+                fprintf(stderr, "%s: calls        %llu\n", program, (unsigned long long)limit);
+            } else {
+                fprintf(stderr, "%s: duration     %.3f\n", program, duration);
+            }
+        }
+
+        start = now();
+        for (created = 0; created < threads; ++created) {
+            consumers[created].index = created;
+            consumers[created].seed = start ^ created;
+            errno = pthread_create(&(consumers[created].thread), (pthread_attr_t *)0, consume, &(consumers[created]));
+            if (errno != 0) {
+                perror("pthread_create");
+                done = !0;
+                break;
+            }
+        }
+
+        /*
+         * The main thread only sleeps, optionally waking up each period to
+         * sum the calls and bytes of all threads, which they update with
+         * relaxed atomic stores so that no lock is ever taken.
+         */
+
+        mark = start;
+        nap.tv_sec = 0;
+        nap.tv_nsec = 10000000L;
+        while (!done) {
+            nanosleep(&nap, (struct timespec *)0);
+            stop = now();
+            if ((limit == 0) && (((stop - start) / 1000000000.0) >= duration)) {
+                done = !0;
+            } else if ((limit > 0) && (__atomic_load_n(&started, __ATOMIC_RELAXED) >= limit)) {
+                break;
+            } else if ((period > 0.0) && (((stop - mark) / 1000000000.0) >= period)) {
+                bytes = 0;
+                calls = 0;
+                for (ii = 0; ii < (int)created; ++ii) {
+                    for (jj = 0; jj < nmethods; ++jj) {
+                        bytes += __atomic_load_n(&(consumers[ii].measures[jj].bytes), __ATOMIC_RELAXED);
+                        calls += __atomic_load_n(&(consumers[ii].measures[jj].calls), __ATOMIC_RELAXED);
+                    }
+                }
+                fprintf(stderr, "%s: seconds=%.3f calls=%llu rate=%.0f\n", program,
+                    (stop - start) / 1000000000.0, (unsigned long long)calls,
+                    (bytes - prior) / ((stop - mark) / 1000000000.0));
+                prior = bytes;
+                mark = stop;
+            } else {
+                /* Do nothing. */
+            }
+        }
+
+        for (ii = 0; ii < (int)created; ++ii) {
+            pthread_join(consumers[ii].thread, (void **)0);
+        }
+        stop = now();
+        seconds = (stop - start) / 1000000000.0;
+
+        for (jj = 0; jj < nmethods; ++jj) {
+            memset(&merged, 0, sizeof(merged));
+            for (ii = 0; ii < (int)created; ++ii) {
+                const struct measure * sp = &(consumers[ii].measures[jj]);
+                merged.calls += sp->calls;
+                merged.bytes += sp->bytes;
+                merged.shorts += sp->shorts;
+                merged.wouldblock += sp->wouldblock;
+                merged.errors += sp->errors;
+                merged.nanoseconds += sp->nanoseconds;
+                if (sp->worst > merged.worst) { merged.worst = sp->worst; }
+                for (kk = 0; kk < BUCKETS; ++kk) {
+                    merged.histogram[kk] += sp->histogram[kk];
+                }
+            }
+            display(methods[jj].name, &merged, seconds, histogram);
+            total.calls += merged.calls;
+            total.bytes += merged.bytes;
+            total.errors += merged.errors + merged.wouldblock;
+        }
+
+        printf("%s: threads=%lu seconds=%.3f calls=%llu bytes=%llu failures=%llu rate=%.0f\n",
+            program, created, seconds, (unsigned long long)total.calls, (unsigned long long)total.bytes,
+            (unsigned long long)total.errors, (seconds > 0.0) ? (total.bytes / seconds) : 0.0);
+
+        xc = (created == threads) ? 0 : 1;
+
+    } while (0);
+
+    for (ii = 0; ii < nmethods; ++ii) {
+        if (methods[ii].fd >= 0) {
+            close(methods[ii].fd);
+        }
+    }
+
+    if (consumers != (struct consumer *)0) {
+        free(consumers);
+    }
+
+    return xc;
+}
@@ -0,0 +1,506 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Corpus<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * corpus [ -h ] [ -v ] [ -c ] [ -s SEED ] [ -j THREADS ] [ -z BYTES ] [ -o OFFSET ] -t BYTES [ PATH ]
+ *
+ * OPTIONS
+ *
+ * -c              Verify PATH against the corpus instead of writing it.
+ * -h              Display this menu.
+ * -j THREADS      Use THREADS threads (default the number of processors).
+ * -o OFFSET       Start at byte OFFSET of the corpus (default 0).
+ * -s SEED         Use the corpus for SEED (default 0).
+ * -t BYTES        Write or verify BYTES bytes.
+ * -v              Display verbose output to stderr.
+ * -z BYTES        Give each thread BYTES at a time (default 4194304).
+ *
+ * EXAMPLES
+ *
+ * corpus -s 0xDEADBEEF -t 107374182400 corpus.dat
+ *
+ * corpus -s 0xDEADBEEF -c -t 107374182400 corpus.dat
+ *
+ * corpus -s 0xDEADBEEF -o 53687091200 -t 4096 | od -t x1
+ *
+ * ABSTRACT
+ *
+ * Writes a reproducible pseudo-random test corpus using the counter based
+ * Philox4x32-10 generator keyed by SEED, in which every sixteen byte block
+ * is computed from its position alone. The region of the corpus from OFFSET
+ * for BYTES is divided into chunks that threads claim in turn and write into
+ * PATH at their own offsets using pwrite(2), so the corpus is written in
+ * parallel, and the same bytes result no matter how many threads (or how
+ * many separate invocations writing different regions of the same file)
+ * are used. PATH is created if need be but never truncated. Without PATH
+ * the region is written to standard output, so that any part of a corpus
+ * can be regenerated on demand while debugging a test. With -c the region
+ * of PATH is read and compared instead, and the offset of the first byte
+ * that differs is displayed. The corpus for SEED is the same as the output
+ * of "baseline -a philox -s SEED". This is part of the Scattergun project.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "prng.h"
+
+/**
+ * This is the work shared by all of the threads.
+ */
+struct work {
+    pthread_mutex_t mutex;
+    uint32_t key[2];
+    int fd;
+    int verify;
+    uint64_t offset;
+    uint64_t total;
+    size_t chunk;
+    uint64_t chunks;
+    uint64_t next;
+    uint64_t done;
+    uint64_t mismatch;
+    int error;
+};
+
+static const char * program = "corpus";
+static int done = 0;
+
+static void handler(int signum)
+{
+    if (signum == SIGPIPE) {
+        done = !0;
+    } else if (signum == SIGINT) {
+        done = !0;
+    } else if (signum == SIGTERM) {
+        done = !0;
+    } else {
+        /* Do nothing. */
+    }
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [ -h ] [ -v ] [ -c ] [ -s SEED ] [ -j THREADS ] [ -z BYTES ] [ -o OFFSET ] -t BYTES [ PATH ]\n", program);
+    fprintf(stderr, "       -c              Verify PATH against the corpus instead of writing it.\n");
+    fprintf(stderr, "       -h              Display this menu.\n");
+    fprintf(stderr, "       -j THREADS      Use THREADS threads (default the number of processors).\n");
+    fprintf(stderr, "       -o OFFSET       Start at byte OFFSET of the corpus (default 0).\n");
+    fprintf(stderr, "       -s SEED         Use the corpus for SEED (default 0).\n");
+    fprintf(stderr, "       -t BYTES        Write or verify BYTES bytes.\n");
+    fprintf(stderr, "       -v              Display verbose output to stderr.\n");
+    fprintf(stderr, "       -z BYTES        Give each thread BYTES at a time (default 4194304).\n");
+}
+
+/**
+ * Return the value of the monotonic clock in seconds.
+ * @return the value of the monotonic clock in seconds.
+ */
+static double now(void)
+{
+    struct timespec ts = { 0 };
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+}
+
+/**
+ * Generate the bytes of the corpus at any offset.
+ * @param key is the Philox key.
+ * @param offset is the offset of the first byte in the corpus.
+ * @param buffer points to the buffer.
+ * @param size is the size of the buffer in bytes.
+ */
+static void generate(const uint32_t key[2], uint64_t offset, uint8_t * buffer, size_t size)
+{
+    uint8_t block[PRNG_PHILOX_BYTES];
+    size_t skip = offset % PRNG_PHILOX_BYTES;
+    size_t length = 0;
+
+    if (skip > 0) {
+        (void)prng_philox(key, offset / PRNG_PHILOX_BYTES, block, sizeof(block));
+        length = sizeof(block) - skip;
+        if (length > size) { length = size; }
+        memcpy(buffer, block + skip, length);
+        buffer += length;
+        size -= length;
+        offset += length;
+    }
+
+    if (size > 0) {
+        (void)prng_philox(key, offset / PRNG_PHILOX_BYTES, buffer, size);
+    }
+}
+
+/**
+ * Claim chunks of the region until there are none left, generating each one
+ * and either writing it to or comparing it with the file at its offset.
+ * @param argp points to the shared work.
+ * @return NULL.
+ */
+static void * worker(void * argp)
+{
+    struct work * wp = (struct work *)argp;
+    uint8_t * buffer = (uint8_t *)0;
+    uint8_t * actual = (uint8_t *)0;
+    uint64_t index = 0;
+    uint64_t offset = 0;
+    size_t length = 0;
+    size_t moved = 0;
+    ssize_t rc = 0;
+    size_t ii;
+
+    buffer = (uint8_t *)malloc(wp->chunk);
+    actual = wp->verify ? (uint8_t *)malloc(wp->chunk) : buffer;
+    if ((buffer == (uint8_t *)0) || (actual == (uint8_t *)0)) {
+        pthread_mutex_lock(&(wp->mutex));
+        wp->error = ENOMEM;
+        pthread_mutex_unlock(&(wp->mutex));
+        done = !0;
+    }
+
+    while (!done) {
+
+        index = __atomic_fetch_add(&(wp->next), 1, __ATOMIC_RELAXED);
+        if (index >= wp->chunks) {
+            break;
+        }
+
+        offset = index * wp->chunk;
+        length = wp->chunk;
+        if (length > (wp->total - offset)) { length = wp->total - offset; }
+        offset += wp->offset;
+
+        generate(wp->key, offset, buffer, length);
+
+        for (moved = 0; moved < length; moved += rc) {
+            if (wp->verify) {
+                rc = pread(wp->fd, actual + moved, length - moved, offset + moved);
+            } else {
+                rc = pwrite(wp->fd, buffer + moved, length - moved, offset + moved);
+            }
+            if (rc > 0) {
+                /* Do nothing. */
+            } else if ((rc < 0) && (errno == EINTR)) {
+                rc = 0;
+            } else {
+                break;
+            }
+        }
+
+        pthread_mutex_lock(&(wp->mutex));
+        if (moved < length) {
+            wp->error = (rc < 0) ? errno : EIO;
+            if (wp->verify && (rc == 0) && ((offset + moved) < wp->mismatch)) {
+                wp->mismatch = offset + moved;
+                wp->error = 0;
+            }
+        } else if (wp->verify && (memcmp(actual, buffer, length) != 0)) {
+            for (ii = 0; (ii < length) && (actual[ii] == buffer[ii]); ++ii) {
+                continue;
+            }
+            if ((offset + ii) < wp->mismatch) {
+                wp->mismatch = offset + ii;
+            }
+        } else {
+            /* Do nothing. */
+        }
+        wp->done += moved;
+        pthread_mutex_unlock(&(wp->mutex));
+
+        if (moved < length) {
+            break;
+        }
+
+    }
+
+    if ((actual != (uint8_t *)0) && (actual != buffer)) {
+        free(actual);
+    }
+    if (buffer != (uint8_t *)0) {
+        free(buffer);
+    }
+
+    return (void *)0;
+}
+
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int verbose = 0;
+    long threads = 0;
+    uint64_t seed = 0;
+    const char * path = (const char *)0;
+    struct work work = { PTHREAD_MUTEX_INITIALIZER };
+    pthread_t * workers = (pthread_t *)0;
+    uint8_t * buffer = (uint8_t *)0;
+    uint64_t offset = 0;
+    size_t length = 0;
+    size_t written = 0;
+    ssize_t rc = 0;
+    long created = 0;
+    double start = 0.0;
+    double seconds = 0.0;
+    struct sigaction action = { 0 };
+    char * end = (char *)0;
+    int opt;
+    long ii;
+    extern char * optarg;
+    extern int optind;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    work.fd = -1;
+    work.chunk = 4194304;
+    work.mismatch = ~(uint64_t)0;
+
+    while ((opt = getopt(argc, argv, "chj:o:s:t:vz:")) >= 0) {
+
+        switch (opt) {
+
+        case 'c':
+            work.verify = !0;
+            break;
+
+        case 'h':
+            usage();
+            return 0;
+
+        case 'j':
+            threads = strtol(optarg, &end, 0);
+            if ((*end != '\0') || (threads <= 0)) {
+                error = !0;
+            }
+            break;
+
+        case 'o':
+            work.offset = strtoull(optarg, &end, 0);
+            if (*end != '\0') {
+                error = !0;
+            }
+            break;
+
+        case 's':
+            seed = strtoull(optarg, &end, 0);
+            if (*end != '\0') {
+                error = !0;
+            }
+            break;
+
+        case 't':
+            work.total = strtoull(optarg, &end, 0);
+            if ((*end != '\0') || (work.total == 0)) {
+                error = !0;
+            }
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        case 'z':
+            work.chunk = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (work.chunk == 0)) {
+                error = !0;
+            }
+            break;
+
+        default:
+            error = !0;
+            break;
+
+        }
+
+    }
+
+    if (work.total == 0) {
+        error = !0;
+    } else if ((argc - optind) > 1) {
+        error = !0;
+    } else if ((argc - optind) == 1) {
+        path = argv[optind];
+    } else if (work.verify) {
+        error = !0;
+    } else {
+        /* Do nothing. */
+    }
+
+    if (error) {
+        usage();
+        return 1;
+    }
+
+    do {
+
+        action.sa_handler = handler;
+        action.sa_flags = 0;
+        if (sigaction(SIGPIPE, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+        if (sigaction(SIGINT, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+        if (sigaction(SIGTERM, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+
+        work.key[0] = (uint32_t)seed;
+        work.key[1] = (uint32_t)(seed >> 32);
+        work.chunks = (work.total + work.chunk - 1) / work.chunk;
+
+        if (threads == 0) {
+            threads = sysconf(_SC_NPROCESSORS_ONLN);
+            if (threads <= 0) { threads = 1; }
+        }
+        if ((uint64_t)threads > work.chunks) {
+            threads = work.chunks;
+        }
+
+        if (verbose) {
+            fprintf(stderr, "%s: seed         0x%llx\n", program, (unsigned long long)seed);
+            fprintf(stderr, "%s: offset       %llu\n", program, (unsigned long long)work.offset);
+            fprintf(stderr, "%s: bytes        %llu\n", program, (unsigned long long)work.total);
+            fprintf(stderr, "%s: chunk        %zu\n", program, work.chunk);
+            fprintf(stderr, "%s: chunks       %llu\n", program, (unsigned long long)work.chunks);
+            fprintf(stderr, "%s: threads      %ld\n", program, (path != (const char *)0) ? threads : 1);
+            fprintf(stderr, "%s: path         \"%s\"\n", program, (path != (const char *)0) ? path : "-");
+        }
+
+        start = now();
+
+        if (path == (const char *)0) {
+
+            /*
+             * Standard output is written in order by this thread alone.
+             */
+
+            buffer = (uint8_t *)malloc(work.chunk);
+            if (buffer == (uint8_t *)0) {
+                perror("malloc");
+                break;
+            }
+
+            for (offset = 0; (!done) && (offset < work.total); offset += length) {
+                length = work.chunk;
+                if (length > (work.total - offset)) { length = work.total - offset; }
+                generate(work.key, work.offset + offset, buffer, length);
+                for (written = 0; written < length; written += rc) {
+                    rc = write(STDOUT_FILENO, buffer + written, length - written);
+                    if (rc > 0) {
+                        /* Do nothing. */
+                    } else if ((rc < 0) && (errno == EINTR) && (!done)) {
+                        rc = 0;
+                    } else {
+                        break;
+                    }
+                }
+                work.done += written;
+                if (written < length) {
+                    if ((rc < 0) && (errno != EPIPE)) { work.error = errno; }
+                    break;
+                }
+            }
+
+        } else {
+
+            work.fd = open(path, work.verify ? O_RDONLY : (O_WRONLY | O_CREAT), 0644);
+            if (work.fd < 0) {
+                perror(path);
+                break;
+            }
+
+            workers = (pthread_t *)calloc(threads, sizeof(pthread_t));
+            if (workers == (pthread_t *)0) {
+                perror("calloc");
+                break;
+            }
+
+            for (created = 0; created < threads; ++created) {
+                errno = pthread_create(&(workers[created]), (pthread_attr_t *)0, worker, &work);
+                if (errno != 0) {
+                    perror("pthread_create");
+                    break;
+                }
+            }
+
+            for (ii = 0; ii < created; ++ii) {
+                pthread_join(workers[ii], (void **)0);
+            }
+
+            if (created == 0) {
+                break;
+            }
+
+            if ((!work.verify) && (fsync(work.fd) < 0)) {
+                work.error = errno;
+            }
+
+        }
+
+        seconds = now() - start;
+
+        if (work.error != 0) {
+            errno = work.error;
+            perror((path != (const char *)0) ? path : "stdout");
+        }
+
+        if (work.verify && (work.mismatch != ~(uint64_t)0)) {
+            fprintf(stderr, "%s: mismatch=%llu\n", program, (unsigned long long)work.mismatch);
+        }
+
+        fprintf(stderr, "%s: bytes=%llu seconds=%.6f rate=%.0f threads=%ld %s\n", program,
+            (unsigned long long)work.done, seconds, (seconds > 0.0) ? (work.done / seconds) : 0.0,
+            (path != (const char *)0) ? created : 1,
+            work.verify ? ((work.mismatch == ~(uint64_t)0) && (work.done == work.total) ? "verified" : "differs") : "written");
+
+        if (work.error != 0) {
+            break;
+        }
+        if (done && (path != (const char *)0)) {
+            break;
+        }
+        if (work.verify && ((work.mismatch != ~(uint64_t)0) || (work.done != work.total))) {
+            xc = 2;
+            break;
+        }
+
+        xc = 0;
+
+    } while (0);
+
+    if (work.fd >= 0) {
+        close(work.fd);
+    }
+    if (workers != (pthread_t *)0) {
+        free(workers);
+    }
+    if (buffer != (uint8_t *)0) {
+        free(buffer);
+    }
+
+    return xc;
+}
@@ -0,0 +1,543 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Debias<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * debias [ -h ] [ -v ] [ -p DEPTH ] [ -z BYTES ]
+ *
+ * OPTIONS
+ *
+ * -h              Display this menu.
+ * -p DEPTH        Iterate Peres extraction DEPTH levels (default 0, which is von Neumann).
+ * -v              Display verbose output to stderr.
+ * -z BYTES        Extract from blocks of BYTES (default 65536).
+ *
+ * EXAMPLES
+ *
+ * cat /dev/ttyACM0 | debias -p 4 | rngtest
+ *
+ * debias < biased.dat > debiased.dat
+ *
+ * faults -d bias:0.6 -t 100000000 | debias -p 8 > /dev/null
+ *
+ * ABSTRACT
+ *
+ * Reads bits from standard input, removes their bias, and writes the
+ * extracted bits to standard output, so that it can sit between any source
+ * and any sink, including rngd. With a depth of zero it is the von Neumann
+ * extractor: of each pair of bits, 01 gives 0, 10 gives 1, and 00 and 11 give
+ * nothing, which for independent bits with any bias gives unbiased output but
+ * at best a quarter of the input. With a depth of N it is the Peres extractor
+ * iterated N levels: it also extracts recursively from the exclusive OR of
+ * each pair and from one bit of each equal pair, which recovers much of what
+ * von Neumann discards and approaches the Shannon entropy of the input as N
+ * grows. Extraction is done a block at a time. Bit pairs are separated and
+ * compacted a sixty-four bit word at a time, with the pext and popcnt
+ * instructions in debias-bmi2 for processors with BMI2, or with lookup tables
+ * a byte at a time otherwise. When done the extraction ratio, output bytes
+ * per input byte, is displayed on standard error along with the fraction of
+ * input bits that were ones, the Shannon entropy per bit that implies, and
+ * the throughput. Note that no extractor can remove correlation between bits,
+ * only bias. This is part of the Scattergun project.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <math.h>
+#include <endian.h>
+#include <unistd.h>
+#if defined(SCATTERGUN_HAS_BMI2)
+#   include <immintrin.h>
+#endif
+
+enum {
+    DEPTHS = 16,        /* Most levels of Peres extraction. */
+};
+
+/**
+ * These are the even bits of a word, the first bit of each pair.
+ */
+static const uint64_t EVEN = 0x5555555555555555ULL;
+
+/**
+ * This is a string of bits.
+ */
+struct bits {
+    uint64_t * words;
+    size_t count;
+};
+
+/**
+ * These are the bits extracted from the pairs of one word: the von Neumann
+ * bits, the exclusive OR of every pair, and the first bit of each equal pair.
+ */
+struct split {
+    uint64_t vn;
+    uint64_t xor;
+    uint64_t eq;
+    int vncount;
+    int xorcount;
+    int eqcount;
+};
+
+static const char * program = "debias";
+static int done = 0;
+
+static void handler(int signum)
+{
+    if (signum == SIGPIPE) {
+        done = !0;
+    } else if (signum == SIGINT) {
+        done = !0;
+    } else if (signum == SIGTERM) {
+        done = !0;
+    } else {
+        /* Do nothing. */
+    }
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [ -h ] [ -v ] [ -p DEPTH ] [ -z BYTES ]\n", program);
+    fprintf(stderr, "       -h              Display this menu.\n");
+    fprintf(stderr, "       -p DEPTH        Iterate Peres extraction DEPTH levels (default 0, which is von Neumann).\n");
+    fprintf(stderr, "       -v              Display verbose output to stderr.\n");
+    fprintf(stderr, "       -z BYTES        Extract from blocks of BYTES (default 65536).\n");
+}
+
+/**
+ * Return the value of the monotonic clock in seconds.
+ * @return the value of the monotonic clock in seconds.
+ */
+static double now(void)
+{
+    struct timespec ts = { 0 };
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+}
+
+#if !defined(SCATTERGUN_HAS_BMI2)
+
+/**
+ * These are the bits extracted from the pairs of each possible byte.
+ */
+static uint8_t VN_BITS[256];
+static uint8_t VN_COUNT[256];
+static uint8_t XOR_BITS[256];
+static uint8_t EQ_BITS[256];
+static uint8_t EQ_COUNT[256];
+
+/**
+ * Separate the pairs of bits of a word a pair at a time. Only the pairs
+ * whose first bits are in the mask are used.
+ * @param w is the word.
+ * @param em is the mask of the first bits of the pairs.
+ * @param sp points to the result.
+ */
+static void pairs(uint64_t w, uint64_t em, struct split * sp)
+{
+    uint64_t a = 0;
+    uint64_t b = 0;
+    int bit;
+
+    memset(sp, 0, sizeof(*sp));
+
+    for (bit = 0; bit < 64; bit += 2) {
+        if ((em & (1ULL << bit)) == 0) {
+            continue;
+        }
+        a = (w >> bit) & 1;
+        b = (w >> (bit + 1)) & 1;
+        if (a != b) {
+            sp->vn |= a << (sp->vncount++);
+        } else {
+            sp->eq |= a << (sp->eqcount++);
+        }
+        sp->xor |= (a ^ b) << (sp->xorcount++);
+    }
+}
+
+/**
+ * Build the lookup tables of the bits extracted from each possible byte.
+ */
+static void tables(void)
+{
+    struct split split;
+    int ii;
+
+    for (ii = 0; ii < 256; ++ii) {
+        pairs(ii, EVEN & 0xff, &split);
+        VN_BITS[ii] = split.vn;
+        VN_COUNT[ii] = split.vncount;
+        XOR_BITS[ii] = split.xor;
+        EQ_BITS[ii] = split.eq;
+        EQ_COUNT[ii] = split.eqcount;
+    }
+}
+
+#endif
+
+/**
+ * Separate the pairs of bits of a word. Only the pairs whose first bits are
+ * in the mask are used.
+ * @param w is the word.
+ * @param em is the mask of the first bits of the pairs.
+ * @param sp points to the result.
+ */
+static inline void split(uint64_t w, uint64_t em, struct split * sp)
+{
+#if defined(SCATTERGUN_HAS_BMI2)
+    uint64_t d = w ^ (w >> 1);
+    uint64_t m = d & em;
+    uint64_t e = ~d & em;
+
+    sp->vn = _pext_u64(w, m);
+    sp->vncount = __builtin_popcountll(m);
+    sp->xor = _pext_u64(d, em);
+    sp->xorcount = __builtin_popcountll(em);
+    sp->eq = _pext_u64(w, e);
+    sp->eqcount = __builtin_popcountll(e);
+#else
+    uint8_t b = 0;
+    int ii;
+
+    if (em != EVEN) {
+        pairs(w, em, sp);
+        return;
+    }
+
+    sp->vn = 0;
+    sp->vncount = 0;
+    sp->xor = 0;
+    sp->xorcount = 32;
+    sp->eq = 0;
+    sp->eqcount = 0;
+
+    for (ii = 0; ii < 8; ++ii) {
+        b = w >> (ii * 8);
+        sp->vn |= (uint64_t)VN_BITS[b] << sp->vncount;
+        sp->vncount += VN_COUNT[b];
+        sp->xor |= (uint64_t)XOR_BITS[b] << (ii * 4);
+        sp->eq |= (uint64_t)EQ_BITS[b] << sp->eqcount;
+        sp->eqcount += EQ_COUNT[b];
+    }
+#endif
+}
+
+/**
+ * Append up to sixty-four bits to a string of bits.
+ * @param bp points to the string.
+ * @param value is the bits, right justified, with nothing to their left.
+ * @param count is the number of bits.
+ */
+static inline void append(struct bits * bp, uint64_t value, int count)
+{
+    size_t index = bp->count / 64;
+    int offset = bp->count % 64;
+
+    if (offset == 0) {
+        bp->words[index] = value;
+    } else {
+        bp->words[index] |= value << offset;
+        if ((offset + count) > 64) {
+            bp->words[index + 1] = value >> (64 - offset);
+        }
+    }
+
+    bp->count += count;
+}
+
+/**
+ * Extract from a string of bits and append the result to another. At each
+ * level the exclusive ORs and the equal bits go into the strings for that
+ * level, and are extracted from in turn using the strings for the levels
+ * below, so each level needs only one pair of strings.
+ * @param in points to the bits.
+ * @param count is the number of bits.
+ * @param depth is the number of levels of Peres extraction.
+ * @param out points to the result.
+ * @param levels points to the strings for this level and those below.
+ */
+static void extract(const uint64_t * in, size_t count, int depth, struct bits * out, struct bits (* levels)[2])
+{
+    struct split s;
+    uint64_t em = EVEN;
+    size_t words = (count + 63) / 64;
+    size_t remainder = 0;
+    size_t ii;
+
+    if (depth > 0) {
+        levels[0][0].count = 0;
+        levels[0][1].count = 0;
+    }
+
+    for (ii = 0; ii < words; ++ii) {
+        remainder = count - (ii * 64);
+        if (remainder < 64) {
+            em = EVEN & ((1ULL << (remainder & ~(size_t)1)) - 1);
+        }
+        split(in[ii], em, &s);
+        append(out, s.vn, s.vncount);
+        if (depth > 0) {
+            append(&(levels[0][0]), s.xor, s.xorcount);
+            append(&(levels[0][1]), s.eq, s.eqcount);
+        }
+    }
+
+    if (depth > 0) {
+        extract(levels[0][0].words, levels[0][0].count, depth - 1, out, levels + 1);
+        extract(levels[0][1].words, levels[0][1].count, depth - 1, out, levels + 1);
+    }
+}
+
+/**
+ * Return the binary entropy of a bit that is one with the specified
+ * probability.
+ * @param p is the probability.
+ * @return the entropy in bits.
+ */
+static double entropy(double p)
+{
+    if ((p <= 0.0) || (p >= 1.0)) {
+        return 0.0;
+    }
+
+    return -((p * log2(p)) + ((1.0 - p) * log2(1.0 - p)));
+}
+
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int verbose = 0;
+    int depth = 0;
+    int eof = 0;
+    size_t size = 65536;
+    size_t words = 0;
+    size_t length = 0;
+    size_t bytes = 0;
+    size_t written = 0;
+    size_t ii;
+    ssize_t rc = 0;
+    uint64_t * input = (uint64_t *)0;
+    struct bits output = { (uint64_t *)0, 0 };
+    struct bits levels[DEPTHS][2];
+    unsigned long long total = 0;
+    unsigned long long extracted = 0;
+    unsigned long long ones = 0;
+    struct sigaction action = { 0 };
+    double start = 0.0;
+    double seconds = 0.0;
+    double p = 0.0;
+    char * end = (char *)0;
+    int opt;
+    int level;
+    extern char * optarg;
+    extern int optind;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "hp:vz:")) >= 0) {
+
+        switch (opt) {
+
+        case 'h':
+            usage();
+            return 0;
+
+        case 'p':
+            depth = strtol(optarg, &end, 0);
+            if ((*end != '\0') || (depth < 0) || (depth > DEPTHS)) {
+                error = !0;
+            }
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        case 'z':
+            size = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (size == 0)) {
+                error = !0;
+            }
+            break;
+
+        default:
+            error = !0;
+            break;
+
+        }
+
+    }
+
+    if ((optind < argc) || error) {
+        usage();
+        return 1;
+    }
+
+    memset(levels, 0, sizeof(levels));
+
+    do {
+
+        action.sa_handler = handler;
+        action.sa_flags = 0;
+        if (sigaction(SIGPIPE, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+        if (sigaction(SIGINT, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+        if (sigaction(SIGTERM, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+
+        /*
+         * The output of a block is never longer than its input, plus the
+         * bits of a partial byte left over from the block before. The strings
+         * for each level are at most half as long as those above.
+         */
+
+        words = (size + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+        input = (uint64_t *)malloc(words * sizeof(uint64_t));
+        output.words = (uint64_t *)malloc((words + 2) * sizeof(uint64_t));
+        if ((input == (uint64_t *)0) || (output.words == (uint64_t *)0)) {
+            perror("malloc");
+            break;
+        }
+        for (level = 0; level < depth; ++level) {
+            levels[level][0].words = (uint64_t *)malloc(((words >> (level + 1)) + 2) * sizeof(uint64_t));
+            levels[level][1].words = (uint64_t *)malloc(((words >> (level + 1)) + 2) * sizeof(uint64_t));
+            if ((levels[level][0].words == (uint64_t *)0) || (levels[level][1].words == (uint64_t *)0)) {
+                break;
+            }
+        }
+        if (level < depth) {
+            perror("malloc");
+            break;
+        }
+
+#if !defined(SCATTERGUN_HAS_BMI2)
+        tables();
+#endif
+
+        if (verbose) {
+            fprintf(stderr, "%s: depth        %d\n", program, depth);
+            fprintf(stderr, "%s: size         %zu\n", program, size);
+#if defined(SCATTERGUN_HAS_BMI2)
+            fprintf(stderr, "%s: kernel       \"%s\"\n", program, "bmi2");
+#else
+            fprintf(stderr, "%s: kernel       \"%s\"\n", program, "table");
+#endif
+        }
+
+        start = now();
+        while ((!done) && (!eof)) {
+
+            /*
+             * Fill the block completely, unless the input ends, so that
+             * the extraction does not depend on how the input arrives.
+             */
+
+            for (length = 0; length < size; length += rc) {
+                rc = read(STDIN_FILENO, (uint8_t *)input + length, size - length);
+                if (rc > 0) {
+                    /* Do nothing. */
+                } else if ((rc < 0) && (errno == EINTR) && (!done)) {
+                    rc = 0;
+                } else {
+                    if (rc < 0) { perror("read"); }
+                    eof = !0;
+                    break;
+                }
+            }
+            if (length == 0) {
+                break;
+            }
+            total += length;
+
+            memset((uint8_t *)input + length, 0, (words * sizeof(uint64_t)) - length);
+            for (ii = 0; ii < ((length + sizeof(uint64_t) - 1) / sizeof(uint64_t)); ++ii) {
+                input[ii] = le64toh(input[ii]);
+                ones += __builtin_popcountll(input[ii]);
+            }
+
+            extract(input, length * 8, depth, &output, levels);
+
+            /*
+             * Write the whole bytes and keep any partial byte for the next
+             * block.
+             */
+
+            bytes = output.count / 8;
+            for (ii = 0; ii < ((output.count + 63) / 64); ++ii) {
+                output.words[ii] = htole64(output.words[ii]);
+            }
+            for (written = 0; written < bytes; written += rc) {
+                rc = write(STDOUT_FILENO, (uint8_t *)output.words + written, bytes - written);
+                if (rc > 0) {
+                    /* Do nothing. */
+                } else if ((rc < 0) && (errno == EINTR) && (!done)) {
+                    rc = 0;
+                } else {
+                    break;
+                }
+            }
+            extracted += written;
+            if (written < bytes) {
+                if ((rc < 0) && (errno != EPIPE)) { perror("write"); }
+                break;
+            }
+            output.words[0] = ((uint8_t *)output.words)[bytes];
+            output.count %= 8;
+
+        }
+        seconds = now() - start;
+
+        p = (total > 0) ? ((double)ones / (total * 8.0)) : 0.0;
+        fprintf(stderr, "%s: depth=%d bytes=%llu extracted=%llu ratio=%.6f ones=%.6f entropy=%.6f seconds=%.6f rate=%.0f\n", program,
+            depth, total, extracted,
+            (total > 0) ? ((double)extracted / total) : 0.0,
+            p, entropy(p), seconds,
+            (seconds > 0.0) ? (total / seconds) : 0.0);
+
+        xc = 0;
+
+    } while (0);
+
+    for (level = 0; level < DEPTHS; ++level) {
+        if (levels[level][1].words != (uint64_t *)0) {
+            free(levels[level][1].words);
+        }
+        if (levels[level][0].words != (uint64_t *)0) {
+            free(levels[level][0].words);
+        }
+    }
+    if (output.words != (uint64_t *)0) {
+        free(output.words);
+    }
+    if (input != (uint64_t *)0) {
+        free(input);
+    }
+
+    return xc;
+}
@@ -0,0 +1,513 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Digest<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * digest [ -h ] [ -v ] [ -a ALGORITHM ] [ -j THREADS ] [ -z BYTES ] [ PATH ... ]
+ *
+ * OPTIONS
+ *
+ * -a ALGORITHM    Use ALGORITHM (sha256, sha3, blake2s) (default blake2s).
+ * -h              Display this menu.
+ * -j THREADS      Use THREADS threads (default the number of processors).
+ * -v              Display verbose output to stderr.
+ * -z BYTES        Hash the file BYTES at a time (default 1048576).
+ *
+ * EXAMPLES
+ *
+ * digest scattergun_silver_TrueRNGpro/ent.dat scattergun_silver_TrueRNGpro/sp800.dat
+ *
+ * dd if=/dev/hwrng bs=1024 count=4096 | digest
+ *
+ * ABSTRACT
+ *
+ * Displays a content hash of each PATH (or of standard input) in the same
+ * form as sha256sum(1), fast enough that a capture can be identified before
+ * deciding whether to test it again. Like BLAKE3, it is a tree hash: the file
+ * is divided into chunks of BYTES bytes, each chunk is hashed into its own
+ * digest, and the digest of the file is the hash of all of the chunk digests
+ * followed by the length of the file and the chunk size, as little-endian
+ * sixty-four and thirty-two bit integers. Threads claim CONDITION_LANES chunks
+ * at a time, read them with pread(2), and hash them side by side with the
+ * vectorized code of condition.c, so a regular file is hashed in parallel.
+ * Anything else is read and hashed in order by one thread, with the same
+ * result. The digest depends on ALGORITHM and BYTES, but not on THREADS. It
+ * is not the BLAKE3 function, whose test vectors it does not reproduce.
+ * This is part of the Scattergun project.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "condition.h"
+
+/**
+ * This is the work shared by all of the threads hashing one file.
+ */
+struct work {
+    enum condition_algorithm algorithm;
+    int fd;
+    uint64_t total;
+    size_t chunk;
+    uint64_t chunks;
+    uint64_t next;
+    uint8_t * digests;
+    int error;
+};
+
+static const char * program = "digest";
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [ -h ] [ -v ] [ -a ALGORITHM ] [ -j THREADS ] [ -z BYTES ] [ PATH ... ]\n", program);
+    fprintf(stderr, "       -a ALGORITHM    Use ALGORITHM (sha256, sha3, blake2s) (default blake2s).\n");
+    fprintf(stderr, "       -h              Display this menu.\n");
+    fprintf(stderr, "       -j THREADS      Use THREADS threads (default the number of processors).\n");
+    fprintf(stderr, "       -v              Display verbose output to stderr.\n");
+    fprintf(stderr, "       -z BYTES        Hash the file BYTES at a time (default 1048576).\n");
+}
+
+/**
+ * Return the value of the monotonic clock in seconds.
+ * @return the value of the monotonic clock in seconds.
+ */
+static double now(void)
+{
+    struct timespec ts = { 0 };
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+}
+
+/**
+ * Read as much of a buffer as there is from a file, at an offset if it is
+ * not negative, or else from where the file is.
+ * @param fd is the file descriptor.
+ * @param buffer points to the buffer.
+ * @param size is the size of the buffer in bytes.
+ * @param offset is the offset into the file or <0.
+ * @return the number of bytes read, or <0 with errno set for failure.
+ */
+static ssize_t fill(int fd, uint8_t * buffer, size_t size, off_t offset)
+{
+    size_t length = 0;
+    ssize_t rc = 0;
+
+    while (length < size) {
+        if (offset < 0) {
+            rc = read(fd, buffer + length, size - length);
+        } else {
+            rc = pread(fd, buffer + length, size - length, offset + length);
+        }
+        if (rc > 0) {
+            length += rc;
+        } else if (rc == 0) {
+            break;
+        } else if (errno == EINTR) {
+            /* Do nothing. */
+        } else {
+            return -1;
+        }
+    }
+
+    return length;
+}
+
+/**
+ * Hash a run of chunks that are in a buffer one after another. All but the
+ * last are full; the last may be short, in which case it is hashed alone.
+ * @param algorithm is the algorithm.
+ * @param buffer points to the chunks.
+ * @param chunk is the size of a full chunk in bytes.
+ * @param length is the number of bytes in the buffer.
+ * @param output points to a digest for each chunk.
+ * @return the number of chunks hashed.
+ */
+static size_t stripe(enum condition_algorithm algorithm, const uint8_t * buffer, size_t chunk, size_t length, uint8_t * output)
+{
+    size_t full = length / chunk;
+    size_t tail = length % chunk;
+
+    if (full > 0) {
+        condition_blocks(algorithm, buffer, chunk, full, output);
+    }
+    if (tail > 0) {
+        condition_blocks(algorithm, buffer + (full * chunk), tail, 1, output + (full * CONDITION_DIGEST));
+    }
+
+    return full + ((tail > 0) ? 1 : 0);
+}
+
+/**
+ * Claim CONDITION_LANES chunks of the file at a time until there are none
+ * left, reading and hashing each group into its place among the digests.
+ * @param argp points to the shared work.
+ * @return NULL.
+ */
+static void * worker(void * argp)
+{
+    struct work * wp = (struct work *)argp;
+    uint8_t * buffer = (uint8_t *)0;
+    uint64_t index = 0;
+    uint64_t offset = 0;
+    size_t length = 0;
+    ssize_t rc = 0;
+
+    buffer = (uint8_t *)malloc(wp->chunk * CONDITION_LANES);
+    if (buffer == (uint8_t *)0) {
+        __atomic_store_n(&(wp->error), ENOMEM, __ATOMIC_RELAXED);
+        return (void *)0;
+    }
+
+    while (__atomic_load_n(&(wp->error), __ATOMIC_RELAXED) == 0) {
+
+        index = __atomic_fetch_add(&(wp->next), CONDITION_LANES, __ATOMIC_RELAXED);
+        if (index >= wp->chunks) {
+            break;
+        }
+
+        offset = index * wp->chunk;
+        length = wp->chunk * CONDITION_LANES;
+        if (length > (wp->total - offset)) { length = wp->total - offset; }
+
+        rc = fill(wp->fd, buffer, length, offset);
+        if (rc < 0) {
+            __atomic_store_n(&(wp->error), errno, __ATOMIC_RELAXED);
+            break;
+        } else if (rc < (ssize_t)length) {
+            __atomic_store_n(&(wp->error), EIO, __ATOMIC_RELAXED);
+            break;
+        } else {
+            /* Do nothing. */
+        }
+
+        stripe(wp->algorithm, buffer, wp->chunk, length, wp->digests + (index * CONDITION_DIGEST));
+
+    }
+
+    free(buffer);
+
+    return (void *)0;
+}
+
+/**
+ * Hash the chunk digests, the length, and the chunk size into the digest of
+ * the whole file.
+ * @param wp points to the work.
+ * @param output points to the digest.
+ * @return 0 for success, or <0 with errno set for failure.
+ */
+static int root(const struct work * wp, uint8_t output[CONDITION_DIGEST])
+{
+    size_t size = (wp->chunks * CONDITION_DIGEST) + sizeof(uint64_t) + sizeof(uint32_t);
+    uint8_t * buffer = (uint8_t *)0;
+    uint8_t * bp = (uint8_t *)0;
+    int ii;
+
+    buffer = (uint8_t *)malloc(size);
+    if (buffer == (uint8_t *)0) {
+        return -1;
+    }
+
+    memcpy(buffer, wp->digests, wp->chunks * CONDITION_DIGEST);
+    bp = buffer + (wp->chunks * CONDITION_DIGEST);
+    for (ii = 0; ii < (int)sizeof(uint64_t); ++ii) {
+        *(bp++) = (uint8_t)(wp->total >> (8 * ii));
+    }
+    for (ii = 0; ii < (int)sizeof(uint32_t); ++ii) {
+        *(bp++) = (uint8_t)(((uint32_t)wp->chunk) >> (8 * ii));
+    }
+
+    condition_blocks(wp->algorithm, buffer, size, 1, output);
+
+    free(buffer);
+
+    return 0;
+}
+
+/**
+ * Hash a regular file with many threads.
+ * @param wp points to the work, with the file descriptor and size set.
+ * @param threads is the most threads to use.
+ * @return the number of threads used, or <0 with errno set for failure.
+ */
+static long parallel(struct work * wp, long threads)
+{
+    pthread_t * workers = (pthread_t *)0;
+    uint64_t groups = (wp->chunks + CONDITION_LANES - 1) / CONDITION_LANES;
+    long created = 0;
+    long ii;
+
+    if ((uint64_t)threads > groups) {
+        threads = groups;
+    }
+    if (threads <= 0) {
+        return 0;
+    }
+
+    workers = (pthread_t *)calloc(threads, sizeof(pthread_t));
+    if (workers == (pthread_t *)0) {
+        return -1;
+    }
+
+    for (created = 0; created < threads; ++created) {
+        errno = pthread_create(&(workers[created]), (pthread_attr_t *)0, worker, wp);
+        if (errno != 0) {
+            break;
+        }
+    }
+
+    for (ii = 0; ii < created; ++ii) {
+        pthread_join(workers[ii], (void **)0);
+    }
+
+    free(workers);
+
+    if (created == 0) {
+        return -1;
+    }
+
+    if (wp->error != 0) {
+        errno = wp->error;
+        return -1;
+    }
+
+    return created;
+}
+
+/**
+ * Hash anything that cannot be read at an offset, in order, with one thread,
+ * growing the array of chunk digests as it goes.
+ * @param wp points to the work, with the file descriptor set.
+ * @return 0 for success, or <0 with errno set for failure.
+ */
+static int sequential(struct work * wp)
+{
+    uint8_t * buffer = (uint8_t *)0;
+    uint8_t * digests = (uint8_t *)0;
+    uint64_t capacity = 0;
+    ssize_t length = 0;
+    int rc = -1;
+
+    buffer = (uint8_t *)malloc(wp->chunk * CONDITION_LANES);
+    if (buffer == (uint8_t *)0) {
+        return -1;
+    }
+
+    do {
+
+        length = fill(wp->fd, buffer, wp->chunk * CONDITION_LANES, -1);
+        if (length < 0) {
+            break;
+        }
+
+        if ((wp->chunks + CONDITION_LANES) > capacity) {
+            capacity = (capacity > 0) ? (capacity * 2) : 1024;
+            digests = (uint8_t *)realloc(wp->digests, capacity * CONDITION_DIGEST);
+            if (digests == (uint8_t *)0) {
+                break;
+            }
+            wp->digests = digests;
+        }
+
+        wp->chunks += stripe(wp->algorithm, buffer, wp->chunk, length, wp->digests + (wp->chunks * CONDITION_DIGEST));
+        wp->total += length;
+
+        if (length < (ssize_t)(wp->chunk * CONDITION_LANES)) {
+            rc = 0;
+            break;
+        }
+
+    } while (!0);
+
+    free(buffer);
+
+    return rc;
+}
+
+int main(int argc, char * argv[])
+{
+    int xc = 0;
+    int error = 0;
+    int verbose = 0;
+    int algorithm = CONDITION_BLAKE2S;
+    long threads = 0;
+    long used = 0;
+    size_t chunk = 1048576;
+    const char * path = (const char *)0;
+    struct work work = { CONDITION_BLAKE2S };
+    struct stat status = { 0 };
+    uint8_t output[CONDITION_DIGEST];
+    double start = 0.0;
+    double seconds = 0.0;
+    char * end = (char *)0;
+    int opt;
+    int done = 0;
+    int ii;
+    int jj;
+    extern char * optarg;
+    extern int optind;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "a:hj:vz:")) >= 0) {
+
+        switch (opt) {
+
+        case 'a':
+            algorithm = condition_parse(optarg);
+            if (algorithm < 0) {
+                error = !0;
+            }
+            break;
+
+        case 'h':
+            usage();
+            return 0;
+
+        case 'j':
+            threads = strtol(optarg, &end, 0);
+            if ((*end != '\0') || (threads <= 0)) {
+                error = !0;
+            }
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        case 'z':
+            chunk = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (chunk == 0) || (chunk > 0x7fffffffUL)) {
+                error = !0;
+            }
+            break;
+
+        default:
+            error = !0;
+            break;
+
+        }
+
+    }
+
+    if (error) {
+        usage();
+        return 1;
+    }
+
+    if (threads == 0) {
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+        if (threads <= 0) { threads = 1; }
+    }
+
+    if (verbose) {
+        fprintf(stderr, "%s: algorithm    %s\n", program, CONDITION_NAMES[algorithm]);
+        fprintf(stderr, "%s: kernel       %s\n", program, CONDITION_KERNEL);
+        fprintf(stderr, "%s: chunk        %zu\n", program, chunk);
+        fprintf(stderr, "%s: threads      %ld\n", program, threads);
+    }
+
+    for (ii = optind; (ii < argc) || (ii == optind); ++ii) {
+
+        path = (ii < argc) ? argv[ii] : "-";
+
+        memset(&work, 0, sizeof(work));
+        work.algorithm = algorithm;
+        work.chunk = chunk;
+        work.fd = -1;
+        used = 1;
+        done = 0;
+
+        start = now();
+
+        do {
+
+            if (strcmp(path, "-") == 0) {
+                work.fd = STDIN_FILENO;
+            } else if ((work.fd = open(path, O_RDONLY)) < 0) {
+                perror(path);
+                break;
+            } else {
+                /* Do nothing. */
+            }
+
+            if (fstat(work.fd, &status) < 0) {
+                perror(path);
+                break;
+            }
+
+            if (S_ISREG(status.st_mode)) {
+                work.total = status.st_size;
+                work.chunks = (work.total + work.chunk - 1) / work.chunk;
+                work.digests = (uint8_t *)malloc((work.chunks > 0) ? (work.chunks * CONDITION_DIGEST) : 1);
+                if (work.digests == (uint8_t *)0) {
+                    perror("malloc");
+                    break;
+                }
+                if ((used = parallel(&work, threads)) < 0) {
+                    perror(path);
+                    break;
+                }
+            } else if (sequential(&work) < 0) {
+                perror(path);
+                break;
+            } else {
+                /* Do nothing. */
+            }
+
+            if (root(&work, output) < 0) {
+                perror("malloc");
+                break;
+            }
+
+            seconds = now() - start;
+
+            for (jj = 0; jj < CONDITION_DIGEST; ++jj) {
+                printf("%02x", output[jj]);
+            }
+            printf("  %s\n", path);
+
+            if (verbose) {
+                fprintf(stderr, "%s: path=\"%s\" bytes=%llu chunks=%llu threads=%ld seconds=%.6f bytes/second=%.0f\n", program, path, (unsigned long long)work.total, (unsigned long long)work.chunks, used, seconds, (seconds > 0.0) ? (work.total / seconds) : 0.0);
+            }
+
+            done = !0;
+
+        } while (0);
+
+        if (!done) {
+            xc = 1;
+        }
+
+        if ((work.fd >= 0) && (work.fd != STDIN_FILENO)) {
+            close(work.fd);
+        }
+        if (work.digests != (uint8_t *)0) {
+            free(work.digests);
+        }
+
+    }
+
+    fflush(stdout);
+
+    return xc;
+}
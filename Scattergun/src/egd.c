@@ -0,0 +1,1348 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * EGD<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * egd [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -s SOURCE [ -s SOURCE ... ] ] [ -p PATH ] [ -m MODE ] [ -c CLIENTS ] [ -r BYTES ] [ -S PATH [ -Z BYTES ] ] [ -L BYTES ] [ -H BYTES ] [ -b BYTES ] [ -q BYTES ]
+ *
+ * EXAMPLES
+ *
+ * egd -v -s /dev/TrueRNGpro -p /tmp/egd-pool
+ *
+ * egd -D -s usb:0 -s /dev/hwrng -p /var/run/egd-pool -r 4194304
+ *
+ * egd -D -s /dev/TrueRNGpro -r 1048576 -S /var/tmp -Z 67108864
+ *
+ * ABSTRACT
+ *
+ * Serves entropy to many concurrent local clients over a Unix domain stream
+ * socket at PATH (default /var/run/egd-pool) using the protocol of the
+ * Entropy Gathering Daemon (EGD), which is spoken by OpenSSL (RAND_egd),
+ * GnuPG, OpenSSH, and others. Each SOURCE is read by its own thread, as by
+ * feeder, and each block of 20,000 bits that passes the FIPS 140-2 tests is
+ * deposited into a shared reservoir of BYTES bytes (default 1048576) of
+ * memory, optionally extended by an encrypted spill file at PATH of BYTES
+ * bytes (default sixteen times the memory; see reservoir.h). When the reservoir reaches its high watermark
+ * (-H, default full) the sources are no longer read until it drains to its
+ * low watermark (-L, default half of the high watermark), so that the
+ * reservoir fills while demand is low and absorbs bursts of demand without
+ * waiting on the devices. The clients are
+ * multiplexed by a single thread using epoll. Each client has a prefetch
+ * buffer of BYTES bytes (default 256) which is topped up from the reservoir
+ * whenever no client is waiting, so that most requests are answered without
+ * touching the shared reservoir. Clients whose blocking reads cannot be
+ * satisfied immediately wait in a queue that is served round robin, BYTES
+ * (default 64) bytes per client per turn, so that one client draining the
+ * reservoir cannot starve the others. The number of requests, bytes served,
+ * throughput, and mean and maximum request latency of each client are
+ * reported on SIGHUP, at exit, and (if verbose) when the client disconnects.
+ * This is part of the Scattergun project.
+ *
+ * PROTOCOL
+ *
+ * 0x00 returns the bits of entropy in the reservoir as a 32-bit big-endian
+ * integer. 0x01 N returns a count byte M followed by up to N bytes without
+ * blocking. 0x02 N returns exactly N bytes, blocking until they are available.
+ * 0x03 MSB LSB N DATA... offers N bytes of entropy; since the reservoir is
+ * served to clients verbatim, the data is counted and discarded. 0x04 returns
+ * a count byte followed by the process identifier as a decimal string.
+ * Requests are answered in order, so a client may send several without
+ * waiting for the responses, but its requests are left unread in the socket
+ * while one of them is outstanding.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include "service.h"
+#include "fips.h"
+#include "source.h"
+#include "reservoir.h"
+
+static const char * program = "egd";
+static const char * ident = "egd";
+static int debug = 0;
+
+enum {
+    SOURCES = 8,        /* Maximum number of sources. */
+    REQUEST = 4 + 255,  /* Largest request (0x03 MSB LSB N DATA...). */
+    RESPONSE = 512,     /* Largest response, with room to spare. */
+    EVENTS = 64,        /* Events returned by each epoll_wait. */
+};
+
+enum command {
+    EGD_LEVEL = 0x00,
+    EGD_READ = 0x01,
+    EGD_BLOCK = 0x02,
+    EGD_WRITE = 0x03,
+    EGD_PID = 0x04,
+};
+
+/**
+ * This describes an entropy source and the thread that reads it.
+ */
+struct channel {
+    struct source device;
+    pthread_t thread;
+    struct fips health;
+    int finished;
+    size_t discarded;
+    size_t deposited;
+};
+
+/**
+ * This is the state of one client connection.
+ */
+struct client {
+    struct client * next;
+    struct client * queue;
+    int fd;
+    unsigned long id;
+    pid_t pid;
+    uid_t uid;
+    int queued;
+    int busy;
+    uint32_t events;
+    size_t owed;
+    size_t inused;
+    size_t outused;
+    size_t outsent;
+    size_t prefetched;
+    double start;
+    double arrival;
+    double latency;
+    double worst;
+    size_t requests;
+    size_t served;
+    size_t prefetches;
+    size_t offered;
+    uint8_t * prefetch;
+    uint8_t input[REQUEST];
+    uint8_t output[RESPONSE];
+};
+
+static struct reservoir reservoir;
+static int notifier = -1;
+
+static struct client * clients = (struct client *)0;
+static struct client * head = (struct client *)0;
+static struct client * tail = (struct client *)0;
+static size_t connected = 0;
+static size_t limit = 4096;
+static size_t prefetch = 256;
+static size_t quantum = 64;
+static int epfd = -1;
+
+/**
+ * Emit a usage message to standard error.
+ * @param nomenu if true supresses the printing of the menu.
+ */
+static void usage(int nomenu)
+{
+    service_printf("usage: %s [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -s SOURCE [ -s SOURCE ... ] ] [ -p PATH ] [ -m MODE ] [ -c CLIENTS ] [ -r BYTES ] [ -S PATH [ -Z BYTES ] ] [ -L BYTES ] [ -H BYTES ] [ -b BYTES ] [ -q BYTES ]\n", program);
+    if (nomenu) { return; }
+    service_printf("       -d            Enable debug mode\n");
+    service_printf("       -v            Enable verbose mode\n");
+    service_printf("       -D            Run as a daemon\n");
+    service_printf("       -i IDENT      Use IDENT as the syslog identifier\n");
+    service_printf("       -s SOURCE     Read from rdrand, rdseed, usb:UNIT, pci:UNIT, onerng:PATH, or PATH (may be repeated)\n");
+    service_printf("       -p PATH       Listen on the Unix domain socket at PATH\n");
+    service_printf("       -m MODE       Set the permissions of the socket to the octal MODE\n");
+    service_printf("       -c CLIENTS    Serve at most CLIENTS clients at a time\n");
+    service_printf("       -r BYTES      Keep a reservoir of BYTES bytes in memory\n");
+    service_printf("       -S PATH       Spill into a new encrypted file at PATH (or in directory PATH) when memory is full\n");
+    service_printf("       -Z BYTES      Make the spill file BYTES bytes\n");
+    service_printf("       -L BYTES      Resume reading the sources when the reservoir falls to BYTES\n");
+    service_printf("       -H BYTES      Stop reading the sources when the reservoir rises to BYTES\n");
+    service_printf("       -b BYTES      Prefetch BYTES bytes for each client\n");
+    service_printf("       -q BYTES      Serve waiting clients BYTES bytes at a time\n");
+    service_printf("       -h            Print help menu\n");
+}
+
+/**
+ * Return the value of the monotonic clock in seconds.
+ * @return the value of the monotonic clock in seconds.
+ */
+static double now(void)
+{
+    struct timespec ts = { 0 };
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+}
+
+/**
+ * Add a block to the reservoir, waiting until the reservoir wants it, and
+ * wake up the server.
+ * @param block points to the block.
+ * @param size is the size of the block in bytes.
+ * @return 0 for success, <0 if the program is shutting down.
+ */
+static int deposit(const uint8_t * block, size_t size)
+{
+    static const uint64_t ONE = 1;
+
+    if (reservoir_deposit(&reservoir, block, size, 8.0 * size, -1) < 0) {
+        return -1;
+    }
+
+    if ((write(notifier, &ONE, sizeof(ONE)) < 0) && (errno != EAGAIN)) {
+        service_error("write");
+    }
+
+    return 0;
+}
+
+/**
+ * Remove up to the requested number of bytes from the reservoir.
+ * @param buffer points to the buffer.
+ * @param size is the size of the buffer in bytes.
+ * @return the number of bytes removed.
+ */
+static size_t withdraw(uint8_t * buffer, size_t size)
+{
+    return reservoir_withdraw(&reservoir, buffer, size, 0, (double *)0);
+}
+
+/**
+ * Return the number of bytes in the reservoir.
+ * @return the number of bytes in the reservoir.
+ */
+static size_t available(void)
+{
+    return reservoir_level(&reservoir);
+}
+
+/**
+ * Read, test, and deposit blocks from one source until it ends, fails, or the
+ * program shuts down. If a read fails the source is closed and reopened.
+ * Blocks that fail the tests are discarded.
+ * @param arg points to the channel.
+ * @return NULL.
+ */
+static void * worker(void * arg)
+{
+    struct channel * cp = (struct channel *)arg;
+    uint8_t block[FIPS_BYTES];
+    ssize_t bytes = 0;
+    int mask = 0;
+
+    while ((!service_done) && (!cp->finished)) {
+
+        if (source_open(&(cp->device)) < 0) {
+            service_error(cp->device.name);
+            source_close(&(cp->device));
+            break;
+        }
+        service_verbosef("%s: source       \"%s\" %s\n", program, cp->device.name, SOURCE_KINDS[cp->device.kind]);
+
+        while (!service_done) {
+
+            /*
+             * A block cut short by the end of the source or by a signal is
+             * discarded; the next read reports which it was.
+             */
+
+            bytes = source_read(&(cp->device), block, sizeof(block));
+            if (bytes == sizeof(block)) {
+                /* Do nothing. */
+            } else if (bytes > 0) {
+                continue;
+            } else if ((cp->device.kind == SOURCE_RDRAND) || (cp->device.kind == SOURCE_RDSEED)) {
+                service_error(cp->device.name);
+                cp->finished = !0;
+                break;
+            } else if ((bytes < 0) && (errno == EINTR)) {
+                continue;
+            } else if (bytes < 0) {
+                service_error(cp->device.name);
+                break;
+            } else {
+                service_verbosef("%s: end          \"%s\"\n", program, cp->device.name);
+                cp->finished = (cp->device.kind == SOURCE_FILE);
+                break;
+            }
+
+            mask = fips_test(&(cp->health), block);
+            if (mask != 0) {
+                service_printf("%s: discard      \"%s\" 0x%x\n", program, cp->device.name, mask);
+                cp->discarded += sizeof(block);
+                continue;
+            }
+
+            if (deposit(block, sizeof(block)) < 0) {
+                break;
+            }
+            cp->deposited += sizeof(block);
+
+        }
+
+        source_close(&(cp->device));
+
+    }
+
+    memset(block, 0, sizeof(block));
+    cp->finished = !0;
+
+    return (void *)0;
+}
+
+/**
+ * Give a client up to the requested number of bytes, first from its
+ * prefetch buffer and then from the reservoir.
+ * @param cp points to the client.
+ * @param buffer points to the buffer.
+ * @param size is the size of the buffer in bytes.
+ * @return the number of bytes given.
+ */
+static size_t supply(struct client * cp, uint8_t * buffer, size_t size)
+{
+    size_t length = 0;
+
+    length = (cp->prefetched < size) ? cp->prefetched : size;
+    if (length > 0) {
+        cp->prefetched -= length;
+        memcpy(buffer, cp->prefetch + cp->prefetched, length);
+        memset(cp->prefetch + cp->prefetched, 0, length);
+    }
+    if (length < size) {
+        length += withdraw(buffer + length, size - length);
+    }
+
+    cp->served += length;
+
+    return length;
+}
+
+/**
+ * Top up the prefetch buffer of a client, unless other clients are waiting
+ * for the reservoir.
+ * @param cp points to the client.
+ */
+static void refill(struct client * cp)
+{
+    size_t length = 0;
+
+    if (head != (struct client *)0) {
+        return;
+    }
+    if (cp->prefetched >= prefetch) {
+        return;
+    }
+
+    length = withdraw(cp->prefetch + cp->prefetched, prefetch - cp->prefetched);
+    if (length > 0) {
+        cp->prefetched += length;
+        ++(cp->prefetches);
+    }
+}
+
+/**
+ * Put a client at the end of the queue of clients waiting for the reservoir.
+ * @param cp points to the client.
+ */
+static void enqueue(struct client * cp)
+{
+    if (cp->queued) {
+        return;
+    }
+    cp->queue = (struct client *)0;
+    if (tail == (struct client *)0) {
+        head = cp;
+    } else {
+        tail->queue = cp;
+    }
+    tail = cp;
+    cp->queued = !0;
+}
+
+/**
+ * Remove a client from the queue of clients waiting for the reservoir.
+ * @param cp points to the client.
+ */
+static void dequeue(struct client * cp)
+{
+    struct client ** pp = &head;
+
+    if (!cp->queued) {
+        return;
+    }
+    tail = (struct client *)0;
+    while (*pp != (struct client *)0) {
+        if (*pp == cp) {
+            *pp = cp->queue;
+        } else {
+            tail = *pp;
+            pp = &((*pp)->queue);
+        }
+    }
+    cp->queue = (struct client *)0;
+    cp->queued = 0;
+}
+
+/**
+ * Emit the statistics for a client.
+ * @param cp points to the client.
+ * @param verb describes why the statistics are being emitted.
+ */
+static void summary(const struct client * cp, const char * verb)
+{
+    double elapsed = 0.0;
+
+    elapsed = now() - cp->start;
+
+    service_printf("%s: %s client=%lu pid=%d uid=%d elapsed=%.3f requests=%zu served=%zu throughput=%.0f latency=%.6f worst=%.6f prefetches=%zu offered=%zu\n", program, verb, cp->id, cp->pid, cp->uid, elapsed, cp->requests, cp->served, (elapsed > 0.0) ? (cp->served / elapsed) : 0.0, (cp->requests > 0) ? (cp->latency / cp->requests) : 0.0, cp->worst, cp->prefetches, cp->offered);
+}
+
+/**
+ * Emit the statistics for the sources, the reservoir, and the clients.
+ * @param channels points to the array of channels.
+ * @param nchannels is the number of channels.
+ */
+static void statistics(const struct channel * channels, size_t nchannels)
+{
+    const struct channel * cp = (const struct channel *)0;
+    const struct client * pp = (const struct client *)0;
+    struct reservoir_metrics metrics;
+    size_t ii;
+    int jj;
+
+    for (ii = 0; ii < nchannels; ++ii) {
+        cp = &(channels[ii]);
+        service_printf("%s: source=\"%s\" kind=%s opens=%zu reads=%zu total=%zu blocks=%zu failures=%zu discarded=%zu deposited=%zu\n", program, cp->device.name, SOURCE_KINDS[cp->device.kind], cp->device.opens, cp->device.reads, cp->device.total, cp->health.blocks, cp->health.failures, cp->discarded, cp->deposited);
+        for (jj = 0; jj < FIPS_TESTS; ++jj) {
+            if (cp->health.failed[jj] > 0) {
+                service_printf("%s: source=\"%s\" %s=%zu\n", program, cp->device.name, FIPS_NAMES[jj], cp->health.failed[jj]);
+            }
+        }
+    }
+
+    reservoir_snapshot(&reservoir, &metrics);
+    service_printf("%s: capacity=%zu spillsize=%zu low=%zu high=%zu level=%zu spilled=%zu peak=%zu deposits=%zu withdrawals=%zu filled=%zu drained=%zu spills=%zu restores=%zu stalls=%zu shortfalls=%zu cycles=%zu connected=%zu\n", program, metrics.capacity, metrics.spillsize, metrics.low, metrics.high, metrics.level, metrics.spilled, metrics.peak, metrics.deposits, metrics.withdrawals, metrics.filled, metrics.drained, metrics.spills, metrics.restores, metrics.stalls, metrics.shortfalls, metrics.cycles, connected);
+
+    for (pp = clients; pp != (const struct client *)0; pp = pp->next) {
+        summary(pp, "report");
+    }
+}
+
+/**
+ * Disconnect a client and free its resources.
+ * @param cp points to the client.
+ */
+static void disconnect(struct client * cp)
+{
+    struct client ** pp = &clients;
+
+    if (service_verbose) {
+        summary(cp, "disconnect");
+    }
+
+    dequeue(cp);
+
+    while (*pp != (struct client *)0) {
+        if (*pp == cp) {
+            *pp = cp->next;
+            break;
+        }
+        pp = &((*pp)->next);
+    }
+
+    close(cp->fd);
+    --connected;
+
+    memset(cp->prefetch, 0, prefetch);
+    free(cp->prefetch);
+    memset(cp, 0, sizeof(*cp));
+    free(cp);
+}
+
+/**
+ * Append data to the response of a client.
+ * @param cp points to the client.
+ * @param data points to the data.
+ * @param size is the size of the data in bytes.
+ */
+static void respond(struct client * cp, const void * data, size_t size)
+{
+    memcpy(cp->output + cp->outused, data, size);
+    cp->outused += size;
+}
+
+/**
+ * Ask epoll to tell us when a client has sent more requests only while it
+ * has no request outstanding and room for more in its input buffer, and
+ * when its socket can take more of its response only while the response is
+ * unsent. Otherwise a client that sends requests ahead of the responses
+ * would leave its socket readable, and epoll would wake us for it without
+ * end until the outstanding request was answered.
+ * @param cp points to the client.
+ * @return 0 for success, <0 for failure.
+ */
+static int arm(struct client * cp)
+{
+    struct epoll_event event = { 0 };
+
+    if ((!cp->busy) && (cp->inused < sizeof(cp->input))) {
+        event.events |= EPOLLIN;
+    }
+    if (cp->outused > 0) {
+        event.events |= EPOLLOUT;
+    }
+
+    if (event.events != cp->events) {
+        event.data.ptr = cp;
+        if (epoll_ctl(epfd, EPOLL_CTL_MOD, cp->fd, &event) < 0) {
+            service_error("epoll_ctl");
+            return -1;
+        }
+        cp->events = event.events;
+    }
+
+    return 0;
+}
+
+/**
+ * Write as much of the response of a client as the socket will take, and
+ * ask epoll to tell us when the socket can take more if it did not take it
+ * all. When the response to a request is complete, its latency is recorded
+ * and the client's next request may be read.
+ * @param cp points to the client.
+ * @return 0 for success, <0 if the client has gone away.
+ */
+static int flush(struct client * cp)
+{
+    ssize_t bytes = 0;
+    double latency = 0.0;
+
+    while (cp->outsent < cp->outused) {
+        bytes = write(cp->fd, cp->output + cp->outsent, cp->outused - cp->outsent);
+        if (bytes > 0) {
+            cp->outsent += bytes;
+        } else if ((bytes < 0) && (errno == EINTR)) {
+            continue;
+        } else if ((bytes < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+            break;
+        } else {
+            return -1;
+        }
+    }
+
+    if (cp->outsent >= cp->outused) {
+        memset(cp->output, 0, cp->outused);
+        cp->outsent = 0;
+        cp->outused = 0;
+        if (cp->busy && (cp->owed == 0)) {
+            latency = now() - cp->arrival;
+            cp->latency += latency;
+            if (latency > cp->worst) { cp->worst = latency; }
+            cp->busy = 0;
+        }
+    }
+
+    return arm(cp);
+}
+
+/**
+ * Parse and execute the requests of a client, for as long as it has a
+ * complete request buffered and no response outstanding.
+ * @param cp points to the client.
+ * @return 0 for success, <0 if the client has gone away or misbehaved.
+ */
+static int execute(struct client * cp)
+{
+    uint8_t buffer[256];
+    char string[32];
+    size_t length = 0;
+    size_t need = 0;
+    uint32_t bits = 0;
+
+    while ((!cp->busy) && (cp->outused == 0) && (cp->inused > 0)) {
+
+        switch (cp->input[0]) {
+        case EGD_LEVEL:
+        case EGD_PID:
+            need = 1;
+            break;
+        case EGD_READ:
+        case EGD_BLOCK:
+            need = 2;
+            break;
+        case EGD_WRITE:
+            need = (cp->inused >= 4) ? (4 + cp->input[3]) : 4;
+            break;
+        default:
+            service_verbosef("%s: invalid      client=%lu 0x%x\n", program, cp->id, cp->input[0]);
+            return -1;
+        }
+
+        if (cp->inused < need) {
+            break;
+        }
+
+        cp->arrival = now();
+        cp->busy = !0;
+        ++(cp->requests);
+
+        switch (cp->input[0]) {
+
+        case EGD_LEVEL:
+            length = cp->prefetched + available();
+            bits = (length > (UINT32_MAX / 8)) ? UINT32_MAX : (length * 8);
+            buffer[0] = bits >> 24;
+            buffer[1] = bits >> 16;
+            buffer[2] = bits >> 8;
+            buffer[3] = bits;
+            respond(cp, buffer, 4);
+            break;
+
+        case EGD_READ:
+            buffer[0] = supply(cp, buffer + 1, cp->input[1]);
+            respond(cp, buffer, 1 + buffer[0]);
+            break;
+
+        case EGD_BLOCK:
+            cp->owed = cp->input[1];
+            if (head == (struct client *)0) {
+                length = supply(cp, buffer, cp->owed);
+                respond(cp, buffer, length);
+                cp->owed -= length;
+            }
+            if (cp->owed > 0) {
+                enqueue(cp);
+            }
+            break;
+
+        case EGD_WRITE:
+            cp->offered += cp->input[3];
+            break;
+
+        case EGD_PID:
+            length = snprintf(string, sizeof(string), "%d", getpid());
+            buffer[0] = length;
+            memcpy(buffer + 1, string, length);
+            respond(cp, buffer, 1 + length);
+            break;
+
+        }
+
+        memset(buffer, 0, sizeof(buffer));
+        cp->inused -= need;
+        memmove(cp->input, cp->input + need, cp->inused);
+
+        if (flush(cp) < 0) {
+            return -1;
+        }
+
+    }
+
+    if (!cp->busy) {
+        refill(cp);
+    }
+
+    return arm(cp);
+}
+
+/**
+ * Serve the clients waiting for the reservoir round robin, a quantum at a
+ * time, until the reservoir is empty or no client is waiting.
+ */
+static void schedule(void)
+{
+    uint8_t buffer[256];
+    struct client * cp = (struct client *)0;
+    size_t length = 0;
+
+    while ((head != (struct client *)0) && (available() > 0)) {
+
+        cp = head;
+        head = cp->queue;
+        if (head == (struct client *)0) { tail = (struct client *)0; }
+        cp->queue = (struct client *)0;
+        cp->queued = 0;
+
+        length = (cp->owed < quantum) ? cp->owed : quantum;
+        length = supply(cp, buffer, length);
+        respond(cp, buffer, length);
+        memset(buffer, 0, length);
+        cp->owed -= length;
+
+        if (cp->owed > 0) {
+            enqueue(cp);
+        }
+
+        if (flush(cp) < 0) {
+            disconnect(cp);
+        } else if (cp->owed > 0) {
+            /* Do nothing. */
+        } else if (cp->outused > 0) {
+            /* Do nothing. */
+        } else if (execute(cp) < 0) {
+            disconnect(cp);
+        } else {
+            /* Do nothing. */
+        }
+
+    }
+}
+
+/**
+ * Accept as many pending connections as there are.
+ * @param sock is the listening socket.
+ * @return 0 for success, <0 for failure.
+ */
+static int welcome(int sock)
+{
+    static unsigned long sequence = 0;
+    struct epoll_event event = { 0 };
+    struct ucred credentials = { 0 };
+    socklen_t length = 0;
+    struct client * cp = (struct client *)0;
+    int fd = -1;
+
+    while (!0) {
+
+        fd = accept4(sock, (struct sockaddr *)0, (socklen_t *)0, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd >= 0) {
+            /* Do nothing. */
+        } else if (errno == EINTR) {
+            continue;
+        } else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+            break;
+        } else if ((errno == EMFILE) || (errno == ENFILE) || (errno == ENOBUFS) || (errno == ENOMEM)) {
+            service_error("accept4");
+            break;
+        } else if (errno == ECONNABORTED) {
+            continue;
+        } else {
+            service_error("accept4");
+            return -1;
+        }
+
+        if (connected >= limit) {
+            service_verbosef("%s: refuse       %zu\n", program, connected);
+            close(fd);
+            continue;
+        }
+
+        cp = (struct client *)calloc(1, sizeof(*cp));
+        if (cp == (struct client *)0) {
+            service_error("calloc");
+            close(fd);
+            continue;
+        }
+        cp->prefetch = (uint8_t *)calloc(1, prefetch);
+        if (cp->prefetch == (uint8_t *)0) {
+            service_error("calloc");
+            free(cp);
+            close(fd);
+            continue;
+        }
+
+        cp->fd = fd;
+        cp->id = ++sequence;
+        cp->start = now();
+        length = sizeof(credentials);
+        if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) == 0) {
+            cp->pid = credentials.pid;
+            cp->uid = credentials.uid;
+        }
+
+        event.events = EPOLLIN;
+        event.data.ptr = cp;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            service_error("epoll_ctl");
+            free(cp->prefetch);
+            free(cp);
+            close(fd);
+            continue;
+        }
+        cp->events = event.events;
+
+        cp->next = clients;
+        clients = cp;
+        ++connected;
+
+        service_verbosef("%s: connect      client=%lu pid=%d uid=%d\n", program, cp->id, cp->pid, cp->uid);
+
+        refill(cp);
+
+    }
+
+    return 0;
+}
+
+/**
+ * Read whatever a client has sent and execute it.
+ * @param cp points to the client.
+ * @return 0 for success, <0 if the client has gone away or misbehaved.
+ */
+static int receive(struct client * cp)
+{
+    ssize_t bytes = 0;
+
+    while (cp->inused < sizeof(cp->input)) {
+        bytes = read(cp->fd, cp->input + cp->inused, sizeof(cp->input) - cp->inused);
+        if (bytes > 0) {
+            cp->inused += bytes;
+        } else if (bytes == 0) {
+            return -1;
+        } else if (errno == EINTR) {
+            continue;
+        } else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            return -1;
+        }
+    }
+
+    return execute(cp);
+}
+
+/**
+ * Listen on a Unix domain socket, removing a stale socket left behind by a
+ * prior instance but refusing to displace a running one.
+ * @param path is the path of the socket.
+ * @param mode is the permissions of the socket.
+ * @return the listening socket, or <0 for failure.
+ */
+static int listener(const char * path, mode_t mode)
+{
+    struct sockaddr_un address = { 0 };
+    struct stat status = { 0 };
+    int sock = -1;
+    int probe = -1;
+
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        errno = ENAMETOOLONG;
+        service_error(path);
+        return -1;
+    }
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe < 0) {
+        service_error("socket");
+        return -1;
+    }
+    if (connect(probe, (struct sockaddr *)&address, sizeof(address)) == 0) {
+        close(probe);
+        errno = EADDRINUSE;
+        service_error(path);
+        return -1;
+    }
+    close(probe);
+
+    /*
+     * Connecting to anything that is not a listening socket, a regular file
+     * included, is refused, so only an actual socket is removed as stale.
+     */
+
+    if (errno != ECONNREFUSED) {
+        /* Do nothing. */
+    } else if (lstat(path, &status) < 0) {
+        service_error(path);
+        return -1;
+    } else if (!S_ISSOCK(status.st_mode)) {
+        errno = EEXIST;
+        service_error(path);
+        return -1;
+    } else if (unlink(path) < 0) {
+        service_error(path);
+        return -1;
+    } else {
+        service_verbosef("%s: stale        \"%s\"\n", program, path);
+    }
+
+    sock = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        service_error("socket");
+        return -1;
+    }
+
+    if (bind(sock, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        service_error(path);
+        close(sock);
+        return -1;
+    }
+
+    if (chmod(path, mode) < 0) {
+        service_error(path);
+        close(sock);
+        unlink(path);
+        return -1;
+    }
+
+    if (listen(sock, SOMAXCONN) < 0) {
+        service_error("listen");
+        close(sock);
+        unlink(path);
+        return -1;
+    }
+
+    return sock;
+}
+
+/**
+ * This is the main program.
+ * @param argc is the count of command line arguments.
+ * @param argv is a vector of pointers to the command line arguments.
+ */
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    char * end = (char *)0;
+    int rc = 0;
+    int sock = -1;
+    int ready = 0;
+    int listening = 0;
+    int fresh = 0;
+    struct sigaction action = { 0 };
+    int daemonize = 0;
+    struct epoll_event event = { 0 };
+    struct epoll_event events[EVENTS];
+    struct rlimit files = { 0 };
+    struct client * cp = (struct client *)0;
+    sigset_t mask;
+    sigset_t prior;
+    static struct channel channels[SOURCES];
+    const char * names[SOURCES] = { "/dev/hwrng", };
+    size_t nnames = 0;
+    size_t nchannels = 0;
+    size_t finished = 0;
+    const char * path = "/var/run/egd-pool";
+    const char * spillpath = (const char *)0;
+    size_t capacity = 1048576;
+    size_t spillsize = 0;
+    size_t low = 0;
+    size_t high = 0;
+    mode_t mode = 0666;
+    uint64_t count = 0;
+    size_t ii;
+    int jj;
+    int opt;
+    extern char * optarg;
+
+    /*
+     * Crack open the command line argument vector.
+     */
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "dvDi:s:p:m:c:r:S:Z:L:H:b:q:h")) >= 0) {
+
+        switch (opt) {
+
+        case 'd':
+            debug = !0;
+            break;
+
+        case 'v':
+            service_verbose = !0;
+            break;
+
+        case 'D':
+            daemonize = !0;
+            break;
+
+        case 'i':
+            ident = optarg;
+            break;
+
+        case 's':
+            if (nnames < SOURCES) {
+                names[nnames++] = optarg;
+            } else {
+                errno = E2BIG;
+                service_error(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'p':
+            path = optarg;
+            break;
+
+        case 'm':
+            mode = strtoul(optarg, &end, 8);
+            if ((*end != '\0') || (mode > 0777)) {
+                errno = EINVAL;
+                service_error(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'c':
+            limit = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (limit == 0)) {
+                errno = EINVAL;
+                service_error(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'r':
+            capacity = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (capacity < FIPS_BYTES)) {
+                errno = EINVAL;
+                service_error(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'S':
+            spillpath = optarg;
+            break;
+
+        case 'Z':
+            spillsize = strtoul(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                service_error(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'L':
+            low = strtoul(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                service_error(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'H':
+            high = strtoul(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                service_error(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'b':
+            prefetch = strtoul(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                service_error(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'q':
+            quantum = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (quantum == 0) || (quantum > 255)) {
+                errno = EINVAL;
+                service_error(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'h':
+            xc = 0;
+            error = !0;
+            break;
+
+        default:
+            error = !0;
+            break;
+
+        }
+
+        if (error) {
+            break;
+        }
+
+    }
+
+    do {
+
+        if (error) {
+            usage(xc);
+            break;
+        }
+
+        if (nnames == 0) {
+            nnames = 1;
+        }
+
+        for (nchannels = 0; nchannels < nnames; ++nchannels) {
+            if (source_parse(&(channels[nchannels].device), names[nchannels]) < 0) {
+                service_error(names[nchannels]);
+                break;
+            }
+        }
+        if (nchannels < nnames) {
+            break;
+        }
+
+        if ((spillpath != (const char *)0) && (spillsize == 0)) {
+            spillsize = 16 * capacity;
+        }
+
+        if (reservoir_create(&reservoir, capacity, spillpath, spillsize, low, high) < 0) {
+            service_error((spillpath != (const char *)0) ? spillpath : "reservoir");
+            break;
+        }
+
+        /*
+         * Make sure we have enough file descriptors for our clients.
+         */
+
+        if (getrlimit(RLIMIT_NOFILE, &files) < 0) {
+            service_error("getrlimit");
+            break;
+        }
+        if (files.rlim_cur < (limit + 32)) {
+            files.rlim_cur = ((limit + 32) < files.rlim_max) ? (limit + 32) : files.rlim_max;
+            if (setrlimit(RLIMIT_NOFILE, &files) < 0) {
+                service_error("setrlimit");
+            }
+        }
+
+        /*
+         * Daemonize if so configured.
+         */
+
+        if (!daemonize) {
+            /* Do nothing. */
+        } else if (service_daemonize(ident) < 0) {
+            perror("daemon");
+            break;
+        } else {
+            service_verbosef("%s: pid          %d\n", program, getpid());
+        }
+
+        for (ii = 0; ii < nchannels; ++ii) {
+            service_verbosef("%s: source       \"%s\"\n", program, channels[ii].device.name);
+            service_verbosef("%s: kind         %s\n", program, SOURCE_KINDS[channels[ii].device.kind]);
+        }
+        service_verbosef("%s: path         \"%s\"\n", program, path);
+        service_verbosef("%s: mode         0%o\n", program, mode);
+        service_verbosef("%s: clients      %zu\n", program, limit);
+        service_verbosef("%s: files        %lu\n", program, (unsigned long)files.rlim_cur);
+        service_verbosef("%s: reservoir    %zu\n", program, reservoir.metrics.capacity);
+        if (spillpath != (const char *)0) {
+            service_verbosef("%s: spill        \"%s\" %zu\n", program, spillpath, reservoir.metrics.spillsize);
+        }
+        service_verbosef("%s: low          %zu\n", program, reservoir.metrics.low);
+        service_verbosef("%s: high         %zu\n", program, reservoir.metrics.high);
+        service_verbosef("%s: prefetch     %zu\n", program, prefetch);
+        service_verbosef("%s: quantum      %zu\n", program, quantum);
+
+        /*
+         * Install our signal handlers. SIGPIPE is ignored, since a client
+         * may disconnect at any time.
+         */
+
+        if (service_signals() < 0) {
+            service_error("sigaction");
+            break;
+        }
+        action.sa_handler = SIG_IGN;
+        action.sa_flags = 0;
+        if (sigaction(SIGPIPE, &action, (struct sigaction *)0) < 0) {
+            service_error("sigaction");
+            break;
+        }
+
+        /*
+         * Set up the socket and the epoll set. The workers wake us up using
+         * an event file descriptor when they deposit a block.
+         */
+
+        notifier = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (notifier < 0) {
+            service_error("eventfd");
+            break;
+        }
+
+        epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (epfd < 0) {
+            service_error("epoll_create1");
+            break;
+        }
+
+        sock = listener(path, mode);
+        if (sock < 0) {
+            break;
+        }
+        listening = !0;
+
+        event.events = EPOLLIN;
+        event.data.ptr = &sock;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, sock, &event) < 0) {
+            service_error("epoll_ctl");
+            break;
+        }
+
+        event.events = EPOLLIN;
+        event.data.ptr = &notifier;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, notifier, &event) < 0) {
+            service_error("epoll_ctl");
+            break;
+        }
+
+        /*
+         * Start a worker thread for each source. The workers block our
+         * signals so that they are always delivered to the main thread.
+         */
+
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGINT);
+        sigaddset(&mask, SIGTERM);
+        sigaddset(&mask, SIGHUP);
+        pthread_sigmask(SIG_BLOCK, &mask, &prior);
+        for (ii = 0; ii < nchannels; ++ii) {
+            rc = pthread_create(&(channels[ii].thread), (pthread_attr_t *)0, worker, &(channels[ii]));
+            if (rc != 0) {
+                errno = rc;
+                service_error("pthread_create");
+                break;
+            }
+        }
+        pthread_sigmask(SIG_SETMASK, &prior, (sigset_t *)0);
+        if (ii < nchannels) {
+            break;
+        }
+
+        /*
+         * Enter our work loop, serving the clients.
+         */
+
+        xc = 0;
+
+        while (!service_done) {
+
+            if (service_report) {
+                statistics(channels, nchannels);
+                service_report = 0;
+            }
+
+            ready = epoll_wait(epfd, events, EVENTS, 1000);
+            if (ready >= 0) {
+                /* Do nothing. */
+            } else if (errno == EINTR) {
+                continue;
+            } else {
+                service_error("epoll_wait");
+                xc = 1;
+                break;
+            }
+
+            for (jj = 0; jj < ready; ++jj) {
+                if (events[jj].data.ptr == &sock) {
+                    if (welcome(sock) < 0) {
+                        service_done = !0;
+                        xc = 1;
+                    }
+                } else if (events[jj].data.ptr == &notifier) {
+                    if (read(notifier, &count, sizeof(count)) > 0) {
+                        fresh = !0;
+                    }
+                } else {
+                    cp = (struct client *)events[jj].data.ptr;
+                    if ((events[jj].events & EPOLLOUT) && (flush(cp) < 0)) {
+                        disconnect(cp);
+                    } else if ((events[jj].events & EPOLLOUT) && (execute(cp) < 0)) {
+                        disconnect(cp);
+                    } else if (events[jj].events & (EPOLLHUP | EPOLLERR)) {
+                        disconnect(cp);
+                    } else if ((events[jj].events & EPOLLIN) && (receive(cp) < 0)) {
+                        disconnect(cp);
+                    } else {
+                        /* Do nothing. */
+                    }
+                }
+            }
+
+            /*
+             * Serve the waiting clients, then (if new data has arrived and
+             * nobody is left waiting) top up the prefetch buffers of the
+             * idle clients.
+             */
+
+            schedule();
+
+            if (fresh && (head == (struct client *)0)) {
+                for (cp = clients; cp != (struct client *)0; cp = cp->next) {
+                    if (!cp->busy) { refill(cp); }
+                }
+                fresh = 0;
+            }
+
+            if (debug) {
+                statistics(channels, nchannels);
+            }
+
+            for (finished = 0, ii = 0; ii < nchannels; ++ii) {
+                if (channels[ii].finished) { ++finished; }
+            }
+            if ((finished >= nchannels) && (available() == 0) && (head != (struct client *)0)) {
+                service_printf("%s: exhausted\n", program);
+                xc = 2;
+                break;
+            }
+
+        }
+
+        statistics(channels, nchannels);
+
+    } while (0);
+
+    /*
+     * Clean up after ourselves. The workers are told to stop but are not
+     * joined, since a worker may be blocked in a read from a device that has
+     * stopped producing data.
+     */
+
+    service_done = !0;
+    reservoir_close(&reservoir);
+
+    while (clients != (struct client *)0) {
+        disconnect(clients);
+    }
+
+    if (sock >= 0) {
+        close(sock);
+    }
+
+    if (listening) {
+        unlink(path);
+    }
+
+    if (epfd >= 0) {
+        close(epfd);
+    }
+
+    service_verbosef("%s: exit         %d\n", program, xc);
+
+    return xc;
+}
@@ -0,0 +1,314 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * EGD Test<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * egdtest [ EGD ]
+ *
+ * EXAMPLES
+ *
+ * make test
+ *
+ * egdtest out/host/bin/egd
+ *
+ * ABSTRACT
+ *
+ * Runs the egd daemon at EGD (default egd) with a FIFO as its only source
+ * and checks that it serves a client that pipelines its requests: one that
+ * sends a blocking read that cannot be satisfied, because nothing has been
+ * written to the FIFO, followed by many more requests than fit in the
+ * daemon's input buffer without waiting for the responses. The daemon must
+ * stay all but idle while the blocking read is outstanding, and once the
+ * FIFO is fed it must answer every request in full. The FIFO and socket are
+ * made in a new directory under TMPDIR (default /tmp). Each case is
+ * displayed as it passes or fails, and the exit status is the number of
+ * failures. This is part of the Scattergun project.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static const char * program = "egdtest";
+
+static int failures = 0;
+
+enum {
+    BLOCK = 255,        /* Bytes asked for by the blocking read. */
+    PIPELINED = 2000,   /* Level requests sent behind it. */
+    FEED = 8 * 2500,    /* Bytes written to the FIFO, in FIPS blocks. */
+};
+
+static void check(const char * name, int condition, const char * what)
+{
+    printf("%s: %s %s %s\n", program, name, what, condition ? "PASSED" : "FAILED");
+    if (!condition) {
+        ++failures;
+    }
+}
+
+/**
+ * Return the processor time consumed by a process so far.
+ * @param pid is the process identifier.
+ * @return the user and system time in clock ticks, or <0 for failure.
+ */
+static long ticks(pid_t pid)
+{
+    char path[64];
+    char buffer[1024];
+    const char * here = (const char *)0;
+    unsigned long utime = 0;
+    unsigned long stime = 0;
+    FILE * fp = (FILE *)0;
+    size_t length = 0;
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    if ((fp = fopen(path, "r")) == (FILE *)0) {
+        return -1;
+    }
+    length = fread(buffer, 1, sizeof(buffer) - 1, fp);
+    fclose(fp);
+    buffer[length] = '\0';
+
+    /*
+     * The command name may contain spaces, so the fields are counted from
+     * the parenthesis that ends it: state is the first, utime the twelfth.
+     */
+
+    if ((here = strrchr(buffer, ')')) == (const char *)0) {
+        return -1;
+    }
+    if (sscanf(here + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2) {
+        return -1;
+    }
+
+    return utime + stime;
+}
+
+/**
+ * Connect to the daemon's socket, waiting for it to start listening.
+ * @param path is the path of the socket.
+ * @return the connected socket, or <0 for failure.
+ */
+static int attach(const char * path)
+{
+    struct sockaddr_un address = { 0 };
+    int fd = -1;
+    int ii;
+
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+
+    for (ii = 0; ii < 100; ++ii) {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        if (connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0) {
+            return fd;
+        }
+        close(fd);
+        poll((struct pollfd *)0, 0, 50);
+    }
+
+    return -1;
+}
+
+/**
+ * Read what the daemon sends until the expected number of bytes arrive or
+ * nothing arrives for a while.
+ * @param fd is the connected socket.
+ * @param expected is the number of bytes expected.
+ * @return the number of bytes read.
+ */
+static size_t drain(int fd, size_t expected)
+{
+    struct pollfd pfd = { 0 };
+    uint8_t buffer[4096];
+    size_t total = 0;
+    ssize_t bytes = 0;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    while (total < expected) {
+        if (poll(&pfd, 1, 5000) <= 0) {
+            break;
+        }
+        bytes = read(fd, buffer, sizeof(buffer));
+        if (bytes <= 0) {
+            break;
+        }
+        total += bytes;
+    }
+
+    return total;
+}
+
+int main(int argc, char * argv[])
+{
+    const char * egd = "egd";
+    const char * tmpdir = (const char *)0;
+    char directory[256];
+    char fifo[sizeof(directory) + 16];
+    char path[sizeof(directory) + 16];
+    uint8_t requests[2 + PIPELINED] = { 0 };
+    uint8_t * feed = (uint8_t *)0;
+    long before = 0;
+    long after = 0;
+    long hz = 0;
+    size_t received = 0;
+    pid_t pid = -1;
+    int source = -1;
+    int random = -1;
+    int sock = -1;
+    int status = 0;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    if (argc > 1) {
+        egd = argv[1];
+    }
+
+    if ((tmpdir = getenv("TMPDIR")) == (const char *)0) {
+        tmpdir = "/tmp";
+    }
+    snprintf(directory, sizeof(directory), "%s/%s.XXXXXX", tmpdir, program);
+    if (mkdtemp(directory) == (char *)0) {
+        perror(directory);
+        return 1;
+    }
+    snprintf(fifo, sizeof(fifo), "%s/source", directory);
+    snprintf(path, sizeof(path), "%s/socket", directory);
+
+    do {
+
+        /*
+         * Holding both ends of the FIFO keeps the daemon's source from
+         * reaching end of file, and lets it open the FIFO without waiting.
+         */
+
+        if (mkfifo(fifo, 0600) < 0) {
+            perror(fifo);
+            ++failures;
+            break;
+        }
+        if ((source = open(fifo, O_RDWR)) < 0) {
+            perror(fifo);
+            ++failures;
+            break;
+        }
+
+        pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            ++failures;
+            break;
+        } else if (pid == 0) {
+            close(source);
+            execl(egd, egd, "-s", fifo, "-p", path, (char *)0);
+            perror(egd);
+            _exit(127);
+        } else {
+            /* Do nothing. */
+        }
+
+        if ((sock = attach(path)) < 0) {
+            perror(path);
+            ++failures;
+            break;
+        }
+
+        /*
+         * A blocking read that the empty reservoir cannot satisfy, followed
+         * by level requests that overflow the daemon's input buffer.
+         */
+
+        requests[0] = 0x02;
+        requests[1] = BLOCK;
+        if (write(sock, requests, sizeof(requests)) != sizeof(requests)) {
+            perror("write");
+            ++failures;
+            break;
+        }
+
+        poll((struct pollfd *)0, 0, 250);
+        hz = sysconf(_SC_CLK_TCK);
+        before = ticks(pid);
+        poll((struct pollfd *)0, 0, 1000);
+        after = ticks(pid);
+        check("pipelined", (before >= 0) && (after >= 0) && ((after - before) < (hz / 4)), "idle while blocked");
+
+        /*
+         * Feed the FIFO enough to pass the FIPS 140-2 tests and satisfy the
+         * blocking read, after which every request must be answered.
+         */
+
+        if ((feed = (uint8_t *)malloc(FEED)) == (uint8_t *)0) {
+            perror("malloc");
+            ++failures;
+            break;
+        }
+        if (((random = open("/dev/urandom", O_RDONLY)) < 0) || (read(random, feed, FEED) != FEED)) {
+            perror("/dev/urandom");
+            ++failures;
+            break;
+        }
+        if (write(source, feed, FEED) != FEED) {
+            perror(fifo);
+            ++failures;
+            break;
+        }
+
+        received = drain(sock, BLOCK + (4 * PIPELINED));
+        check("pipelined", received == (BLOCK + (4 * PIPELINED)), "answered");
+
+    } while (0);
+
+    if (sock >= 0) {
+        close(sock);
+    }
+
+    if (pid > 0) {
+        kill(pid, SIGTERM);
+        if (waitpid(pid, &status, 0) == pid) {
+            check("daemon", WIFEXITED(status) && (WEXITSTATUS(status) == 0), "exit");
+        }
+    }
+
+    if (random >= 0) {
+        close(random);
+    }
+    if (source >= 0) {
+        close(source);
+    }
+    free(feed);
+
+    unlink(path);
+    unlink(fifo);
+    rmdir(directory);
+
+    printf("%s: failures=%d\n", program, failures);
+
+    return failures;
+}
@@ -0,0 +1,645 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Emulator<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * emulator [ -h ] [ -v ] [ -l LINK ] [ -b BITS ] [ -c BYTES ] [ -m MODE ] [ -p PARAMETER ] [ -s SEED ] [ -t BYTES ] [ -n ]
+ *
+ * OPTIONS
+ *
+ * -b BITS         Emit at most this many bits per second (0 for no limit).
+ * -c BYTES        Emit this many bytes at a time.
+ * -h              Display this menu.
+ * -l LINK         Create a symbolic link LINK to the pseudo-terminal.
+ * -m MODE         Emit good, biased, stuck, or periodic data.
+ * -n              Emit nothing until the OneRNG command cmdO is received.
+ * -p PARAMETER    Probability of a one bit, stuck byte value, or period.
+ * -s SEED         Seed the generator.
+ * -t BYTES        Exit after emitting this many bytes.
+ * -v              Display verbose output to stderr.
+ *
+ * EXAMPLES
+ *
+ * emulator -l /tmp/TrueRNGpro -b 3200000 &
+ * rate -f /tmp/TrueRNGpro -T -r 65536 -t 40000000 -x 3000
+ *
+ * emulator -l /tmp/OneRNG -b 350000 -n &
+ * feeder -v -s onerng:/tmp/OneRNG -o random.dat
+ *
+ * emulator -l /tmp/TrueRNG -b 350000 -m biased -p 0.55 &
+ * dd if=/tmp/TrueRNG | scattergun.sh biased-test
+ *
+ * ABSTRACT
+ *
+ * Emulates a USB serial entropy generator like the ubld.it TrueRNG or
+ * TrueRNGpro or the Moonbase Otago OneRNG using a pseudo-terminal, so that the
+ * serial device paths through feeder, rate, and scattergun.sh can be tested
+ * and benchmarked without the hardware. The name of the slave side of the
+ * pseudo-terminal is printed to standard output. Data is emitted in chunks of
+ * the specified size (like USB bulk transfers) at the specified bit rate.
+ * It can be good (from a xoshiro256** generator), biased (each bit is one
+ * with probability PARAMETER), stuck (every byte is PARAMETER), or periodic
+ * (a good sequence of PARAMETER bytes repeated). Like a OneRNG, "cmdO" turns
+ * the output on, "cmdo" turns it off, and "cmd0" through "cmd7" select the
+ * noise mode: the whitened modes 0, 2, and 6 emit good data, the unwhitened
+ * modes 1, 3, and 7 biased data, mode 4 (whitened, no noise) periodic data,
+ * and mode 5 (unwhitened, no noise) stuck data. This is part of the
+ * Scattergun project.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+static const char * program = "emulator";
+static int done = 0;
+static int report = 0;
+
+enum mode { GOOD=0, BIASED=1, STUCK=2, PERIODIC=3, };
+static const char * MODE[] = { "good", "biased", "stuck", "periodic", };
+
+/**
+ * This maps the OneRNG noise modes selected by cmd0 through cmd7 onto the
+ * kind of data we emit.
+ */
+static const enum mode ONERNG[] = { GOOD, BIASED, GOOD, BIASED, PERIODIC, STUCK, GOOD, BIASED, };
+
+/**
+ * This is the state of the xoshiro256** generator.
+ */
+struct generator {
+    uint64_t s[4];
+};
+
+static void handler(int signum)
+{
+    if (signum == SIGPIPE) {
+        done = !0;
+    } else if (signum == SIGINT) {
+        done = !0;
+    } else if (signum == SIGTERM) {
+        done = !0;
+    } else if (signum == SIGHUP) {
+        report = !0;
+    } else {
+        /* Do nothing. */
+    }
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [ -h ] [ -v ] [ -l LINK ] [ -b BITS ] [ -c BYTES ] [ -m MODE ] [ -p PARAMETER ] [ -s SEED ] [ -t BYTES ] [ -n ]\n", program);
+    fprintf(stderr, "       -b BITS         Emit at most this many bits per second (0 for no limit).\n");
+    fprintf(stderr, "       -c BYTES        Emit this many bytes at a time.\n");
+    fprintf(stderr, "       -h              Display this menu.\n");
+    fprintf(stderr, "       -l LINK         Create a symbolic link LINK to the pseudo-terminal.\n");
+    fprintf(stderr, "       -m MODE         Emit good, biased, stuck, or periodic data.\n");
+    fprintf(stderr, "       -n              Emit nothing until the OneRNG command cmdO is received.\n");
+    fprintf(stderr, "       -p PARAMETER    Probability of a one bit, stuck byte value, or period.\n");
+    fprintf(stderr, "       -s SEED         Seed the generator.\n");
+    fprintf(stderr, "       -t BYTES        Exit after emitting this many bytes.\n");
+    fprintf(stderr, "       -v              Display verbose output to stderr.\n");
+}
+
+static uint64_t watch(void)
+{
+    struct timespec spec = { 0 };
+    uint64_t ticks = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &spec);
+    ticks = spec.tv_sec;
+    ticks *= 1000000000;
+    ticks += spec.tv_nsec;
+
+    return ticks;
+}
+
+/**
+ * Seed the generator by running SplitMix64 on the seed, as recommended by
+ * the authors of xoshiro256**.
+ * @param gp points to the generator.
+ * @param seed is the seed.
+ */
+static void seed(struct generator * gp, uint64_t seed)
+{
+    uint64_t z;
+    int ii;
+
+    for (ii = 0; ii < 4; ++ii) {
+        z = (seed += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        gp->s[ii] = z ^ (z >> 31);
+    }
+}
+
+static inline uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+/**
+ * Return the next value from the xoshiro256** generator.
+ * @param gp points to the generator.
+ * @return the next value.
+ */
+static inline uint64_t next(struct generator * gp)
+{
+    uint64_t result = rotl(gp->s[1] * 5, 7) * 9;
+    uint64_t t = gp->s[1] << 17;
+
+    gp->s[2] ^= gp->s[0];
+    gp->s[3] ^= gp->s[1];
+    gp->s[1] ^= gp->s[2];
+    gp->s[0] ^= gp->s[3];
+    gp->s[2] ^= t;
+    gp->s[3] = rotl(gp->s[3], 45);
+
+    return result;
+}
+
+/**
+ * Fill a buffer with good data.
+ * @param gp points to the generator.
+ * @param buffer points to the buffer.
+ * @param size is the size of the buffer in bytes.
+ */
+static void good(struct generator * gp, uint8_t * buffer, size_t size)
+{
+    uint64_t word;
+    size_t length;
+
+    while (size > 0) {
+        word = next(gp);
+        length = (size < sizeof(word)) ? size : sizeof(word);
+        memcpy(buffer, &word, length);
+        buffer += length;
+        size -= length;
+    }
+}
+
+/**
+ * Fill a buffer with biased data in which each bit is a one with the
+ * specified probability.
+ * @param gp points to the generator.
+ * @param buffer points to the buffer.
+ * @param size is the size of the buffer in bytes.
+ * @param threshold is the probability of a one scaled to 2^32.
+ */
+static void biased(struct generator * gp, uint8_t * buffer, size_t size, uint64_t threshold)
+{
+    uint64_t word;
+    uint8_t byte;
+    int ii;
+
+    while ((size--) > 0) {
+        byte = 0;
+        for (ii = 0; ii < 8; ii += 2) {
+            word = next(gp);
+            byte |= ((word & 0xffffffffULL) < threshold) << ii;
+            byte |= ((word >> 32) < threshold) << (ii + 1);
+        }
+        *(buffer++) = byte;
+    }
+}
+
+/**
+ * Parse any complete OneRNG commands in the command buffer, and shift out
+ * what was consumed.
+ * @param line points to the command buffer.
+ * @param lengthp points to the length of the command buffer.
+ * @param enabledp points to the output enabled flag.
+ * @param modep points to the current mode.
+ * @param verbose enables verbose output.
+ * @return the number of commands recognized.
+ */
+static int command(char * line, size_t * lengthp, int * enabledp, enum mode * modep, int verbose)
+{
+    char * here = line;
+    char * end = line + *lengthp;
+    char * found;
+    int commands = 0;
+    char code;
+
+    while ((found = memmem(here, end - here, "cmd", 3)) != (char *)0) {
+        if ((found + 3) >= end) {
+            here = found;
+            break;
+        }
+        code = found[3];
+        if (code == 'O') {
+            *enabledp = !0;
+        } else if (code == 'o') {
+            *enabledp = 0;
+        } else if (('0' <= code) && (code <= '7')) {
+            *modep = ONERNG[code - '0'];
+        } else {
+            /* Do nothing: e.g. cmdX (extract firmware) is not emulated. */
+        }
+        if (verbose) {
+            fprintf(stderr, "%s: cmd%c enabled=%d mode=%s\n", program, code, *enabledp, MODE[*modep]);
+        }
+        ++commands;
+        here = found + 4;
+    }
+
+    if ((found == (char *)0) && ((end - here) > 2)) {
+        here = end - 2;
+    }
+
+    *lengthp = end - here;
+    memmove(line, here, *lengthp);
+
+    return commands;
+}
+
+/**
+ * This is the main program.
+ * @param argc is the count of command line arguments.
+ * @param argv is a vector of pointers to the command line arguments.
+ */
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int verbose = 0;
+    int enabled = !0;
+    enum mode mode = GOOD;
+    const char * link = (const char *)0;
+    const char * name = (const char *)0;
+    uint64_t bits = 3200000;
+    size_t size = 512;
+    double parameter = -1.0;
+    uint64_t threshold = 0;
+    uint64_t value = 0;
+    size_t period = 0;
+    uint64_t initial = 0;
+    size_t limit = ~0;
+    struct generator generator = { { 0 } };
+    uint8_t * buffer = (uint8_t *)0;
+    uint8_t * pattern = (uint8_t *)0;
+    size_t phase = 0;
+    int master = -1;
+    int slave = -1;
+    struct termios tios = { 0 };
+    struct sigaction action = { 0 };
+    struct pollfd pfd = { 0 };
+    char line[64];
+    size_t length = 0;
+    ssize_t bytes = 0;
+    size_t total = 0;
+    size_t chunks = 0;
+    size_t commands = 0;
+    size_t late = 0;
+    uint64_t epoch = 0;
+    uint64_t deadline = 0;
+    uint64_t now = 0;
+    struct timespec request = { 0 };
+    char * end = (char *)0;
+    size_t ii;
+    int opt;
+    extern char * optarg;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    initial = watch();
+
+    while ((opt = getopt(argc, argv, "b:c:hl:m:np:s:t:v")) >= 0) {
+
+        switch (opt) {
+
+        case 'b':
+            bits = strtoull(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'c':
+            size = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (size == 0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'h':
+            usage();
+            xc = 0;
+            error = !0;
+            break;
+
+        case 'l':
+            link = optarg;
+            break;
+
+        case 'm':
+            for (ii = 0; ii < (sizeof(MODE) / sizeof(MODE[0])); ++ii) {
+                if (strcmp(optarg, MODE[ii]) == 0) {
+                    mode = ii;
+                    break;
+                }
+            }
+            if (ii >= (sizeof(MODE) / sizeof(MODE[0]))) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'n':
+            enabled = 0;
+            break;
+
+        case 'p':
+            parameter = strtod(optarg, &end);
+            if ((*end != '\0') || (parameter < 0.0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 's':
+            initial = strtoull(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 't':
+            limit = strtoul(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        default:
+            usage();
+            error = !0;
+            break;
+
+        }
+
+        if (error) {
+            break;
+        }
+
+    }
+
+    do {
+
+        if (error) {
+            break;
+        }
+
+        threshold = ((parameter >= 0.0) && (parameter <= 1.0)) ? parameter * 4294967296.0 : 0.55 * 4294967296.0;
+        value = (parameter >= 0.0) ? (uint64_t)parameter : 0;
+        period = (parameter >= 1.0) ? (size_t)parameter : 4096;
+
+        seed(&generator, initial);
+
+        buffer = (uint8_t *)malloc(size);
+        pattern = (uint8_t *)malloc(period);
+        if ((buffer == (uint8_t *)0) || (pattern == (uint8_t *)0)) {
+            perror("malloc");
+            break;
+        }
+        good(&generator, pattern, period);
+
+        /*
+         * Create the pseudo-terminal. We keep the slave side open ourselves,
+         * in raw mode so it doesn't echo our data back to us, so that readers
+         * can come and go without our getting EIO on the master side.
+         */
+
+        master = posix_openpt(O_RDWR | O_NOCTTY);
+        if (master < 0) {
+            perror("posix_openpt");
+            break;
+        }
+        if (grantpt(master) < 0) {
+            perror("grantpt");
+            break;
+        }
+        if (unlockpt(master) < 0) {
+            perror("unlockpt");
+            break;
+        }
+        name = ptsname(master);
+        if (name == (const char *)0) {
+            perror("ptsname");
+            break;
+        }
+        slave = open(name, O_RDWR | O_NOCTTY);
+        if (slave < 0) {
+            perror(name);
+            break;
+        }
+        if (tcgetattr(slave, &tios) < 0) {
+            perror("tcgetattr");
+            break;
+        }
+        cfmakeraw(&tios);
+        if (tcsetattr(slave, TCSANOW, &tios) < 0) {
+            perror("tcsetattr");
+            break;
+        }
+
+        if (link != (const char *)0) {
+            (void)unlink(link);
+            if (symlink(name, link) < 0) {
+                perror(link);
+                break;
+            }
+        }
+
+        printf("%s\n", name);
+        fflush(stdout);
+
+        if (verbose) {
+            fprintf(stderr, "%s: %s pseudo-terminal\n", program, name);
+            fprintf(stderr, "%s: %llu bits/second\n", program, (unsigned long long)bits);
+            fprintf(stderr, "%s: %zu bytes chunk\n", program, size);
+            fprintf(stderr, "%s: %s mode\n", program, MODE[mode]);
+            fprintf(stderr, "%s: %d enabled\n", program, enabled);
+        }
+
+        action.sa_handler = handler;
+        action.sa_flags = 0;
+        sigaction(SIGPIPE, &action, (struct sigaction *)0);
+        sigaction(SIGINT, &action, (struct sigaction *)0);
+        sigaction(SIGTERM, &action, (struct sigaction *)0);
+        action.sa_flags = SA_RESTART;
+        sigaction(SIGHUP, &action, (struct sigaction *)0);
+
+        xc = 0;
+        epoch = watch();
+        deadline = epoch;
+
+        while ((!done) && (total < limit)) {
+
+            if (report) {
+                fprintf(stderr, "%s: total=%zu chunks=%zu commands=%zu late=%zu mode=%s enabled=%d\n", program, total, chunks, commands, late, MODE[mode], enabled);
+                report = 0;
+            }
+
+            /*
+             * Wait until it is time for the next chunk, or for a command from
+             * the reader, whichever comes first.
+             */
+
+            now = watch();
+            pfd.fd = master;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            if (!enabled) {
+                bytes = poll(&pfd, 1, 100);
+            } else if (now < deadline) {
+                bytes = poll(&pfd, 1, 0);
+                if (bytes == 0) {
+                    request.tv_sec = (deadline - now) / 1000000000;
+                    request.tv_nsec = (deadline - now) % 1000000000;
+                    nanosleep(&request, (struct timespec *)0);
+                    continue;
+                }
+            } else {
+                bytes = poll(&pfd, 1, 0);
+            }
+
+            if ((bytes > 0) && (pfd.revents & POLLIN)) {
+                bytes = read(master, line + length, sizeof(line) - length);
+                if (bytes > 0) {
+                    length += bytes;
+                    commands += command(line, &length, &enabled, &mode, verbose);
+                    if (length >= sizeof(line)) {
+                        length = 0;
+                    }
+                }
+                if (enabled && (deadline < now)) {
+                    deadline = now;
+                }
+            }
+
+            if (!enabled) {
+                continue;
+            }
+
+            now = watch();
+            if (now < deadline) {
+                continue;
+            }
+
+            /*
+             * If we have fallen more than a second behind (because nobody was
+             * reading), start the schedule over rather than bursting.
+             */
+
+            if ((now - deadline) > 1000000000ULL) {
+                ++late;
+                deadline = now;
+            }
+
+            switch (mode) {
+            case GOOD:
+                good(&generator, buffer, size);
+                break;
+            case BIASED:
+                biased(&generator, buffer, size, threshold);
+                break;
+            case STUCK:
+                memset(buffer, (int)value, size);
+                break;
+            case PERIODIC:
+                for (ii = 0; ii < size; ++ii) {
+                    buffer[ii] = pattern[phase];
+                    phase = (phase + 1) % period;
+                }
+                break;
+            }
+
+            bytes = size;
+            if (bytes > (limit - total)) {
+                bytes = limit - total;
+            }
+            bytes = write(master, buffer, bytes);
+            if (bytes > 0) {
+                /* Do nothing. */
+            } else if ((bytes < 0) && (errno == EINTR)) {
+                continue;
+            } else {
+                perror("write");
+                xc = 2;
+                break;
+            }
+
+            total += bytes;
+            ++chunks;
+
+            if (bits > 0) {
+                deadline += (bytes * 8ULL * 1000000000ULL) / bits;
+            }
+
+        }
+
+        if (verbose) {
+            now = watch();
+            fprintf(stderr, "%s: %zu bytes total\n", program, total);
+            fprintf(stderr, "%s: %zu chunks\n", program, chunks);
+            fprintf(stderr, "%s: %zu commands\n", program, commands);
+            fprintf(stderr, "%s: %zu late\n", program, late);
+            if (now > epoch) {
+                fprintf(stderr, "%s: %lf kilobits/second sustained\n", program, (total * 8.0 * 1000000.0) / (now - epoch));
+            }
+        }
+
+    } while (0);
+
+    if (link != (const char *)0) {
+        (void)unlink(link);
+    }
+
+    if (slave >= 0) {
+        close(slave);
+    }
+
+    if (master >= 0) {
+        close(master);
+    }
+
+    free(buffer);
+    free(pattern);
+
+    return xc;
+}
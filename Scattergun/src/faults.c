@@ -0,0 +1,651 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Faults<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * faults [ -h ] [ -v ] [ -n ] [ -s SEED ] [ -z BYTES ] [ -t BYTES ] [ -d DEFECT ... ]
+ *
+ * OPTIONS
+ *
+ * -d DEFECT       Overlay DEFECT on the stream (in the order given).
+ * -h              Display this menu.
+ * -n              Generate without writing, to measure the generator alone.
+ * -s SEED         Seed the generator with SEED.
+ * -t BYTES        Stop after BYTES in all (default never).
+ * -v              Display verbose output to stderr.
+ * -z BYTES        Generate and write BYTES at a time (default 1048576).
+ *
+ * DEFECTS
+ *
+ * bias:P[:MASK]            Bits in MASK (default all) are one with probability P.
+ * stuck:MASK:VALUE         Bits in MASK are stuck at their value in VALUE.
+ * periodic:BYTES           The stream repeats every BYTES bytes.
+ * dropout:BYTES:LENGTH     About every BYTES bytes, LENGTH bytes are zero.
+ * lag:BYTES:P              Each bit copies the bit BYTES bytes earlier with probability P (the first BYTES bytes pass unchanged).
+ * ones:P                   Each thirty-two bit word is all ones with probability P.
+ *
+ * EXAMPLES
+ *
+ * faults -d bias:0.51 | scattergun.sh biased-test
+ *
+ * faults -d stuck:0x0000000000000080:0 -d dropout:10000000:4096 | rate -T
+ *
+ * faults -n -t 10000000000 -d lag:1:0.01 -d ones:0.0001
+ *
+ * ABSTRACT
+ *
+ * Continuously writes a good pseudo-random stream (from xoshiro256**) with
+ * configurable defects overlaid on it, so that the thresholds of the test
+ * batteries and of the feeder's screening can be tuned against realistic
+ * failures, and how quickly they detect them can be benchmarked, without
+ * waiting hours for a real device to misbehave. The stream is handled as an
+ * array of sixty-four bit words and each defect is applied to the whole
+ * buffer with branch free masking in loops the compiler vectorizes. Bias is
+ * exact to one part in 65536: a bit that is one with probability P is made
+ * by combining random words with AND and OR according to the binary digits
+ * of P, so probabilities with fewer binary digits, like 0.5 or 0.75, cost
+ * fewer random words than ones like 0.51. MASK and VALUE are sixty-four bit
+ * words in host byte order. When done the throughput and the number of times
+ * each defect was applied are displayed on standard error. This is part of the Scattergun project.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include "prng.h"
+
+enum {
+    DEFECTS = 16,       /* Most defects. */
+    PRECISION = 16,     /* Binary digits of probability. */
+    BLOCK = 512,        /* Words combined at a time. */
+};
+
+enum kind {
+    BIAS = 0,
+    STUCK = 1,
+    PERIODIC = 2,
+    DROPOUT = 3,
+    LAG = 4,
+    ONES = 5,
+};
+
+/**
+ * This is one defect and its state.
+ */
+struct defect {
+    const char * spec;
+    enum kind kind;
+    double probability;
+    uint32_t digits;        /* Probability in sixteenths of a bit. */
+    uint32_t threshold;     /* Probability as a thirty-two bit threshold. */
+    uint64_t mask;
+    uint64_t value;
+    size_t bytes;
+    size_t length;
+    uint8_t * history;      /* Periodic pattern or lag history. */
+    size_t phase;
+    uint64_t next;          /* Position of the next dropout. */
+    uint64_t events;
+};
+
+static const char * program = "faults";
+static int done = 0;
+
+static void handler(int signum)
+{
+    if (signum == SIGPIPE) {
+        done = !0;
+    } else if (signum == SIGINT) {
+        done = !0;
+    } else if (signum == SIGTERM) {
+        done = !0;
+    } else {
+        /* Do nothing. */
+    }
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [ -h ] [ -v ] [ -n ] [ -s SEED ] [ -z BYTES ] [ -t BYTES ] [ -d DEFECT ... ]\n", program);
+    fprintf(stderr, "       -d DEFECT       Overlay DEFECT on the stream (in the order given).\n");
+    fprintf(stderr, "       -h              Display this menu.\n");
+    fprintf(stderr, "       -n              Generate without writing, to measure the generator alone.\n");
+    fprintf(stderr, "       -s SEED         Seed the generator with SEED.\n");
+    fprintf(stderr, "       -t BYTES        Stop after BYTES in all (default never).\n");
+    fprintf(stderr, "       -v              Display verbose output to stderr.\n");
+    fprintf(stderr, "       -z BYTES        Generate and write BYTES at a time (default 1048576).\n");
+    fprintf(stderr, "       DEFECT is bias:P[:MASK], stuck:MASK:VALUE, periodic:BYTES, dropout:BYTES:LENGTH, lag:BYTES:P, or ones:P.\n");
+}
+
+/**
+ * Return the value of the monotonic clock in seconds.
+ * @return the value of the monotonic clock in seconds.
+ */
+static double now(void)
+{
+    struct timespec ts = { 0 };
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+}
+
+/**
+ * Parse a probability.
+ * @param string is the string.
+ * @param pp points to where the probability is stored.
+ * @return a pointer to the character after the probability, or NULL.
+ */
+static const char * probability(const char * string, double * pp)
+{
+    char * end = (char *)0;
+
+    *pp = strtod(string, &end);
+    if ((end == string) || (*pp < 0.0) || (*pp > 1.0)) {
+        return (const char *)0;
+    }
+
+    return end;
+}
+
+/**
+ * Parse an unsigned number.
+ * @param string is the string.
+ * @param np points to where the number is stored.
+ * @return a pointer to the character after the number, or NULL.
+ */
+static const char * number(const char * string, uint64_t * np)
+{
+    char * end = (char *)0;
+
+    *np = strtoull(string, &end, 0);
+    if (end == string) {
+        return (const char *)0;
+    }
+
+    return end;
+}
+
+/**
+ * Parse a defect specification.
+ * @param dp points to the defect.
+ * @param spec is the specification.
+ * @return 0 for success, <0 for failure.
+ */
+static int parse(struct defect * dp, const char * spec)
+{
+    const char * here = (const char *)0;
+    uint64_t bytes = 0;
+    uint64_t length = 0;
+
+    memset(dp, 0, sizeof(*dp));
+    dp->spec = spec;
+    dp->mask = ~(uint64_t)0;
+
+    if (strncmp(spec, "bias:", 5) == 0) {
+        dp->kind = BIAS;
+        here = probability(spec + 5, &(dp->probability));
+        if ((here != (const char *)0) && (*here == ':')) {
+            here = number(here + 1, &(dp->mask));
+        }
+    } else if (strncmp(spec, "stuck:", 6) == 0) {
+        dp->kind = STUCK;
+        here = number(spec + 6, &(dp->mask));
+        if ((here != (const char *)0) && (*here == ':')) {
+            here = number(here + 1, &(dp->value));
+        } else {
+            here = (const char *)0;
+        }
+    } else if (strncmp(spec, "periodic:", 9) == 0) {
+        dp->kind = PERIODIC;
+        here = number(spec + 9, &bytes);
+    } else if (strncmp(spec, "dropout:", 8) == 0) {
+        dp->kind = DROPOUT;
+        here = number(spec + 8, &bytes);
+        if ((here != (const char *)0) && (*here == ':')) {
+            here = number(here + 1, &length);
+        } else {
+            here = (const char *)0;
+        }
+    } else if (strncmp(spec, "lag:", 4) == 0) {
+        dp->kind = LAG;
+        here = number(spec + 4, &bytes);
+        if ((here != (const char *)0) && (*here == ':')) {
+            here = probability(here + 1, &(dp->probability));
+        } else {
+            here = (const char *)0;
+        }
+    } else if (strncmp(spec, "ones:", 5) == 0) {
+        dp->kind = ONES;
+        here = probability(spec + 5, &(dp->probability));
+    } else {
+        /* Do nothing. */
+    }
+
+    if ((here == (const char *)0) || (*here != '\0')) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (((dp->kind == PERIODIC) || (dp->kind == DROPOUT) || (dp->kind == LAG)) && (bytes == 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    dp->bytes = bytes;
+    dp->length = length;
+    dp->digits = (dp->probability * (1U << PRECISION)) + 0.5;
+    dp->threshold = (dp->probability >= 1.0) ? 0xffffffffU : (uint32_t)(dp->probability * 4294967296.0);
+
+    if ((dp->kind == PERIODIC) || (dp->kind == LAG)) {
+        dp->history = (uint8_t *)calloc(dp->bytes, 1);
+        if (dp->history == (uint8_t *)0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Fill a buffer with words in which each bit is one with the probability of
+ * the defect, by combining random words according to the binary digits of
+ * the probability from the least significant: OR for a one and AND for a
+ * zero. This is done a block at a time so that the block and the random
+ * words, which are generated into the scratch buffer, stay in the cache.
+ * @param dp points to the defect.
+ * @param pp points to the generator.
+ * @param words points to the buffer.
+ * @param scratch points to the scratch buffer.
+ * @param count is the number of words in each buffer.
+ */
+static void probable(const struct defect * dp, struct prng * pp, uint64_t * words, uint64_t * scratch, size_t count)
+{
+    uint32_t digits = dp->digits;
+    uint64_t * here = (uint64_t *)0;
+    size_t length = 0;
+    size_t base = 0;
+    int first = 0;
+    int bit = 0;
+    size_t ii;
+
+    if (digits >= (1U << PRECISION)) {
+        memset(words, 0xff, count * sizeof(uint64_t));
+        return;
+    }
+
+    if (digits == 0) {
+        memset(words, 0, count * sizeof(uint64_t));
+        return;
+    }
+
+    /*
+     * Trailing zero digits would only AND zero with random words, and the
+     * first one digit ORs random words with zero, which is just the words.
+     */
+    while ((digits & (1U << first)) == 0) {
+        ++first;
+    }
+
+    for (base = 0; base < count; base += length) {
+        here = words + base;
+        length = ((count - base) < BLOCK) ? (count - base) : BLOCK;
+        prng_fill(pp, here, length * sizeof(uint64_t));
+        for (bit = first + 1; bit < PRECISION; ++bit) {
+            prng_fill(pp, scratch, length * sizeof(uint64_t));
+            if (digits & (1U << bit)) {
+                for (ii = 0; ii < length; ++ii) {
+                    here[ii] |= scratch[ii];
+                }
+            } else {
+                for (ii = 0; ii < length; ++ii) {
+                    here[ii] &= scratch[ii];
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Apply a defect to a buffer of words.
+ * @param dp points to the defect.
+ * @param pp points to the generator.
+ * @param words points to the buffer.
+ * @param masks points to a buffer of the same size for masks.
+ * @param scratch points to a buffer of the same size for random words.
+ * @param count is the number of words in each buffer.
+ * @param position is the position in the stream of the first byte.
+ */
+static void apply(struct defect * dp, struct prng * pp, uint64_t * words, uint64_t * masks, uint64_t * scratch, size_t count, uint64_t position)
+{
+    uint8_t * bytes = (uint8_t *)words;
+    uint8_t * bits = (uint8_t *)masks;
+    size_t size = count * sizeof(uint64_t);
+    uint64_t mask = dp->mask;
+    uint64_t value = dp->value;
+    uint32_t * halves = (uint32_t *)words;
+    uint32_t * randoms = (uint32_t *)scratch;
+    uint32_t threshold = dp->threshold;
+    uint64_t end = position + size;
+    uint64_t events = 0;
+    uint64_t gap = 0;
+    size_t offset = 0;
+    size_t length = 0;
+    size_t ii;
+
+    switch (dp->kind) {
+
+    case BIAS:
+        probable(dp, pp, masks, scratch, count);
+        for (ii = 0; ii < count; ++ii) {
+            words[ii] = (words[ii] & ~mask) | (masks[ii] & mask);
+        }
+        dp->events += count;
+        break;
+
+    case STUCK:
+        for (ii = 0; ii < count; ++ii) {
+            words[ii] = (words[ii] & ~mask) | (value & mask);
+        }
+        dp->events += count;
+        break;
+
+    case PERIODIC:
+        /*
+         * The first period of the stream is kept and repeated forever.
+         */
+        for (offset = 0; offset < size; offset += length) {
+            length = dp->bytes - dp->phase;
+            if (length > (size - offset)) { length = size - offset; }
+            if ((position + offset) < dp->bytes) {
+                memcpy(dp->history + dp->phase, bytes + offset, length);
+            } else {
+                memcpy(bytes + offset, dp->history + dp->phase, length);
+            }
+            dp->phase = (dp->phase + length) % dp->bytes;
+        }
+        dp->events += (position >= dp->bytes) ? count : 0;
+        break;
+
+    case DROPOUT:
+        /*
+         * Dropouts start at positions spaced uniformly at random between
+         * zero and twice the interval apart, and may span buffers.
+         */
+        if ((dp->next == 0) && (position == 0)) {
+            prng_fill(pp, &(dp->next), sizeof(dp->next));
+            dp->next %= (2 * dp->bytes);
+        }
+        while (dp->next < end) {
+            offset = (dp->next > position) ? (dp->next - position) : 0;
+            length = dp->length - ((dp->next < position) ? (position - dp->next) : 0);
+            if (length > (size - offset)) { length = size - offset; }
+            memset(bytes + offset, 0, length);
+            if ((dp->next + dp->length) > end) {
+                break;
+            }
+            ++(dp->events);
+            prng_fill(pp, &gap, sizeof(gap));
+            dp->next += dp->length + (gap % (2 * dp->bytes));
+        }
+        break;
+
+    case LAG:
+        /*
+         * Each bit is replaced with probability P by the bit the lag
+         * earlier, which for the first lag of the buffer is in the history
+         * of the previous buffer. The first lag of the stream has nothing
+         * before it and passes unchanged.
+         */
+        probable(dp, pp, masks, scratch, count);
+        length = (dp->bytes < size) ? dp->bytes : size;
+        for (ii = 0; ii < length; ++ii) {
+            if ((position + ii) < dp->bytes) { continue; }
+            bytes[ii] ^= (bytes[ii] ^ dp->history[(dp->phase + ii) % dp->bytes]) & bits[ii];
+        }
+        for (ii = length; ii < size; ++ii) {
+            bytes[ii] ^= (bytes[ii] ^ bytes[ii - dp->bytes]) & bits[ii];
+        }
+        if (size >= dp->bytes) {
+            memcpy(dp->history, bytes + size - dp->bytes, dp->bytes);
+            dp->phase = 0;
+        } else {
+            for (ii = 0; ii < size; ++ii) {
+                dp->history[(dp->phase + ii) % dp->bytes] = bytes[ii];
+            }
+            dp->phase = (dp->phase + size) % dp->bytes;
+        }
+        dp->events += count;
+        break;
+
+    case ONES:
+        prng_fill(pp, scratch, size);
+        for (ii = 0; ii < (size / sizeof(uint32_t)); ++ii) {
+            uint32_t all = -(uint32_t)(randoms[ii] < threshold);
+            halves[ii] |= all;
+            events += all & 1;
+        }
+        dp->events += events;
+        break;
+
+    default:
+        break;
+
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int verbose = 0;
+    int discard = 0;
+    uint64_t seed = 0;
+    size_t size = 1048576;
+    size_t count = 0;
+    unsigned long long limit = 0;
+    unsigned long long total = 0;
+    size_t length = 0;
+    size_t written = 0;
+    ssize_t rc = 0;
+    uint64_t * words = (uint64_t *)0;
+    uint64_t * masks = (uint64_t *)0;
+    uint64_t * scratch = (uint64_t *)0;
+    struct defect defects[DEFECTS];
+    int ndefects = 0;
+    struct prng good;
+    struct prng noise;
+    struct sigaction action = { 0 };
+    double start = 0.0;
+    double seconds = 0.0;
+    char * end = (char *)0;
+    int opt;
+    int ii;
+    extern char * optarg;
+    extern int optind;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "d:hns:t:vz:")) >= 0) {
+
+        switch (opt) {
+
+        case 'd':
+            if (ndefects >= DEFECTS) {
+                error = !0;
+            } else if (parse(&(defects[ndefects]), optarg) < 0) {
+                perror(optarg);
+                error = !0;
+            } else {
+                ++ndefects;
+            }
+            break;
+
+        case 'h':
+            usage();
+            return 0;
+
+        case 'n':
+            discard = !0;
+            break;
+
+        case 's':
+            seed = strtoull(optarg, &end, 0);
+            if (*end != '\0') {
+                error = !0;
+            }
+            break;
+
+        case 't':
+            limit = strtoull(optarg, &end, 0);
+            if ((*end != '\0') || (limit == 0)) {
+                error = !0;
+            }
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        case 'z':
+            size = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (size == 0)) {
+                error = !0;
+            }
+            break;
+
+        default:
+            error = !0;
+            break;
+
+        }
+
+    }
+
+    if (optind < argc) {
+        error = !0;
+    }
+
+    if (error) {
+        usage();
+        return 1;
+    }
+
+    do {
+
+        action.sa_handler = handler;
+        action.sa_flags = 0;
+        if (sigaction(SIGPIPE, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+        if (sigaction(SIGINT, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+        if (sigaction(SIGTERM, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+
+        /*
+         * Buffers are a whole number of words. The stream and the noise
+         * that drives the defects come from separate generators, so adding
+         * a defect does not change the underlying good stream.
+         */
+
+        count = (size + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+        words = (uint64_t *)malloc(count * sizeof(uint64_t));
+        masks = (uint64_t *)malloc(count * sizeof(uint64_t));
+        scratch = (uint64_t *)malloc(count * sizeof(uint64_t));
+        if ((words == (uint64_t *)0) || (masks == (uint64_t *)0) || (scratch == (uint64_t *)0)) {
+            perror("malloc");
+            break;
+        }
+        size = count * sizeof(uint64_t);
+
+        prng_init(&good, PRNG_XOSHIRO256, seed);
+        prng_init(&noise, PRNG_XOSHIRO256, ~seed);
+
+        if (verbose) {
+            fprintf(stderr, "%s: seed         0x%llx\n", program, (unsigned long long)seed);
+            fprintf(stderr, "%s: size         %zu\n", program, size);
+            fprintf(stderr, "%s: limit        %llu\n", program, limit);
+            for (ii = 0; ii < ndefects; ++ii) {
+                fprintf(stderr, "%s: defect       \"%s\"\n", program, defects[ii].spec);
+            }
+        }
+
+        start = now();
+        while (!done) {
+            length = size;
+            if ((limit > 0) && (length > (limit - total))) { length = limit - total; }
+            if (length == 0) {
+                break;
+            }
+            prng_fill(&good, words, size);
+            for (ii = 0; ii < ndefects; ++ii) {
+                apply(&(defects[ii]), &noise, words, masks, scratch, count, total);
+            }
+            if (discard) {
+                total += length;
+                continue;
+            }
+            for (written = 0; written < length; written += rc) {
+                rc = write(STDOUT_FILENO, (uint8_t *)words + written, length - written);
+                if (rc > 0) {
+                    /* Do nothing. */
+                } else if ((rc < 0) && (errno == EINTR) && (!done)) {
+                    rc = 0;
+                } else {
+                    break;
+                }
+            }
+            total += written;
+            if (written < length) {
+                if ((rc < 0) && (errno != EPIPE)) { perror("write"); }
+                break;
+            }
+        }
+        seconds = now() - start;
+
+        fprintf(stderr, "%s: bytes=%llu seconds=%.6f rate=%.0f\n", program, total, seconds, (seconds > 0.0) ? (total / seconds) : 0.0);
+        for (ii = 0; ii < ndefects; ++ii) {
+            fprintf(stderr, "%s: defect=\"%s\" events=%llu\n", program, defects[ii].spec, (unsigned long long)defects[ii].events);
+        }
+
+        xc = 0;
+
+    } while (0);
+
+    for (ii = 0; ii < ndefects; ++ii) {
+        if (defects[ii].history != (uint8_t *)0) {
+            free(defects[ii].history);
+        }
+    }
+    if (scratch != (uint64_t *)0) {
+        free(scratch);
+    }
+    if (masks != (uint64_t *)0) {
+        free(masks);
+    }
+    if (words != (uint64_t *)0) {
+        free(words);
+    }
+
+    return xc;
+}
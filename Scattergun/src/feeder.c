@@ -0,0 +1,1165 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Feeder<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * feeder [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -s SOURCE [ -s SOURCE ... ] ] [ -e BITS ] [ -a ALGORITHM ] [ -r BYTES ] [ -t MILLISECONDS ] [ -R BYTES ] [ -S PATH [ -Z BYTES ] ] [ -L BYTES ] [ -H BYTES ] [ -o SINK ]
+ *
+ * EXAMPLES
+ *
+ * feeder -v -s /dev/TrueRNGpro
+ *
+ * feeder -v -s /dev/TrueRNGpro -s rdseed
+ *
+ * feeder -v -s rdseed -r 0 -o random.dat
+ *
+ * feeder -D -i feeder -s usb:0
+ *
+ * feeder -D -i feeder -s /dev/TrueRNGpro -R 1048576 -S /var/tmp -Z 67108864
+ *
+ * ABSTRACT
+ *
+ * Continuously reads data from one or more hardware entropy sources, runs the
+ * FIPS 140-2 statistical tests on each block of 20,000 bits, conditions the
+ * blocks that pass by hashing them together using SHA-256 (or SHA3-256 or
+ * BLAKE2s, see condition.h), and adds the result
+ * to the kernel entropy pool using the RNDADDENTROPY ioctl. This does the work
+ * of the rngd daemon from rng-tools, without needing rngd, a FIFO, or a
+ * separate daemon like seventool or quantistool to feed the FIFO. Each SOURCE
+ * may be "rdrand" or "rdseed" to use the Intel instructions, "usb:UNIT" or
+ * "pci:UNIT" to use an ID Quantique Quantis (if built with the Quantis
+ * library), or the path to a character device (like /dev/hwrng), a serial
+ * device (like /dev/TrueRNGpro), a FIFO, or a file. Serial devices are placed
+ * into raw mode with low latency and read in large blocks; a SOURCE of
+ * "onerng:PATH" also initializes a OneRNG as onernginit.sh does. This is part
+ * of the Scattergun project.
+ * Adding entropy to the kernel pool requires the CAP_SYS_ADMIN capability.
+ *
+ * Each source is read by its own thread, so the aggregate throughput is the
+ * sum of that of the sources. Each block is credited with the entropy
+ * estimated for its source by the SP 800-90B Most Common Value estimator over
+ * a sliding window of recent blocks, but never more than BITS bits per byte.
+ * A source that fails a FIPS test is quarantined, and its blocks discarded,
+ * until it passes eight consecutive blocks. Every BYTES bytes of input from
+ * all of the sources is hashed into thirty-two bytes of output, whose credit
+ * is that which SP 800-90B 3.1.5 allows for the sum of that of the input: at
+ * most 256 bits for SHA-256 and SHA3-256, and at most 255.744 bits for
+ * BLAKE2s, which is not a vetted conditioning component. A BYTES of zero disables the
+ * conditioning and passes the tested blocks through unchanged. The hash is
+ * SHA-256 unless another ALGORITHM (-a) is chosen. The output may instead be
+ * written (-o) without credit to a file, a FIFO, or a socket named unix:PATH
+ * or tcp:HOST:PORT (see sink.h).
+ *
+ * Optionally (-R) the conditioned output is kept in a reservoir of BYTES
+ * bytes of memory, extended (-S) by an encrypted spill file at PATH of BYTES
+ * (-Z, default sixteen times the memory) bytes (see reservoir.h), from which
+ * a separate thread adds it to the pool whenever the pool wants it. The
+ * sources are read until the reservoir reaches its high watermark (-H,
+ * default full) and then left alone until it drains to its low watermark
+ * (-L, default half of the high watermark), so that the reservoir fills
+ * while demand is low and a burst of demand is met at memory speed rather
+ * than at the speed of the devices.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "service.h"
+#include "tty.h"
+#include "fips.h"
+#include "pool.h"
+#include "source.h"
+#include "sink.h"
+#include "reservoir.h"
+#include "condition.h"
+
+static const char * program = "feeder";
+static const char * ident = "feeder";
+static int debug = 0;
+
+enum state { HEALTHY=0, QUARANTINED=1, FINISHED=2, };
+static const char * STATE[] = { "healthy", "quarantined", "finished", };
+
+enum {
+    SOURCES = 8,        /* Maximum number of sources. */
+    QUEUE = 16,         /* Blocks queued between the sources and the mixer. */
+    WINDOW = 16,        /* Blocks in the min-entropy estimate window. */
+    RELEASE = 8,        /* Consecutive passing blocks to end a quarantine. */
+    DIGEST = CONDITION_DIGEST, /* Bytes in a digest. */
+    OUTPUT = 512,       /* Bytes added to the pool at a time. */
+};
+
+/**
+ * This is the state of the Most Common Value min-entropy estimate, which is
+ * computed over the bytes in the last WINDOW blocks.
+ */
+struct estimate {
+    uint16_t histograms[WINDOW][256];
+    uint32_t counts[256];
+    size_t samples;
+    size_t blocks;
+    double minentropy;
+};
+
+/**
+ * This describes an entropy source, the thread that reads it, and the
+ * statistics collected on it.
+ */
+struct channel {
+    struct source device;
+    pthread_t thread;
+    enum state state;
+    int failed;
+    size_t passes;
+    size_t quarantines;
+    size_t mixed;
+    double credited;
+    struct fips health;
+    struct estimate estimate;
+};
+
+/**
+ * This is a block which has passed its tests and is queued to be mixed.
+ */
+struct slot {
+    struct channel * channel;
+    double credit;
+    uint8_t block[FIPS_BYTES];
+};
+
+/**
+ * This is the state of the thread that drains the reservoir.
+ */
+struct drain {
+    pthread_t thread;
+    int fd;
+    struct sink * sink;
+    int timeout;
+    size_t * injected;
+    size_t * credited;
+    int stopping;       /* 1 to stop now, 2 to stop when empty. */
+    int failed;
+};
+
+/**
+ * This is the state of the conditioner which hashes the input of all of the
+ * sources together.
+ */
+struct mixer {
+    enum condition_algorithm algorithm;
+    uint8_t * block;
+    size_t ratio;
+    size_t accumulated;
+    double entropy;
+    size_t used;
+    double credit;
+    size_t input;
+    size_t output;
+    uint8_t buffer[OUTPUT];
+};
+
+static struct slot queue[QUEUE];
+static unsigned int head = 0;
+static unsigned int tail = 0;
+static unsigned int count = 0;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t space = PTHREAD_COND_INITIALIZER;
+static double perbyte = 8.0;
+static struct reservoir reservoir;
+static int reserving = 0;
+
+/**
+ * Emit a usage message to standard error.
+ * @param nomenu if true supresses the printing of the menu.
+ */
+static void usage(int nomenu)
+{
+    service_printf("usage: %s [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -s SOURCE [ -s SOURCE ... ] ] [ -e BITS ] [ -a ALGORITHM ] [ -r BYTES ] [ -t MILLISECONDS ] [ -R BYTES ] [ -S PATH [ -Z BYTES ] ] [ -L BYTES ] [ -H BYTES ] [ -o SINK ]\n", program);
+    if (nomenu) { return; }
+    service_printf("       -d            Enable debug mode\n");
+    service_printf("       -v            Enable verbose mode\n");
+    service_printf("       -D            Run as a daemon\n");
+    service_printf("       -i IDENT      Use IDENT as the syslog identifier\n");
+    service_printf("       -s SOURCE     Read from rdrand, rdseed, usb:UNIT, pci:UNIT, onerng:PATH, or PATH (may be repeated)\n");
+    service_printf("       -e BITS       Credit at most BITS (0..8) bits of entropy per byte\n");
+    service_printf("       -a ALGORITHM  Hash with sha256 (default), sha3, or blake2s (not vetted, credited at most 0.999 bits per bit)\n");
+    service_printf("       -r BYTES      Hash every BYTES bytes into 32 bytes (0 to disable)\n");
+    service_printf("       -t MILLISECONDS Wait at most MILLISECONDS for the pool to want entropy\n");
+    service_printf("       -R BYTES      Keep a reservoir of BYTES bytes of output in memory\n");
+    service_printf("       -S PATH       Spill into a new encrypted file at PATH (or in directory PATH) when memory is full\n");
+    service_printf("       -Z BYTES      Make the spill file BYTES bytes\n");
+    service_printf("       -L BYTES      Resume reading the sources when the reservoir falls to BYTES\n");
+    service_printf("       -H BYTES      Stop reading the sources when the reservoir rises to BYTES\n");
+    service_printf("       -o SINK       Write to SINK (PATH, fifo, unix:PATH, tcp:HOST:PORT) instead of the kernel entropy pool\n");
+    service_printf("       -h            Print help menu\n");
+}
+
+/**
+ * Open a source, logging the reason if it fails.
+ * @param sp points to the source descriptor.
+ * @return 0 for success, <0 for failure.
+ */
+static int openfutz(struct source * sp)
+{
+    if (source_open(sp) == 0) {
+        /* Do nothing. */
+#if defined(SCATTERGUN_HAS_QUANTIS)
+    } else if (sp->status < QUANTIS_SUCCESS) {
+        service_printf("%s: QuantisOpen(%d,%u)=%d=\"%s\"\n", program, sp->type, sp->unit, sp->status, QuantisStrError(sp->status));
+        return -1;
+#endif
+    } else {
+        service_error(sp->name);
+        return -1;
+    }
+
+    if (sp->kind == SOURCE_TTY) {
+        service_verbosef("%s: lowlatency   \"%s\" %d\n", program, sp->name, tty_lowlatency(sp->fd));
+        if (sp->onerng) {
+            service_verbosef("%s: onerng       \"%s\"\n", program, sp->name);
+        }
+    }
+    service_verbosef("%s: source       \"%s\" %s\n", program, sp->name, SOURCE_KINDS[sp->kind]);
+
+    return 0;
+}
+
+/**
+ * Read exactly the requested number of bytes from a source, logging the
+ * reason if it fails.
+ * @param sp points to the source descriptor.
+ * @param buffer points to the buffer.
+ * @param size is the size of the buffer in bytes.
+ * @return the number of bytes read, 0 for end of file, <0 for an error.
+ */
+static ssize_t readfutz(struct source * sp, void * buffer, size_t size)
+{
+    ssize_t bytes = 0;
+
+    bytes = source_read(sp, buffer, size);
+    if (bytes >= 0) {
+        /* Do nothing. */
+    } else if (errno == EINTR) {
+        /* Do nothing. */
+#if defined(SCATTERGUN_HAS_QUANTIS)
+    } else if (sp->status < QUANTIS_SUCCESS) {
+        service_printf("%s: QuantisReadHandled(%p,%zu)=%d=\"%s\"\n", program, sp->handle, size, sp->status, QuantisStrError(sp->status));
+#endif
+    } else {
+        service_error(sp->name);
+    }
+
+    return bytes;
+}
+
+/**
+ * Update the Most Common Value min-entropy estimate (SP 800-90B 6.3.1) with
+ * a block and return the estimate in bits per byte. The estimate uses the
+ * upper bound of the 99% confidence interval of the probability of the most
+ * common byte value in the window.
+ * @param ep points to the estimate state.
+ * @param block points to the block of FIPS_BYTES bytes.
+ * @return the min-entropy estimate in bits per byte.
+ */
+static double estimate(struct estimate * ep, const uint8_t * block)
+{
+    uint16_t * hp = ep->histograms[ep->blocks % WINDOW];
+    uint32_t maximum = 0;
+    double probability = 0.0;
+    double upper = 0.0;
+    int ii;
+
+    if (ep->blocks >= WINDOW) {
+        for (ii = 0; ii < 256; ++ii) {
+            ep->counts[ii] -= hp[ii];
+        }
+        ep->samples -= FIPS_BYTES;
+    }
+
+    memset(hp, 0, sizeof(ep->histograms[0]));
+    for (ii = 0; ii < FIPS_BYTES; ++ii) {
+        ++hp[block[ii]];
+    }
+    for (ii = 0; ii < 256; ++ii) {
+        ep->counts[ii] += hp[ii];
+        if (ep->counts[ii] > maximum) {
+            maximum = ep->counts[ii];
+        }
+    }
+    ep->samples += FIPS_BYTES;
+    ++(ep->blocks);
+
+    probability = (double)maximum / (double)ep->samples;
+    upper = probability + (2.576 * sqrt((probability * (1.0 - probability)) / (ep->samples - 1)));
+    if (upper > 1.0) {
+        upper = 1.0;
+    }
+    ep->minentropy = -log2(upper);
+
+    return ep->minentropy;
+}
+
+/**
+ * Queue a block that has passed its tests to be mixed, waiting for space
+ * in the queue if necessary.
+ * @param sp points to the source descriptor.
+ * @param block points to the block of FIPS_BYTES bytes.
+ * @param credit is the number of bits of entropy in the block.
+ * @return 0 for success, <0 if the program is shutting down.
+ */
+static int enqueue(struct channel * sp, const uint8_t * block, double credit)
+{
+    int rc = -1;
+
+    pthread_mutex_lock(&mutex);
+    while ((count >= QUEUE) && (!service_done)) {
+        pthread_cond_wait(&space, &mutex);
+    }
+    if (!service_done) {
+        queue[tail].channel = sp;
+        queue[tail].credit = credit;
+        memcpy(queue[tail].block, block, FIPS_BYTES);
+        tail = (tail + 1) % QUEUE;
+        ++count;
+        pthread_cond_signal(&ready);
+        rc = 0;
+    }
+    pthread_mutex_unlock(&mutex);
+
+    return rc;
+}
+
+/**
+ * Read, test, and queue blocks from one source until it ends, fails, or the
+ * program shuts down. If a read fails the source is closed and reopened. As
+ * long as the open succeeds, we soldier on.
+ * @param arg points to the source descriptor.
+ * @return NULL.
+ */
+static void * worker(void * arg)
+{
+    struct channel * sp = (struct channel *)arg;
+    uint8_t block[FIPS_BYTES];
+    ssize_t bytes = 0;
+    double entropy = 0.0;
+    double credit = 0.0;
+    int finished = 0;
+    int mask = 0;
+
+    while ((!service_done) && (!finished)) {
+
+        if (openfutz(&(sp->device)) < 0) {
+            source_close(&(sp->device));
+            sp->failed = !0;
+            break;
+        }
+
+        while (!service_done) {
+
+            /*
+             * A block cut short by the end of the source or by a signal is
+             * discarded; the next read reports which it was.
+             */
+
+            bytes = readfutz(&(sp->device), block, sizeof(block));
+            if (bytes == sizeof(block)) {
+                /* Do nothing. */
+            } else if (bytes > 0) {
+                continue;
+            } else if ((sp->device.kind == SOURCE_RDRAND) || (sp->device.kind == SOURCE_RDSEED)) {
+                sp->failed = !0;
+                finished = !0;
+                break;
+            } else if ((bytes < 0) && (errno == EINTR)) {
+                continue;
+            } else if (bytes < 0) {
+                break;
+            } else {
+                service_verbosef("%s: end          \"%s\"\n", program, sp->device.name);
+                finished = (sp->device.kind == SOURCE_FILE);
+                break;
+            }
+
+            mask = fips_test(&(sp->health), block);
+            entropy = estimate(&(sp->estimate), block);
+
+            if (mask != 0) {
+                if (sp->state == HEALTHY) {
+                    sp->state = QUARANTINED;
+                    ++(sp->quarantines);
+                    service_printf("%s: quarantine   \"%s\" 0x%x\n", program, sp->device.name, mask);
+                }
+                sp->passes = 0;
+                continue;
+            } else if (sp->state != QUARANTINED) {
+                /* Do nothing. */
+            } else if ((++(sp->passes)) < RELEASE) {
+                continue;
+            } else {
+                sp->state = HEALTHY;
+                service_printf("%s: release      \"%s\"\n", program, sp->device.name);
+            }
+
+            credit = ((entropy < perbyte) ? entropy : perbyte) * sizeof(block);
+            if (enqueue(sp, block, credit) < 0) {
+                break;
+            }
+            ++(sp->mixed);
+            sp->credited += credit;
+
+        }
+
+        source_close(&(sp->device));
+
+    }
+
+    memset(block, 0, sizeof(block));
+
+    pthread_mutex_lock(&mutex);
+    sp->state = FINISHED;
+    pthread_cond_signal(&ready);
+    pthread_mutex_unlock(&mutex);
+
+    return (void *)0;
+}
+
+/**
+ * Write data to the kernel entropy pool, or to the output file if there is
+ * one. Like rngd, we wait for the kernel to tell us that the pool has fallen
+ * below its write wakeup threshold. But we add entropy anyway when the wait
+ * times out so that the pool continues to be stirred.
+ * @param buffer points to the data.
+ * @param size is the size of the data in bytes.
+ * @param credit is the number of bits of entropy credited to the data.
+ * @param fd is the open file descriptor of /dev/random or <0.
+ * @param sink is the output sink or NULL.
+ * @param timeout is the poll timeout in milliseconds.
+ * @param injected points to the count of bytes written.
+ * @param credited points to the count of bits of entropy credited.
+ * @return 0 for success, <0 for failure.
+ */
+static int output(const uint8_t * buffer, size_t size, double credit, int fd, struct sink * sink, int timeout, size_t * injected, size_t * credited)
+{
+    struct pollfd pfd = { 0 };
+    struct iovec vector;
+    int bits = 0;
+    int rc = 0;
+
+    if (sink != (struct sink *)0) {
+        vector.iov_base = (void *)buffer;
+        vector.iov_len = size;
+        if (sink_writev(sink, &vector, 1) < size) {
+            service_error(sink->name);
+            return -1;
+        }
+    } else {
+        pfd.fd = fd;
+        pfd.events = POLLOUT;
+        rc = poll(&pfd, 1, timeout);
+        if ((rc < 0) && (errno != EINTR)) {
+            service_error("poll");
+            return -1;
+        }
+        bits = credit;
+        if (pool_inject(fd, buffer, size, bits) < 0) {
+            service_error("ioctl(RNDADDENTROPY)");
+            return -1;
+        }
+        *credited += bits;
+    }
+
+    *injected += size;
+
+    return 0;
+}
+
+/**
+ * Write the output of the mixer to the kernel entropy pool or the output
+ * file, or deposit it in the reservoir if there is one. A deposit waits
+ * while the reservoir is above its watermark; if the program is told to
+ * shut down in the meantime the output is discarded.
+ * @param mp points to the mixer.
+ * @param fd is the open file descriptor of /dev/random or <0.
+ * @param sink is the output sink or NULL.
+ * @param timeout is the poll timeout in milliseconds.
+ * @param injected points to the count of bytes written.
+ * @param credited points to the count of bits of entropy credited.
+ * @return 0 for success, <0 for failure.
+ */
+static int emit(struct mixer * mp, int fd, struct sink * sink, int timeout, size_t * injected, size_t * credited)
+{
+    int rc = 0;
+
+    if (mp->used == 0) {
+        return 0;
+    }
+
+    if (!reserving) {
+        rc = output(mp->buffer, mp->used, mp->credit, fd, sink, timeout, injected, credited);
+    } else {
+        while (((rc = reservoir_deposit(&reservoir, mp->buffer, mp->used, mp->credit, 1000)) < 0) && (errno == EAGAIN) && (!service_done)) {
+            continue;
+        }
+        if (rc == 0) {
+            /* Do nothing. */
+        } else if ((errno == EAGAIN) || (errno == ECANCELED)) {
+            rc = 0;
+        } else {
+            service_error("reservoir_deposit");
+        }
+    }
+
+    memset(mp->buffer, 0, mp->used);
+    mp->used = 0;
+    mp->credit = 0.0;
+
+    return rc;
+}
+
+/**
+ * Withdraw the output from the reservoir and write it to the kernel entropy
+ * pool or the output file, as fast as the pool will take it, until told to
+ * stop or until an error occurs.
+ * @param arg points to the drain.
+ * @return NULL.
+ */
+static void * drainer(void * arg)
+{
+    struct drain * dp = (struct drain *)arg;
+    uint8_t buffer[OUTPUT];
+    double credit = 0.0;
+    size_t size = 0;
+
+    while (dp->stopping != 1) {
+        size = reservoir_withdraw(&reservoir, buffer, sizeof(buffer), 1000, &credit);
+        if (size > 0) {
+            /* Do nothing. */
+        } else if (dp->stopping == 2) {
+            break;
+        } else {
+            continue;
+        }
+        if (output(buffer, size, credit, dp->fd, dp->sink, dp->timeout, dp->injected, dp->credited) < 0) {
+            dp->failed = !0;
+            service_done = !0;
+            break;
+        }
+    }
+
+    memset(buffer, 0, sizeof(buffer));
+
+    return (void *)0;
+}
+
+/**
+ * Compute the entropy of a digest from that of its input using the
+ * Output_Entropy function of SP 800-90B 3.1.5.1.2, rearranged so that no
+ * power of two overflows however large the input. The narrowest internal
+ * width of each algorithm is that of its digest. SHA-256 and SHA3-256 are
+ * vetted conditioning components; BLAKE2s is not (see condition.h), so as
+ * 3.1.5.2 requires its output is credited with no more than 0.999 bits per
+ * bit.
+ * @param algorithm is the hash algorithm.
+ * @param input is the number of bits of input.
+ * @param entropy is the number of bits of entropy in the input.
+ * @return the number of bits of entropy in the digest.
+ */
+static double conditioned(enum condition_algorithm algorithm, double input, double entropy)
+{
+    static const double OUTPUT = 8.0 * DIGEST;
+    double high = 0.0;
+    double scaled = 0.0;
+    double psi = 0.0;
+    double omega = 0.0;
+    double bits = 0.0;
+
+    if (entropy <= 0.0) {
+        return 0.0;
+    }
+
+    /*
+     * P_high is the probability of the most likely input and P_low that of
+     * each of the others. Scaled is P_low times 2^(n_in - n), the number of
+     * inputs per output, and omega the bound on the probability of the most
+     * likely output when the rest are spread as evenly as chance allows.
+     */
+
+    high = pow(2.0, -entropy);
+    scaled = (1.0 - high) * pow(2.0, -OUTPUT) / (1.0 - pow(2.0, -input));
+    psi = scaled + high;
+    omega = scaled * (1.0 + sqrt(2.0 * OUTPUT * log(2.0) * pow(2.0, OUTPUT - input)));
+    bits = -log2((psi > omega) ? psi : omega);
+
+    if (algorithm == CONDITION_BLAKE2S) {
+        if (bits > (0.999 * OUTPUT)) { bits = 0.999 * OUTPUT; }
+    }
+
+    return (bits < entropy) ? bits : entropy;
+}
+
+/**
+ * Condition a block by hashing it with the rest of the mixer input. Each
+ * time the mixer has accumulated its ratio of input bytes it appends a digest
+ * to its output buffer, credited with the entropy that SP 800-90B allows the
+ * digest given that of its input. A ratio of zero appends the block
+ * unconditioned.
+ * @param mp points to the mixer.
+ * @param sp points to the slot containing the block.
+ * @param fd is the open file descriptor of /dev/random or <0.
+ * @param sink is the output sink or NULL.
+ * @param timeout is the poll timeout in milliseconds.
+ * @param injected points to the count of bytes written.
+ * @param credited points to the count of bits of entropy credited.
+ * @return 0 for success, <0 for failure.
+ */
+static int mix(struct mixer * mp, const struct slot * sp, int fd, struct sink * sink, int timeout, size_t * injected, size_t * credited)
+{
+    const uint8_t * here = sp->block;
+    size_t remaining = sizeof(sp->block);
+    double density = sp->credit / sizeof(sp->block);
+    uint8_t digest[DIGEST];
+    size_t length = 0;
+
+    mp->input += remaining;
+
+    while (remaining > 0) {
+
+        if (mp->ratio == 0) {
+            length = sizeof(mp->buffer) - mp->used;
+            if (length > remaining) { length = remaining; }
+            memcpy(mp->buffer + mp->used, here, length);
+            mp->used += length;
+            mp->credit += density * length;
+            mp->output += length;
+        } else {
+            length = mp->ratio - mp->accumulated;
+            if (length > remaining) { length = remaining; }
+            memcpy(mp->block + mp->accumulated, here, length);
+            mp->accumulated += length;
+            mp->entropy += density * length;
+            if (mp->accumulated >= mp->ratio) {
+                condition_blocks(mp->algorithm, mp->block, mp->ratio, 1, digest);
+                memset(mp->block, 0, mp->ratio);
+                memcpy(mp->buffer + mp->used, digest, sizeof(digest));
+                mp->used += sizeof(digest);
+                mp->credit += conditioned(mp->algorithm, 8.0 * mp->ratio, mp->entropy);
+                mp->output += sizeof(digest);
+                mp->accumulated = 0;
+                mp->entropy = 0.0;
+                memset(digest, 0, sizeof(digest));
+            }
+        }
+
+        here += length;
+        remaining -= length;
+
+        if (mp->used >= sizeof(mp->buffer)) {
+            if (emit(mp, fd, sink, timeout, injected, credited) < 0) {
+                return -1;
+            }
+        }
+
+    }
+
+    return 0;
+}
+
+/**
+ * Emit the statistics for the sources, their health tests, and the mixer.
+ * @param sources points to the array of source descriptors.
+ * @param nsources is the number of sources.
+ * @param mp points to the mixer.
+ * @param injected is the number of bytes added to the pool.
+ * @param credited is the number of bits of entropy credited.
+ */
+static void statistics(const struct channel * sources, size_t nsources, const struct mixer * mp, size_t injected, size_t credited)
+{
+    const struct channel * sp = (const struct channel *)0;
+    struct reservoir_metrics metrics;
+    size_t ii;
+    int jj;
+
+    for (ii = 0; ii < nsources; ++ii) {
+        sp = &(sources[ii]);
+        service_printf("%s: source=\"%s\" kind=%s state=%s opens=%zu reads=%zu total=%zu yield=%.1f blocks=%zu failures=%zu quarantines=%zu minentropy=%.3f mixed=%zu credited=%.0f\n", program, sp->device.name, SOURCE_KINDS[sp->device.kind], STATE[sp->state], sp->device.opens, sp->device.reads, sp->device.total, (sp->device.reads > 0) ? ((double)sp->device.total / sp->device.reads) : 0.0, sp->health.blocks, sp->health.failures, sp->quarantines, sp->estimate.minentropy, sp->mixed, sp->credited);
+        for (jj = 0; jj < FIPS_TESTS; ++jj) {
+            if (sp->health.failed[jj] > 0) {
+                service_printf("%s: source=\"%s\" %s=%zu\n", program, sp->device.name, FIPS_NAMES[jj], sp->health.failed[jj]);
+            }
+        }
+    }
+    service_printf("%s: algorithm=\"%s\" ratio=%zu input=%zu output=%zu injected=%zu credited=%zu\n", program, CONDITION_NAMES[mp->algorithm], mp->ratio, mp->input, mp->output, injected, credited);
+    if (reserving) {
+        reservoir_snapshot(&reservoir, &metrics);
+        service_printf("%s: capacity=%zu spillsize=%zu low=%zu high=%zu level=%zu spilled=%zu peak=%zu deposits=%zu withdrawals=%zu filled=%zu drained=%zu spills=%zu restores=%zu stalls=%zu shortfalls=%zu cycles=%zu credit=%.0f\n", program, metrics.capacity, metrics.spillsize, metrics.low, metrics.high, metrics.level, metrics.spilled, metrics.peak, metrics.deposits, metrics.withdrawals, metrics.filled, metrics.drained, metrics.spills, metrics.restores, metrics.stalls, metrics.shortfalls, metrics.cycles, metrics.credit);
+    }
+}
+
+/**
+ * This is the main program.
+ * @param argc is the count of command line arguments.
+ * @param argv is a vector of pointers to the command line arguments.
+ */
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    char * end = (char *)0;
+    int rc = 0;
+    int fd = -1;
+    int daemonize = 0;
+    static struct sink sink;
+    struct sink * sp = (struct sink *)0;
+    struct timespec deadline = { 0 };
+    sigset_t mask;
+    sigset_t prior;
+    static struct channel sources[SOURCES];
+    static struct mixer mixer;
+    static struct slot slot;
+    const char * names[SOURCES] = { "/dev/hwrng", };
+    size_t nnames = 0;
+    size_t nsources = 0;
+    size_t finished = 0;
+    size_t failed = 0;
+    const char * path = (const char *)0;
+    const char * spillpath = (const char *)0;
+    size_t capacity = 0;
+    size_t spillsize = 0;
+    size_t low = 0;
+    size_t high = 0;
+    int exhausted = 0;
+    int draining = 0;
+    int timeout = 60000;
+    int algorithm = 0;
+    size_t injected = 0;
+    size_t credited = 0;
+    static struct drain drain;
+    size_t ii;
+    int opt;
+    extern char * optarg;
+
+    /*
+     * Crack open the command line argument vector.
+     */
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    mixer.ratio = 2 * DIGEST;
+
+    while ((opt = getopt(argc, argv, "dvDi:s:e:a:r:t:R:S:Z:L:H:o:h")) >= 0) {
+
+        switch (opt) {
+
+        case 'd':
+            debug = !0;
+            break;
+
+        case 'v':
+            service_verbose = !0;
+            break;
+
+        case 'D':
+            daemonize = !0;
+            break;
+
+        case 'i':
+            ident = optarg;
+            break;
+
+        case 's':
+            if (nnames < SOURCES) {
+                names[nnames++] = optarg;
+            } else {
+                errno = E2BIG;
+                service_error(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'e':
+            perbyte = strtod(optarg, &end);
+            if ((*end != '\0') || (perbyte < 0.0) || (perbyte > 8.0)) {
+                errno = EINVAL;
+                service_error(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'a':
+            algorithm = condition_parse(optarg);
+            if (algorithm < 0) {
+                error = !0;
+            } else {
+                mixer.algorithm = algorithm;
+            }
+            break;
+
+        case 'r':
+            mixer.ratio = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || ((mixer.ratio != 0) && (mixer.ratio < DIGEST))) {
+                errno = EINVAL;
+                service_error(optarg);
+                error = !0;
+            }
+            break;
+
+        case 't':
+            timeout = strtol(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                service_error(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'R':
+            capacity = strtoul(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                service_error(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'S':
+            spillpath = optarg;
+            break;
+
+        case 'Z':
+            spillsize = strtoul(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                service_error(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'L':
+            low = strtoul(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                service_error(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'H':
+            high = strtoul(optarg, &end, 0);
+            if (*end != '\0') {
+                errno = EINVAL;
+                service_error(optarg);
+                error = !0;
+            }
+            break;
+
+        case 'o':
+            path = optarg;
+            break;
+
+        case 'h':
+            xc = 0;
+            error = !0;
+            break;
+
+        default:
+            error = !0;
+            break;
+
+        }
+
+        if (error) {
+            break;
+        }
+
+    }
+
+    do {
+
+        if (error) {
+            usage(xc);
+            break;
+        }
+
+        if (nnames == 0) {
+            nnames = 1;
+        }
+
+        for (nsources = 0; nsources < nnames; ++nsources) {
+            if (source_parse(&(sources[nsources].device), names[nsources]) < 0) {
+                service_error(names[nsources]);
+                break;
+            }
+        }
+        if (nsources < nnames) {
+            break;
+        }
+
+        if (mixer.ratio == 0) {
+            /* Do nothing. */
+        } else if ((mixer.block = (uint8_t *)malloc(mixer.ratio)) == (uint8_t *)0) {
+            service_error("malloc");
+            break;
+        } else {
+            /* Do nothing. */
+        }
+
+        if ((spillpath != (const char *)0) && (spillsize == 0)) {
+            spillsize = 16 * capacity;
+        }
+
+        if ((capacity == 0) && (spillpath == (const char *)0)) {
+            /* Do nothing. */
+        } else if (reservoir_create(&reservoir, capacity, spillpath, spillsize, low, high) < 0) {
+            service_error((spillpath != (const char *)0) ? spillpath : "reservoir");
+            break;
+        } else {
+            reserving = !0;
+        }
+
+        /*
+         * Daemonize if so configured.
+         */
+
+        if (!daemonize) {
+            /* Do nothing. */
+        } else if (service_daemonize(ident) < 0) {
+            perror("daemon");
+            break;
+        } else {
+            service_verbosef("%s: pid          %d\n", program, getpid());
+        }
+
+        for (ii = 0; ii < nsources; ++ii) {
+            service_verbosef("%s: source       \"%s\"\n", program, sources[ii].device.name);
+            service_verbosef("%s: kind         %s\n", program, SOURCE_KINDS[sources[ii].device.kind]);
+        }
+        service_verbosef("%s: credit       %.3f\n", program, perbyte);
+        service_verbosef("%s: algorithm    \"%s\"\n", program, CONDITION_NAMES[mixer.algorithm]);
+        service_verbosef("%s: ratio        %zu\n", program, mixer.ratio);
+        service_verbosef("%s: timeout      %d\n", program, timeout);
+        if (reserving) {
+            service_verbosef("%s: reservoir    %zu\n", program, reservoir.metrics.capacity);
+            if (spillpath != (const char *)0) {
+                service_verbosef("%s: spill        \"%s\" %zu\n", program, spillpath, reservoir.metrics.spillsize);
+            }
+            service_verbosef("%s: low          %zu\n", program, reservoir.metrics.low);
+            service_verbosef("%s: high         %zu\n", program, reservoir.metrics.high);
+        }
+
+        /*
+         * Install our signal handlers.
+         */
+
+        if (service_signals() < 0) {
+            service_error("sigaction");
+            break;
+        }
+
+        /*
+         * Open the kernel entropy pool, or SINK if so configured.
+         */
+
+        if (path != (const char *)0) {
+            service_verbosef("%s: path         \"%s\"\n", program, path);
+            if ((sink_parse(&sink, path) < 0) || (sink_open(&sink) < 0)) {
+                service_error(path);
+                break;
+            }
+            sp = &sink;
+            service_verbosef("%s: sink         %s\n", program, SINK_KINDS[sink.kind]);
+        } else {
+            fd = open("/dev/random", O_RDWR);
+            if (fd < 0) {
+                service_error("/dev/random");
+                break;
+            }
+        }
+
+        /*
+         * Start a worker thread for each source, and a thread to drain the
+         * reservoir if there is one. The threads block our signals so that
+         * they are always delivered to the main thread.
+         */
+
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGPIPE);
+        sigaddset(&mask, SIGINT);
+        sigaddset(&mask, SIGTERM);
+        sigaddset(&mask, SIGHUP);
+        pthread_sigmask(SIG_BLOCK, &mask, &prior);
+        for (ii = 0; ii < nsources; ++ii) {
+            rc = pthread_create(&(sources[ii].thread), (pthread_attr_t *)0, worker, &(sources[ii]));
+            if (rc != 0) {
+                errno = rc;
+                service_error("pthread_create");
+                break;
+            }
+        }
+        if ((ii == nsources) && reserving) {
+            drain.fd = fd;
+            drain.sink = sp;
+            drain.timeout = timeout;
+            drain.injected = &injected;
+            drain.credited = &credited;
+            rc = pthread_create(&(drain.thread), (pthread_attr_t *)0, drainer, &drain);
+            if (rc != 0) {
+                errno = rc;
+                service_error("pthread_create");
+            } else {
+                draining = !0;
+            }
+        }
+        pthread_sigmask(SIG_SETMASK, &prior, (sigset_t *)0);
+        if ((ii < nsources) || (rc != 0)) {
+            service_done = !0;
+            break;
+        }
+
+        /*
+         * Enter our work loop, mixing the blocks queued by the workers.
+         */
+
+        xc = 0;
+
+        while (!service_done) {
+
+            if (service_report) {
+                statistics(sources, nsources, &mixer, injected, credited);
+                service_report = 0;
+            }
+
+            pthread_mutex_lock(&mutex);
+            for (finished = 0, failed = 0, ii = 0; ii < nsources; ++ii) {
+                if (sources[ii].state == FINISHED) { ++finished; }
+                if (sources[ii].failed) { ++failed; }
+            }
+            if (count > 0) {
+                memcpy(&slot, &(queue[head]), sizeof(slot));
+                head = (head + 1) % QUEUE;
+                --count;
+                pthread_cond_signal(&space);
+                rc = !0;
+            } else if (finished >= nsources) {
+                exhausted = !0;
+                service_done = !0;
+                rc = 0;
+            } else {
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_sec += 1;
+                pthread_cond_timedwait(&ready, &mutex, &deadline);
+                rc = 0;
+            }
+            pthread_mutex_unlock(&mutex);
+
+            if (!rc) {
+                continue;
+            }
+
+            if (mix(&mixer, &slot, fd, sp, timeout, &injected, &credited) < 0) {
+                xc = 2;
+                break;
+            }
+
+            if (debug) {
+                statistics(sources, nsources, &mixer, injected, credited);
+            }
+
+        }
+
+        if ((xc == 0) && (emit(&mixer, fd, sp, timeout, &injected, &credited) < 0)) {
+            xc = 2;
+        }
+
+        /*
+         * If the sources are exhausted, the reservoir is drained before we
+         * exit. Otherwise whatever is left in it is discarded. Either way the
+         * drainer is joined here, before the pool or the output file it
+         * writes to is closed; it is never blocked for longer than the poll
+         * timeout or a withdrawal from the closed reservoir.
+         */
+
+        if (!draining) {
+            /* Do nothing. */
+        } else if (exhausted && (!drain.failed)) {
+            drain.stopping = 2;
+            pthread_join(drain.thread, (void **)0);
+        } else {
+            drain.stopping = 1;
+            reservoir_close(&reservoir);
+            pthread_join(drain.thread, (void **)0);
+        }
+        draining = 0;
+
+        if (drain.failed) {
+            xc = 2;
+        }
+
+        if (failed > 0) {
+            xc = 2;
+        }
+
+    } while (0);
+
+    /*
+     * Clean up after ourselves. The workers are told to stop but are not
+     * joined, since a worker may be blocked in a read from a device that has
+     * stopped producing data.
+     */
+
+    pthread_mutex_lock(&mutex);
+    service_done = !0;
+    pthread_cond_broadcast(&space);
+    pthread_mutex_unlock(&mutex);
+
+    if (draining) {
+        drain.stopping = 1;
+        reservoir_close(&reservoir);
+        pthread_join(drain.thread, (void **)0);
+    }
+
+    memset(&slot, 0, sizeof(slot));
+    if (mixer.block != (uint8_t *)0) {
+        memset(mixer.block, 0, mixer.ratio);
+        free(mixer.block);
+    }
+    memset(mixer.buffer, 0, sizeof(mixer.buffer));
+
+    if (sp != (struct sink *)0) {
+        sink_close(sp);
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    if (service_verbose) {
+        statistics(sources, nsources, &mixer, injected, credited);
+    }
+
+    if (reserving) {
+        reservoir_close(&reservoir);
+        reservoir_destroy(&reservoir);
+    }
+
+    return xc;
+}
@@ -0,0 +1,104 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * FIPS<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ */
+
+#include <string.h>
+#include "fips.h"
+
+const char * FIPS_NAMES[FIPS_TESTS] = { "continuous", "monobit", "poker", "runs", "longrun", };
+
+int fips_test(struct fips * fp, const uint8_t * block)
+{
+    static const size_t RUNS[6][2] = {
+        { 2315, 2685 }, { 1114, 1386 }, { 527, 723 },
+        { 240, 384 }, { 103, 209 }, { 103, 209 },
+    };
+    size_t poker[16] = { 0 };
+    size_t runs[2][6] = { { 0 } };
+    size_t ones = 0;
+    size_t length = 0;
+    size_t longest = 0;
+    double chi = 0.0;
+    uint32_t first = 0;
+    int previous = -1;
+    int bit = 0;
+    int mask = 0;
+    int ii;
+    int jj;
+
+    memcpy(&first, block, sizeof(first));
+    if (fp->primed && (first == fp->last)) {
+        mask |= 1 << FIPS_CONTINUOUS;
+    }
+    fp->last = first;
+    fp->primed = !0;
+
+    for (ii = 0; ii < FIPS_BYTES; ++ii) {
+        ones += __builtin_popcount(block[ii]);
+        ++poker[block[ii] >> 4];
+        ++poker[block[ii] & 0xf];
+        for (jj = 7; jj >= 0; --jj) {
+            bit = (block[ii] >> jj) & 1;
+            if (bit == previous) {
+                ++length;
+            } else {
+                if (previous >= 0) {
+                    ++runs[previous][(length > 6) ? 5 : (length - 1)];
+                    if (length > longest) { longest = length; }
+                }
+                previous = bit;
+                length = 1;
+            }
+        }
+    }
+    ++runs[previous][(length > 6) ? 5 : (length - 1)];
+    if (length > longest) { longest = length; }
+
+    if (!((9725 < ones) && (ones < 10275))) {
+        mask |= 1 << FIPS_MONOBIT;
+    }
+
+    for (ii = 0; ii < 16; ++ii) {
+        chi += (double)poker[ii] * (double)poker[ii];
+    }
+    chi = ((16.0 / 5000.0) * chi) - 5000.0;
+    if (!((2.16 < chi) && (chi < 46.17))) {
+        mask |= 1 << FIPS_POKER;
+    }
+
+    for (ii = 0; ii < 2; ++ii) {
+        for (jj = 0; jj < 6; ++jj) {
+            if ((runs[ii][jj] < RUNS[jj][0]) || (runs[ii][jj] > RUNS[jj][1])) {
+                mask |= 1 << FIPS_RUNS;
+            }
+        }
+    }
+
+    if (longest >= 26) {
+        mask |= 1 << FIPS_LONGRUN;
+    }
+
+    ++(fp->blocks);
+    if (mask == 0) {
+        fp->consecutive = 0;
+    } else {
+        ++(fp->failures);
+        ++(fp->consecutive);
+        for (ii = 0; ii < FIPS_TESTS; ++ii) {
+            if (mask & (1 << ii)) {
+                ++(fp->failed[ii]);
+            }
+        }
+    }
+
+    return mask;
+}
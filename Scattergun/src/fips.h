@@ -0,0 +1,72 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+#ifndef _H_COM_DIAG_SCATTERGUN_FIPS_
+#define _H_COM_DIAG_SCATTERGUN_FIPS_
+
+/**
+ * @file
+ * FIPS<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * Implements the FIPS 140-2 statistical tests, as specified in FIPS 140-2
+ * Annex C and as used by rngtest and rngd, on blocks of 20,000 bits. This is
+ * part of the Scattergun project.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * This is the number of bytes in the block of 20,000 bits on which the
+ * FIPS 140-2 tests are performed.
+ */
+#define FIPS_BYTES (20000 / 8)
+
+/**
+ * These are the bit positions in the mask returned by fips_test.
+ */
+enum {
+    FIPS_CONTINUOUS = 0,
+    FIPS_MONOBIT = 1,
+    FIPS_POKER = 2,
+    FIPS_RUNS = 3,
+    FIPS_LONGRUN = 4,
+    FIPS_TESTS = 5,
+};
+
+/**
+ * These are the names of the tests indexed by their bit positions.
+ */
+extern const char * FIPS_NAMES[FIPS_TESTS];
+
+/**
+ * This is the state carried by the FIPS 140-2 tests from block to block. It
+ * must be zeroed before its first use.
+ */
+struct fips {
+    uint32_t last;
+    int primed;
+    size_t blocks;
+    size_t failures;
+    size_t consecutive;
+    size_t failed[FIPS_TESTS];
+};
+
+/**
+ * Run the FIPS 140-2 statistical tests on one block of 20,000 bits and update
+ * the state. The continuous test compares the first thirty-two bits of each
+ * block to those of the prior block.
+ * @param fp points to the state.
+ * @param block points to the block of FIPS_BYTES bytes.
+ * @return a mask with a bit set for each test that failed.
+ */
+extern int fips_test(struct fips * fp, const uint8_t * block);
+
+#endif
@@ -0,0 +1,517 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * HWRNG Tool<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * hwrngtool [ -h ] [ -v ] [ -n ] [ -f PATH ] [ -b BYTES ] [ -r BYTES ] [ -t SECONDS ] [ -o PATH ] [ DRIVER ... ]
+ *
+ * OPTIONS
+ *
+ * -b BYTES        Read BYTES bytes from each driver (default 20000).
+ * -f PATH         Read from PATH instead of /dev/hwrng.
+ * -h              Display this menu.
+ * -n              Benchmark only, leaving rng_current as it was.
+ * -o PATH         Record the selection in PATH.
+ * -r BYTES        Read no more than BYTES at a time (default 4096).
+ * -t SECONDS      Give up on a driver after SECONDS (default 10).
+ * -v              Display verbose output to stderr.
+ *
+ * EXAMPLES
+ *
+ * hwrngtool -n
+ *
+ * hwrngtool -o /etc/default/hwrng
+ *
+ * hwrngtool -b 200000 -o /etc/default/hwrng tpm-rng-0 virtio_rng.0
+ *
+ * ABSTRACT
+ *
+ * Manages the Linux kernel hardware random number generator framework
+ * through /sys/class/misc/hw_random. Each driver listed in rng_available (or
+ * each DRIVER named on the command line) is made the current driver in turn
+ * by writing its name to rng_current, and BYTES bytes are read from
+ * /dev/hwrng. The first read is discarded, since it may be satisfied from
+ * data buffered from the prior driver. The throughput and the mean and
+ * maximum latency of each read are measured, and each block of 20,000 bits
+ * is screened using the FIPS 140-2 tests. A driver is healthy if every block
+ * passes and it did not time out. The fastest healthy driver is left in
+ * rng_current, or if none is healthy the original driver is restored. The
+ * selection and the measurements are optionally written to PATH as shell
+ * variable assignments (HWRNG and SOURCE) that the feeder init script reads
+ * to restore the selection at boot. Exits with 0 if a driver was selected,
+ * 2 if none was healthy, and 1 for any other failure. Changing rng_current
+ * requires root. This is part of the Scattergun project.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "fips.h"
+
+#define HWRNG_AVAILABLE "/sys/class/misc/hw_random/rng_available"
+#define HWRNG_CURRENT "/sys/class/misc/hw_random/rng_current"
+
+enum {
+    DRIVERS = 16,       /* Maximum number of drivers. */
+    NAME = 64,          /* Longest driver name. */
+};
+
+/**
+ * These are the measurements of one driver.
+ */
+struct result {
+    char name[NAME];
+    size_t bytes;
+    size_t reads;
+    double seconds;
+    double rate;
+    double mean;
+    double worst;
+    int timedout;
+    int healthy;
+    struct fips health;
+};
+
+static const char * program = "hwrngtool";
+static int verbose = 0;
+static int alarmed = 0;
+
+static void alarming(int signum)
+{
+    if (signum == SIGALRM) {
+        alarmed = !0;
+    }
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [ -h ] [ -v ] [ -n ] [ -f PATH ] [ -b BYTES ] [ -r BYTES ] [ -t SECONDS ] [ -o PATH ] [ DRIVER ... ]\n", program);
+    fprintf(stderr, "       -b BYTES        Read BYTES bytes from each driver (default 20000).\n");
+    fprintf(stderr, "       -f PATH         Read from PATH instead of /dev/hwrng.\n");
+    fprintf(stderr, "       -h              Display this menu.\n");
+    fprintf(stderr, "       -n              Benchmark only, leaving rng_current as it was.\n");
+    fprintf(stderr, "       -o PATH         Record the selection in PATH.\n");
+    fprintf(stderr, "       -r BYTES        Read no more than BYTES at a time (default 4096).\n");
+    fprintf(stderr, "       -t SECONDS      Give up on a driver after SECONDS (default 10).\n");
+    fprintf(stderr, "       -v              Display verbose output to stderr.\n");
+}
+
+/**
+ * Return the value of the monotonic clock in seconds.
+ * @return the value of the monotonic clock in seconds.
+ */
+static double now(void)
+{
+    struct timespec ts = { 0 };
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+}
+
+/**
+ * Read the first line of a sysfs attribute, without its newline.
+ * @param path is the path of the attribute.
+ * @param buffer points to the buffer.
+ * @param size is the size of the buffer in bytes.
+ * @return 0 for success, <0 for failure.
+ */
+static int attribute(const char * path, char * buffer, size_t size)
+{
+    FILE * fp = (FILE *)0;
+    char * here = (char *)0;
+
+    fp = fopen(path, "r");
+    if (fp == (FILE *)0) {
+        perror(path);
+        return -1;
+    }
+
+    if (fgets(buffer, size, fp) == (char *)0) {
+        buffer[0] = '\0';
+    }
+    fclose(fp);
+
+    here = strchr(buffer, '\n');
+    if (here != (char *)0) {
+        *here = '\0';
+    }
+
+    return 0;
+}
+
+/**
+ * Make a driver the current driver by writing its name to rng_current.
+ * @param name is the name of the driver.
+ * @return 0 for success, <0 for failure.
+ */
+static int choose(const char * name)
+{
+    int fd = -1;
+    ssize_t rc = 0;
+
+    fd = open(HWRNG_CURRENT, O_WRONLY);
+    if (fd < 0) {
+        perror(HWRNG_CURRENT);
+        return -1;
+    }
+
+    rc = write(fd, name, strlen(name));
+    if (rc < 0) {
+        perror(name);
+    }
+
+    close(fd);
+
+    return (rc < 0) ? -1 : 0;
+}
+
+/**
+ * Benchmark and screen the current driver.
+ * @param rp points to the result.
+ * @param path is the path of the device.
+ * @param total is the number of bytes to read.
+ * @param size is the most bytes to read at a time.
+ * @param seconds is the most time to spend.
+ * @return 0 for success, <0 for failure.
+ */
+static int benchmark(struct result * rp, const char * path, size_t total, size_t size, unsigned int seconds)
+{
+    uint8_t * buffer = (uint8_t *)0;
+    uint8_t block[FIPS_BYTES];
+    size_t staged = 0;
+    size_t length = 0;
+    ssize_t bytes = 0;
+    double start = 0.0;
+    double before = 0.0;
+    double after = 0.0;
+    int fd = -1;
+    int mask = 0;
+    size_t ii;
+
+    buffer = (uint8_t *)malloc(size);
+    if (buffer == (uint8_t *)0) {
+        perror("malloc");
+        return -1;
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        free(buffer);
+        return -1;
+    }
+
+    /*
+     * A driver that stops producing data interrupts the read when the
+     * alarm goes off.
+     */
+
+    alarmed = 0;
+    alarm(seconds);
+
+    bytes = read(fd, buffer, size);
+
+    start = now();
+    while ((!alarmed) && (bytes >= 0) && (rp->bytes < total)) {
+        length = total - rp->bytes;
+        if (length > size) { length = size; }
+        before = now();
+        bytes = read(fd, buffer, length);
+        after = now();
+        if (bytes > 0) {
+            /* Do nothing. */
+        } else if (bytes == 0) {
+            break;
+        } else if ((errno == EINTR) && (!alarmed)) {
+            bytes = 0;
+            continue;
+        } else {
+            break;
+        }
+        ++(rp->reads);
+        rp->bytes += bytes;
+        rp->mean += after - before;
+        if ((after - before) > rp->worst) { rp->worst = after - before; }
+        for (ii = 0; ii < (size_t)bytes; ii += length) {
+            length = sizeof(block) - staged;
+            if (length > ((size_t)bytes - ii)) { length = (size_t)bytes - ii; }
+            memcpy(block + staged, buffer + ii, length);
+            staged += length;
+            if (staged >= sizeof(block)) {
+                mask = fips_test(&(rp->health), block);
+                if ((mask != 0) && verbose) {
+                    fprintf(stderr, "%s: failed       \"%s\" 0x%x\n", program, rp->name, mask);
+                }
+                staged = 0;
+            }
+        }
+    }
+    rp->seconds = now() - start;
+
+    alarm(0);
+
+    if (alarmed) {
+        rp->timedout = !0;
+    } else if (bytes < 0) {
+        perror(path);
+    } else {
+        /* Do nothing. */
+    }
+
+    close(fd);
+    memset(block, 0, sizeof(block));
+    memset(buffer, 0, size);
+    free(buffer);
+
+    if (rp->reads > 0) {
+        rp->mean /= rp->reads;
+    }
+    if (rp->seconds > 0.0) {
+        rp->rate = rp->bytes / rp->seconds;
+    }
+    rp->healthy = (!rp->timedout) && (rp->bytes >= total) && (rp->health.blocks > 0) && (rp->health.failures == 0);
+
+    return 0;
+}
+
+/**
+ * Write the selection and the measurements as shell variable assignments.
+ * @param path is the path of the record.
+ * @param results points to the array of results.
+ * @param nresults is the number of results.
+ * @param best points to the selected result.
+ * @param device is the path of the device.
+ * @return 0 for success, <0 for failure.
+ */
+static int record(const char * path, const struct result * results, size_t nresults, const struct result * best, const char * device)
+{
+    FILE * fp = (FILE *)0;
+    char stamp[sizeof("YYYY-MM-DDTHH:MM:SSZ")];
+    time_t epoch = 0;
+    struct tm utc = { 0 };
+    size_t ii;
+
+    fp = fopen(path, "w");
+    if (fp == (FILE *)0) {
+        perror(path);
+        return -1;
+    }
+
+    epoch = time((time_t *)0);
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime_r(&epoch, &utc));
+
+    fprintf(fp, "# %s %s\n", program, stamp);
+    for (ii = 0; ii < nresults; ++ii) {
+        fprintf(fp, "# %s rate=%.0f latency=%.6f worst=%.6f blocks=%zu failures=%zu health=%s\n", results[ii].name, results[ii].rate, results[ii].mean, results[ii].worst, results[ii].health.blocks, results[ii].health.failures, results[ii].healthy ? "pass" : results[ii].timedout ? "timeout" : "fail");
+    }
+    fprintf(fp, "HWRNG=%s\n", best->name);
+    fprintf(fp, "SOURCE=%s\n", device);
+
+    if (fclose(fp) == EOF) {
+        perror(path);
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int dryrun = 0;
+    size_t total = 10 * FIPS_BYTES;
+    size_t size = 4096;
+    unsigned long seconds = 10;
+    const char * device = "/dev/hwrng";
+    const char * path = (const char *)0;
+    char * end = (char *)0;
+    char * here = (char *)0;
+    char * token = (char *)0;
+    char available[DRIVERS * NAME];
+    char original[NAME];
+    static struct result results[DRIVERS];
+    struct result * rp = (struct result *)0;
+    struct result * best = (struct result *)0;
+    size_t nresults = 0;
+    struct sigaction action = { 0 };
+    size_t ii;
+    int opt;
+    extern char * optarg;
+    extern int optind;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "b:f:hno:r:t:v")) >= 0) {
+
+        switch (opt) {
+
+        case 'b':
+            total = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (total < FIPS_BYTES)) {
+                error = !0;
+            }
+            break;
+
+        case 'f':
+            device = optarg;
+            break;
+
+        case 'h':
+            usage();
+            return 0;
+
+        case 'n':
+            dryrun = !0;
+            break;
+
+        case 'o':
+            path = optarg;
+            break;
+
+        case 'r':
+            size = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (size == 0)) {
+                error = !0;
+            }
+            break;
+
+        case 't':
+            seconds = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (seconds == 0)) {
+                error = !0;
+            }
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        default:
+            error = !0;
+            break;
+
+        }
+
+    }
+
+    if (error) {
+        usage();
+        return 1;
+    }
+
+    do {
+
+        if (attribute(HWRNG_CURRENT, original, sizeof(original)) < 0) {
+            break;
+        }
+        if (attribute(HWRNG_AVAILABLE, available, sizeof(available)) < 0) {
+            break;
+        }
+
+        if (verbose) {
+            fprintf(stderr, "%s: available    \"%s\"\n", program, available);
+            fprintf(stderr, "%s: current      \"%s\"\n", program, original);
+            fprintf(stderr, "%s: device       \"%s\"\n", program, device);
+            fprintf(stderr, "%s: bytes        %zu\n", program, total);
+            fprintf(stderr, "%s: size         %zu\n", program, size);
+            fprintf(stderr, "%s: timeout      %lu\n", program, seconds);
+        }
+
+        /*
+         * The candidates are the drivers named on the command line if there
+         * are any, otherwise every available driver. The pseudo-driver
+         * "none" is never a candidate.
+         */
+
+        if (optind < argc) {
+            for (ii = optind; (ii < argc) && (nresults < DRIVERS); ++ii) {
+                snprintf(results[nresults++].name, NAME, "%s", argv[ii]);
+            }
+        } else {
+            for (token = strtok_r(available, " ", &here); (token != (char *)0) && (nresults < DRIVERS); token = strtok_r((char *)0, " ", &here)) {
+                if (strcmp(token, "none") != 0) {
+                    snprintf(results[nresults++].name, NAME, "%s", token);
+                }
+            }
+        }
+
+        if (nresults == 0) {
+            fprintf(stderr, "%s: no drivers\n", program);
+            xc = 2;
+            break;
+        }
+
+        action.sa_handler = alarming;
+        action.sa_flags = 0;
+        if (sigaction(SIGALRM, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+
+        for (ii = 0; ii < nresults; ++ii) {
+            rp = &(results[ii]);
+            if (choose(rp->name) < 0) {
+                continue;
+            }
+            if (benchmark(rp, device, total, size, seconds) < 0) {
+                continue;
+            }
+            printf("%s: driver=\"%s\" bytes=%zu reads=%zu seconds=%.6f rate=%.0f latency=%.6f worst=%.6f blocks=%zu failures=%zu health=%s\n", program, rp->name, rp->bytes, rp->reads, rp->seconds, rp->rate, rp->mean, rp->worst, rp->health.blocks, rp->health.failures, rp->healthy ? "pass" : rp->timedout ? "timeout" : "fail");
+            fflush(stdout);
+            if (!rp->healthy) {
+                /* Do nothing. */
+            } else if ((best == (struct result *)0) || (rp->rate > best->rate)) {
+                best = rp;
+            } else {
+                /* Do nothing. */
+            }
+        }
+
+        /*
+         * Leave the fastest healthy driver selected, or restore the original
+         * one if none was healthy or this was only a benchmark.
+         */
+
+        if ((best == (struct result *)0) || dryrun) {
+            (void)choose(original);
+        } else {
+            (void)choose(best->name);
+        }
+
+        if (best == (struct result *)0) {
+            fprintf(stderr, "%s: no healthy drivers\n", program);
+            xc = 2;
+            break;
+        }
+
+        printf("%s: selected=\"%s\"%s\n", program, best->name, dryrun ? " (not applied)" : "");
+
+        if ((path != (const char *)0) && (record(path, results, nresults, best, device) < 0)) {
+            break;
+        }
+
+        xc = 0;
+
+    } while (0);
+
+    return xc;
+}
@@ -0,0 +1,536 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Monitor<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * monitor [ -h ] [ -v ] [ -r HERTZ ] [ -d SECONDS ] [ -l BITS ] [ -u BITS ] [ -c | -H | -g SECONDS ]
+ *
+ * OPTIONS
+ *
+ * -H              Display histograms when done instead of events.
+ * -c              Display events as CSV (default).
+ * -d SECONDS      Stop after SECONDS (default until interrupted).
+ * -g SECONDS      Display a bar graph of the pool every SECONDS.
+ * -h              Display this menu.
+ * -l BITS         Pool is depleted at or below BITS (default poolsize/4).
+ * -r HERTZ        Sample the pool HERTZ times a second (default 1000).
+ * -u BITS         Pool is full at or above BITS (default poolsize).
+ * -v              Display verbose output to stderr.
+ *
+ * EXAMPLES
+ *
+ * monitor > pool.csv
+ *
+ * monitor -r 5000 -d 60 -H
+ *
+ * monitor -g 0.25
+ *
+ * ABSTRACT
+ *
+ * Samples the kernel's estimate of the entropy in its pool at up to several
+ * thousand times a second, using one pread(2) of an open entropy_avail per
+ * sample and an absolute deadline so that the sampling period does not drift,
+ * and, on kernels that have getrandom(2), whether the kernel random number
+ * generator is ready, until it is. Each change in the level is recorded as a
+ * timestamped drain (the level fell) or refill (the level rose) event; the
+ * level falling to the low watermark is recorded as a depleted event, and the
+ * level then reaching the high watermark as a full event giving the time to
+ * full and the refill rate since the pool was depleted. Events are written as
+ * CSV, or else histograms of the time to full and of the level are written
+ * when done. A summary of the refills and of the cost of sampling is written
+ * to stderr when done. With -g it instead replaces monitor.sh, displaying
+ * the lowest level seen during each period as a bar graph. This is part of
+ * the Scattergun project.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "pool.h"
+
+#if !defined(GRND_NONBLOCK)
+#   define GRND_NONBLOCK 0x0001
+#endif
+
+enum {
+    BUCKETS = 24,       /* Time to full histogram: powers of two ms. */
+    DECILES = 11,       /* Level histogram: tenths of the pool. */
+};
+
+static const char * program = "monitor";
+static int done = 0;
+
+static void handler(int signum)
+{
+    if (signum == SIGPIPE) {
+        done = !0;
+    } else if (signum == SIGINT) {
+        done = !0;
+    } else if (signum == SIGTERM) {
+        done = !0;
+    } else {
+        /* Do nothing. */
+    }
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [ -h ] [ -v ] [ -r HERTZ ] [ -d SECONDS ] [ -l BITS ] [ -u BITS ] [ -c | -H | -g SECONDS ]\n", program);
+    fprintf(stderr, "       -H              Display histograms when done instead of events.\n");
+    fprintf(stderr, "       -c              Display events as CSV (default).\n");
+    fprintf(stderr, "       -d SECONDS      Stop after SECONDS (default until interrupted).\n");
+    fprintf(stderr, "       -g SECONDS      Display a bar graph of the pool every SECONDS.\n");
+    fprintf(stderr, "       -h              Display this menu.\n");
+    fprintf(stderr, "       -l BITS         Pool is depleted at or below BITS (default poolsize/4).\n");
+    fprintf(stderr, "       -r HERTZ        Sample the pool HERTZ times a second (default 1000).\n");
+    fprintf(stderr, "       -u BITS         Pool is full at or above BITS (default poolsize).\n");
+    fprintf(stderr, "       -v              Display verbose output to stderr.\n");
+}
+
+/**
+ * Return the difference between two times in seconds.
+ * @param ap points to the later time.
+ * @param bp points to the earlier time.
+ * @return the difference in seconds.
+ */
+static double elapsed(const struct timespec * ap, const struct timespec * bp)
+{
+    return (ap->tv_sec - bp->tv_sec) + ((ap->tv_nsec - bp->tv_nsec) / 1000000000.0);
+}
+
+/**
+ * Advance a time by a number of nanoseconds.
+ * @param tp points to the time.
+ * @param nanoseconds is the number of nanoseconds.
+ */
+static void advance(struct timespec * tp, long nanoseconds)
+{
+    tp->tv_nsec += nanoseconds;
+    while (tp->tv_nsec >= 1000000000L) {
+        tp->tv_nsec -= 1000000000L;
+        tp->tv_sec += 1;
+    }
+}
+
+/**
+ * Ask the kernel whether its random number generator is ready, without
+ * consuming anything from it.
+ * @return 1 if ready, 0 if not, <0 if getrandom(2) is not available.
+ */
+static int ready(void)
+{
+#if defined(SYS_getrandom)
+    if (syscall(SYS_getrandom, (void *)0, 0, GRND_NONBLOCK) >= 0) {
+        return 1;
+    } else if (errno == EAGAIN) {
+        return 0;
+    } else {
+        return -1;
+    }
+#else
+    return -1;
+#endif
+}
+
+/**
+ * Display a histogram bucket with a bar scaled to the largest bucket.
+ * @param label is the label of the bucket.
+ * @param count is the count in the bucket.
+ * @param largest is the count in the largest bucket.
+ */
+static void bar(const char * label, unsigned long count, unsigned long largest)
+{
+    static const char GRAPH[] = "==================================================";
+    int width = 0;
+
+    if (largest > 0) {
+        width = (count * (sizeof(GRAPH) - 1)) / largest;
+    }
+    if ((width == 0) && (count > 0)) {
+        width = 1;
+    }
+
+    printf("%s: %-16s %10lu %.*s\n", program, label, count, width, GRAPH);
+}
+
+int main(int argc, char * argv[])
+{
+    static const char GRAPH[] = "====================================================================================================";
+    int xc = 1;
+    int error = 0;
+    int verbose = 0;
+    int csv = !0;
+    int histogram = 0;
+    double graph = 0.0;
+    double hertz = 1000.0;
+    double duration = 0.0;
+    long low = -1;
+    long high = -1;
+    int fd = -1;
+    int poolsize = 0;
+    int level = 0;
+    int previous = 0;
+    int lowest = 0;
+    int readiness = -1;
+    int depleted = 0;
+    int percent = 0;
+    long period = 0;
+    struct timespec start = { 0 };
+    struct timespec deadline = { 0 };
+    struct timespec before = { 0 };
+    struct timespec after = { 0 };
+    struct timespec drained = { 0 };
+    struct timespec shown = { 0 };
+    double seconds = 0.0;
+    double cost = 0.0;
+    double worst = 0.0;
+    double refilling = 0.0;
+    double fill = 0.0;
+    double minimum = 0.0;
+    double maximum = 0.0;
+    unsigned long samples = 0;
+    unsigned long overruns = 0;
+    unsigned long drains = 0;
+    unsigned long refills = 0;
+    unsigned long depletions = 0;
+    unsigned long fulls = 0;
+    unsigned long bitsdrained = 0;
+    unsigned long bitsrefilled = 0;
+    unsigned long filled = 0;
+    unsigned long bitsfilled = 0;
+    unsigned long ttf[BUCKETS] = { 0 };
+    unsigned long levels[DECILES] = { 0 };
+    unsigned long largest = 0;
+    char label[32];
+    char * end = (char *)0;
+    struct sigaction action = { 0 };
+    int opt;
+    int ii;
+    extern char * optarg;
+    extern int optind;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "Hcd:g:hl:r:u:v")) >= 0) {
+
+        switch (opt) {
+
+        case 'H':
+            histogram = !0;
+            csv = 0;
+            break;
+
+        case 'c':
+            csv = !0;
+            histogram = 0;
+            break;
+
+        case 'd':
+            duration = strtod(optarg, &end);
+            if ((*end != '\0') || (duration < 0.0)) {
+                error = !0;
+            }
+            break;
+
+        case 'g':
+            graph = strtod(optarg, &end);
+            if ((*end != '\0') || (graph <= 0.0)) {
+                error = !0;
+            }
+            csv = 0;
+            histogram = 0;
+            break;
+
+        case 'h':
+            usage();
+            return 0;
+
+        case 'l':
+            low = strtol(optarg, &end, 0);
+            if ((*end != '\0') || (low < 0)) {
+                error = !0;
+            }
+            break;
+
+        case 'r':
+            hertz = strtod(optarg, &end);
+            if ((*end != '\0') || (hertz <= 0.0) || (hertz > 1000000.0)) {
+                error = !0;
+            }
+            break;
+
+        case 'u':
+            high = strtol(optarg, &end, 0);
+            if ((*end != '\0') || (high <= 0)) {
+                error = !0;
+            }
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        default:
+            error = !0;
+            break;
+
+        }
+
+    }
+
+    if (optind < argc) {
+        error = !0;
+    } else if ((low >= 0) && (high > 0) && (low >= high)) {
+        error = !0;
+    } else {
+        /* Do nothing. */
+    }
+
+    if (error) {
+        usage();
+        return 1;
+    }
+
+    do {
+
+        action.sa_handler = handler;
+        action.sa_flags = 0;
+        if (sigaction(SIGPIPE, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+        if (sigaction(SIGINT, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+        if (sigaction(SIGTERM, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+
+        poolsize = pool_size();
+        if (poolsize <= 0) {
+            perror(POOL_SIZE);
+            break;
+        }
+        if (high <= 0) { high = poolsize; }
+        if (low < 0) { low = high / 4; }
+        if (low >= high) { low = high - 1; }
+
+        fd = open(POOL_AVAILABLE, O_RDONLY);
+        if (fd < 0) {
+            perror(POOL_AVAILABLE);
+            break;
+        }
+
+        period = 1000000000.0 / hertz;
+        if (period < 1) { period = 1; }
+
+        if (verbose) {
+            fprintf(stderr, "%s: poolsize     %d\n", program, poolsize);
+            fprintf(stderr, "%s: low          %ld\n", program, low);
+            fprintf(stderr, "%s: high         %ld\n", program, high);
+            fprintf(stderr, "%s: hertz        %.1f\n", program, hertz);
+            fprintf(stderr, "%s: period       %ld\n", program, period);
+            fprintf(stderr, "%s: duration     %.3f\n", program, duration);
+        }
+
+        if (csv) {
+            printf("seconds,event,bits,delta,detail\n");
+        }
+
+        /*
+         * The loop sleeps until an absolute deadline on the monotonic clock
+         * and then advances the deadline by one period, so the sampling rate
+         * does not drift with the time spent in the loop. If the loop falls
+         * more than a period behind, the missed samples are counted as an
+         * overrun and the deadline is restarted from now rather than
+         * sampling in a burst to catch up.
+         */
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        deadline = start;
+        shown = start;
+        previous = -1;
+
+        while (!done) {
+
+            clock_gettime(CLOCK_MONOTONIC, &before);
+            level = pool_sample(fd);
+            clock_gettime(CLOCK_MONOTONIC, &after);
+            if (level < 0) {
+                perror(POOL_AVAILABLE);
+                break;
+            }
+
+            seconds = elapsed(&after, &before);
+            cost += seconds;
+            if (seconds > worst) { worst = seconds; }
+            ++samples;
+            seconds = elapsed(&before, &start);
+
+            if (readiness == 0) {
+                readiness = ready();
+                if ((readiness > 0) && csv) {
+                    printf("%.6f,ready,%d,0,\n", seconds, level);
+                }
+            } else if (samples == 1) {
+                readiness = ready();
+                if (csv) {
+                    printf("%.6f,%s,%d,0,\n", seconds, (readiness > 0) ? "ready" : (readiness == 0) ? "unready" : "start", level);
+                }
+            } else {
+                /* Do nothing. */
+            }
+
+            percent = (level * 100) / poolsize;
+            if (percent > 100) { percent = 100; }
+            ++levels[percent / 10];
+
+            if (previous < 0) {
+                lowest = level;
+            } else if (level < previous) {
+                ++drains;
+                bitsdrained += previous - level;
+                if (csv) {
+                    printf("%.6f,drain,%d,%d,\n", seconds, level, level - previous);
+                }
+            } else if (level > previous) {
+                ++refills;
+                bitsrefilled += level - previous;
+                if (depleted) { filled += level - previous; }
+                if (csv) {
+                    printf("%.6f,refill,%d,%d,\n", seconds, level, level - previous);
+                }
+            } else {
+                /* Do nothing. */
+            }
+
+            if ((!depleted) && (level <= low)) {
+                depleted = !0;
+                drained = before;
+                filled = 0;
+                ++depletions;
+                if (csv) {
+                    printf("%.6f,depleted,%d,0,\n", seconds, level);
+                }
+            } else if (depleted && (level >= high)) {
+                depleted = 0;
+                fill = elapsed(&before, &drained);
+                refilling += fill;
+                bitsfilled += filled;
+                if ((fulls == 0) || (fill < minimum)) { minimum = fill; }
+                if (fill > maximum) { maximum = fill; }
+                ++fulls;
+                for (ii = 0; ii < (BUCKETS - 1); ++ii) {
+                    if ((fill * 1000.0) < (double)(1UL << ii)) { break; }
+                }
+                ++ttf[ii];
+                if (csv) {
+                    printf("%.6f,full,%d,0,%.6f:%.1f\n", seconds, level, fill, (fill > 0.0) ? (filled / fill) : 0.0);
+                }
+            } else {
+                /* Do nothing. */
+            }
+
+            previous = level;
+            if (level < lowest) { lowest = level; }
+
+            if ((graph > 0.0) && (elapsed(&before, &shown) >= graph)) {
+                percent = (lowest * 100) / poolsize;
+                if (percent > 100) { percent = 100; }
+                printf("%3d%% %.*s\n", percent, percent, GRAPH);
+                fflush(stdout);
+                shown = before;
+                lowest = level;
+            }
+
+            if ((duration > 0.0) && (seconds >= duration)) {
+                break;
+            }
+
+            advance(&deadline, period);
+            if (elapsed(&after, &deadline) > (period / 1000000000.0)) {
+                ++overruns;
+                deadline = after;
+                advance(&deadline, period);
+            }
+            while ((!done) && (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, (struct timespec *)0) == EINTR)) {
+                continue;
+            }
+
+        }
+
+        fflush(stdout);
+
+        if (histogram) {
+            largest = 0;
+            for (ii = 0; ii < BUCKETS; ++ii) {
+                if (ttf[ii] > largest) { largest = ttf[ii]; }
+            }
+            printf("%s: %-16s %10s\n", program, "timetofull", "count");
+            for (ii = 0; ii < BUCKETS; ++ii) {
+                if (ii < (BUCKETS - 1)) {
+                    snprintf(label, sizeof(label), "<%lums", 1UL << ii);
+                } else {
+                    snprintf(label, sizeof(label), ">=%lums", 1UL << (ii - 1));
+                }
+                bar(label, ttf[ii], largest);
+            }
+            largest = 0;
+            for (ii = 0; ii < DECILES; ++ii) {
+                if (levels[ii] > largest) { largest = levels[ii]; }
+            }
+            printf("%s: %-16s %10s\n", program, "level", "samples");
+            for (ii = 0; ii < DECILES; ++ii) {
+                if (ii < (DECILES - 1)) {
+                    snprintf(label, sizeof(label), "%d-%d%%", ii * 10, (ii * 10) + 9);
+                } else {
+                    snprintf(label, sizeof(label), "100%%");
+                }
+                bar(label, levels[ii], largest);
+            }
+            fflush(stdout);
+        }
+
+        /*
+         * The refill rate is the bits added while the pool was depleted and
+         * refilling, divided by the time it spent doing so.
+         */
+
+        seconds = elapsed(&after, &start);
+        fprintf(stderr, "%s: seconds=%.3f samples=%lu hertz=%.1f overruns=%lu cost=%.3fus worst=%.3fus ready=%s\n",
+            program, seconds, samples, (seconds > 0.0) ? (samples / seconds) : 0.0, overruns,
+            (samples > 0) ? ((cost * 1000000.0) / samples) : 0.0, worst * 1000000.0,
+            (readiness > 0) ? "yes" : (readiness == 0) ? "no" : "unknown");
+        fprintf(stderr, "%s: drains=%lu drained=%lu refills=%lu refilled=%lu depleted=%lu full=%lu timetofull=%.6f/%.6f/%.6f rate=%.1f\n",
+            program, drains, bitsdrained, refills, bitsrefilled, depletions, fulls,
+            minimum, (fulls > 0) ? (refilling / fulls) : 0.0, maximum,
+            (refilling > 0.0) ? (bitsfilled / refilling) : 0.0);
+
+        xc = 0;
+
+    } while (0);
+
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    return xc;
+}
@@ -0,0 +1,100 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Pool<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/random.h>
+#include "pool.h"
+
+int pool_inject(int fd, const void * data, size_t size, int bits)
+{
+    struct rand_pool_info * ip = (struct rand_pool_info *)0;
+    int rc = -1;
+    int error = 0;
+
+    ip = (struct rand_pool_info *)malloc(sizeof(*ip) + size);
+    if (ip == (struct rand_pool_info *)0) {
+        return -1;
+    }
+
+    ip->entropy_count = bits;
+    ip->buf_size = size;
+    memcpy(ip->buf, data, size);
+
+    rc = ioctl(fd, RNDADDENTROPY, ip);
+    error = errno;
+
+    memset(ip, 0, sizeof(*ip) + size);
+    free(ip);
+
+    errno = error;
+
+    return rc;
+}
+
+static int pool_read(const char * path)
+{
+    FILE * fp = (FILE *)0;
+    int value = -1;
+
+    fp = fopen(path, "r");
+    if (fp == (FILE *)0) {
+        return -1;
+    }
+
+    if (fscanf(fp, "%d", &value) != 1) {
+        errno = EINVAL;
+        value = -1;
+    }
+
+    fclose(fp);
+
+    return value;
+}
+
+int pool_available(void)
+{
+    return pool_read(POOL_AVAILABLE);
+}
+
+int pool_sample(int fd)
+{
+    char buffer[16];
+    ssize_t rc = 0;
+    char * end = (char *)0;
+    long value = 0;
+
+    rc = pread(fd, buffer, sizeof(buffer) - 1, 0);
+    if (rc <= 0) {
+        if (rc == 0) { errno = EINVAL; }
+        return -1;
+    }
+    buffer[rc] = '\0';
+
+    value = strtol(buffer, &end, 10);
+    if (end == buffer) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return (int)value;
+}
+
+int pool_size(void)
+{
+    return pool_read(POOL_SIZE);
+}
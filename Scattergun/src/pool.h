@@ -0,0 +1,69 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+#ifndef _H_COM_DIAG_SCATTERGUN_POOL_
+#define _H_COM_DIAG_SCATTERGUN_POOL_
+
+/**
+ * @file
+ * Pool<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * Adds data to the Linux kernel entropy pool with credit, and reports how
+ * much entropy the kernel believes the pool holds. This is part of the
+ * Scattergun project.
+ */
+
+#include <stddef.h>
+
+/**
+ * This is the path of the kernel's estimate of the entropy in the pool.
+ */
+#define POOL_AVAILABLE "/proc/sys/kernel/random/entropy_avail"
+
+/**
+ * This is the path of the size of the pool in bits.
+ */
+#define POOL_SIZE "/proc/sys/kernel/random/poolsize"
+
+/**
+ * Add data to the kernel entropy pool using the RNDADDENTROPY ioctl and
+ * credit it with the specified number of bits of entropy. This requires the
+ * CAP_SYS_ADMIN capability.
+ * @param fd is the open file descriptor of /dev/random.
+ * @param data points to the data.
+ * @param size is the size of the data in bytes.
+ * @param bits is the number of bits of entropy with which to credit the data.
+ * @return 0 for success, <0 with errno set for failure.
+ */
+extern int pool_inject(int fd, const void * data, size_t size, int bits);
+
+/**
+ * Return the number of bits of entropy the kernel estimates is in the pool.
+ * @return the number of bits, or <0 with errno set for failure.
+ */
+extern int pool_available(void);
+
+/**
+ * Return the number of bits of entropy the kernel estimates is in the pool
+ * by reading an already open file descriptor of POOL_AVAILABLE from its
+ * start, so that each sample costs a single system call. This is meant for
+ * sampling the pool at a high rate.
+ * @param fd is the open file descriptor of POOL_AVAILABLE.
+ * @return the number of bits, or <0 with errno set for failure.
+ */
+extern int pool_sample(int fd);
+
+/**
+ * Return the size of the kernel entropy pool in bits.
+ * @return the number of bits, or <0 with errno set for failure.
+ */
+extern int pool_size(void);
+
+#endif
@@ -0,0 +1,349 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * PRNG<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "prng.h"
+
+const char * PRNG_NAMES[PRNG_ALGORITHMS] = { "mrand48", "random", "splitmix64", "xoshiro256", "pcg64", "philox", };
+
+/*
+ * PCG64 multiplies its 128-bit state by this constant.
+ */
+static const uint64_t PCG_MULTIPLIER_HIGH = 2549297995355413924ULL;
+static const uint64_t PCG_MULTIPLIER_LOW = 4865540595714422341ULL;
+
+static inline uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t rotr(uint64_t x, unsigned int k)
+{
+    return (x >> k) | (x << ((64 - k) & 63));
+}
+
+static inline uint64_t splitmix64(uint64_t * xp)
+{
+    uint64_t z = (*xp += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+    return z ^ (z >> 31);
+}
+
+/**
+ * Multiply two 128-bit numbers modulo 2^128.
+ */
+static inline void multiply128(uint64_t * hp, uint64_t * lp, uint64_t ah, uint64_t al, uint64_t bh, uint64_t bl)
+{
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 product = (unsigned __int128)al * bl;
+
+    *hp = (uint64_t)(product >> 64) + (ah * bl) + (al * bh);
+    *lp = (uint64_t)product;
+#else
+    uint64_t a0 = al & 0xffffffffULL;
+    uint64_t a1 = al >> 32;
+    uint64_t b0 = bl & 0xffffffffULL;
+    uint64_t b1 = bl >> 32;
+    uint64_t p00 = a0 * b0;
+    uint64_t p01 = a0 * b1;
+    uint64_t p10 = a1 * b0;
+    uint64_t p11 = a1 * b1;
+    uint64_t middle = (p00 >> 32) + (p01 & 0xffffffffULL) + (p10 & 0xffffffffULL);
+
+    *hp = p11 + (p01 >> 32) + (p10 >> 32) + (middle >> 32) + (ah * bl) + (al * bh);
+    *lp = (middle << 32) | (p00 & 0xffffffffULL);
+#endif
+}
+
+static inline void pcg64_step(uint64_t * hp, uint64_t * lp, uint64_t ih, uint64_t il)
+{
+    uint64_t high;
+    uint64_t low;
+
+    multiply128(&high, &low, *hp, *lp, PCG_MULTIPLIER_HIGH, PCG_MULTIPLIER_LOW);
+    low += il;
+    high += ih + (low < il);
+
+    *hp = high;
+    *lp = low;
+}
+
+int prng_parse(const char * name)
+{
+    int ii;
+
+    for (ii = 0; ii < PRNG_ALGORITHMS; ++ii) {
+        if (strcmp(name, PRNG_NAMES[ii]) == 0) {
+            return ii;
+        }
+    }
+
+    errno = EINVAL;
+
+    return -1;
+}
+
+void prng_init(struct prng * pp, enum prng_algorithm algorithm, uint64_t seed)
+{
+    static const uint64_t JUMP[] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL, };
+    uint64_t mixer = seed;
+    uint64_t s[4];
+    uint64_t t[4];
+    int lane;
+    int ii;
+    int jj;
+    int bit;
+
+    memset(pp, 0, sizeof(*pp));
+    pp->algorithm = algorithm;
+
+    switch (algorithm) {
+
+    case PRNG_MRAND48:
+        if (seed != 0) { srand48(seed); }
+        break;
+
+    case PRNG_RANDOM:
+        if (seed != 0) { srandom((unsigned int)seed); }
+        break;
+
+    case PRNG_SPLITMIX64:
+        for (lane = 0; lane < PRNG_LANES; ++lane) {
+            pp->state[0][lane] = splitmix64(&mixer);
+        }
+        break;
+
+    case PRNG_XOSHIRO256:
+        /*
+         * Each lane starts 2^128 steps after the one before it, so the
+         * lanes can never overlap.
+         */
+        for (ii = 0; ii < 4; ++ii) {
+            s[ii] = splitmix64(&mixer);
+        }
+        for (lane = 0; lane < PRNG_LANES; ++lane) {
+            for (ii = 0; ii < 4; ++ii) {
+                pp->state[ii][lane] = s[ii];
+            }
+            memset(t, 0, sizeof(t));
+            for (ii = 0; ii < 4; ++ii) {
+                for (bit = 0; bit < 64; ++bit) {
+                    if (JUMP[ii] & (1ULL << bit)) {
+                        for (jj = 0; jj < 4; ++jj) { t[jj] ^= s[jj]; }
+                    }
+                    uint64_t x = s[1] << 17;
+                    s[2] ^= s[0];
+                    s[3] ^= s[1];
+                    s[1] ^= s[2];
+                    s[0] ^= s[3];
+                    s[2] ^= x;
+                    s[3] = rotl(s[3], 45);
+                }
+            }
+            memcpy(s, t, sizeof(s));
+        }
+        break;
+
+    case PRNG_PCG64:
+        /*
+         * Each lane is a distinct PCG stream with its own odd increment,
+         * seeded the way pcg64_srandom_r seeds one.
+         */
+        for (lane = 0; lane < PRNG_LANES; ++lane) {
+            uint64_t sh = splitmix64(&mixer);
+            uint64_t sl = splitmix64(&mixer);
+            uint64_t ih = splitmix64(&mixer);
+            uint64_t il = splitmix64(&mixer);
+            ih = (ih << 1) | (il >> 63);
+            il = (il << 1) | 1;
+            pp->state[0][lane] = 0;
+            pp->state[1][lane] = 0;
+            pp->state[2][lane] = ih;
+            pp->state[3][lane] = il;
+            pcg64_step(&(pp->state[0][lane]), &(pp->state[1][lane]), ih, il);
+            pp->state[1][lane] += sl;
+            pp->state[0][lane] += sh + (pp->state[1][lane] < sl);
+            pcg64_step(&(pp->state[0][lane]), &(pp->state[1][lane]), ih, il);
+        }
+        break;
+
+    case PRNG_PHILOX:
+        pp->key[0] = (uint32_t)seed;
+        pp->key[1] = (uint32_t)(seed >> 32);
+        pp->counter = 0;
+        break;
+
+    default:
+        break;
+
+    }
+}
+
+uint64_t prng_philox(const uint32_t key[2], uint64_t counter, void * buffer, size_t size)
+{
+    static const uint32_t M0 = 0xD2511F53U;
+    static const uint32_t M1 = 0xCD9E8D57U;
+    static const uint32_t W0 = 0x9E3779B9U;
+    static const uint32_t W1 = 0xBB67AE85U;
+    uint8_t * here = (uint8_t *)buffer;
+    uint32_t c0[PRNG_LANES];
+    uint32_t c1[PRNG_LANES];
+    uint32_t c2[PRNG_LANES];
+    uint32_t c3[PRNG_LANES];
+    uint32_t out[PRNG_LANES][4];
+    uint32_t k0 = 0;
+    uint32_t k1 = 0;
+    uint64_t blocks = 0;
+    size_t length = 0;
+    int lane;
+    int round;
+
+    while (size > 0) {
+
+        /*
+         * Each lane encrypts its own counter. The multiplications are
+         * thirty-two by thirty-two into sixty-four bits, which most SIMD
+         * instruction sets can do for several lanes at once.
+         */
+
+        for (lane = 0; lane < PRNG_LANES; ++lane) {
+            c0[lane] = (uint32_t)(counter + lane);
+            c1[lane] = (uint32_t)((counter + lane) >> 32);
+            c2[lane] = 0;
+            c3[lane] = 0;
+        }
+
+        k0 = key[0];
+        k1 = key[1];
+        for (round = 0; round < 10; ++round) {
+            for (lane = 0; lane < PRNG_LANES; ++lane) {
+                uint64_t p0 = (uint64_t)M0 * c0[lane];
+                uint64_t p1 = (uint64_t)M1 * c2[lane];
+                uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1[lane] ^ k0;
+                uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3[lane] ^ k1;
+                c1[lane] = (uint32_t)p1;
+                c3[lane] = (uint32_t)p0;
+                c0[lane] = n0;
+                c2[lane] = n2;
+            }
+            k0 += W0;
+            k1 += W1;
+        }
+
+        for (lane = 0; lane < PRNG_LANES; ++lane) {
+            out[lane][0] = c0[lane];
+            out[lane][1] = c1[lane];
+            out[lane][2] = c2[lane];
+            out[lane][3] = c3[lane];
+        }
+
+        length = (size < sizeof(out)) ? size : sizeof(out);
+        memcpy(here, out, length);
+        here += length;
+        size -= length;
+        blocks += (length + PRNG_PHILOX_BYTES - 1) / PRNG_PHILOX_BYTES;
+        counter += PRNG_LANES;
+
+    }
+
+    return blocks;
+}
+
+void prng_fill(struct prng * pp, void * buffer, size_t size)
+{
+    uint8_t * here = (uint8_t *)buffer;
+    uint64_t out[PRNG_LANES];
+    int32_t value = 0;
+    size_t length = 0;
+    int lane;
+
+    switch (pp->algorithm) {
+
+    case PRNG_MRAND48:
+    case PRNG_RANDOM:
+        while (size > 0) {
+            value = (pp->algorithm == PRNG_MRAND48) ? mrand48() : random();
+            length = (size < sizeof(value)) ? size : sizeof(value);
+            memcpy(here, &value, length);
+            here += length;
+            size -= length;
+        }
+        break;
+
+    case PRNG_SPLITMIX64:
+        while (size > 0) {
+            for (lane = 0; lane < PRNG_LANES; ++lane) {
+                out[lane] = splitmix64(&(pp->state[0][lane]));
+            }
+            length = (size < sizeof(out)) ? size : sizeof(out);
+            memcpy(here, out, length);
+            here += length;
+            size -= length;
+        }
+        break;
+
+    case PRNG_XOSHIRO256:
+        while (size > 0) {
+            for (lane = 0; lane < PRNG_LANES; ++lane) {
+                uint64_t s0 = pp->state[0][lane];
+                uint64_t s1 = pp->state[1][lane];
+                uint64_t s2 = pp->state[2][lane];
+                uint64_t s3 = pp->state[3][lane];
+                uint64_t t = s1 << 17;
+                out[lane] = rotl(s1 * 5, 7) * 9;
+                s2 ^= s0;
+                s3 ^= s1;
+                s1 ^= s2;
+                s0 ^= s3;
+                s2 ^= t;
+                s3 = rotl(s3, 45);
+                pp->state[0][lane] = s0;
+                pp->state[1][lane] = s1;
+                pp->state[2][lane] = s2;
+                pp->state[3][lane] = s3;
+            }
+            length = (size < sizeof(out)) ? size : sizeof(out);
+            memcpy(here, out, length);
+            here += length;
+            size -= length;
+        }
+        break;
+
+    case PRNG_PCG64:
+        while (size > 0) {
+            for (lane = 0; lane < PRNG_LANES; ++lane) {
+                pcg64_step(&(pp->state[0][lane]), &(pp->state[1][lane]), pp->state[2][lane], pp->state[3][lane]);
+                out[lane] = rotr(pp->state[0][lane] ^ pp->state[1][lane], (unsigned int)(pp->state[0][lane] >> 58));
+            }
+            length = (size < sizeof(out)) ? size : sizeof(out);
+            memcpy(here, out, length);
+            here += length;
+            size -= length;
+        }
+        break;
+
+    case PRNG_PHILOX:
+        pp->counter += prng_philox(pp->key, pp->counter, buffer, size);
+        break;
+
+    default:
+        memset(buffer, 0, size);
+        break;
+
+    }
+}
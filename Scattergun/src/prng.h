@@ -0,0 +1,114 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+#ifndef _H_COM_DIAG_SCATTERGUN_PRNG_
+#define _H_COM_DIAG_SCATTERGUN_PRNG_
+
+/**
+ * @file
+ * PRNG<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * Implements the pseudo-random number generators used as baselines against
+ * which the hardware entropy sources are compared: the C library's mrand48(3)
+ * and random(3), for continuity with cmrand48 and crandom, and SplitMix64,
+ * xoshiro256**, PCG64 (XSL RR 128/64), and Philox4x32-10. Each of the latter
+ * runs PRNG_LANES independent streams side by side, with the state of each
+ * kept as an array indexed by lane, so that the compiler can generate SIMD
+ * code for the inner loops on any architecture without intrinsics. Buffers
+ * are filled with one word from each lane in turn. Philox is counter based,
+ * so any block of its output can also be generated directly from its
+ * position, which lets many threads or processes fill disjoint parts of one
+ * output in parallel. None of these is suitable for cryptography. This is
+ * part of the Scattergun project.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * This is the number of streams each generator runs side by side.
+ */
+#define PRNG_LANES 8
+
+/**
+ * This is the number of bytes in one block of Philox output.
+ */
+#define PRNG_PHILOX_BYTES 16
+
+enum prng_algorithm {
+    PRNG_MRAND48 = 0,
+    PRNG_RANDOM = 1,
+    PRNG_SPLITMIX64 = 2,
+    PRNG_XOSHIRO256 = 3,
+    PRNG_PCG64 = 4,
+    PRNG_PHILOX = 5,
+    PRNG_ALGORITHMS = 6,
+};
+
+/**
+ * These are the names of the algorithms indexed by algorithm.
+ */
+extern const char * PRNG_NAMES[PRNG_ALGORITHMS];
+
+/**
+ * This is the state of a generator. SplitMix64 uses the first row of the
+ * state, xoshiro256** all four, and PCG64 the high and low halves of its
+ * state and of its stream increment. Philox uses only its key and counter.
+ */
+struct prng {
+    enum prng_algorithm algorithm;
+    uint64_t state[4][PRNG_LANES];
+    uint32_t key[2];
+    uint64_t counter;
+};
+
+/**
+ * Return the algorithm with the specified name.
+ * @param name is the name of the algorithm.
+ * @return the algorithm, or <0 with errno set for failure.
+ */
+extern int prng_parse(const char * name);
+
+/**
+ * Initialize a generator. The libc generators are seeded only if the seed is
+ * not zero, so that by default they produce the same sequence as cmrand48
+ * and crandom. The lanes of the other generators are seeded from the seed
+ * using SplitMix64 so that their streams are distinct; the lanes of
+ * xoshiro256** are further separated by its jump function.
+ * @param pp points to the generator.
+ * @param algorithm is the algorithm.
+ * @param seed is the seed.
+ */
+extern void prng_init(struct prng * pp, enum prng_algorithm algorithm, uint64_t seed);
+
+/**
+ * Fill a buffer with pseudo-random bytes. Generators produce whole words
+ * from every lane at a time, so if the size is not a multiple of that, the
+ * remainder of the last words generated is discarded.
+ * @param pp points to the generator.
+ * @param buffer points to the buffer.
+ * @param size is the size of the buffer in bytes.
+ */
+extern void prng_fill(struct prng * pp, void * buffer, size_t size);
+
+/**
+ * Fill a buffer with the Philox4x32-10 output starting at the specified
+ * block, without any other state. The output of block N is always the same
+ * for the same key, so disjoint parts of a large output may be generated
+ * independently.
+ * @param key is the two word key.
+ * @param counter is the number of the first block.
+ * @param buffer points to the buffer.
+ * @param size is the size of the buffer in bytes.
+ * @return the number of blocks generated, including any partial last block.
+ */
+extern uint64_t prng_philox(const uint32_t key[2], uint64_t counter, void * buffer, size_t size);
+
+#endif
@@ -0,0 +1,780 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Probe<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * probe [ -h ] [ -v ] [ -n ] [ -b SECONDS ] [ -z BYTES ] [ -o PATH ] [ SOURCE ... ]
+ *
+ * OPTIONS
+ *
+ * -b SECONDS      Benchmark each source for SECONDS (default 1).
+ * -h              Display this menu.
+ * -n              Detect sources without benchmarking them.
+ * -o PATH         Write the JSON document to PATH instead of stdout.
+ * -v              Display verbose output to stderr.
+ * -z BYTES        Read BYTES at a time (default 4096).
+ *
+ * EXAMPLES
+ *
+ * probe > $(hostname).json
+ *
+ * probe -b 5 -o /tmp/probe.json /dev/ttyACM0
+ *
+ * ABSTRACT
+ *
+ * Detects every entropy source that Scattergun knows about on this system:
+ * the rdrand and rdseed bits reported by the cpuid instruction, the drivers
+ * in the kernel hardware random number generator framework, TrueRNG,
+ * TrueRNGpro, and OneRNG serial devices by their udev links, Quantis units
+ * (in the -quantis variant, which is linked with the Quantis library), and
+ * the rngd configuration, along with the state of the kernel entropy pool
+ * and which entropy daemons are running. Each source found (and each SOURCE
+ * named on the command line, using the same specifications as the feeder),
+ * plus /dev/urandom as a baseline, is then read for a fixed time budget, and
+ * its throughput, mean and worst read latency, and FIPS 140-2 failures are
+ * measured. A read that blocks past the budget is interrupted, so a dead
+ * device cannot hang the probe. Everything is written as a single JSON
+ * document so that systems across a fleet can be compared. This is part of
+ * the Scattergun project.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/utsname.h>
+#include <sys/syscall.h>
+#include "source.h"
+#include "fips.h"
+#include "pool.h"
+
+#if !defined(GRND_NONBLOCK)
+#   define GRND_NONBLOCK 0x0001
+#endif
+
+#define HWRNG_AVAILABLE "/sys/class/misc/hw_random/rng_available"
+#define HWRNG_CURRENT "/sys/class/misc/hw_random/rng_current"
+#define HWRNG_DEVICE "/dev/hwrng"
+#define RNGTOOLS "/etc/default/rng-tools"
+#define BYID "/dev/serial/by-id"
+
+enum {
+    SOURCES = 32,       /* Most sources benchmarked. */
+    NAME = 512,         /* Longest name or path. */
+};
+
+/**
+ * These are the measurements of one source.
+ */
+struct bench {
+    char name[NAME];
+    const char * kind;
+    const char * status;
+    int error;
+    size_t bytes;
+    size_t reads;
+    double seconds;
+    double mean;
+    double worst;
+    struct fips health;
+};
+
+static const char * program = "probe";
+static int verbose = 0;
+static int alarmed = 0;
+static char names[SOURCES][NAME];
+static int nnames = 0;
+
+static void alarming(int signum)
+{
+    if (signum == SIGALRM) {
+        alarmed = !0;
+    }
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [ -h ] [ -v ] [ -n ] [ -b SECONDS ] [ -z BYTES ] [ -o PATH ] [ SOURCE ... ]\n", program);
+    fprintf(stderr, "       -b SECONDS      Benchmark each source for SECONDS (default 1).\n");
+    fprintf(stderr, "       -h              Display this menu.\n");
+    fprintf(stderr, "       -n              Detect sources without benchmarking them.\n");
+    fprintf(stderr, "       -o PATH         Write the JSON document to PATH instead of stdout.\n");
+    fprintf(stderr, "       -v              Display verbose output to stderr.\n");
+    fprintf(stderr, "       -z BYTES        Read BYTES at a time (default 4096).\n");
+}
+
+/**
+ * Return the value of the monotonic clock in seconds.
+ * @return the value of the monotonic clock in seconds.
+ */
+static double now(void)
+{
+    struct timespec ts = { 0 };
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+}
+
+/**
+ * Write a string as a JSON string, quoted and escaped.
+ * @param fp points to the output stream.
+ * @param string is the string, or NULL for null.
+ */
+static void jstring(FILE * fp, const char * string)
+{
+    const unsigned char * here = (const unsigned char *)string;
+
+    if (string == (const char *)0) {
+        fputs("null", fp);
+        return;
+    }
+
+    fputc('"', fp);
+    for (; *here != '\0'; ++here) {
+        if ((*here == '"') || (*here == '\\')) {
+            fputc('\\', fp);
+            fputc(*here, fp);
+        } else if (*here < ' ') {
+            fprintf(fp, "\\u%04x", *here);
+        } else {
+            fputc(*here, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+/**
+ * Read the first line of a file, without its newline.
+ * @param path is the path of the file.
+ * @param buffer points to the buffer.
+ * @param size is the size of the buffer in bytes.
+ * @return 0 for success, <0 for failure.
+ */
+static int attribute(const char * path, char * buffer, size_t size)
+{
+    FILE * fp = (FILE *)0;
+    char * here = (char *)0;
+
+    buffer[0] = '\0';
+
+    fp = fopen(path, "r");
+    if (fp == (FILE *)0) {
+        return -1;
+    }
+
+    if (fgets(buffer, size, fp) == (char *)0) {
+        buffer[0] = '\0';
+    }
+    fclose(fp);
+
+    here = strchr(buffer, '\n');
+    if (here != (char *)0) {
+        *here = '\0';
+    }
+
+    return 0;
+}
+
+/**
+ * Add a source specification to the list of sources to benchmark, unless
+ * it is already there.
+ * @param name is the source specification.
+ */
+static void add(const char * name)
+{
+    int ii;
+
+    for (ii = 0; ii < nnames; ++ii) {
+        if (strcmp(names[ii], name) == 0) {
+            return;
+        }
+    }
+
+    if (nnames < SOURCES) {
+        snprintf(names[nnames], sizeof(names[nnames]), "%s", name);
+        ++nnames;
+    }
+}
+
+/**
+ * Return true if a process with the specified command name is running.
+ * @param command is the command name as it appears in /proc/PID/comm.
+ * @return true if it is running, false otherwise.
+ */
+static int running(const char * command)
+{
+    DIR * dp = (DIR *)0;
+    struct dirent * ep = (struct dirent *)0;
+    char path[NAME];
+    char comm[NAME];
+    int found = 0;
+
+    dp = opendir("/proc");
+    if (dp == (DIR *)0) {
+        return 0;
+    }
+
+    while ((!found) && ((ep = readdir(dp)) != (struct dirent *)0)) {
+        if ((ep->d_name[0] < '0') || (ep->d_name[0] > '9')) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "/proc/%s/comm", ep->d_name);
+        if (attribute(path, comm, sizeof(comm)) < 0) {
+            continue;
+        }
+        found = (strcmp(comm, command) == 0);
+    }
+
+    closedir(dp);
+
+    return found;
+}
+
+/**
+ * Detect and describe the processor and its rdrand and rdseed instructions.
+ * @param fp points to the output stream.
+ */
+static void cpu(FILE * fp)
+{
+    char vendor[13] = { '\0' };
+    int hasrdrand = 0;
+    int hasrdseed = 0;
+#if defined(__i386__) || defined(__x86_64__)
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+    uint32_t d;
+    uint32_t leaves;
+
+    asm volatile ("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d) : "a" (0), "c" (0));
+    leaves = a;
+    memcpy(&vendor[0], &b, 4);
+    memcpy(&vendor[4], &d, 4);
+    memcpy(&vendor[8], &c, 4);
+
+    if (leaves >= 1) {
+        asm volatile ("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d) : "a" (1), "c" (0));
+        hasrdrand = ((c & 0x40000000) != 0);
+    }
+    if (leaves >= 7) {
+        asm volatile ("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d) : "a" (7), "c" (0));
+        hasrdseed = ((b & 0x00040000) != 0);
+    }
+#else
+    snprintf(vendor, sizeof(vendor), "%s", "other");
+#endif
+
+    if (hasrdrand) { add("rdrand"); }
+    if (hasrdseed) { add("rdseed"); }
+
+    fprintf(fp, "  \"cpu\": { \"vendor\": ");
+    jstring(fp, vendor);
+    fprintf(fp, ", \"rdrand\": %s, \"rdseed\": %s },\n", hasrdrand ? "true" : "false", hasrdseed ? "true" : "false");
+}
+
+/**
+ * Describe the kernel entropy pool and getrandom(2).
+ * @param fp points to the output stream.
+ */
+static void pool(FILE * fp)
+{
+    const char * ready = "unknown";
+
+#if defined(SYS_getrandom)
+    if (syscall(SYS_getrandom, (void *)0, 0, GRND_NONBLOCK) >= 0) {
+        ready = "ready";
+    } else if (errno == EAGAIN) {
+        ready = "unready";
+    } else {
+        /* Do nothing. */
+    }
+#endif
+
+    fprintf(fp, "  \"pool\": { \"poolsize\": %d, \"entropy_avail\": %d, \"getrandom\": ", pool_size(), pool_available());
+    jstring(fp, ready);
+    fprintf(fp, " },\n");
+}
+
+/**
+ * Detect and describe the kernel hardware random number generator drivers.
+ * @param fp points to the output stream.
+ */
+static void hwrng(FILE * fp)
+{
+    char available[NAME];
+    char current[NAME];
+    char * name = (char *)0;
+    char * here = (char *)0;
+    struct stat status = { 0 };
+    int device = 0;
+    int count = 0;
+
+    (void)attribute(HWRNG_AVAILABLE, available, sizeof(available));
+    (void)attribute(HWRNG_CURRENT, current, sizeof(current));
+    device = ((stat(HWRNG_DEVICE, &status) == 0) && S_ISCHR(status.st_mode));
+
+    fprintf(fp, "  \"hwrng\": { \"available\": [");
+    for (name = strtok_r(available, " ", &here); name != (char *)0; name = strtok_r((char *)0, " ", &here)) {
+        if (strcmp(name, "none") == 0) {
+            continue;
+        }
+        fprintf(fp, "%s", (count++ > 0) ? ", " : " ");
+        jstring(fp, name);
+    }
+    fprintf(fp, "%s], \"current\": ", (count > 0) ? " " : "");
+    jstring(fp, (current[0] != '\0') ? current : (const char *)0);
+    fprintf(fp, ", \"device\": %s },\n", device ? "true" : "false");
+
+    if (device && (current[0] != '\0') && (strcmp(current, "none") != 0)) {
+        add(HWRNG_DEVICE);
+    }
+}
+
+/**
+ * Detect and describe the TrueRNG, TrueRNGpro, and OneRNG serial devices by
+ * their udev links.
+ * @param fp points to the output stream.
+ */
+static void ttys(FILE * fp)
+{
+    static const char * LINKS[] = { "/dev/TrueRNG", "/dev/TrueRNGpro", "/dev/OneRNG", };
+    char paths[SOURCES][NAME];
+    char target[NAME];
+    char spec[NAME];
+    DIR * dp = (DIR *)0;
+    struct dirent * ep = (struct dirent *)0;
+    ssize_t length = 0;
+    int npaths = 0;
+    int ii;
+
+    for (ii = 0; ii < (int)(sizeof(LINKS) / sizeof(LINKS[0])); ++ii) {
+        if (access(LINKS[ii], F_OK) == 0) {
+            snprintf(paths[npaths++], NAME, "%s", LINKS[ii]);
+        }
+    }
+
+    dp = opendir(BYID);
+    if (dp != (DIR *)0) {
+        while ((npaths < SOURCES) && ((ep = readdir(dp)) != (struct dirent *)0)) {
+            if ((strstr(ep->d_name, "TrueRNG") != (char *)0) || (strstr(ep->d_name, "OneRNG") != (char *)0)) {
+                snprintf(paths[npaths++], NAME, "%s/%s", BYID, ep->d_name);
+            }
+        }
+        closedir(dp);
+    }
+
+    fprintf(fp, "  \"ttys\": [");
+    for (ii = 0; ii < npaths; ++ii) {
+        length = readlink(paths[ii], target, sizeof(target) - 1);
+        target[(length < 0) ? 0 : length] = '\0';
+        fprintf(fp, "%s{ \"path\": ", (ii > 0) ? ", " : " ");
+        jstring(fp, paths[ii]);
+        fprintf(fp, ", \"target\": ");
+        jstring(fp, (target[0] != '\0') ? target : (const char *)0);
+        fprintf(fp, ", \"onerng\": %s }", (strstr(paths[ii], "OneRNG") != (char *)0) ? "true" : "false");
+        if (strstr(paths[ii], "OneRNG") != (char *)0) {
+            snprintf(spec, sizeof(spec), "onerng:%.*s", NAME - 8, paths[ii]);
+            add(spec);
+        } else {
+            add(paths[ii]);
+        }
+    }
+    fprintf(fp, "%s],\n", (npaths > 0) ? " " : "");
+}
+
+/**
+ * Detect and describe the Quantis units.
+ * @param fp points to the output stream.
+ */
+static void quantis(FILE * fp)
+{
+#if defined(SCATTERGUN_HAS_QUANTIS)
+    char spec[NAME];
+    int usb = 0;
+    int pci = 0;
+    int ii;
+
+    usb = QuantisCount(QUANTIS_DEVICE_USB);
+    pci = QuantisCount(QUANTIS_DEVICE_PCI);
+    if (usb < 0) { usb = 0; }
+    if (pci < 0) { pci = 0; }
+
+    for (ii = 0; ii < usb; ++ii) {
+        snprintf(spec, sizeof(spec), "usb:%d", ii);
+        add(spec);
+    }
+    for (ii = 0; ii < pci; ++ii) {
+        snprintf(spec, sizeof(spec), "pci:%d", ii);
+        add(spec);
+    }
+
+    fprintf(fp, "  \"quantis\": { \"supported\": true, \"usb\": %d, \"pci\": %d },\n", usb, pci);
+#else
+    fprintf(fp, "  \"quantis\": { \"supported\": false, \"usb\": null, \"pci\": null },\n");
+#endif
+}
+
+/**
+ * Describe the rngd configuration and which entropy daemons are running.
+ * @param fp points to the output stream.
+ */
+static void daemons(FILE * fp)
+{
+    static const char * DAEMONS[] = { "rngd", "feeder", "truerngd", "egd", "seventool", "quantistool", "haveged", };
+    FILE * cp = (FILE *)0;
+    char line[NAME];
+    char device[NAME] = { '\0' };
+    char options[NAME] = { '\0' };
+    char * value = (char *)0;
+    char * into = (char *)0;
+    int configured = 0;
+    int ii;
+
+    cp = fopen(RNGTOOLS, "r");
+    if (cp != (FILE *)0) {
+        configured = !0;
+        while (fgets(line, sizeof(line), cp) != (char *)0) {
+            if (strncmp(line, "HRNGDEVICE=", 11) == 0) {
+                value = line + 11;
+                into = device;
+            } else if (strncmp(line, "RNGDOPTIONS=", 12) == 0) {
+                value = line + 12;
+                into = options;
+            } else {
+                continue;
+            }
+            value[strcspn(value, "\n")] = '\0';
+            if ((value[0] == '"') || (value[0] == '\'')) {
+                ++value;
+                value[strcspn(value, "\"'")] = '\0';
+            }
+            snprintf(into, NAME, "%s", value);
+        }
+        fclose(cp);
+    }
+
+    fprintf(fp, "  \"rngd\": { \"configured\": %s, \"hrngdevice\": ", configured ? "true" : "false");
+    jstring(fp, (device[0] != '\0') ? device : (const char *)0);
+    fprintf(fp, ", \"rngdoptions\": ");
+    jstring(fp, (options[0] != '\0') ? options : (const char *)0);
+    fprintf(fp, " },\n");
+
+    fprintf(fp, "  \"daemons\": {");
+    for (ii = 0; ii < (int)(sizeof(DAEMONS) / sizeof(DAEMONS[0])); ++ii) {
+        fprintf(fp, "%s", (ii > 0) ? ", " : " ");
+        jstring(fp, DAEMONS[ii]);
+        fprintf(fp, ": %s", running(DAEMONS[ii]) ? "true" : "false");
+    }
+    fprintf(fp, " },\n");
+}
+
+/**
+ * Read a source for a fixed time budget, measuring its throughput and
+ * latency and screening what it produces with the FIPS 140-2 tests. Reads
+ * of file descriptors are made directly so that the interval timer can
+ * interrupt one that blocks.
+ * @param bp points to the measurements.
+ * @param spec is the source specification.
+ * @param budget is the time budget in seconds.
+ * @param size is the most bytes to read at a time.
+ */
+static void benchmark(struct bench * bp, const char * spec, double budget, size_t size)
+{
+    struct source source = { 0 };
+    struct itimerval timer = { { 0 } };
+    uint8_t * buffer = (uint8_t *)0;
+    uint8_t block[FIPS_BYTES];
+    size_t staged = 0;
+    size_t length = 0;
+    ssize_t bytes = 0;
+    double start = 0.0;
+    double before = 0.0;
+    double after = 0.0;
+    size_t ii;
+
+    memset(bp, 0, sizeof(*bp));
+    snprintf(bp->name, sizeof(bp->name), "%.*s", NAME - 1, spec);
+    bp->kind = SOURCE_KINDS[SOURCE_NONE];
+    bp->status = "error";
+
+    do {
+
+        if (source_parse(&source, spec) < 0) {
+            bp->error = errno;
+            break;
+        }
+
+        if (source_open(&source) < 0) {
+            bp->error = errno;
+            break;
+        }
+        bp->kind = SOURCE_KINDS[source.kind];
+
+        buffer = (uint8_t *)malloc(size);
+        if (buffer == (uint8_t *)0) {
+            bp->error = errno;
+            break;
+        }
+
+        alarmed = 0;
+        timer.it_value.tv_sec = budget;
+        timer.it_value.tv_usec = (budget - (long)budget) * 1000000.0;
+        setitimer(ITIMER_REAL, &timer, (struct itimerval *)0);
+
+        bp->status = "ok";
+        start = now();
+        while (!alarmed) {
+            before = now();
+            if (source.fd >= 0) {
+                bytes = read(source.fd, buffer, size);
+            } else {
+                bytes = source_read(&source, buffer, size);
+            }
+            after = now();
+            if (bytes > 0) {
+                /* Do nothing. */
+            } else if (bytes == 0) {
+                bp->status = "eof";
+                break;
+            } else if ((errno == EINTR) && alarmed) {
+                break;
+            } else if (errno == EINTR) {
+                continue;
+            } else {
+                bp->error = errno;
+                bp->status = "error";
+                break;
+            }
+            ++(bp->reads);
+            bp->bytes += bytes;
+            bp->mean += (after - before);
+            if ((after - before) > bp->worst) { bp->worst = after - before; }
+            for (ii = 0; ii < (size_t)bytes; ii += length) {
+                length = FIPS_BYTES - staged;
+                if (length > ((size_t)bytes - ii)) { length = (size_t)bytes - ii; }
+                memcpy(block + staged, buffer + ii, length);
+                staged += length;
+                if (staged >= FIPS_BYTES) {
+                    (void)fips_test(&(bp->health), block);
+                    staged = 0;
+                }
+            }
+        }
+        bp->seconds = now() - start;
+
+        memset(&timer, 0, sizeof(timer));
+        setitimer(ITIMER_REAL, &timer, (struct itimerval *)0);
+
+        if ((bp->bytes == 0) && (strcmp(bp->status, "ok") == 0)) {
+            bp->status = "timeout";
+        }
+        if (bp->reads > 0) {
+            bp->mean /= bp->reads;
+        }
+
+    } while (0);
+
+    memset(block, 0, sizeof(block));
+    if (buffer != (uint8_t *)0) {
+        memset(buffer, 0, size);
+        free(buffer);
+    }
+    source_close(&source);
+
+    if (verbose) {
+        fprintf(stderr, "%s: source=\"%s\" kind=%s bytes=%zu reads=%zu seconds=%.6f status=%s\n", program, bp->name, bp->kind, bp->bytes, bp->reads, bp->seconds, bp->status);
+    }
+}
+
+/**
+ * Write the measurements of a source as a JSON object.
+ * @param fp points to the output stream.
+ * @param bp points to the measurements.
+ */
+static void emit(FILE * fp, const struct bench * bp)
+{
+    fprintf(fp, "{ \"source\": ");
+    jstring(fp, bp->name);
+    fprintf(fp, ", \"kind\": ");
+    jstring(fp, bp->kind);
+    fprintf(fp, ", \"status\": ");
+    jstring(fp, bp->status);
+    fprintf(fp, ", \"error\": ");
+    jstring(fp, (bp->error != 0) ? strerror(bp->error) : (const char *)0);
+    fprintf(fp, ", \"bytes\": %zu, \"reads\": %zu, \"seconds\": %.6f, \"rate\": %.0f, \"latency\": { \"mean\": %.9f, \"worst\": %.9f }, \"fips\": { \"blocks\": %zu, \"failures\": %zu } }",
+        bp->bytes, bp->reads, bp->seconds, (bp->seconds > 0.0) ? (bp->bytes / bp->seconds) : 0.0,
+        bp->mean, bp->worst, bp->health.blocks, bp->health.failures);
+}
+
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int measure = !0;
+    double budget = 1.0;
+    size_t size = 4096;
+    const char * path = (const char *)0;
+    FILE * fp = stdout;
+    char * end = (char *)0;
+    struct sigaction action = { 0 };
+    struct utsname host = { { 0 } };
+    struct bench bench = { { 0 } };
+    char hostname[NAME] = { '\0' };
+    char stamp[sizeof("YYYY-MM-DDTHH:MM:SSZ")];
+    struct tm utc = { 0 };
+    time_t epoch = 0;
+    int opt;
+    int ii;
+    extern char * optarg;
+    extern int optind;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "b:hno:vz:")) >= 0) {
+
+        switch (opt) {
+
+        case 'b':
+            budget = strtod(optarg, &end);
+            if ((*end != '\0') || (budget <= 0.0)) {
+                error = !0;
+            }
+            break;
+
+        case 'h':
+            usage();
+            return 0;
+
+        case 'n':
+            measure = 0;
+            break;
+
+        case 'o':
+            path = optarg;
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        case 'z':
+            size = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (size == 0)) {
+                error = !0;
+            }
+            break;
+
+        default:
+            error = !0;
+            break;
+
+        }
+
+    }
+
+    if (error) {
+        usage();
+        return 1;
+    }
+
+    do {
+
+        /*
+         * The timer interrupts a read that blocks, so SA_RESTART is not
+         * set, and the handler does nothing but note that it went off.
+         */
+
+        action.sa_handler = alarming;
+        action.sa_flags = 0;
+        if (sigaction(SIGALRM, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+
+        if (path != (const char *)0) {
+            fp = fopen(path, "w");
+            if (fp == (FILE *)0) {
+                perror(path);
+                break;
+            }
+        }
+
+        (void)uname(&host);
+        (void)gethostname(hostname, sizeof(hostname) - 1);
+        epoch = time((time_t *)0);
+        strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime_r(&epoch, &utc));
+
+        fprintf(fp, "{\n");
+        fprintf(fp, "  \"probe\": 1,\n");
+        fprintf(fp, "  \"timestamp\": ");
+        jstring(fp, stamp);
+        fprintf(fp, ",\n  \"host\": { \"hostname\": ");
+        jstring(fp, hostname);
+        fprintf(fp, ", \"sysname\": ");
+        jstring(fp, host.sysname);
+        fprintf(fp, ", \"release\": ");
+        jstring(fp, host.release);
+        fprintf(fp, ", \"version\": ");
+        jstring(fp, host.version);
+        fprintf(fp, ", \"machine\": ");
+        jstring(fp, host.machine);
+        fprintf(fp, " },\n");
+
+        cpu(fp);
+        pool(fp);
+        hwrng(fp);
+        ttys(fp);
+        quantis(fp);
+        daemons(fp);
+
+        for (ii = optind; ii < argc; ++ii) {
+            add(argv[ii]);
+        }
+        add("/dev/urandom");
+
+        fprintf(fp, "  \"budget\": %.3f,\n", measure ? budget : 0.0);
+        fprintf(fp, "  \"size\": %zu,\n", size);
+        fprintf(fp, "  \"benchmarks\": [");
+        for (ii = 0; measure && (ii < nnames); ++ii) {
+            benchmark(&bench, names[ii], budget, size);
+            fprintf(fp, "%s\n    ", (ii > 0) ? "," : "");
+            emit(fp, &bench);
+            fflush(fp);
+        }
+        fprintf(fp, "%s]\n", (measure && (nnames > 0)) ? "\n  " : "");
+        fprintf(fp, "}\n");
+
+        if (fflush(fp) == EOF) {
+            perror((path != (const char *)0) ? path : "stdout");
+            break;
+        }
+
+        xc = 0;
+
+    } while (0);
+
+    if ((fp != stdout) && (fp != (FILE *)0)) {
+        fclose(fp);
+    }
+
+    return xc;
+}
@@ -0,0 +1,101 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+#ifndef _H_COM_DIAG_SCATTERGUN_PROBES_
+#define _H_COM_DIAG_SCATTERGUN_PROBES_
+
+/**
+ * @file
+ * Probes<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * Defines statically defined tracepoints (USDT) for the hot loops of the
+ * producers, in the provider "scattergun", so that bpftrace, perf, or
+ * SystemTap can measure a live daemon without restarting it or perturbing
+ * its timing the way the -d debug flag does. Each tracepoint is a single
+ * nop instruction plus an ELF note (section .note.stapsdt) that tells the
+ * tracer where the nop is and where to find the arguments; until a tracer
+ * attaches, it costs nothing. If compiled with SCATTERGUN_HAS_SDT, the
+ * tracepoints are defined using <sys/sdt.h> from SystemTap; otherwise they
+ * are defined here, in the same format, on x86_64 and aarch64, and are
+ * empty elsewhere. Arguments are integers, passed as signed 64-bit values.
+ * This is part of the Scattergun project.
+ *
+ * EXAMPLES
+ *
+ * readelf -n seventool | grep -A2 stapsdt
+ *
+ * bpftrace -e 'usdt:./seventool:scattergun:read__start { @t[tid] = nsecs; }
+ *   usdt:./seventool:scattergun:read__end /@t[tid]/ { @ns = hist(nsecs - @t[tid]); }'
+ *
+ * perf probe -x ./quantistool sdt_scattergun:reopen
+ */
+
+#include <stdint.h>
+
+#if defined(SCATTERGUN_HAS_SDT)
+
+#   include <sys/sdt.h>
+
+#   define PROBE0(_NAME_) DTRACE_PROBE(scattergun, _NAME_)
+#   define PROBE1(_NAME_, _A1_) DTRACE_PROBE1(scattergun, _NAME_, (int64_t)(_A1_))
+#   define PROBE2(_NAME_, _A1_, _A2_) DTRACE_PROBE2(scattergun, _NAME_, (int64_t)(_A1_), (int64_t)(_A2_))
+#   define PROBE3(_NAME_, _A1_, _A2_, _A3_) DTRACE_PROBE3(scattergun, _NAME_, (int64_t)(_A1_), (int64_t)(_A2_), (int64_t)(_A3_))
+
+#elif defined(__x86_64__) || defined(__aarch64__)
+
+/*
+ * This is the version 3 note layout of <sys/sdt.h>: the address of the nop,
+ * the address of the .stapsdt.base section (so tracers can adjust for
+ * prelinking), a zero semaphore address, and the provider, name, and
+ * argument strings. Each argument string is "-8@" followed by wherever the
+ * compiler chose to put the argument, a register, memory, or an immediate.
+ */
+
+#   define PROBE_NOTE(_NAME_, _ARGUMENTS_, ...) \
+        __asm__ __volatile__ ( \
+            "990: nop\n" \
+            ".pushsection .note.stapsdt,\"?\",\"note\"\n" \
+            ".balign 4\n" \
+            ".4byte 992f-991f,994f-993f,3\n" \
+            "991: .asciz \"stapsdt\"\n" \
+            "992: .balign 4\n" \
+            "993: .8byte 990b\n" \
+            ".8byte _.stapsdt.base\n" \
+            ".8byte 0\n" \
+            ".asciz \"scattergun\"\n" \
+            ".asciz \"" #_NAME_ "\"\n" \
+            ".asciz \"" _ARGUMENTS_ "\"\n" \
+            "994: .balign 4\n" \
+            ".popsection\n" \
+            ".ifndef _.stapsdt.base\n" \
+            ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+            ".weak _.stapsdt.base\n" \
+            ".hidden _.stapsdt.base\n" \
+            "_.stapsdt.base: .space 1\n" \
+            ".size _.stapsdt.base,1\n" \
+            ".popsection\n" \
+            ".endif\n" \
+            :: __VA_ARGS__)
+
+#   define PROBE0(_NAME_) PROBE_NOTE(_NAME_, "")
+#   define PROBE1(_NAME_, _A1_) PROBE_NOTE(_NAME_, "-8@%0", "nor" ((int64_t)(_A1_)))
+#   define PROBE2(_NAME_, _A1_, _A2_) PROBE_NOTE(_NAME_, "-8@%0 -8@%1", "nor" ((int64_t)(_A1_)), "nor" ((int64_t)(_A2_)))
+#   define PROBE3(_NAME_, _A1_, _A2_, _A3_) PROBE_NOTE(_NAME_, "-8@%0 -8@%1 -8@%2", "nor" ((int64_t)(_A1_)), "nor" ((int64_t)(_A2_)), "nor" ((int64_t)(_A3_)))
+
+#else
+
+#   define PROBE0(_NAME_) ((void)0)
+#   define PROBE1(_NAME_, _A1_) ((void)(_A1_))
+#   define PROBE2(_NAME_, _A1_, _A2_) ((void)(_A1_), (void)(_A2_))
+#   define PROBE3(_NAME_, _A1_, _A2_, _A3_) ((void)(_A1_), (void)(_A2_), (void)(_A3_))
+
+#endif
+
+#endif
@@ -12,7 +12,7 @@
  *
  * USAGE
  *
- * quantistool [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -u UNIT | -p UNIT ] [ -r BYTES ] [ -c ] [ -o PATH ]
+ * quantistool [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -u UNIT | -p UNIT ] [ -r BYTES ] [ -c ] [ -o SINK | -m NAME [ -M MODE ] ]
  *
  * EXAMPLES
  *
@@ -24,14 +24,23 @@
  * chmod 666 quantis.fifo
  * quantistool -D -i QUANTIS -U 0 -c -o quantis.fifo &
  *
+ * quantistool -D -i QUANTIS -U 0 -m /quantistool &
+ * ringtool -r /quantistool | dd of=random.dat bs=4096 count=1024 iflag=fullblock
+ *
+ * quantistool -D -i QUANTIS -U 0 -o tcp:collector:4242 &
+ *
  * ABSTRACT
  *
  * Continuously reads data from a Quantis hardware entropy generator,
  * manufactured by ID Quantique, and writes it to standard output, or to a
  * specified file system path. This latter object could be a FIFO, which could
- * allow generated entropy to be read by another program, like rngd. Optionally
- * does some other useful stuff with the Quantis. This is part of the Scattergun
- * project. This must be linked with the Quantis library.
+ * allow generated entropy to be read by another program, like rngd. Or it
+ * can be a shared memory ring (see ringtool) from which any number of
+ * consumers take entropy, each slot going to exactly one of them, or the kernel
+ * entropy pool or a socket (see sink.h). Several reads are made into a vector
+ * of buffers, directly into the ring if there is one, before they are written.
+ * Optionally does some other useful stuff with the Quantis. This is part of
+ * the Scattergun project. This must be linked with the Quantis library.
  *
  * The Quantis software library I have restricts reads to sizes of no more
  * than 16 megabytes (16 * 1024 * 1024). But it restricts each individual
@@ -45,16 +54,16 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
-#include <stdarg.h>
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
-#include <fcntl.h>
-#include <signal.h>
-#include <syslog.h>
 #include <sys/types.h>
-#include <sys/stat.h>
+#include <sys/uio.h>
 #include "Quantis.h"
+#include "service.h"
+#include "source.h"
+#include "sink.h"
+#include "probes.h"
 
 static const QuantisDeviceType TYPES[] = { QUANTIS_DEVICE_PCI, QUANTIS_DEVICE_USB };
 static const char * NAMES[] = { "PCI", "USB" };
@@ -62,79 +71,12 @@ static const char * NAMES[] = { "PCI", "USB" };
 static const char * program = "quantistool";
 static const char * ident = "quantistool";
 static int debug = 0;
-static int verbose = 0;
-static int done = 0;
-static int report = 0;
-static int daemonize = 0;
-
-/**
- * Emit a formatting string to either the system log or to standard error.
- * @param format is the printf format.
- */
-static void lprintf(const char * format, ...)
-{
-    va_list ap;
-    va_start(ap, format);
-    if (daemonize) {
-        vsyslog(LOG_DEBUG, format, ap);
-    } else {
-        vfprintf(stderr, format, ap);
-    }
-    va_end(ap);
-}
-
-/**
- * Emit a formatting string to either the system log or to standard error
- * if verbosity is enabled.
- * @param format is the printf format.
- */
-static void lverbosef(const char * format, ...)
-{
-    if (verbose) {
-        va_list ap;
-        va_start(ap, format);
-        if (daemonize) {
-            vsyslog(LOG_DEBUG, format, ap);
-        } else {
-            vfprintf(stderr, format, ap);
-        }
-        va_end(ap);
-    }
-}
-
-/**
- * Emit a caller provider string and an error message string corresponding to
- * the current value of the error number (errno) to either the system log or
- * to standard error.
- * @param string is the string.
- */
-static void lerror(const char * string)
-{
-    if (daemonize) {
-        syslog(LOG_ERR, "%s: %s\n", string, strerror(errno));
-    } else {
-        fprintf(stderr, "%s: %s\n", string, strerror(errno));
-    }
-}
 
 /**
- * Handle a signal. In the event of a SIGPIPE or a SIGINT, the program shuts
- * down in an orderly fashion. In the event of a SIGHUP, it emits some
- * statistics to standard error.
- * @param signum is the number of the incoming signal.
+ * This is the most bytes read into a vector before it is written, unless a
+ * single read is larger.
  */
-static void handler(int signum)
-{
-    if (signum == SIGPIPE) {
-        done = !0;
-    } else if (signum == SIGINT) {
-        done = !0;
-    } else if (signum == SIGHUP) {
-        report = !0;
-    } else {
-        /* Do nothing. */
-    }
-}
+static const size_t BATCH = 65536;
 
 /**
  * Emit a usage message to standard error.
@@ -142,18 +84,20 @@ static void handler(int signum)
  */
 static void usage(int nomenu)
 {
-    lprintf("usage: %s [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -u UNIT | -p UNIT ] [ -r BYTES ] [ -c ] [ -o PATH ]\n", program);
+    service_printf("usage: %s [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -u UNIT | -p UNIT ] [ -r BYTES ] [ -c ] [ -o SINK | -m NAME [ -M MODE ] ]\n", program);
     if (nomenu) { return; }
-    lprintf("       -d            Enable debug mode\n");
-    lprintf("       -v            Enable verbose mode\n");
-    lprintf("       -D            Run as a daemon\n");
-    lprintf("       -i IDENT      Use IDENT as the syslog identifier\n");
-    lprintf("       -u UNIT       Use USB card UNIT\n");
-    lprintf("       -p UNIT       Use PCI card UNIT\n");
-    lprintf("       -r BYTES      Read at most BYTES bytes at a time (0 to exit)\n");
-    lprintf("       -c            Check for the requested device\n");
-    lprintf("       -o PATH       Write to PATH (which may be a fifo) instead of stdout\n");
-    lprintf("       -h            Print help menu\n");
+    service_printf("       -d            Enable debug mode\n");
+    service_printf("       -v            Enable verbose mode\n");
+    service_printf("       -D            Run as a daemon\n");
+    service_printf("       -i IDENT      Use IDENT as the syslog identifier\n");
+    service_printf("       -u UNIT       Use USB card UNIT\n");
+    service_printf("       -p UNIT       Use PCI card UNIT\n");
+    service_printf("       -r BYTES      Read at most BYTES bytes at a time (0 to exit)\n");
+    service_printf("       -c            Check for the requested device\n");
+    service_printf("       -o SINK       Write to SINK (PATH, fifo, pool[:BITS], unix:PATH, tcp:HOST:PORT) instead of stdout\n");
+    service_printf("       -m NAME       Publish to shared memory ring NAME instead of stdout\n");
+    service_printf("       -M MODE       Create the ring with the octal permissions MODE (default 0%o)\n", RING_MODE);
+    service_printf("       -h            Print help menu\n");
 }
 
 /**
@@ -167,7 +111,7 @@ static int query(QuantisDeviceType want, int unit)
     int rc = 0;
     int ii;
 
-    lverbosef("%s: device       detecting\n", program);
+    service_verbosef("%s: device       detecting\n", program);
 
     for (ii = 0; ii < (sizeof(TYPES) / sizeof(TYPES[0])); ++ii) {
         QuantisDeviceType type = 0;
@@ -178,15 +122,15 @@ static int query(QuantisDeviceType want, int unit)
         type = TYPES[ii];
         detected = QuantisCount(type);
 
-        lverbosef("%s: type         %s\n", program, NAMES[ii]);
-        lverbosef("%s: detected     %d\n", program, detected);
+        service_verbosef("%s: type         %s\n", program, NAMES[ii]);
+        service_verbosef("%s: detected     %d\n", program, detected);
 
         if (detected <= 0) {
             continue;
         }
 
         software = QuantisGetDriverVersion(type);
-        lverbosef("%s: software     %f\n", program, software);
+        service_verbosef("%s: software     %f\n", program, software);
 
         for (jj = 0; jj < detected; ++jj) {
             int hardware = 0;
@@ -203,13 +147,13 @@ static int query(QuantisDeviceType want, int unit)
             mask = QuantisGetModulesMask(type, jj);
             status = QuantisGetModulesStatus(type, jj);
 
-            lverbosef("%s: unit         %d\n", program, jj);
-            lverbosef("%s: hardware     %d\n", program, hardware);
-            lverbosef("%s: serial       \"%s\"\n", program, serial);
-            lverbosef("%s: manufacturer \"%s\"\n", program, manufacturer);
-            lverbosef("%s: power        %d\n", program, power);
-            lverbosef("%s: modules      0x%8.8x\n", program, mask);
-            lverbosef("%s: status       0x%8.8x\n", program, status);
+            service_verbosef("%s: unit         %d\n", program, jj);
+            service_verbosef("%s: hardware     %d\n", program, hardware);
+            service_verbosef("%s: serial       \"%s\"\n", program, serial);
+            service_verbosef("%s: manufacturer \"%s\"\n", program, manufacturer);
+            service_verbosef("%s: power        %d\n", program, power);
+            service_verbosef("%s: modules      0x%8.8x\n", program, mask);
+            service_verbosef("%s: status       0x%8.8x\n", program, status);
 
             if (want != type) {
                 /* Do nothing. */
@@ -221,7 +165,7 @@ static int query(QuantisDeviceType want, int unit)
                 rc = !0;
             }
 
-            lverbosef("%s: device       %s\n", program, rc ? "present" : "absent");
+            service_verbosef("%s: device       %s\n", program, rc ? "present" : "absent");
         }
     }
     
@@ -240,21 +184,20 @@ int main(int argc, char * argv[])
     QuantisDeviceType type = QUANTIS_DEVICE_USB;
     unsigned int unit = 0;
     size_t size = 512;
-    size_t written = 0;
     char * end = (char *)0;
-    QuantisDeviceHandle * handle = (QuantisDeviceHandle *)0;
-    unsigned char * buffer = (unsigned char *)0;
     int rc = 0;
-    FILE * fp = stdout;
-    uintptr_t offset = 0;
-    struct sigaction sigpipe = { 0 };
-    struct sigaction sighup = { 0 };
-    struct sigaction sigint = { 0 };
-    size_t opens = 0;
-    size_t total = 0;
-    size_t reads = 0;
-    int try = 0;
-    const char * path = (const char *)0;
+    int count = 0;
+    int buffers = 0;
+    ssize_t bytes = 0;
+    const char * path = "-";
+    const char * name = (const char *)0;
+    mode_t permissions = RING_MODE;
+    char spec[sizeof("pci:") + 3 * sizeof(unit)];
+    struct source source = { 0 };
+    struct sink sink = { 0 };
+    struct iovec vector[SOURCE_VECTOR];
+    int daemonize = 0;
+    int failed = 0;
     int opt;
     extern char * optarg;
     int ii;
@@ -266,7 +209,10 @@ int main(int argc, char * argv[])
 
     program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
 
-    while ((opt = getopt(argc, argv, "dvDu:p:r:co:i:h")) >= 0) {
+    source.fd = -1;
+    sink.fd = -1;
+
+    while ((opt = getopt(argc, argv, "dvDu:p:r:co:m:M:i:h")) >= 0) {
 
         switch (opt) {
 
@@ -275,7 +221,7 @@ int main(int argc, char * argv[])
             break;
 
         case 'v':
-            verbose = !0;
+            service_verbose = !0;
             break;
 
         case 'D':
@@ -300,7 +246,7 @@ int main(int argc, char * argv[])
             size = strtoul(optarg, &end, 0);
             if ((*end != '\0') || (!((0 <= size) && (size <= QUANTIS_MAX_READ_SIZE)))) {
                 errno = EINVAL;
-                lerror(optarg);
+                service_error(optarg);
                 error = !0;
             }
             break;
@@ -309,6 +255,19 @@ int main(int argc, char * argv[])
             path = optarg;
             break;
 
+        case 'm':
+            name = optarg;
+            break;
+
+        case 'M':
+            permissions = strtoul(optarg, &end, 8);
+            if ((*end != '\0') || (permissions > 0777)) {
+                errno = EINVAL;
+                service_error(optarg);
+                error = !0;
+            }
+            break;
+
         case 'i':
             ident = optarg;
             break;
@@ -343,22 +302,21 @@ int main(int argc, char * argv[])
 
         if (!daemonize) {
             /* Do nothing. */
-        } else if (daemon(0, 0) < 0) {
+        } else if (service_daemonize(ident) < 0) {
             perror("daemon");
             break;
         } else {
-            openlog(ident, LOG_CONS | LOG_PID, LOG_DAEMON);
-            lverbosef("%s: pid          %d\n", program, getpid());
+            service_verbosef("%s: pid          %d\n", program, getpid());
         }
 
         for (ii = 0; ii < (sizeof(TYPES) / sizeof(TYPES[0])); ++ii) {
             if (TYPES[ii] == type) {
-                lverbosef("%s: type         %s\n", program, NAMES[ii]);
+                service_verbosef("%s: type         %s\n", program, NAMES[ii]);
             }
         }
-        lverbosef("%s: unit         %d\n", program, unit);
-        lverbosef("%s: bytes        %zu\n", program, size);
-        lverbosef("%s: maximum      %zu\n", program, (size_t)QUANTIS_MAX_READ_SIZE);
+        service_verbosef("%s: unit         %d\n", program, unit);
+        service_verbosef("%s: bytes        %zu\n", program, size);
+        service_verbosef("%s: maximum      %zu\n", program, (size_t)QUANTIS_MAX_READ_SIZE);
 
         /*
          * See what kind of hardware we have, and if it matches what
@@ -390,66 +348,60 @@ int main(int argc, char * argv[])
             /* Do nothing. */
         }
 
-        buffer = malloc(size);
-        if (buffer == (unsigned char *)0) {
-            lerror("malloc");
-            break;
-        }
-
         /*
-         * Install our signal handlers.
+         * Each read is limited to the read size, so a vector of them is
+         * made before anything is written.
          */
 
-        sigpipe.sa_handler = handler;
-        sigpipe.sa_flags = 0;
-        rc = sigaction(SIGPIPE, &sigpipe, (struct sigaction *)0);
-        if (rc < 0) {
-            lerror("sigaction");
-            break;
-        }
+        buffers = (size < BATCH) ? (BATCH / size) : 1;
+        if (buffers > SOURCE_VECTOR) { buffers = SOURCE_VECTOR; }
+        service_verbosef("%s: buffers      %d\n", program, buffers);
 
-        sighup.sa_handler = handler;
-        sighup.sa_flags = SA_RESTART;
-        rc = sigaction(SIGHUP, &sighup, (struct sigaction *)0);
-        if (rc < 0) {
-            lerror("sigaction");
+        snprintf(spec, sizeof(spec), "%s:%u", (type == QUANTIS_DEVICE_PCI) ? "pci" : "usb", unit);
+        if (source_parse(&source, spec) < 0) {
+            service_error(spec);
             break;
         }
 
-        sigint.sa_handler = handler;
-        sigint.sa_flags = 0;
-        rc = sigaction(SIGINT, &sighup, (struct sigaction *)0);
-        if (rc < 0) {
-            lerror("sigaction");
+        /*
+         * Install our signal handlers.
+         */
+
+        if (service_signals() < 0) {
+            service_error("sigaction");
             break;
         }
 
         /*
-         * Switch from stdout to PATH if so configured.
+         * Switch from stdout to SINK or to the ring NAME if so configured.
          */
 
-        if (path != (const char *)0) {
-            lverbosef("%s: path         \"%s\"\n", program, path);
-            fp = fopen(path, "a");
-            if (fp == (FILE *)0) {
-                lerror(path);
-                break;
-            }
+        if (name != (const char *)0) {
+            service_verbosef("%s: ring         \"%s\"\n", program, name);
+            rc = sink_ring(&sink, name);
+            sink.mode = permissions;
+            sink.cancel = &service_done;
+        } else {
+            service_verbosef("%s: path         \"%s\"\n", program, path);
+            rc = sink_parse(&sink, path);
         }
+        if ((rc < 0) || (sink_open(&sink) < 0)) {
+            service_error((name != (const char *)0) ? name : path);
+            break;
+        }
+        service_verbosef("%s: sink         %s\n", program, SINK_KINDS[sink.kind]);
 
         /*
          * Enter our work loop.
          */
 
-        while (!done) {
+        while ((!service_done) && (!failed)) {
 
-            rc = QuantisOpen(type, unit, &handle);
-            if (rc < QUANTIS_SUCCESS) {
-                lprintf("%s: QuantisOpen(%d,%d,%p)=%d=\"%s\"\n", program, type, unit, handle,  rc, QuantisStrError(rc));
+            if (source_open(&source) < 0) {
+                service_printf("%s: QuantisOpen(%d,%d)=%d=\"%s\"\n", program, type, unit, source.status, QuantisStrError(source.status));
                 break;
             }
-            ++opens;
-            lverbosef("%s: handle       %p\n", program, handle);
+            service_verbosef("%s: handle       %p\n", program, source.handle);
 
             /*
              * Enter our input/output loop. If the read fails we try it again,
@@ -458,38 +410,49 @@ int main(int argc, char * argv[])
              * and reopen it. As long as the open succeeds, we soldier on.
              */
 
-            while (!done) {
-                if (report) {
-                    lprintf("%s: opens=%zu size=%zu reads=%zu total=%zu\n", program, opens, size, reads, total);
-                    report = 0;
+            while (!service_done) {
+                if (service_report) {
+                    service_printf("%s: opens=%zu size=%zu reads=%zu total=%zu writes=%zu\n", program, source.opens, size, source.reads, sink.total, sink.writes);
+                    service_report = 0;
+                }
+                count = sink_reserve(&sink, vector, buffers, size);
+                if (count > 0) {
+                    /* Do nothing. */
+                } else if ((errno == EAGAIN) || (errno == EINTR)) {
+                    continue;
+                } else {
+                    service_error("sink_reserve");
+                    failed = !0;
+                    break;
                 }
-                rc = QuantisReadHandled(handle, buffer, size);
-                if (rc < QUANTIS_SUCCESS) {
-                    lprintf("%s: QuantisReadHandled(%p,%p,%zu)=%d=\"%s\" try=1\n", program, handle, buffer, size, rc, QuantisStrError(rc));
-                    rc = QuantisReadHandled(handle, buffer, size);
-                    if (rc < QUANTIS_SUCCESS) {
-                        lprintf("%s: QuantisReadHandled(%p,%p,%zu)=%d=\"%s\" try=2\n", program, handle, buffer, size, rc, QuantisStrError(rc));
+                PROBE1(read__start, count);
+                bytes = source_readv(&source, vector, count);
+                PROBE1(read__end, bytes);
+                if (bytes <= 0) {
+                    service_printf("%s: QuantisReadHandled(%p,%d)=%d=\"%s\" try=1\n", program, source.handle, count, source.status, QuantisStrError(source.status));
+                    PROBE1(read__start, count);
+                    bytes = source_readv(&source, vector, count);
+                    PROBE1(read__end, bytes);
+                    if (bytes <= 0) {
+                        service_printf("%s: QuantisReadHandled(%p,%d)=%d=\"%s\" try=2\n", program, source.handle, count, source.status, QuantisStrError(source.status));
+                        PROBE2(reopen, source.opens, source.status);
                         break;
                     }
                 }
-                if (rc < QUANTIS_SUCCESS) {
-                    break;
-                }
-                ++reads;
-                total += size;
-                written = fwrite(buffer, size, 1, fp);
-                if (written < 1) {
-                    lerror("fwrite");
+                PROBE1(write__start, bytes);
+                rc = sink_commit(&sink, bytes);
+                PROBE1(write__end, rc);
+                if (rc < 0) {
+                    if (!service_done) { service_error("write"); }
+                    failed = !0;
                     break;
                 }
                 if (debug) {
-                    lprintf("%s: opens=%zu size=%zu reads=%zu total=%zu\n", program, opens, size, reads, total);
+                    service_printf("%s: opens=%zu size=%zu reads=%zu total=%zu writes=%zu\n", program, source.opens, size, source.reads, sink.total, sink.writes);
                 }
             }
 
-            if (handle != (QuantisDeviceHandle *)0) {
-                QuantisClose(handle);
-            }
+            source_close(&source);
 
         }
 
@@ -501,15 +464,10 @@ int main(int argc, char * argv[])
      * Clean up after ourselves.
      */
 
-    if (fp != (FILE *)0) {
-        fclose(fp);
-    }
-
-    if (buffer != (unsigned char *)0) {
-        free(buffer);
-    }
+    sink_close(&sink);
+    source_close(&source);
 
-    lverbosef("%s: opens=%zu size=%zu reads=%zu total=%zu\n", program, opens, size, reads, total);
+    service_verbosef("%s: opens=%zu size=%zu reads=%zu total=%zu writes=%zu\n", program, source.opens, size, source.reads, sink.total, sink.writes);
 
     return xc;
 }
@@ -12,7 +12,7 @@
  *
  * USAGE
  *
- * rate [ -h ] [ -c NANOSECONDS ] [ -v ] [ -f PATH ] [ -r BYTES ] [ -t BYTES ]
+ * rate [ -h ] [ -c NANOSECONDS ] [ -v ] [ -f PATH ] [ -r BYTES ] [ -t BYTES ] [ -T | -O ] [ -x KILOBITS ]
  *
  * OPTIONS
  *
@@ -22,16 +22,25 @@
  * -r BYTES        Read no more than this at a time.
  * -t BYTES        Read no more than this total.
  * -v              Display verbose output to stderr.
+ * -T              Configure PATH as a low latency raw serial device.
+ * -O              Like -T but also initialize PATH as a OneRNG.
+ * -x KILOBITS     Exit with 2 if the sustained rate is less than this.
  *
  * EXAMPLES
  *
  * rate -f /dev/TrueRNGpro -r 4096 -t 1000000000
  *
+ * rate -f /dev/TrueRNGpro -T -r 65536 -t 400000000 -x 3200
+ *
+ * rate -f /dev/OneRNG -O -r 65536 -t 40000000
+ *
  * ABSTRACT
  *
  * Measures the sustained and peak rates of a data source. Optionally outputs
  * a comma separated value (CSV) file of performance metrics with the specified
- * period.
+ * period. Reports the yield of each read, the average number of bytes it
+ * returned as a percentage of the number requested, which for a serial device
+ * shows whether VMIN, VTIME, and the low latency flag are doing their jobs.
  */
 
 #include <stdlib.h>
@@ -47,6 +56,8 @@
 #include <sys/time.h>
 #include <fcntl.h>
 #include <float.h>
+#include "tty.h"
+#include "probes.h"
 
 static const char * program = "rate";
 
@@ -115,13 +126,16 @@ static int alarmable(void)
 
 static void usage(void)
 {
-    fprintf(stderr, "usage: %s [ -c NANOSECONDS ] [ -f PATH ] [ -h ] [ -r BYTES ] [ -t BYTES ] [ -v ] \n", program);
+    fprintf(stderr, "usage: %s [ -c NANOSECONDS ] [ -f PATH ] [ -h ] [ -r BYTES ] [ -t BYTES ] [ -v ] [ -T | -O ] [ -x KILOBITS ]\n", program);
     fprintf(stderr, "       -c NANOSECONDS  Display CSV output to stdout.\n");
     fprintf(stderr, "       -f PATH         Read from here instead of stdin.\n");
     fprintf(stderr, "       -h              Display this menu.\n");
     fprintf(stderr, "       -r BYTES        Read no more than this at a time.\n");
     fprintf(stderr, "       -t BYTES        Read no more than this total.\n");
     fprintf(stderr, "       -v              Display verbose output to stderr.\n");
+    fprintf(stderr, "       -T              Configure PATH as a low latency raw serial device.\n");
+    fprintf(stderr, "       -O              Like -T but also initialize PATH as a OneRNG.\n");
+    fprintf(stderr, "       -x KILOBITS     Exit with 2 if the sustained rate is less than this.\n");
 }
 
 /**
@@ -143,12 +157,15 @@ int main(int argc, char * argv[])
     char * end = (char *)0;
     int verbose = 0;
     uint64_t period = 0;
+    int dotty = 0;
+    int doonerng = 0;
+    double expected = 0.0;
     int opt;
     extern char * optarg;
 
     program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
 
-    while ((opt = getopt(argc, argv, "c:f:ht:r:v")) >= 0) {
+    while ((opt = getopt(argc, argv, "c:f:ht:r:vTOx:")) >= 0) {
 
         switch (opt) {
 
@@ -191,6 +208,24 @@ int main(int argc, char * argv[])
             verbose = !0;
             break;
 
+        case 'T':
+            dotty = !0;
+            break;
+
+        case 'O':
+            dotty = !0;
+            doonerng = !0;
+            break;
+
+        case 'x':
+            expected = strtod(optarg, &end);
+            if ((*end != '\0') || (expected < 0.0)) {
+                errno = EINVAL;
+                perror(optarg);
+                error = !0;
+            }
+            break;
+
         default:
             usage();
             error = !0;
@@ -233,13 +268,33 @@ int main(int argc, char * argv[])
         }
 
         if (path != (const char *)0) {
-            fd = open(path, O_RDONLY);
+            fd = open(path, doonerng ? (O_RDWR | O_NOCTTY) : (O_RDONLY | O_NOCTTY));
             if (fd < 0) {
                 perror(path);
                 break;
             }
         }
 
+        if (!dotty) {
+            /* Do nothing. */
+        } else if (tty_raw(fd, TTY_VMIN, TTY_VTIME) < 0) {
+            perror("tty_raw");
+            break;
+        } else {
+            fprintf(stderr, "%s: %d VMIN\n", program, TTY_VMIN);
+            fprintf(stderr, "%s: %d VTIME\n", program, TTY_VTIME);
+            fprintf(stderr, "%s: %d low latency\n", program, tty_lowlatency(fd));
+        }
+
+        if (!doonerng) {
+            /* Do nothing. */
+        } else if (tty_onerng(fd) < 0) {
+            perror("tty_onerng");
+            break;
+        } else {
+            /* Do nothing. */
+        }
+
         if (size > limit) {
             size = limit;
         }
@@ -262,7 +317,13 @@ int main(int argc, char * argv[])
             if (remaining < size) {
                 xc = 0;
                 break;
-            } else if ((bytes = read(fd, buffer, size)) == 0) {
+            }
+
+            PROBE1(read__start, size);
+            bytes = read(fd, buffer, size);
+            PROBE1(read__end, bytes);
+
+            if (bytes == 0) {
                 xc = 0;
                 break;
             } else if (bytes < 0) {
@@ -340,6 +401,7 @@ int main(int argc, char * argv[])
         }
 
         fprintf(stderr, "%s: %lf bytes average\n", program, (0.0 + total) / reads);
+        fprintf(stderr, "%s: %lf percent yield\n", program, (100.0 * total) / (reads * (0.0 + size)));
         if (reads <= 1) {
             break;
         }
@@ -349,6 +411,11 @@ int main(int argc, char * argv[])
         fprintf(stderr, "%s: %lf kilobits/second sustained\n", program, sustained);
         fprintf(stderr, "%s: %lf kilobits/second peak\n", program, peak);
 
+        if ((xc == 0) && (sustained < expected)) {
+            fprintf(stderr, "%s: %lf kilobits/second expected\n", program, expected);
+            xc = 2;
+        }
+
     } while (0);
 
     return xc;
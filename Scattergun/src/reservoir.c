@@ -0,0 +1,491 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Reservoir<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "reservoir.h"
+
+#define ROTATE(_V_, _N_) (((_V_) << (_N_)) | ((_V_) >> (32 - (_N_))))
+
+#define QUARTER(_A_, _B_, _C_, _D_) \
+    do { \
+        _A_ += _B_; _D_ ^= _A_; _D_ = ROTATE(_D_, 16); \
+        _C_ += _D_; _B_ ^= _C_; _B_ = ROTATE(_B_, 12); \
+        _A_ += _B_; _D_ ^= _A_; _D_ = ROTATE(_D_, 8); \
+        _C_ += _D_; _B_ ^= _C_; _B_ = ROTATE(_B_, 7); \
+    } while (0)
+
+/**
+ * Compute a 64-byte block of ChaCha20 keystream. This is the original
+ * variant with a 64-bit nonce and a 64-bit block counter, so the counter
+ * never wraps no matter how much passes through the spill file.
+ * @param key points to the 256-bit key.
+ * @param nonce is the nonce.
+ * @param counter is the block counter.
+ * @param block points to where the keystream is stored.
+ */
+static void chacha20(const uint32_t * key, uint64_t nonce, uint64_t counter, uint8_t * block)
+{
+    uint32_t input[16];
+    uint32_t x[16];
+    int ii;
+
+    input[0] = 0x61707865;
+    input[1] = 0x3320646e;
+    input[2] = 0x79622d32;
+    input[3] = 0x6b206574;
+    for (ii = 0; ii < 8; ++ii) {
+        input[4 + ii] = key[ii];
+    }
+    input[12] = (uint32_t)counter;
+    input[13] = (uint32_t)(counter >> 32);
+    input[14] = (uint32_t)nonce;
+    input[15] = (uint32_t)(nonce >> 32);
+
+    memcpy(x, input, sizeof(x));
+    for (ii = 0; ii < 10; ++ii) {
+        QUARTER(x[0], x[4], x[8], x[12]);
+        QUARTER(x[1], x[5], x[9], x[13]);
+        QUARTER(x[2], x[6], x[10], x[14]);
+        QUARTER(x[3], x[7], x[11], x[15]);
+        QUARTER(x[0], x[5], x[10], x[15]);
+        QUARTER(x[1], x[6], x[11], x[12]);
+        QUARTER(x[2], x[7], x[8], x[13]);
+        QUARTER(x[3], x[4], x[9], x[14]);
+    }
+
+    for (ii = 0; ii < 16; ++ii) {
+        x[ii] += input[ii];
+        block[(ii * 4) + 0] = x[ii];
+        block[(ii * 4) + 1] = x[ii] >> 8;
+        block[(ii * 4) + 2] = x[ii] >> 16;
+        block[(ii * 4) + 3] = x[ii] >> 24;
+    }
+
+    memset(x, 0, sizeof(x));
+    memset(input, 0, sizeof(input));
+}
+
+/**
+ * Encrypt or decrypt data at an absolute position in the stream of data that
+ * has passed through the spill file. Since the position never repeats, no
+ * part of the keystream is ever used twice even though the file is reused.
+ * @param rp points to the reservoir.
+ * @param to points to the output.
+ * @param from points to the input.
+ * @param size is the size of the data in bytes.
+ * @param position is the absolute position of the first byte.
+ */
+static void cipher(const struct reservoir * rp, uint8_t * to, const uint8_t * from, size_t size, uint64_t position)
+{
+    uint8_t block[64];
+    size_t offset = 0;
+    size_t length = 0;
+    size_t ii;
+
+    while (size > 0) {
+        chacha20(rp->key, rp->nonce, position / sizeof(block), block);
+        offset = position % sizeof(block);
+        length = sizeof(block) - offset;
+        if (length > size) { length = size; }
+        for (ii = 0; ii < length; ++ii) {
+            to[ii] = from[ii] ^ block[offset + ii];
+        }
+        to += length;
+        from += length;
+        size -= length;
+        position += length;
+    }
+
+    memset(block, 0, sizeof(block));
+}
+
+/**
+ * Return the total number of bytes in the reservoir. The mutex must be held.
+ * @param rp points to the reservoir.
+ * @return the total number of bytes in the reservoir.
+ */
+static inline size_t total(const struct reservoir * rp)
+{
+    return rp->metrics.level + rp->metrics.spilled;
+}
+
+/**
+ * Compute the deadline for a timed wait.
+ * @param deadlinep points to where the deadline is stored.
+ * @param timeout is the timeout in milliseconds.
+ */
+static void expire(struct timespec * deadlinep, int timeout)
+{
+    clock_gettime(CLOCK_REALTIME, deadlinep);
+    deadlinep->tv_sec += timeout / 1000;
+    deadlinep->tv_nsec += (timeout % 1000) * 1000000L;
+    if (deadlinep->tv_nsec >= 1000000000L) {
+        deadlinep->tv_sec += 1;
+        deadlinep->tv_nsec -= 1000000000L;
+    }
+}
+
+int reservoir_create(struct reservoir * rp, size_t capacity, const char * path, size_t spillsize, size_t low, size_t high)
+{
+    uint8_t seed[sizeof(rp->key) + sizeof(rp->nonce)];
+    void * base = (void *)0;
+    int fd = -1;
+    int error = 0;
+    struct stat status = { 0 };
+
+    memset(rp, 0, sizeof(*rp));
+    pthread_mutex_init(&(rp->mutex), (pthread_mutexattr_t *)0);
+    pthread_cond_init(&(rp->space), (pthread_condattr_t *)0);
+    pthread_cond_init(&(rp->data), (pthread_condattr_t *)0);
+
+    if (path == (const char *)0) {
+        spillsize = 0;
+    }
+
+    if ((high == 0) || (high > (capacity + spillsize))) {
+        high = capacity + spillsize;
+    }
+    if (low == 0) {
+        low = high / 2;
+    }
+    if (((capacity + spillsize) == 0) || (low > high)) {
+        reservoir_destroy(rp);
+        errno = EINVAL;
+        return -1;
+    }
+
+    rp->metrics.capacity = capacity;
+    rp->metrics.low = low;
+    rp->metrics.high = high;
+
+    if (capacity > 0) {
+        rp->memory = (uint8_t *)malloc(capacity);
+        if (rp->memory == (uint8_t *)0) {
+            error = errno;
+            reservoir_destroy(rp);
+            errno = error;
+            return -1;
+        }
+    }
+
+    if (spillsize == 0) {
+        return 0;
+    }
+
+    /*
+     * The key and nonce for the spill file come from the kernel and are
+     * never written anywhere.
+     */
+
+    fd = open("/dev/urandom", O_RDONLY);
+    if (fd < 0) {
+        error = errno;
+        reservoir_destroy(rp);
+        errno = error;
+        return -1;
+    }
+    if (read(fd, seed, sizeof(seed)) != sizeof(seed)) {
+        error = (errno != 0) ? errno : EIO;
+        close(fd);
+        reservoir_destroy(rp);
+        errno = error;
+        return -1;
+    }
+    close(fd);
+    memcpy(rp->key, seed, sizeof(rp->key));
+    memcpy(&(rp->nonce), seed + sizeof(rp->key), sizeof(rp->nonce));
+    memset(seed, 0, sizeof(seed));
+
+    /*
+     * The spill file is never an existing file: a directory gets an unnamed
+     * file in it, and any other path must not exist yet (nor be a symbolic
+     * link) and is removed as soon as it is created, so that a daemon running
+     * as root cannot be tricked into truncating or removing someone else's
+     * file. The open descriptor and then the mapping keep it alive.
+     */
+
+    if (stat(path, &status) == 0 && S_ISDIR(status.st_mode)) {
+        fd = open(path, O_RDWR | O_TMPFILE | O_EXCL, 0600);
+    } else {
+        fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW, 0600);
+        if (fd >= 0) {
+            unlink(path);
+        }
+    }
+    if (fd < 0) {
+        error = errno;
+        reservoir_destroy(rp);
+        errno = error;
+        return -1;
+    }
+
+    if (ftruncate(fd, spillsize) < 0) {
+        error = errno;
+        close(fd);
+        reservoir_destroy(rp);
+        errno = error;
+        return -1;
+    }
+
+    base = mmap((void *)0, spillsize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        error = errno;
+        close(fd);
+        reservoir_destroy(rp);
+        errno = error;
+        return -1;
+    }
+
+    close(fd);
+
+    rp->spill = (uint8_t *)base;
+    rp->metrics.spillsize = spillsize;
+
+    return 0;
+}
+
+void reservoir_close(struct reservoir * rp)
+{
+    pthread_mutex_lock(&(rp->mutex));
+    rp->closed = !0;
+    pthread_cond_broadcast(&(rp->space));
+    pthread_cond_broadcast(&(rp->data));
+    pthread_mutex_unlock(&(rp->mutex));
+}
+
+void reservoir_destroy(struct reservoir * rp)
+{
+    if (rp->memory != (uint8_t *)0) {
+        memset(rp->memory, 0, rp->metrics.capacity);
+        free(rp->memory);
+    }
+
+    if (rp->spill != (uint8_t *)0) {
+        munmap(rp->spill, rp->metrics.spillsize);
+    }
+
+    pthread_cond_destroy(&(rp->data));
+    pthread_cond_destroy(&(rp->space));
+    pthread_mutex_destroy(&(rp->mutex));
+
+    memset(rp, 0, sizeof(*rp));
+}
+
+int reservoir_deposit(struct reservoir * rp, const void * data, size_t size, double credit, int timeout)
+{
+    struct reservoir_metrics * mp = &(rp->metrics);
+    const uint8_t * here = (const uint8_t *)data;
+    struct timespec deadline = { 0 };
+    size_t last = 0;
+    size_t length = 0;
+    size_t offset = 0;
+    int stalled = 0;
+
+    if (size > (mp->capacity + mp->spillsize)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pthread_mutex_lock(&(rp->mutex));
+
+    /*
+     * The high watermark is reached when this deposit would cross it, not
+     * only when one lands exactly on it, since it need not be a multiple of
+     * the size of a deposit. It is not reached while the level is at or below
+     * the low watermark, since then no withdrawal would restart deposits.
+     */
+
+    if ((!rp->stopped) && ((total(rp) + size) > mp->high) && (total(rp) > mp->low)) {
+        rp->stopped = !0;
+        ++(mp->cycles);
+    }
+
+    while ((!rp->closed) && (rp->stopped || (((mp->capacity + mp->spillsize) - total(rp)) < size))) {
+        if (!stalled) {
+            stalled = !0;
+            ++(mp->stalls);
+            if (timeout > 0) { expire(&deadline, timeout); }
+        }
+        if (timeout < 0) {
+            pthread_cond_wait(&(rp->space), &(rp->mutex));
+        } else if ((timeout == 0) || (pthread_cond_timedwait(&(rp->space), &(rp->mutex), &deadline) != 0)) {
+            pthread_mutex_unlock(&(rp->mutex));
+            errno = EAGAIN;
+            return -1;
+        } else {
+            /* Do nothing. */
+        }
+    }
+
+    if (rp->closed) {
+        pthread_mutex_unlock(&(rp->mutex));
+        errno = ECANCELED;
+        return -1;
+    }
+
+    /*
+     * Fill memory first, and spill whatever does not fit.
+     */
+
+    length = mp->capacity - mp->level;
+    if (length > size) { length = size; }
+    if (length > 0) {
+        last = (rp->first + mp->level) % mp->capacity;
+        offset = mp->capacity - last;
+        if (offset > length) { offset = length; }
+        memcpy(rp->memory + last, here, offset);
+        memcpy(rp->memory, here + offset, length - offset);
+        mp->level += length;
+        here += length;
+    }
+
+    length = size - length;
+    if (length > 0) {
+        last = rp->spillin % mp->spillsize;
+        offset = mp->spillsize - last;
+        if (offset > length) { offset = length; }
+        cipher(rp, rp->spill + last, here, offset, rp->spillin);
+        cipher(rp, rp->spill, here + offset, length - offset, rp->spillin + offset);
+        rp->spillin += length;
+        mp->spilled += length;
+        mp->spills += length;
+    }
+
+    mp->filled += size;
+    mp->credit += credit;
+    ++(mp->deposits);
+    if (total(rp) > mp->peak) {
+        mp->peak = total(rp);
+    }
+    if (total(rp) >= mp->high) {
+        rp->stopped = !0;
+        ++(mp->cycles);
+    }
+
+    pthread_cond_broadcast(&(rp->data));
+    pthread_mutex_unlock(&(rp->mutex));
+
+    return 0;
+}
+
+size_t reservoir_withdraw(struct reservoir * rp, void * buffer, size_t size, int timeout, double * creditp)
+{
+    struct reservoir_metrics * mp = &(rp->metrics);
+    uint8_t * here = (uint8_t *)buffer;
+    struct timespec deadline = { 0 };
+    size_t requested = size;
+    size_t length = 0;
+    size_t offset = 0;
+    size_t first = 0;
+    double credit = 0.0;
+
+    pthread_mutex_lock(&(rp->mutex));
+
+    if ((timeout != 0) && (total(rp) == 0) && (!rp->closed)) {
+        if (timeout > 0) { expire(&deadline, timeout); }
+        while ((total(rp) == 0) && (!rp->closed)) {
+            if (timeout < 0) {
+                pthread_cond_wait(&(rp->data), &(rp->mutex));
+            } else if (pthread_cond_timedwait(&(rp->data), &(rp->mutex), &deadline) != 0) {
+                break;
+            }
+        }
+    }
+
+    if (size > total(rp)) { size = total(rp); }
+
+    if (size > 0) {
+
+        /*
+         * Drain memory first, then the spill file.
+         */
+
+        length = mp->level;
+        if (length > size) { length = size; }
+        if (length > 0) {
+            offset = mp->capacity - rp->first;
+            if (offset > length) { offset = length; }
+            memcpy(here, rp->memory + rp->first, offset);
+            memcpy(here + offset, rp->memory, length - offset);
+            memset(rp->memory + rp->first, 0, offset);
+            memset(rp->memory, 0, length - offset);
+            rp->first = (rp->first + length) % mp->capacity;
+            mp->level -= length;
+            here += length;
+        }
+
+        length = size - length;
+        if (length > 0) {
+            first = rp->spillout % mp->spillsize;
+            offset = mp->spillsize - first;
+            if (offset > length) { offset = length; }
+            cipher(rp, here, rp->spill + first, offset, rp->spillout);
+            cipher(rp, here + offset, rp->spill, length - offset, rp->spillout + offset);
+            rp->spillout += length;
+            mp->spilled -= length;
+            mp->restores += length;
+        }
+
+        credit = mp->credit * size / (total(rp) + size);
+        mp->credit = (total(rp) > 0) ? (mp->credit - credit) : 0.0;
+        mp->drained += size;
+        ++(mp->withdrawals);
+
+        if (rp->stopped && (total(rp) <= mp->low)) {
+            rp->stopped = 0;
+        }
+        if (!rp->stopped) {
+            pthread_cond_broadcast(&(rp->space));
+        }
+
+    }
+
+    if (size < requested) {
+        ++(mp->shortfalls);
+    }
+
+    pthread_mutex_unlock(&(rp->mutex));
+
+    if (creditp != (double *)0) {
+        *creditp = credit;
+    }
+
+    return size;
+}
+
+size_t reservoir_level(struct reservoir * rp)
+{
+    size_t size = 0;
+
+    pthread_mutex_lock(&(rp->mutex));
+    size = total(rp);
+    pthread_mutex_unlock(&(rp->mutex));
+
+    return size;
+}
+
+void reservoir_snapshot(struct reservoir * rp, struct reservoir_metrics * mp)
+{
+    pthread_mutex_lock(&(rp->mutex));
+    memcpy(mp, &(rp->metrics), sizeof(*mp));
+    pthread_mutex_unlock(&(rp->mutex));
+}
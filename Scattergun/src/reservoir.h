@@ -0,0 +1,151 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+#ifndef _H_COM_DIAG_SCATTERGUN_RESERVOIR_
+#define _H_COM_DIAG_SCATTERGUN_RESERVOIR_
+
+/**
+ * @file
+ * Reservoir<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * Implements a thread safe reservoir of entropy that absorbs the difference
+ * between the steady rate at which a device produces entropy and the bursty
+ * rate at which it is consumed. Data is kept in memory, and optionally in a
+ * spill file mapped into memory when the memory is full. The spill file is
+ * encrypted with ChaCha20 using a key that exists only in the memory of the
+ * process, and is removed from the file system as soon as it is mapped, so
+ * that the entropy in it is never visible to anyone else and never outlives
+ * the process. Producers stop depositing when the level of the reservoir
+ * reaches its high watermark, and do not resume until it falls to its low
+ * watermark, so that a device is read in long runs while the reservoir fills
+ * during idle periods, and is left alone while the reservoir drains at
+ * memory speed during bursts. The reservoir also keeps track of the number
+ * of bits of entropy credited to the data in it. This is part of the
+ * Scattergun project.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/**
+ * These are the metrics of a reservoir. The counts of bytes deposited and
+ * withdrawn over an interval give the fill and drain rates.
+ */
+struct reservoir_metrics {
+    size_t capacity;    /* Bytes of memory. */
+    size_t spillsize;   /* Bytes of spill file. */
+    size_t low;         /* Level at which deposits resume. */
+    size_t high;        /* Level at which deposits stop. */
+    size_t level;       /* Bytes in memory. */
+    size_t spilled;     /* Bytes in the spill file. */
+    size_t peak;        /* Highest total level. */
+    size_t deposits;    /* Calls that deposited data. */
+    size_t withdrawals; /* Calls that withdrew data. */
+    size_t filled;      /* Bytes deposited. */
+    size_t drained;     /* Bytes withdrawn. */
+    size_t spills;      /* Bytes written to the spill file. */
+    size_t restores;    /* Bytes read from the spill file. */
+    size_t stalls;      /* Times a deposit had to wait. */
+    size_t shortfalls;  /* Withdrawals that got less than they asked for. */
+    size_t cycles;      /* Times the high watermark was reached. */
+    double credit;      /* Bits of entropy credited to the data held. */
+};
+
+/**
+ * This is the state of a reservoir.
+ */
+struct reservoir {
+    pthread_mutex_t mutex;
+    pthread_cond_t space;
+    pthread_cond_t data;
+    uint8_t * memory;
+    size_t first;
+    uint8_t * spill;
+    uint64_t spillin;
+    uint64_t spillout;
+    uint32_t key[8];
+    uint64_t nonce;
+    int stopped;
+    int closed;
+    struct reservoir_metrics metrics;
+};
+
+/**
+ * Create a reservoir.
+ * @param rp points to the reservoir.
+ * @param capacity is the number of bytes kept in memory.
+ * @param path is the path of a new spill file, or of a directory in which
+ * to create an unnamed one, or NULL for none. An existing file is an error.
+ * @param spillsize is the number of bytes kept in the spill file.
+ * @param low is the level at which deposits resume (0 for half of high).
+ * @param high is the level at which deposits stop (0 for the total size).
+ * @return 0 for success, <0 with errno set for failure.
+ */
+extern int reservoir_create(struct reservoir * rp, size_t capacity, const char * path, size_t spillsize, size_t low, size_t high);
+
+/**
+ * Wake up any thread waiting on the reservoir and make further deposits
+ * fail, so that the threads that use it can shut down.
+ * @param rp points to the reservoir.
+ */
+extern void reservoir_close(struct reservoir * rp);
+
+/**
+ * Destroy a reservoir, wiping the data in it. No thread may be using it.
+ * @param rp points to the reservoir.
+ */
+extern void reservoir_destroy(struct reservoir * rp);
+
+/**
+ * Deposit data into the reservoir, first into memory and then into the spill
+ * file, waiting while the reservoir is above its low watermark after having
+ * reached its high watermark (or after a deposit would have crossed it), or
+ * until there is room for all of the data.
+ * @param rp points to the reservoir.
+ * @param data points to the data.
+ * @param size is the size of the data in bytes.
+ * @param credit is the number of bits of entropy credited to the data.
+ * @param timeout is the most milliseconds to wait (<0 forever).
+ * @return 0 for success, <0 with errno set to EAGAIN if the wait timed out,
+ * ECANCELED if the reservoir was closed, or EINVAL if the data can never fit.
+ */
+extern int reservoir_deposit(struct reservoir * rp, const void * data, size_t size, double credit, int timeout);
+
+/**
+ * Withdraw up to the requested number of bytes from the reservoir, first from
+ * memory and then from the spill file. The withdrawn data is wiped from
+ * memory.
+ * @param rp points to the reservoir.
+ * @param buffer points to the buffer.
+ * @param size is the size of the buffer in bytes.
+ * @param timeout is the most milliseconds to wait if the reservoir is empty
+ * (0 never, <0 forever).
+ * @param creditp points to where the bits of entropy credited to the data
+ * withdrawn are stored, or is NULL.
+ * @return the number of bytes withdrawn.
+ */
+extern size_t reservoir_withdraw(struct reservoir * rp, void * buffer, size_t size, int timeout, double * creditp);
+
+/**
+ * Return the number of bytes in the reservoir.
+ * @param rp points to the reservoir.
+ * @return the number of bytes in memory and in the spill file.
+ */
+extern size_t reservoir_level(struct reservoir * rp);
+
+/**
+ * Copy the metrics of the reservoir.
+ * @param rp points to the reservoir.
+ * @param mp points to where the metrics are copied.
+ */
+extern void reservoir_snapshot(struct reservoir * rp, struct reservoir_metrics * mp);
+
+#endif
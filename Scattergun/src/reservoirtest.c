@@ -0,0 +1,286 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Reservoir Test<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * reservoirtest
+ *
+ * EXAMPLES
+ *
+ * make test
+ *
+ * ABSTRACT
+ *
+ * Checks the watermarks of the reservoir (see reservoir.h) with deposits
+ * whose size does and does not divide the high watermark, like the 2500 byte
+ * FIPS blocks that egd and the 512 byte outputs that feeder deposit into their
+ * default 1048576 byte reservoirs: that deposits stop once the next one would
+ * cross the high watermark, stay stopped while the level is above the low
+ * watermark, and resume at it; and that a deposit larger than the high
+ * watermark into an empty reservoir does not wait forever. Also checks the
+ * spill file: that one is made in a directory without a name, that a new
+ * PATH is removed as soon as it is made, that an existing file or symbolic
+ * link at PATH is refused and left alone, that what is in the spill file is
+ * not the plaintext, and that what is withdrawn is exactly what was
+ * deposited. The files are made in a new directory under TMPDIR (default
+ * /tmp). Each case is displayed as it passes or fails, and the exit status is
+ * the number of failures. This is part of the Scattergun project.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "reservoir.h"
+
+static const char * program = "reservoirtest";
+
+static int failures = 0;
+
+static void check(const char * name, size_t size, int condition, const char * what)
+{
+    printf("%s: %s size=%zu %s %s\n", program, name, size, what, condition ? "PASSED" : "FAILED");
+    if (!condition) {
+        ++failures;
+    }
+}
+
+/**
+ * Fill a reservoir to its high watermark with deposits of one size, drain it
+ * to its low watermark, and check that deposits stop and resume where they
+ * should.
+ * @param name names the case.
+ * @param capacity is the number of bytes of memory.
+ * @param low is the low watermark or 0.
+ * @param high is the high watermark or 0.
+ * @param size is the size of each deposit.
+ */
+static void watermarks(const char * name, size_t capacity, size_t low, size_t high, size_t size)
+{
+    struct reservoir reservoir;
+    struct reservoir_metrics metrics;
+    uint8_t * buffer = (uint8_t *)0;
+    size_t level = 0;
+    int rc = 0;
+
+    buffer = (uint8_t *)calloc(1, size);
+    if (buffer == (uint8_t *)0) {
+        perror("calloc");
+        ++failures;
+        return;
+    }
+
+    if (reservoir_create(&reservoir, capacity, (const char *)0, 0, low, high) < 0) {
+        perror("reservoir_create");
+        ++failures;
+        free(buffer);
+        return;
+    }
+
+    reservoir_snapshot(&reservoir, &metrics);
+    low = metrics.low;
+    high = metrics.high;
+
+    while ((rc = reservoir_deposit(&reservoir, buffer, size, 0.0, 0)) == 0) {
+        continue;
+    }
+
+    level = reservoir_level(&reservoir);
+    reservoir_snapshot(&reservoir, &metrics);
+    check(name, size, (rc < 0) && (errno == EAGAIN), "fill stops");
+    check(name, size, (level <= high) && ((level + size) > high), "fill reaches high");
+    check(name, size, metrics.cycles == 1, "fill cycles");
+
+    while (reservoir_level(&reservoir) > (low + size)) {
+        (void)reservoir_withdraw(&reservoir, buffer, size, 0, (double *)0);
+    }
+    if (reservoir_level(&reservoir) > low) {
+        (void)reservoir_withdraw(&reservoir, buffer, 1, 0, (double *)0);
+    }
+
+    level = reservoir_level(&reservoir);
+    rc = reservoir_deposit(&reservoir, buffer, size, 0.0, 0);
+    check(name, size, (level <= low) || ((rc < 0) && (errno == EAGAIN)), "above low stays stopped");
+
+    while (reservoir_level(&reservoir) > low) {
+        (void)reservoir_withdraw(&reservoir, buffer, size, 0, (double *)0);
+    }
+
+    rc = reservoir_deposit(&reservoir, buffer, size, 0.0, 0);
+    check(name, size, rc == 0, "at low resumes");
+
+    reservoir_destroy(&reservoir);
+    free(buffer);
+}
+
+/**
+ * Fill a reservoir with a spill file at PATH past its memory with a known
+ * pattern, check that the spill file holds ciphertext, and withdraw it all
+ * and check that it is the pattern.
+ * @param name names the case.
+ * @param path is the path of the spill file or of its directory.
+ */
+static void spill(const char * name, const char * path)
+{
+    static const size_t CAPACITY = 4096;
+    static const size_t SPILLSIZE = 65536;
+    static const size_t SIZE = 512;
+    static const size_t TOTAL = 16384;
+    struct reservoir reservoir;
+    struct reservoir_metrics metrics;
+    uint8_t * plaintext = (uint8_t *)0;
+    uint8_t * withdrawn = (uint8_t *)0;
+    size_t offset = 0;
+    size_t bytes = 0;
+    size_t same = 0;
+    size_t ii;
+
+    plaintext = (uint8_t *)malloc(TOTAL);
+    withdrawn = (uint8_t *)calloc(1, TOTAL);
+    if ((plaintext == (uint8_t *)0) || (withdrawn == (uint8_t *)0)) {
+        perror("malloc");
+        ++failures;
+        free(plaintext);
+        free(withdrawn);
+        return;
+    }
+    for (ii = 0; ii < TOTAL; ++ii) {
+        plaintext[ii] = ii;
+    }
+
+    if (reservoir_create(&reservoir, CAPACITY, path, SPILLSIZE, 0, 0) < 0) {
+        perror(path);
+        check(name, SIZE, 0, "create");
+        free(plaintext);
+        free(withdrawn);
+        return;
+    }
+
+    for (offset = 0; offset < TOTAL; offset += SIZE) {
+        if (reservoir_deposit(&reservoir, plaintext + offset, SIZE, 0.0, 0) < 0) {
+            break;
+        }
+    }
+    reservoir_snapshot(&reservoir, &metrics);
+    check(name, SIZE, (offset == TOTAL) && (metrics.spilled == (TOTAL - CAPACITY)), "spills");
+
+    for (ii = 0; ii < metrics.spilled; ++ii) {
+        if (reservoir.spill[ii] == plaintext[CAPACITY + ii]) { ++same; }
+    }
+    check(name, SIZE, same < (metrics.spilled / 64), "ciphertext");
+
+    for (offset = 0; offset < TOTAL; offset += bytes) {
+        bytes = reservoir_withdraw(&reservoir, withdrawn + offset, TOTAL - offset, 0, (double *)0);
+        if (bytes == 0) {
+            break;
+        }
+    }
+    check(name, SIZE, (offset == TOTAL) && (memcmp(withdrawn, plaintext, TOTAL) == 0), "round trip");
+
+    reservoir_destroy(&reservoir);
+    free(plaintext);
+    free(withdrawn);
+}
+
+/**
+ * Check that a spill file is refused at PATH when something is already there
+ * and that what is there is left alone.
+ * @param name names the case.
+ * @param path is the path at which something already exists.
+ * @param victim is the path of the file that must be left alone.
+ */
+static void refuse(const char * name, const char * path, const char * victim)
+{
+    static const char CONTENT[] = "victim\n";
+    struct reservoir reservoir;
+    char buffer[sizeof(CONTENT)] = { 0 };
+    int rc = 0;
+    int fd = -1;
+
+    rc = reservoir_create(&reservoir, 4096, path, 65536, 0, 0);
+    check(name, 0, (rc < 0) && (errno == EEXIST), "refused");
+    if (rc == 0) {
+        reservoir_destroy(&reservoir);
+    }
+
+    fd = open(victim, O_RDONLY);
+    check(name, 0, (fd >= 0) && (read(fd, buffer, sizeof(buffer)) == (sizeof(CONTENT) - 1)) && (strcmp(buffer, CONTENT) == 0), "left alone");
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    struct reservoir reservoir;
+    uint8_t buffer[2000] = { 0 };
+    const char * tmpdir = (const char *)0;
+    char directory[256];
+    char file[sizeof(directory) + 16];
+    char link[sizeof(directory) + 16];
+    FILE * fp = (FILE *)0;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    watermarks("egd", 1048576, 0, 0, 2500);
+    watermarks("feeder", 1048576, 0, 0, 512);
+    watermarks("watermarks", 65536, 10000, 50000, 3000);
+    watermarks("watermarks", 65536, 10000, 50000, 5000);
+
+    if (reservoir_create(&reservoir, 4096, (const char *)0, 0, 500, 1000) < 0) {
+        perror("reservoir_create");
+        ++failures;
+    } else {
+        check("oversize", sizeof(buffer), reservoir_deposit(&reservoir, buffer, sizeof(buffer), 0.0, 0) == 0, "into empty does not wait");
+        reservoir_destroy(&reservoir);
+    }
+
+    if ((tmpdir = getenv("TMPDIR")) == (const char *)0) {
+        tmpdir = "/tmp";
+    }
+    snprintf(directory, sizeof(directory), "%s/%s.XXXXXX", tmpdir, program);
+    if (mkdtemp(directory) == (char *)0) {
+        perror(directory);
+        ++failures;
+    } else {
+        snprintf(file, sizeof(file), "%s/spill", directory);
+        snprintf(link, sizeof(link), "%s/link", directory);
+        spill("directory", directory);
+        spill("path", file);
+        check("path", 0, (access(file, F_OK) < 0) && (errno == ENOENT), "removed");
+        if ((fp = fopen(file, "w")) == (FILE *)0) {
+            perror(file);
+            ++failures;
+        } else {
+            fputs("victim\n", fp);
+            fclose(fp);
+            refuse("existing", file, file);
+            if (symlink(file, link) < 0) {
+                perror(link);
+                ++failures;
+            } else {
+                refuse("symlink", link, file);
+                unlink(link);
+            }
+            unlink(file);
+        }
+        check("directory", 0, rmdir(directory) == 0, "empty");
+    }
+
+    printf("%s: failures=%d\n", program, failures);
+
+    return failures;
+}
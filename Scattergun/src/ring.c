@@ -0,0 +1,518 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Ring<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "ring.h"
+
+#define LOAD(_P_) __atomic_load_n((_P_), __ATOMIC_ACQUIRE)
+#define STORE(_P_, _V_) __atomic_store_n((_P_), (_V_), __ATOMIC_RELEASE)
+#define INCREMENT(_P_) __atomic_fetch_add((_P_), 1, __ATOMIC_ACQ_REL)
+#define DECREMENT(_P_) __atomic_fetch_sub((_P_), 1, __ATOMIC_ACQ_REL)
+#define ADD(_P_, _V_) __atomic_fetch_add((_P_), (_V_), __ATOMIC_RELAXED)
+
+/**
+ * Tell the processor we are spinning.
+ */
+static inline void relax(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#else
+    __asm__ __volatile__ ("" ::: "memory");
+#endif
+}
+
+/**
+ * Return a pointer to the slot at a position.
+ * @param rp points to the handle.
+ * @param position is the position.
+ * @return a pointer to the slot.
+ */
+static inline struct ring_slot * slotof(const struct ring * rp, uint64_t position)
+{
+    return (struct ring_slot *)(rp->base + sizeof(struct ring_header) + ((position & (rp->header->slots - 1)) * rp->header->stride));
+}
+
+/**
+ * Wait for the sequence number of a slot to reach a value, first by
+ * spinning and then by sleeping, counting the wait if there was one.
+ * @param sequencep points to the sequence number.
+ * @param value is the value to wait for.
+ * @param counterp points to the counter of waits.
+ * @param timeout is the most milliseconds to wait (<0 forever).
+ * @param cancelp points to a flag that ends the wait when set, or is NULL.
+ * @return 0 if the sequence number reached the value, <0 with errno set to
+ * EAGAIN if the wait timed out or EINTR if it was cancelled.
+ */
+static int await(uint64_t * sequencep, uint64_t value, uint64_t * counterp, int timeout, const volatile sig_atomic_t * cancelp)
+{
+    static const struct timespec NAP = { 0, 100000 };
+    struct timespec start = { 0 };
+    struct timespec now = { 0 };
+    long elapsed = 0;
+    int ii;
+
+    for (ii = 0; ii < RING_SPIN; ++ii) {
+        if (LOAD(sequencep) == value) {
+            return 0;
+        }
+        relax();
+    }
+
+    ADD(counterp, 1);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    while (LOAD(sequencep) != value) {
+        if ((cancelp != (const volatile sig_atomic_t *)0) && (*cancelp)) {
+            errno = EINTR;
+            return -1;
+        }
+        if (timeout >= 0) {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            elapsed = ((now.tv_sec - start.tv_sec) * 1000) + ((now.tv_nsec - start.tv_nsec) / 1000000);
+            if (elapsed >= timeout) {
+                errno = EAGAIN;
+                return -1;
+            }
+        }
+        /*
+         * A signal cuts the nap short, and the flag it set is checked
+         * before the next one.
+         */
+        nanosleep(&NAP, (struct timespec *)0);
+    }
+
+    return 0;
+}
+
+/**
+ * Map a shared memory object.
+ * @param rp points to the handle.
+ * @param fd is the open shared memory object.
+ * @param length is the size of the mapping.
+ * @return 0 for success, <0 for failure.
+ */
+static int map(struct ring * rp, int fd, size_t length)
+{
+    void * base = (void *)0;
+
+    base = mmap((void *)0, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        return -1;
+    }
+
+    rp->base = (uint8_t *)base;
+    rp->header = (struct ring_header *)base;
+    rp->length = length;
+
+    return 0;
+}
+
+int ring_create(struct ring * rp, const char * name, size_t slots, size_t slotsize, mode_t mode)
+{
+    struct ring_header * hp = (struct ring_header *)0;
+    struct ring_slot * sp = (struct ring_slot *)0;
+    size_t stride = 0;
+    size_t length = 0;
+    int fd = -1;
+    int error = 0;
+    uint64_t ii;
+
+    memset(rp, 0, sizeof(*rp));
+
+    if ((slots == 0) || ((slots & (slots - 1)) != 0) || (slotsize == 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    stride = (sizeof(struct ring_slot) + slotsize + 63) & ~(size_t)63;
+    length = sizeof(struct ring_header) + (slots * stride);
+
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, mode);
+    if ((fd < 0) && (errno == EEXIST)) {
+        if (ring_attach(rp, name) < 0) {
+            return -1;
+        }
+        if ((rp->header->slots != slots) || (rp->header->slotsize != slotsize)) {
+            ring_detach(rp);
+            errno = EEXIST;
+            return -1;
+        }
+        return 0;
+    }
+    if (fd < 0) {
+        return -1;
+    }
+
+    /*
+     * The object is created with the permissions modified by the umask, but
+     * producers and consumers may be run by different users in one group.
+     */
+
+    (void)fchmod(fd, mode);
+
+    if (ftruncate(fd, length) < 0) {
+        error = errno;
+        close(fd);
+        shm_unlink(name);
+        errno = error;
+        return -1;
+    }
+
+    if (map(rp, fd, length) < 0) {
+        error = errno;
+        close(fd);
+        shm_unlink(name);
+        errno = error;
+        return -1;
+    }
+
+    close(fd);
+
+    hp = rp->header;
+    hp->version = RING_VERSION;
+    hp->slots = slots;
+    hp->slotsize = slotsize;
+    hp->stride = stride;
+    hp->created = time((time_t *)0);
+    for (ii = 0; ii < slots; ++ii) {
+        sp = slotof(rp, ii);
+        sp->sequence = ii;
+        sp->size = 0;
+    }
+    STORE(&(hp->magic), RING_MAGIC);
+
+    return 0;
+}
+
+int ring_attach(struct ring * rp, const char * name)
+{
+    struct stat status = { 0 };
+    struct ring_header * hp = (struct ring_header *)0;
+    int fd = -1;
+    int error = 0;
+    int ii;
+
+    memset(rp, 0, sizeof(*rp));
+
+    fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    /*
+     * The creator may not have sized or initialized the object yet.
+     */
+
+    for (ii = 0; ii < 1000; ++ii) {
+        if (fstat(fd, &status) < 0) {
+            error = errno;
+            close(fd);
+            errno = error;
+            return -1;
+        }
+        if (status.st_size >= sizeof(struct ring_header)) {
+            break;
+        }
+        usleep(1000);
+    }
+    if (status.st_size < sizeof(struct ring_header)) {
+        close(fd);
+        errno = EAGAIN;
+        return -1;
+    }
+
+    if (map(rp, fd, status.st_size) < 0) {
+        error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+
+    close(fd);
+
+    hp = rp->header;
+    for (ii = 0; ii < 1000; ++ii) {
+        if (LOAD(&(hp->magic)) == RING_MAGIC) {
+            break;
+        }
+        usleep(1000);
+    }
+    if ((LOAD(&(hp->magic)) != RING_MAGIC) || (hp->version != RING_VERSION) || (rp->length < (sizeof(struct ring_header) + (hp->slots * hp->stride)))) {
+        munmap(rp->base, rp->length);
+        memset(rp, 0, sizeof(*rp));
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+void ring_detach(struct ring * rp)
+{
+    struct ring_slot * sp = (struct ring_slot *)0;
+    uint64_t expected = 0;
+    size_t size = 0;
+
+    if (rp->header == (struct ring_header *)0) {
+        return;
+    }
+
+    /*
+     * A position that has been reserved but not yet filled is published
+     * empty, and one that has been claimed is released, so that neither
+     * leaves a hole in the ring. A pending reservation or claim that is
+     * still the latest one is instead taken back, as if it had never been
+     * made, so that a process told to stop while the ring is full or empty
+     * need not wait for it. Any other must be waited for, however the
+     * process was told to stop.
+     */
+
+    rp->cancel = (const volatile sig_atomic_t *)0;
+
+    expected = rp->reservation + 1;
+    if (!rp->reserving) {
+        /* Do nothing. */
+    } else if (__atomic_compare_exchange_n(&(rp->header->produced), &expected, rp->reservation, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        rp->reserving = 0;
+    } else {
+        /* Do nothing. */
+    }
+
+    expected = rp->claim + 1;
+    if ((!rp->claiming) || rp->holding) {
+        /* Do nothing. */
+    } else if (__atomic_compare_exchange_n(&(rp->header->claimed), &expected, rp->claim, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        rp->claiming = 0;
+    } else {
+        /* Do nothing. */
+    }
+
+    if (rp->reserving) {
+        sp = slotof(rp, rp->reservation);
+        if (await(&(sp->sequence), rp->reservation, &(rp->header->full), 1000, rp->cancel) == 0) {
+            rp->reserving = 0;
+            rp->slot = (uint8_t *)(sp + 1);
+            rp->used = 0;
+        }
+    }
+
+    ring_flush(rp);
+
+    if (rp->claiming) {
+        (void)ring_claim(rp, &size, 1000);
+        ring_release(rp);
+    }
+
+    if (rp->producer) {
+        DECREMENT(&(rp->header->producers));
+    }
+    if (rp->consumer) {
+        DECREMENT(&(rp->header->consumers));
+    }
+
+    munmap(rp->base, rp->length);
+    memset(rp, 0, sizeof(*rp));
+}
+
+void ring_cancel(struct ring * rp, const volatile sig_atomic_t * cancelp)
+{
+    rp->cancel = cancelp;
+}
+
+int ring_unlink(const char * name)
+{
+    return shm_unlink(name);
+}
+
+size_t ring_publish(struct ring * rp, const void * data, size_t size, int timeout)
+{
+    const uint8_t * here = (const uint8_t *)data;
+    uint8_t * there = (uint8_t *)0;
+    size_t length = 0;
+    size_t total = 0;
+
+    while (total < size) {
+        there = (uint8_t *)ring_reserve(rp, &length, timeout);
+        if (there == (uint8_t *)0) {
+            break;
+        }
+        if (length > (size - total)) { length = size - total; }
+        memcpy(there, here, length);
+        ring_commit(rp, length);
+        here += length;
+        total += length;
+    }
+
+    return total;
+}
+
+void * ring_reserve(struct ring * rp, size_t * sizep, int timeout)
+{
+    struct ring_header * hp = rp->header;
+    struct ring_slot * sp = (struct ring_slot *)0;
+
+    if (!rp->producer) {
+        INCREMENT(&(hp->producers));
+        rp->producer = !0;
+    }
+
+    if (rp->slot == (uint8_t *)0) {
+        if (!rp->reserving) {
+            rp->reservation = INCREMENT(&(hp->produced));
+            rp->reserving = !0;
+        }
+        sp = slotof(rp, rp->reservation);
+        if (await(&(sp->sequence), rp->reservation, &(hp->full), timeout, rp->cancel) < 0) {
+            return (void *)0;
+        }
+        rp->reserving = 0;
+        rp->slot = (uint8_t *)(sp + 1);
+        rp->used = 0;
+    }
+
+    *sizep = hp->slotsize - rp->used;
+
+    return (void *)(rp->slot + rp->used);
+}
+
+void ring_commit(struct ring * rp, size_t size)
+{
+    if (rp->slot == (uint8_t *)0) {
+        return;
+    }
+
+    rp->used += size;
+    if (rp->used >= rp->header->slotsize) {
+        ring_flush(rp);
+    }
+}
+
+void ring_flush(struct ring * rp)
+{
+    struct ring_header * hp = rp->header;
+    struct ring_slot * sp = (struct ring_slot *)0;
+
+    if (rp->slot == (uint8_t *)0) {
+        return;
+    }
+
+    sp = slotof(rp, rp->reservation);
+    sp->size = rp->used;
+    ADD(&(hp->bytes), rp->used);
+    ADD(&(hp->published), 1);
+    STORE(&(sp->sequence), rp->reservation + 1);
+
+    rp->slot = (uint8_t *)0;
+    rp->used = 0;
+}
+
+const void * ring_claim(struct ring * rp, size_t * sizep, int timeout)
+{
+    struct ring_header * hp = rp->header;
+    struct ring_slot * sp = (struct ring_slot *)0;
+
+    if (!rp->consumer) {
+        INCREMENT(&(hp->consumers));
+        rp->consumer = !0;
+    }
+
+    if (rp->holding) {
+        errno = EBUSY;
+        return (const void *)0;
+    }
+
+    if (!rp->claiming) {
+        rp->claim = INCREMENT(&(hp->claimed));
+        rp->claiming = !0;
+    }
+
+    sp = slotof(rp, rp->claim);
+    if (await(&(sp->sequence), rp->claim + 1, &(hp->empty), timeout, rp->cancel) < 0) {
+        return (const void *)0;
+    }
+
+    rp->holding = !0;
+    *sizep = sp->size;
+
+    return (const void *)(sp + 1);
+}
+
+const void * ring_tryclaim(struct ring * rp, size_t * sizep)
+{
+    struct ring_header * hp = rp->header;
+    struct ring_slot * sp = (struct ring_slot *)0;
+    uint64_t position = 0;
+    uint64_t sequence = 0;
+
+    if (!rp->consumer) {
+        INCREMENT(&(hp->consumers));
+        rp->consumer = !0;
+    }
+
+    if (rp->holding) {
+        errno = EBUSY;
+        return (const void *)0;
+    }
+
+    if (rp->claiming) {
+        return ring_claim(rp, sizep, 0);
+    }
+
+    position = LOAD(&(hp->claimed));
+    while (!0) {
+        sp = slotof(rp, position);
+        sequence = LOAD(&(sp->sequence));
+        if (sequence == (position + 1)) {
+            if (__atomic_compare_exchange_n(&(hp->claimed), &position, position + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                break;
+            }
+        } else if (sequence < (position + 1)) {
+            errno = EAGAIN;
+            return (const void *)0;
+        } else {
+            position = LOAD(&(hp->claimed));
+        }
+    }
+
+    rp->claim = position;
+    rp->claiming = !0;
+    rp->holding = !0;
+    *sizep = sp->size;
+
+    return (const void *)(sp + 1);
+}
+
+void ring_release(struct ring * rp)
+{
+    struct ring_header * hp = rp->header;
+    struct ring_slot * sp = (struct ring_slot *)0;
+
+    if (!rp->holding) {
+        return;
+    }
+
+    sp = slotof(rp, rp->claim);
+    ADD(&(hp->released), 1);
+    STORE(&(sp->sequence), rp->claim + hp->slots);
+
+    rp->claiming = 0;
+    rp->holding = 0;
+}
@@ -0,0 +1,247 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+#ifndef _H_COM_DIAG_SCATTERGUN_RING_
+#define _H_COM_DIAG_SCATTERGUN_RING_
+
+/**
+ * @file
+ * Ring<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * Implements a ring of fixed size slots in POSIX shared memory through which
+ * one or more producers (like seventool and quantistool) hand entropy to one
+ * or more consumers in other processes without copying it and without system
+ * calls in the common case. Each slot carries a sequence number, in the manner
+ * of Dmitry Vyukov's bounded multi-producer multi-consumer queue. A producer
+ * claims the next position by atomically incrementing the produced counter,
+ * waits for the slot at that position to be released, fills it, and publishes
+ * it by advancing its sequence number. A consumer claims the next position by
+ * atomically incrementing the claimed counter, waits for the slot at that
+ * position to be published, uses its data in place, and releases it. Because
+ * every position is claimed by exactly one consumer, and a slot cannot be
+ * refilled until its consumer releases it, no data is ever handed out twice.
+ * A claim that times out remains pending and is completed by the next call,
+ * so that a slow producer never leaves a hole in the ring. Counters in the
+ * shared header record how often producers found the ring full and consumers
+ * found it empty. This is part of the Scattergun project.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <signal.h>
+#include <sys/types.h>
+
+/**
+ * This is the magic number that marks an initialized ring ("RING").
+ */
+#define RING_MAGIC 0x52494e47U
+
+/**
+ * This is the version of the layout of the shared memory.
+ */
+#define RING_VERSION 1U
+
+/**
+ * This is the default number of slots in a ring.
+ */
+#define RING_SLOTS 1024
+
+/**
+ * This is the default number of bytes of data in a slot.
+ */
+#define RING_SLOTSIZE 4096
+
+/**
+ * These are the default permissions of a ring, which any producer or
+ * consumer in the group of its creator may use.
+ */
+#define RING_MODE 0660
+
+/**
+ * This is the number of times a waiter spins before it starts sleeping.
+ */
+#define RING_SPIN 1000
+
+/**
+ * This is the layout of the header at the start of the shared memory. The
+ * counters that are written by producers and by consumers are kept on
+ * separate cache lines.
+ */
+struct ring_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t slots;
+    uint64_t slotsize;
+    uint64_t stride;
+    uint64_t created;
+    uint8_t pad0[64 - 40];
+    uint64_t produced;      /* Positions claimed by producers. */
+    uint64_t published;     /* Slots published by producers. */
+    uint64_t bytes;         /* Bytes published by producers. */
+    uint64_t full;          /* Times a producer waited for a slot. */
+    uint64_t producers;     /* Producers attached. */
+    uint8_t pad1[64 - 40];
+    uint64_t claimed;       /* Positions claimed by consumers. */
+    uint64_t released;      /* Slots released by consumers. */
+    uint64_t empty;         /* Times a consumer waited for a slot. */
+    uint64_t consumers;     /* Consumers attached. */
+    uint8_t pad2[64 - 32];
+};
+
+/**
+ * This is the layout of the header at the start of each slot.
+ */
+struct ring_slot {
+    uint64_t sequence;
+    uint64_t size;
+};
+
+/**
+ * This is a process's handle to a ring. A handle has at most one slot
+ * reserved for producing and at most one slot claimed for consuming at a
+ * time; a consumer that wants several slices at once attaches several
+ * handles.
+ */
+struct ring {
+    struct ring_header * header;
+    uint8_t * base;
+    size_t length;
+    int producer;
+    int consumer;
+    int reserving;
+    uint64_t reservation;
+    uint8_t * slot;
+    size_t used;
+    int claiming;
+    int holding;
+    uint64_t claim;
+    const volatile sig_atomic_t * cancel;
+};
+
+/**
+ * Create a ring in POSIX shared memory, or attach to it if it already
+ * exists with the same geometry.
+ * @param rp points to the handle.
+ * @param name is the name of the shared memory object (e.g. "/seventool").
+ * @param slots is the number of slots, which must be a power of two.
+ * @param slotsize is the number of bytes of data in each slot.
+ * @param mode is the permissions of a new ring regardless of the umask
+ * (e.g. RING_MODE); an existing ring keeps its own.
+ * @return 0 for success, <0 with errno set for failure.
+ */
+extern int ring_create(struct ring * rp, const char * name, size_t slots, size_t slotsize, mode_t mode);
+
+/**
+ * Attach to an existing ring.
+ * @param rp points to the handle.
+ * @param name is the name of the shared memory object.
+ * @return 0 for success, <0 with errno set for failure.
+ */
+extern int ring_attach(struct ring * rp, const char * name);
+
+/**
+ * Make every wait on a ring give up as soon as a flag is set, like the one
+ * a signal handler sets to ask a daemon to stop, instead of waiting out its
+ * timeout. ring_create and ring_attach clear it.
+ * @param rp points to the handle.
+ * @param cancelp points to the flag, or is NULL for none.
+ */
+extern void ring_cancel(struct ring * rp, const volatile sig_atomic_t * cancelp);
+
+/**
+ * Detach from a ring. A partially filled or reserved slot is published
+ * first, and a pending or held claim is released (waiting briefly for its
+ * slot if need be), so that neither stalls the other processes. A pending
+ * reservation or claim that no other process has passed is simply taken
+ * back, without waiting; otherwise the wait ignores the cancel flag, since
+ * giving up would leave a hole in the ring. A consumer
+ * may therefore occasionally be handed an empty slot.
+ * @param rp points to the handle.
+ */
+extern void ring_detach(struct ring * rp);
+
+/**
+ * Remove a ring from the name space. Processes attached to it may continue
+ * to use it.
+ * @param name is the name of the shared memory object.
+ * @return 0 for success, <0 with errno set for failure.
+ */
+extern int ring_unlink(const char * name);
+
+/**
+ * Copy data into the ring, reserving slots as needed and publishing each
+ * one as it is filled.
+ * @param rp points to the handle.
+ * @param data points to the data.
+ * @param size is the size of the data in bytes.
+ * @param timeout is the most milliseconds to wait for a slot (<0 forever).
+ * @return the number of bytes copied, which is less than size only if the
+ * wait timed out (errno is EAGAIN) or was cancelled (errno is EINTR).
+ */
+extern size_t ring_publish(struct ring * rp, const void * data, size_t size, int timeout);
+
+/**
+ * Return the unused space in the slot being filled, reserving and waiting
+ * for the next slot if there is none, so that a producer can read entropy
+ * directly into shared memory instead of copying it there.
+ * @param rp points to the handle.
+ * @param sizep points to where the number of unused bytes is stored.
+ * @param timeout is the most milliseconds to wait for a slot (<0 forever).
+ * @return a pointer to the unused space, or NULL with errno set to EAGAIN if
+ * the wait timed out or EINTR if it was cancelled.
+ */
+extern void * ring_reserve(struct ring * rp, size_t * sizep, int timeout);
+
+/**
+ * Account for data a producer has placed in the space returned by
+ * ring_reserve, publishing the slot if it is now full.
+ * @param rp points to the handle.
+ * @param size is the number of bytes placed, no more than were returned.
+ */
+extern void ring_commit(struct ring * rp, size_t size);
+
+/**
+ * Publish a partially filled slot, if there is one.
+ * @param rp points to the handle.
+ */
+extern void ring_flush(struct ring * rp);
+
+/**
+ * Claim the next position in the ring and wait for the slot at that
+ * position to be published. If the wait times out the claim remains pending
+ * and the next call waits for the same slot. A slot that is already held
+ * must be released before another can be claimed.
+ * @param rp points to the handle.
+ * @param sizep points to where the size of the data in the slot is stored.
+ * @param timeout is the most milliseconds to wait (<0 forever).
+ * @return a pointer to the data in the slot, or NULL with errno set to
+ * EAGAIN if the wait timed out, EINTR if it was cancelled, or EBUSY if a
+ * slot is already held.
+ */
+extern const void * ring_claim(struct ring * rp, size_t * sizep, int timeout);
+
+/**
+ * Claim the next slot only if it has already been published. This never
+ * waits and never leaves a claim pending.
+ * @param rp points to the handle.
+ * @param sizep points to where the size of the data in the slot is stored.
+ * @return a pointer to the data in the slot, or NULL with errno set to
+ * EAGAIN if the ring is empty or EBUSY if a slot is already held.
+ */
+extern const void * ring_tryclaim(struct ring * rp, size_t * sizep);
+
+/**
+ * Release the claimed slot so that a producer may refill it. The data may
+ * not be used afterwards.
+ * @param rp points to the handle.
+ */
+extern void ring_release(struct ring * rp);
+
+#endif
@@ -0,0 +1,391 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Ring Tool<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * ringtool [ -h ] [ -v ] [ -c [ -s SLOTS ] [ -z BYTES ] [ -m MODE ] ] [ -r [ -t BYTES ] | -p SECONDS ] [ -u ] NAME
+ *
+ * OPTIONS
+ *
+ * -c              Create the ring if it does not exist.
+ * -h              Display this menu.
+ * -m MODE         Create the ring with the octal permissions MODE (default 0660).
+ * -p SECONDS      Display statistics every SECONDS until interrupted.
+ * -r              Consume from the ring and write to stdout.
+ * -s SLOTS        Create the ring with SLOTS slots (a power of two).
+ * -t BYTES        Consume no more than this total.
+ * -u              Remove the ring from the name space afterwards.
+ * -v              Display verbose output to stderr.
+ * -z BYTES        Create the ring with BYTES bytes per slot.
+ *
+ * EXAMPLES
+ *
+ * seventool -R -m /seventool &
+ * ringtool -r /seventool | rate
+ *
+ * ringtool -p 1 /seventool
+ *
+ * ringtool -u /seventool
+ *
+ * ABSTRACT
+ *
+ * Creates, reports on, consumes from, or removes a shared memory ring into
+ * which seventool or quantistool publish entropy. By default it displays the
+ * geometry of the ring and the counters in its header once. With -p it
+ * displays the rates at which slots are published and released and the
+ * number of times producers found the ring full and consumers found it
+ * empty during each period: if consumers keep finding the ring empty while
+ * it is not filling, the producers are not keeping up. With -r it claims
+ * slots, writes their contents to standard output, and releases them; any
+ * number of ringtool processes (or other consumers using ring.h) may do this
+ * at once, and each slot goes to exactly one of them. This is part of the
+ * Scattergun project.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include "ring.h"
+
+static const char * program = "ringtool";
+static volatile sig_atomic_t done = 0;
+
+static void handler(int signum)
+{
+    if (signum == SIGPIPE) {
+        done = !0;
+    } else if (signum == SIGINT) {
+        done = !0;
+    } else if (signum == SIGTERM) {
+        done = !0;
+    } else {
+        /* Do nothing. */
+    }
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [ -h ] [ -v ] [ -c [ -s SLOTS ] [ -z BYTES ] [ -m MODE ] ] [ -r [ -t BYTES ] | -p SECONDS ] [ -u ] NAME\n", program);
+    fprintf(stderr, "       -c              Create the ring if it does not exist.\n");
+    fprintf(stderr, "       -h              Display this menu.\n");
+    fprintf(stderr, "       -m MODE         Create the ring with the octal permissions MODE (default 0%o).\n", RING_MODE);
+    fprintf(stderr, "       -p SECONDS      Display statistics every SECONDS until interrupted.\n");
+    fprintf(stderr, "       -r              Consume from the ring and write to stdout.\n");
+    fprintf(stderr, "       -s SLOTS        Create the ring with SLOTS slots (a power of two).\n");
+    fprintf(stderr, "       -t BYTES        Consume no more than this total.\n");
+    fprintf(stderr, "       -u              Remove the ring from the name space afterwards.\n");
+    fprintf(stderr, "       -v              Display verbose output to stderr.\n");
+    fprintf(stderr, "       -z BYTES        Create the ring with BYTES bytes per slot.\n");
+}
+
+/**
+ * Display the geometry and the counters of a ring.
+ * @param hp points to the header of the ring.
+ */
+static void display(const struct ring_header * hp)
+{
+    uint64_t produced = __atomic_load_n(&(hp->produced), __ATOMIC_RELAXED);
+    uint64_t claimed = __atomic_load_n(&(hp->claimed), __ATOMIC_RELAXED);
+    uint64_t published = __atomic_load_n(&(hp->published), __ATOMIC_RELAXED);
+    uint64_t released = __atomic_load_n(&(hp->released), __ATOMIC_RELAXED);
+
+    printf("%s: slots        %llu\n", program, (unsigned long long)hp->slots);
+    printf("%s: slotsize     %llu\n", program, (unsigned long long)hp->slotsize);
+    printf("%s: created      %llu\n", program, (unsigned long long)hp->created);
+    printf("%s: producers    %llu\n", program, (unsigned long long)hp->producers);
+    printf("%s: consumers    %llu\n", program, (unsigned long long)hp->consumers);
+    printf("%s: produced     %llu\n", program, (unsigned long long)produced);
+    printf("%s: published    %llu\n", program, (unsigned long long)published);
+    printf("%s: bytes        %llu\n", program, (unsigned long long)hp->bytes);
+    printf("%s: claimed      %llu\n", program, (unsigned long long)claimed);
+    printf("%s: released     %llu\n", program, (unsigned long long)released);
+    printf("%s: filled       %llu\n", program, (unsigned long long)((published > released) ? (published - released) : 0));
+    printf("%s: pending      %llu\n", program, (unsigned long long)((claimed > published) ? (claimed - published) : 0));
+    printf("%s: full         %llu\n", program, (unsigned long long)hp->full);
+    printf("%s: empty        %llu\n", program, (unsigned long long)hp->empty);
+}
+
+/**
+ * Judge whether the producers kept up with the consumers during a period.
+ * @param bp points to a copy of the header at the start of the period.
+ * @param ap points to a copy of the header at the end of the period.
+ * @return "lagging" if consumers waited on an empty ring, "backlog" if
+ * producers waited on a full ring, "idle" if nothing moved, or "keeping"
+ * otherwise.
+ */
+static const char * verdict(const struct ring_header * bp, const struct ring_header * ap)
+{
+    if ((ap->empty > bp->empty) && (ap->published <= ap->released)) {
+        return "lagging";
+    } else if (ap->full > bp->full) {
+        return "backlog";
+    } else if ((ap->published == bp->published) && (ap->released == bp->released)) {
+        return "idle";
+    } else {
+        return "keeping";
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int verbose = 0;
+    int create = 0;
+    int consume = 0;
+    int remove = 0;
+    unsigned long period = 0;
+    size_t slots = RING_SLOTS;
+    size_t slotsize = RING_SLOTSIZE;
+    mode_t mode = RING_MODE;
+    size_t limit = ~(size_t)0;
+    size_t total = 0;
+    size_t size = 0;
+    ssize_t rc = 0;
+    size_t length = 0;
+    const uint8_t * data = (const uint8_t *)0;
+    const char * name = (const char *)0;
+    char * end = (char *)0;
+    struct ring ring = { 0 };
+    struct sigaction action = { 0 };
+    struct ring_header before = { 0 };
+    struct ring_header after = { 0 };
+    double published = 0.0;
+    double released = 0.0;
+    double bytes = 0.0;
+    int opt;
+    extern char * optarg;
+    extern int optind;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "chm:p:rs:t:uvz:")) >= 0) {
+
+        switch (opt) {
+
+        case 'c':
+            create = !0;
+            break;
+
+        case 'h':
+            usage();
+            return 0;
+
+        case 'm':
+            mode = strtoul(optarg, &end, 8);
+            if ((*end != '\0') || (mode > 0777)) {
+                error = !0;
+            }
+            break;
+
+        case 'p':
+            period = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (period == 0)) {
+                error = !0;
+            }
+            break;
+
+        case 'r':
+            consume = !0;
+            break;
+
+        case 's':
+            slots = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (slots == 0) || ((slots & (slots - 1)) != 0)) {
+                error = !0;
+            }
+            break;
+
+        case 't':
+            limit = strtoul(optarg, &end, 0);
+            if (*end != '\0') {
+                error = !0;
+            }
+            break;
+
+        case 'u':
+            remove = !0;
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        case 'z':
+            slotsize = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (slotsize == 0)) {
+                error = !0;
+            }
+            break;
+
+        default:
+            error = !0;
+            break;
+
+        }
+
+    }
+
+    if ((argc - optind) != 1) {
+        error = !0;
+    } else if (consume && (period > 0)) {
+        error = !0;
+    } else {
+        name = argv[optind];
+    }
+
+    if (error) {
+        usage();
+        return 1;
+    }
+
+    do {
+
+        action.sa_handler = handler;
+        action.sa_flags = 0;
+        if (sigaction(SIGPIPE, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+        if (sigaction(SIGINT, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+        if (sigaction(SIGTERM, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+
+        if (create) {
+            if (ring_create(&ring, name, slots, slotsize, mode) < 0) {
+                perror(name);
+                break;
+            }
+        } else if ((!consume) && (period == 0) && remove) {
+            /* Do nothing. */
+        } else if (ring_attach(&ring, name) < 0) {
+            perror(name);
+            break;
+        }
+        ring_cancel(&ring, &done);
+
+        if (verbose && (ring.header != (struct ring_header *)0)) {
+            fprintf(stderr, "%s: name         \"%s\"\n", program, name);
+            fprintf(stderr, "%s: slots        %llu\n", program, (unsigned long long)ring.header->slots);
+            fprintf(stderr, "%s: slotsize     %llu\n", program, (unsigned long long)ring.header->slotsize);
+            fprintf(stderr, "%s: length       %zu\n", program, ring.length);
+        }
+
+        if (consume) {
+
+            /*
+             * Each claimed slot is written straight from shared memory. A
+             * claim that times out stays pending, so we just try again.
+             */
+
+            while ((!done) && (total < limit)) {
+                data = (const uint8_t *)ring_claim(&ring, &size, 1000);
+                if (data != (const uint8_t *)0) {
+                    /* Do nothing. */
+                } else if ((errno == EAGAIN) || (errno == EINTR)) {
+                    continue;
+                } else {
+                    perror("ring_claim");
+                    break;
+                }
+                if (size > (limit - total)) { size = limit - total; }
+                length = 0;
+                while (length < size) {
+                    rc = write(STDOUT_FILENO, data + length, size - length);
+                    if (rc > 0) {
+                        length += rc;
+                    } else if ((rc < 0) && (errno == EINTR) && (!done)) {
+                        continue;
+                    } else {
+                        break;
+                    }
+                }
+                ring_release(&ring);
+                total += length;
+                if (length < size) {
+                    if (errno != EPIPE) { perror("write"); }
+                    break;
+                }
+            }
+
+            if (verbose) {
+                fprintf(stderr, "%s: total        %zu\n", program, total);
+            }
+
+        } else if (period > 0) {
+
+            /*
+             * Each line shows, for the last period, the slots published and
+             * released per second, the throughput, how many slots are filled
+             * and awaiting a consumer, and how often producers had to wait
+             * for a free slot (full) and consumers for a filled one (empty).
+             */
+
+            memcpy(&before, ring.header, sizeof(before));
+            printf("%s: %10s %10s %12s %8s %8s %10s %10s %s\n", program, "published", "released", "bytes", "filled", "pending", "full", "empty", "state");
+            fflush(stdout);
+            while (!done) {
+                sleep(period);
+                memcpy(&after, ring.header, sizeof(after));
+                published = (after.published - before.published) / (double)period;
+                released = (after.released - before.released) / (double)period;
+                bytes = (after.bytes - before.bytes) / (double)period;
+                printf("%s: %10.1f %10.1f %12.0f %8llu %8llu %10llu %10llu %s\n",
+                    program, published, released, bytes,
+                    (unsigned long long)((after.published > after.released) ? (after.published - after.released) : 0),
+                    (unsigned long long)((after.claimed > after.published) ? (after.claimed - after.published) : 0),
+                    (unsigned long long)(after.full - before.full),
+                    (unsigned long long)(after.empty - before.empty),
+                    verdict(&before, &after));
+                fflush(stdout);
+                memcpy(&before, &after, sizeof(before));
+            }
+
+        } else if (ring.header != (struct ring_header *)0) {
+
+            display(ring.header);
+
+        } else {
+
+            /* Do nothing. */
+
+        }
+
+        ring_detach(&ring);
+
+        if (!remove) {
+            /* Do nothing. */
+        } else if (ring_unlink(name) < 0) {
+            perror(name);
+            break;
+        } else if (verbose) {
+            fprintf(stderr, "%s: unlinked     \"%s\"\n", program, name);
+        }
+
+        xc = 0;
+
+    } while (0);
+
+    ring_detach(&ring);
+
+    return xc;
+}
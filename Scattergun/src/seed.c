@@ -12,33 +12,236 @@
  *
  * USAGE
  *
- * seed [ -i | -l ]
+ * seed [ -h ] [ -v ] [ -i | -l ] [ -b ] [ -n COUNT ] [ -s SOURCE ]
  *
  * OPTIONS
  *
- * -i              Generate an unsigned integer seed.
- * -l              Generate an unsigned long seed.
+ * -b              Write binary words instead of decimal lines.
+ * -h              Display this menu.
+ * -i              Generate unsigned integer seeds.
+ * -l              Generate unsigned long seeds (default).
+ * -n COUNT        Generate COUNT seeds (default 1).
+ * -s SOURCE       Derive seeds from rdseed, getrandom, clock, or the device at path SOURCE.
+ * -v              Display verbose output to stderr.
  *
  * EXAMPLES
  *
  * seed -l > LONG
  * seed -i > INTEGER
+ * seed -n 10000 | while read SEED; do baseline -s ${SEED} -t 1000000 > run-${SEED}.dat; done
+ * seed -b -n 1000000 -s /dev/hwrng > seeds.bin
  *
  * ABSTRACT
  *
- * Generates an unsigned long or an unsigned integer seed (one some platforms
- * this might be the same bit-size, on others not so much) and prints it to
- * standard output.
+ * Generates one or more unsigned long or unsigned integer seeds (on some
+ * platforms these might be the same bit-size, on others not so much) and
+ * prints them to standard output, one per line, or writes them as binary
+ * words in host byte order. Each seed is derived from its own sixty-four bits
+ * taken from the rdseed instruction (the default where the processor has it),
+ * from getrandom(2) (the default otherwise), from a device such as /dev/hwrng,
+ * or, as this used to do, from the raw monotonic clock, and mixed through the
+ * SplitMix64 finalizer so that even similar raw values, like successive clock
+ * readings, give unrelated seeds. The seeds in one batch are guaranteed to be
+ * distinct: each is checked against those already generated and is replaced
+ * by a fresh one if it is a duplicate, and if the source keeps producing
+ * duplicates it is deemed broken and this fails. Zero, which baseline takes
+ * to mean no seed, is never generated. A whole test farm can therefore be
+ * seeded with one call. This is part of the Scattergun project.
  */
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
+#include <errno.h>
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+enum {
+    WORDS = 4096,       /* Raw words fetched at a time. */
+    RETRIES = 64,       /* Consecutive duplicates before the source is deemed broken. */
+    ATTEMPTS = 1024,    /* Tries of the rdseed instruction before giving up. */
+};
+
+enum source {
+    RDSEED = 0,
+    GETRANDOM = 1,
+    CLOCK = 2,
+    DEVICE = 3,
+};
 
 static const char * program = "seed";
 
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [ -h ] [ -v ] [ -i | -l ] [ -b ] [ -n COUNT ] [ -s SOURCE ]\n", program);
+    fprintf(stderr, "       -b              Write binary words instead of decimal lines.\n");
+    fprintf(stderr, "       -h              Display this menu.\n");
+    fprintf(stderr, "       -i              Generate unsigned integer seeds.\n");
+    fprintf(stderr, "       -l              Generate unsigned long seeds (default).\n");
+    fprintf(stderr, "       -n COUNT        Generate COUNT seeds (default 1).\n");
+    fprintf(stderr, "       -s SOURCE       Derive seeds from rdseed, getrandom, clock, or the device at path SOURCE.\n");
+    fprintf(stderr, "       -v              Display verbose output to stderr.\n");
+}
+
+/**
+ * Use the cpuid instruction to determine whether the processor implements
+ * the rdseed instruction.
+ * @return !0 if it does, 0 otherwise.
+ */
+static int hasrdseed(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+    uint32_t d;
+
+    asm volatile ("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d) : "a" (0), "c" (0));
+    if (a < 7) {
+        return 0;
+    }
+    asm volatile ("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d) : "a" (7), "c" (0));
+
+    return ((b & 0x00040000) != 0);
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Run the rdseed instruction until it succeeds or has been tried too many
+ * times, since it fails whenever its conditioner has not caught up.
+ * @param wp points to the result word.
+ * @return !0 for success, 0 for failure.
+ */
+static int rdseed(uint32_t * wp)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    uint8_t carry = 0;
+    int ii;
+
+    for (ii = 0; ii < ATTEMPTS; ++ii) {
+        asm volatile (".byte 0x0f,0xc7,0xf8; setc %0" : "=qm" (carry), "=a" (*wp));
+        if (carry) {
+            return !0;
+        }
+        asm volatile ("pause");
+    }
+#endif
+
+    return 0;
+}
+
+/**
+ * Fetch raw words from the source.
+ * @param source is the source.
+ * @param fd is the open device if the source is a device.
+ * @param words points to the buffer.
+ * @param count is the number of words.
+ * @return 0 for success, <0 with errno set for failure.
+ */
+static int fetch(enum source source, int fd, uint64_t * words, size_t count)
+{
+    uint8_t * here = (uint8_t *)words;
+    size_t size = count * sizeof(uint64_t);
+    struct timespec spec = { 0 };
+    uint32_t high = 0;
+    uint32_t low = 0;
+    ssize_t rc = 0;
+    size_t ii;
+
+    switch (source) {
+
+    case RDSEED:
+        for (ii = 0; ii < count; ++ii) {
+            if (!rdseed(&high) || !rdseed(&low)) {
+                errno = EIO;
+                return -1;
+            }
+            words[ii] = ((uint64_t)high << 32) | low;
+        }
+        break;
+
+    case CLOCK:
+        for (ii = 0; ii < count; ++ii) {
+            if (clock_gettime(CLOCK_MONOTONIC_RAW, &spec) < 0) {
+                return -1;
+            }
+            words[ii] = spec.tv_sec;
+            words[ii] *= 1000000000;
+            words[ii] += spec.tv_nsec;
+        }
+        break;
+
+    case GETRANDOM:
+    case DEVICE:
+        while (size > 0) {
+#if defined(SYS_getrandom)
+            if (source == GETRANDOM) {
+                rc = syscall(SYS_getrandom, here, size, 0);
+            } else {
+                rc = read(fd, here, size);
+            }
+#else
+            rc = read(fd, here, size);
+#endif
+            if (rc > 0) {
+                here += rc;
+                size -= rc;
+            } else if ((rc < 0) && (errno == EINTR)) {
+                /* Do nothing. */
+            } else {
+                if (rc == 0) { errno = EIO; }
+                return -1;
+            }
+        }
+        break;
+
+    }
+
+    return 0;
+}
+
+/**
+ * Mix a raw word through the SplitMix64 finalizer, which is a bijection, so
+ * distinct raw words always give distinct results.
+ * @param z is the raw word.
+ * @return the mixed word.
+ */
+static uint64_t mix(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+    return z ^ (z >> 31);
+}
+
+/**
+ * Insert a seed into the open addressed table of the seeds already
+ * generated, in which zero marks an empty slot.
+ * @param table points to the table.
+ * @param mask is the size of the table, a power of two, less one.
+ * @param seed is the seed, which must not be zero.
+ * @return !0 if the seed was inserted, 0 if it was already there.
+ */
+static int insert(uint64_t * table, size_t mask, uint64_t seed)
+{
+    size_t ii = mix(seed) & mask;
+
+    while (table[ii] != 0) {
+        if (table[ii] == seed) {
+            return 0;
+        }
+        ii = (ii + 1) & mask;
+    }
+    table[ii] = seed;
+
+    return !0;
+}
+
 /**
  * This is the main program.
  * @param argc is the count of command line arguments.
@@ -46,20 +249,54 @@ static const char * program = "seed";
  */
 int main(int argc, char * argv[])
 {
+    int xc = 1;
+    int error = 0;
+    int verbose = 0;
     int dolong = !0;
-    int rc;
-    uint64_t ticks = ~0;
-    struct timespec spec = { 0 };
+    int binary = 0;
+    int retries = 0;
+    enum source source = RDSEED;
+    const char * path = (const char *)0;
+    int fd = -1;
+    unsigned long long count = 1;
+    unsigned long long generated = 0;
+    unsigned long long duplicates = 0;
+    size_t width = sizeof(unsigned long);
+    uint64_t limit = ~(uint64_t)0;
+    uint64_t * raw = (uint64_t *)0;
+    size_t available = 0;
+    uint64_t * table = (uint64_t *)0;
+    size_t mask = 0;
+    uint64_t value = 0;
     unsigned long ll;
     unsigned int ii;
+    char * end = (char *)0;
     int opt;
+    extern char * optarg;
+    extern int optind;
 
     program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
 
-    while ((opt = getopt(argc, argv, "il")) >= 0) {
+    source = hasrdseed() ? RDSEED : GETRANDOM;
+#if !defined(SYS_getrandom)
+    if (source == GETRANDOM) {
+        source = DEVICE;
+        path = "/dev/urandom";
+    }
+#endif
+
+    while ((opt = getopt(argc, argv, "bhiln:s:v")) >= 0) {
 
         switch (opt) {
 
+        case 'b':
+            binary = !0;
+            break;
+
+        case 'h':
+            usage();
+            return 0;
+
         case 'i':
             dolong = 0;
             break;
@@ -68,32 +305,179 @@ int main(int argc, char * argv[])
             dolong = !0;
             break;
 
+        case 'n':
+            count = strtoull(optarg, &end, 0);
+            if ((*end != '\0') || (count == 0)) {
+                error = !0;
+            }
+            break;
+
+        case 's':
+            if (strcmp(optarg, "rdseed") == 0) {
+                if (!hasrdseed()) {
+                    errno = ENOTSUP;
+                    perror(optarg);
+                    error = !0;
+                }
+                source = RDSEED;
+            } else if (strcmp(optarg, "getrandom") == 0) {
+#if defined(SYS_getrandom)
+                source = GETRANDOM;
+#else
+                errno = ENOSYS;
+                perror(optarg);
+                error = !0;
+#endif
+            } else if (strcmp(optarg, "clock") == 0) {
+                source = CLOCK;
+            } else {
+                source = DEVICE;
+                path = optarg;
+            }
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
         default:
-            fprintf(stderr, "%s: [ -l | -i ]\n", program);
-            exit(1);
+            error = !0;
             break;
 
         }
 
     }
 
-    rc = clock_gettime(CLOCK_MONOTONIC_RAW, &spec);
-    if (rc == 0) {
-        ticks = spec.tv_sec;
-        ticks *= 1000000000;
-        ticks += spec.tv_nsec;
-    } else {
-        perror("clock_gettime");
-        exit(1);
+    /*
+     * A batch cannot have more distinct nonzero seeds than the width allows.
+     */
+
+    width = dolong ? sizeof(unsigned long) : sizeof(unsigned int);
+    if (width < sizeof(uint64_t)) {
+        limit = (1ULL << (width * 8)) - 1;
+    }
+    if (count > limit) {
+        error = !0;
+    }
+
+    if ((optind < argc) || error) {
+        usage();
+        return 1;
     }
 
-    if (dolong) {
-        ll = ticks;
-        printf("%lu\n", ll);
-    } else {
-        ii = ticks;
-        printf("%u\n", ii);
+    do {
+
+        if (source == DEVICE) {
+            fd = open(path, O_RDONLY);
+            if (fd < 0) {
+                perror(path);
+                break;
+            }
+        }
+
+        raw = (uint64_t *)malloc(WORDS * sizeof(uint64_t));
+        if (raw == (uint64_t *)0) {
+            perror("malloc");
+            break;
+        }
+
+        /*
+         * The table is at least twice the size of the batch so that it never
+         * gets more than half full. A single seed needs no table.
+         */
+
+        if (count > 1) {
+            for (mask = 1; mask < (2 * count); mask <<= 1) {
+                continue;
+            }
+            table = (uint64_t *)calloc(mask, sizeof(uint64_t));
+            if (table == (uint64_t *)0) {
+                perror("calloc");
+                break;
+            }
+            mask -= 1;
+        }
+
+        if (verbose) {
+            fprintf(stderr, "%s: source       \"%s\"\n", program, (source == RDSEED) ? "rdseed" : (source == GETRANDOM) ? "getrandom" : (source == CLOCK) ? "clock" : path);
+            fprintf(stderr, "%s: width        %zu\n", program, width * 8);
+            fprintf(stderr, "%s: count        %llu\n", program, count);
+            fprintf(stderr, "%s: format       \"%s\"\n", program, binary ? "binary" : "decimal");
+        }
+
+        while (generated < count) {
+
+            if (available == 0) {
+                if (fetch(source, fd, raw, WORDS) < 0) {
+                    perror((source == DEVICE) ? path : "fetch");
+                    break;
+                }
+                available = WORDS;
+            }
+
+            value = mix(raw[--available]) & limit;
+            if ((value == 0) || ((table != (uint64_t *)0) && !insert(table, mask, value))) {
+                ++duplicates;
+                if ((++retries) >= RETRIES) {
+                    errno = EIO;
+                    perror("duplicates");
+                    break;
+                }
+                continue;
+            }
+            retries = 0;
+
+            if (dolong) {
+                ll = value;
+                if (binary) {
+                    fwrite(&ll, sizeof(ll), 1, stdout);
+                } else {
+                    printf("%lu\n", ll);
+                }
+            } else {
+                ii = value;
+                if (binary) {
+                    fwrite(&ii, sizeof(ii), 1, stdout);
+                } else {
+                    printf("%u\n", ii);
+                }
+            }
+            if (ferror(stdout)) {
+                perror("stdout");
+                break;
+            }
+
+            ++generated;
+
+        }
+
+        if (fflush(stdout) == EOF) {
+            perror("stdout");
+            break;
+        }
+
+        if (verbose) {
+            fprintf(stderr, "%s: generated    %llu\n", program, generated);
+            fprintf(stderr, "%s: duplicates   %llu\n", program, duplicates);
+        }
+
+        if (generated < count) {
+            break;
+        }
+
+        xc = 0;
+
+    } while (0);
+
+    if (table != (uint64_t *)0) {
+        free(table);
+    }
+    if (raw != (uint64_t *)0) {
+        free(raw);
+    }
+    if (fd >= 0) {
+        close(fd);
     }
 
-    exit(0);
+    return xc;
 }
@@ -0,0 +1,120 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Service<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <syslog.h>
+#include "service.h"
+
+volatile sig_atomic_t service_done = 0;
+
+volatile sig_atomic_t service_report = 0;
+
+int service_verbose = 0;
+
+static int daemonized = 0;
+
+void service_printf(const char * format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    if (daemonized) {
+        vsyslog(LOG_DEBUG, format, ap);
+    } else {
+        vfprintf(stderr, format, ap);
+    }
+    va_end(ap);
+}
+
+void service_verbosef(const char * format, ...)
+{
+    if (service_verbose) {
+        va_list ap;
+        va_start(ap, format);
+        if (daemonized) {
+            vsyslog(LOG_DEBUG, format, ap);
+        } else {
+            vfprintf(stderr, format, ap);
+        }
+        va_end(ap);
+    }
+}
+
+void service_error(const char * string)
+{
+    if (daemonized) {
+        syslog(LOG_ERR, "%s: %s\n", string, strerror(errno));
+    } else {
+        fprintf(stderr, "%s: %s\n", string, strerror(errno));
+    }
+}
+
+int service_daemonize(const char * ident)
+{
+    if (daemon(0, 0) < 0) {
+        return -1;
+    }
+
+    openlog(ident, LOG_CONS | LOG_PID, LOG_DAEMON);
+    daemonized = !0;
+
+    return 0;
+}
+
+/**
+ * Handle a signal. In the event of a SIGPIPE, SIGINT, or SIGTERM, the
+ * program shuts down in an orderly fashion. In the event of a SIGHUP, it
+ * reports its statistics.
+ * @param signum is the number of the incoming signal.
+ */
+static void handler(int signum)
+{
+    if (signum == SIGPIPE) {
+        service_done = !0;
+    } else if (signum == SIGINT) {
+        service_done = !0;
+    } else if (signum == SIGTERM) {
+        service_done = !0;
+    } else if (signum == SIGHUP) {
+        service_report = !0;
+    } else {
+        /* Do nothing. */
+    }
+}
+
+int service_signals(void)
+{
+    struct sigaction action = { 0 };
+
+    action.sa_handler = handler;
+    action.sa_flags = 0;
+    if (sigaction(SIGPIPE, &action, (struct sigaction *)0) < 0) {
+        return -1;
+    }
+    if (sigaction(SIGINT, &action, (struct sigaction *)0) < 0) {
+        return -1;
+    }
+    if (sigaction(SIGTERM, &action, (struct sigaction *)0) < 0) {
+        return -1;
+    }
+
+    action.sa_flags = SA_RESTART;
+    if (sigaction(SIGHUP, &action, (struct sigaction *)0) < 0) {
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,78 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+#ifndef _H_COM_DIAG_SCATTERGUN_SERVICE_
+#define _H_COM_DIAG_SCATTERGUN_SERVICE_
+
+/**
+ * @file
+ * Service<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * Implements the plumbing common to the long running producers like
+ * seventool and quantistool: messages that go to standard error or, once
+ * the program has become a daemon, to the system log; becoming a daemon;
+ * and signal handlers that ask the program to shut down in an orderly
+ * fashion (SIGPIPE, SIGINT, SIGTERM) or to report its statistics (SIGHUP).
+ * This is part of the Scattergun project.
+ */
+
+#include <signal.h>
+
+/**
+ * This becomes true when the program has been asked to shut down.
+ */
+extern volatile sig_atomic_t service_done;
+
+/**
+ * This becomes true when the program has been asked to report its
+ * statistics; the program clears it afterwards.
+ */
+extern volatile sig_atomic_t service_report;
+
+/**
+ * This enables the messages emitted by service_verbosef.
+ */
+extern int service_verbose;
+
+/**
+ * Emit a formatted message to either the system log or to standard error.
+ * @param format is the printf format.
+ */
+extern void service_printf(const char * format, ...);
+
+/**
+ * Emit a formatted message to either the system log or to standard error
+ * if verbosity is enabled.
+ * @param format is the printf format.
+ */
+extern void service_verbosef(const char * format, ...);
+
+/**
+ * Emit a caller provided string and the error message corresponding to the
+ * current value of errno to either the system log or to standard error.
+ * @param string is the string.
+ */
+extern void service_error(const char * string);
+
+/**
+ * Detach from the controlling terminal and run in the background, sending
+ * all further messages to the system log.
+ * @param ident is the system log identifier.
+ * @return 0 for success, <0 with errno set for failure.
+ */
+extern int service_daemonize(const char * ident);
+
+/**
+ * Install the signal handlers.
+ * @return 0 for success, <0 with errno set for failure.
+ */
+extern int service_signals(void);
+
+#endif
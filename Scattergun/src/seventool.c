@@ -12,116 +12,53 @@
  *
  * USAGE
  *
- * seventool [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -R [ -r ] | -S ] [ -c ] [ -x ] [ -o PATH ]
+ * seventool [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -R [ -r ] | -S ] [ -c ] [ -x ] [ -o SINK | -m NAME [ -M MODE ] ]
  *
  * EXAMPLES
  *
+ * seventool -R -m /seventool & ringtool -r /seventool | rate
+ *
+ * sudo seventool -D -S -c -o pool:2
+ *
  * ABSTRACT
  *
  * Continuously reads thirty-two bits of entropy using the rdrand or rdseed
  * instructions available on various Intel processors such as certain models of
  * the i7 and writes it to standard output, or to a specified file system path.
  * This latter object could be a FIFO, which could allow generated entropy to be
- * read by another program, like rngd. Optionally does some other useful stuff
- * regarding examining the capabilities of the host processor. This is part of
- * the Scattergun project.
+ * read by another program, like rngd, or a shared memory ring (see ringtool)
+ * from which any number of consumers take entropy without copying it. Each
+ * slot of the ring is handed to exactly one consumer. It may also be the kernel
+ * entropy pool or a socket (see sink.h). Entropy is read a vector of buffers at
+ * a time, directly into the ring if there is one. Optionally does some other
+ * useful stuff regarding examining the capabilities of the host processor.
+ * This is part of the Scattergun project.
  */
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
-#include <stdarg.h>
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
-#include <fcntl.h>
-#include <signal.h>
-#include <syslog.h>
-#include <time.h>
 #include <sys/types.h>
-#include <sys/stat.h>
-#define  __RDRND__
-#include <immintrin.h>
+#include <sys/uio.h>
+#include "service.h"
+#include "source.h"
+#include "sink.h"
+#include "probes.h"
 
 static const char * program = "seventool";
 static const char * ident = "seventool";
 static int debug = 0;
-static int verbose = 0;
-static int done = 0;
-static int report = 0;
-static int daemonize = 0;
 
 enum mode { FAIL=0, RDRAND=1, RDSEED=2, };
 static const char * MODE[] = { "fail", "rdrand", "rdseed", };
 
 /**
- * Emit a formatting string to either the system log or to standard error.
- * @param format is the printf format.
+ * This is the size of each buffer in the vector that is read at a time.
  */
-static void lprintf(const char * format, ...)
-{
-    va_list ap;
-    va_start(ap, format);
-    if (daemonize) {
-        vsyslog(LOG_DEBUG, format, ap);
-    } else {
-        vfprintf(stderr, format, ap);
-    }
-    va_end(ap);
-}
-
-/**
- * Emit a formatting string to either the system log or to standard error
- * if verbosity is enabled.
- * @param format is the printf format.
- */
-static void lverbosef(const char * format, ...)
-{
-    if (verbose) {
-        va_list ap;
-        va_start(ap, format);
-        if (daemonize) {
-            vsyslog(LOG_DEBUG, format, ap);
-        } else {
-            vfprintf(stderr, format, ap);
-        }
-        va_end(ap);
-    }
-}
-
-/**
- * Emit a caller provider string and an error message string corresponding to
- * the current value of the error number (errno) to either the system log or
- * to standard error.
- * @param string is the string.
- */
-static void lerror(const char * string)
-{
-    if (daemonize) {
-        syslog(LOG_ERR, "%s: %s\n", string, strerror(errno));
-    } else {
-        fprintf(stderr, "%s: %s\n", string, strerror(errno));
-    }
-}
-
-/**
- * Handle a signal. In the event of a SIGPIPE or a SIGINT, the program shuts
- * down in an orderly fashion. In the event of a SIGHUP, it emits some
- * statistics to standard error.
- * @param signum is the number of the incoming signal.
- */
-static void handler(int signum)
-{
-    if (signum == SIGPIPE) {
-        done = !0;
-    } else if (signum == SIGINT) {
-        done = !0;
-    } else if (signum == SIGHUP) {
-        report = !0;
-    } else {
-        /* Do nothing. */
-    }
-}
+static const size_t BUFFER = 4096;
 
 /**
  * Emit a usage message to standard error.
@@ -129,19 +66,21 @@ static void handler(int signum)
  */
 static void usage(int nomenu)
 {
-    lprintf("usage: %s [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -R [ -r ] | -S ] [ -c ] [ -x ] [ -o PATH ]\n", program);
+    service_printf("usage: %s [ -h ] [ -d ] [ -v ] [ -D ] [ -i IDENT ] [ -R [ -r ] | -S ] [ -c ] [ -x ] [ -o SINK | -m NAME [ -M MODE ] ]\n", program);
     if (nomenu) { return; }
-    lprintf("       -d            Enable debug mode\n");
-    lprintf("       -v            Enable verbose mode\n");
-    lprintf("       -D            Run as a daemon\n");
-    lprintf("       -i IDENT      Use IDENT as the syslog identifier\n");
-    lprintf("       -R            Use the rdrand instruction\n");
-    lprintf("       -r            Force the rdrand DRNG to reseed beforehand\n");
-    lprintf("       -S            Use the rdseed instruction\n");
-    lprintf("       -c            Check for instruction, exit if unimplemented\n");
-    lprintf("       -x            Perform check only, exit afterwards\n");
-    lprintf("       -o PATH       Write to PATH (which may be a fifo) instead of stdout\n");
-    lprintf("       -h            Print help menu\n");
+    service_printf("       -d            Enable debug mode\n");
+    service_printf("       -v            Enable verbose mode\n");
+    service_printf("       -D            Run as a daemon\n");
+    service_printf("       -i IDENT      Use IDENT as the syslog identifier\n");
+    service_printf("       -R            Use the rdrand instruction\n");
+    service_printf("       -r            Force the rdrand DRNG to reseed beforehand\n");
+    service_printf("       -S            Use the rdseed instruction\n");
+    service_printf("       -c            Check for instruction, exit if unimplemented\n");
+    service_printf("       -x            Perform check only, exit afterwards\n");
+    service_printf("       -o SINK       Write to SINK (PATH, fifo, pool[:BITS], unix:PATH, tcp:HOST:PORT) instead of stdout\n");
+    service_printf("       -m NAME       Publish to shared memory ring NAME instead of stdout\n");
+    service_printf("       -M MODE       Create the ring with the octal permissions MODE (default 0%o)\n", RING_MODE);
+    service_printf("       -h            Print help menu\n");
 }
 
 /**
@@ -158,55 +97,13 @@ static void cpuid(uint32_t * ap, uint32_t * bp, uint32_t * cp, uint32_t * dp, ui
 {
     asm volatile ("cpuid" : "=a" (*ap), "=b" (*bp), "=c" (*cp), "=d" (*dp) : "a" (l), "c" (s) );
  
-    lverbosef("%s: cpuid\n", program);
-    lverbosef("%s: leaf         %d\n", program, l);
-    lverbosef("%s: subleaf      %d\n", program, s);
-    lverbosef("%s: eax          0x%8.8x\n", program, *ap);
-    lverbosef("%s: ebx          0x%8.8x\n", program, *bp);
-    lverbosef("%s: ecx          0x%8.8x\n", program, *cp);
-    lverbosef("%s: edx          0x%8.8x\n", program, *dp);
-}
-
-/**
- * Run the rdrand instruction.
- * @param wp points to the result word.
- * @return the carry bit indicating success.
- */
-static inline uint8_t rdrand(uint32_t * wp)
-{
-#if defined(SCATTERGUN_HAS_RDRAND_INLINE)
-    return _rdrand32_step(wp);
-#elif defined(SCATTERGUN_HAS_RDRAND_INTRINSIC)
-    return __builtin_ia32_rdrand32_step(wp);
-#elif defined(SCATTERGUN_HAS_RDRAND_MNEMONIC)
-    uint8_t carry = 1;
-    asm volatile ("rdrand %0; setc %1" : "=r" (*wp), "=qm" (carry));
-    return carry;
-#else
-    uint8_t carry = 1;
-    asm volatile (".byte 0x0f,0xc7,0xf0; setc %0" : "=qm" (carry), "=a" (*wp));
-    return carry;
-#endif
-}
-
-/**
- * Run the rdseed instruction.
- * @param wp points to the result word.
- * @return the carry bit indicating success.
- */
-static inline uint8_t rdseed(uint32_t * wp)
-{
-#if defined(SCATTERGUN_HAS_RDSEED_INTRINSIC)
-    return __builtin_ia32_rdseed32_step(wp);
-#elif defined(SCATTERGUN_HAS_RDSEED_MNEMONIC)
-    uint8_t carry = 1;
-    asm volatile ("rdseed %0; setc %1" : "=r" (*wp), "=qm" (carry));
-    return carry;
-#else
-    uint8_t carry = 1;
-    asm volatile (".byte 0x0f,0xc7,0xf8; setc %0" : "=qm" (carry), "=a" (*wp));
-    return carry;
-#endif
+    service_verbosef("%s: cpuid\n", program);
+    service_verbosef("%s: leaf         %d\n", program, l);
+    service_verbosef("%s: subleaf      %d\n", program, s);
+    service_verbosef("%s: eax          0x%8.8x\n", program, *ap);
+    service_verbosef("%s: ebx          0x%8.8x\n", program, *bp);
+    service_verbosef("%s: ecx          0x%8.8x\n", program, *cp);
+    service_verbosef("%s: edx          0x%8.8x\n", program, *dp);
 }
 
 /**
@@ -227,27 +124,27 @@ static int query(void)
 
     if ((memcmp((char *)&b, "Genu", 4) == 0) && (memcmp((char *)&d, "ineI", 4) == 0) && (memcmp((char *)&c, "ntel", 4) == 0)) {
 
-        lverbosef("%s: cpu          Intel\n", program);
+        service_verbosef("%s: cpu          Intel\n", program);
 
         cpuid(&a, &b, &c, &d, 1, 0);
         if (c & 0x40000000) {
-            lverbosef("%s: rdrand       available\n", program);
+            service_verbosef("%s: rdrand       available\n", program);
             result |= 1<<RDRAND;
         } else {
-            lverbosef("%s: rdrand       unavailable\n", program);
+            service_verbosef("%s: rdrand       unavailable\n", program);
         }
 
         cpuid(&a, &b, &c, &d, 7, 0);
         if (b & 0x00040000) {
-            lverbosef("%s: rdseed       available\n", program);
+            service_verbosef("%s: rdseed       available\n", program);
             result |= 1<<RDSEED;
         } else {
-            lverbosef("%s: rdseed       unavailable\n", program);
+            service_verbosef("%s: rdseed       unavailable\n", program);
         }
 
     } else {
 
-        lverbosef("%s: cpu          other\n", program);
+        service_verbosef("%s: cpu          other\n", program);
 
     }
 
@@ -259,28 +156,32 @@ static int query(void)
  * one more time than its reseed cycle. The rdrand DRNG is guaranteed to
  * produce no more than (511 * 2) or 1022 64-bit results using the same seed.
  * Where exactly in this loop the rdrand reseeds is transparent and unknowable.
+ * @param sp points to the open rdrand source.
  * @return true if the all of the rdrand calls succeeded, false otherwise.
  */
-static int reseed(void)
+static int reseed(struct source * sp)
 {
     static const int RESEED = ((511 * 2 * 64) / sizeof(uint32_t)) + 1;
-    int count = 0;
-    uint32_t word = 0;
-    uint8_t carry = 1;
-    int ii;
+    uint32_t * words = (uint32_t *)0;
+    ssize_t bytes = 0;
 
-    lverbosef("%s: reseeding    %d\n", program, RESEED);
+    service_verbosef("%s: reseeding    %d\n", program, RESEED);
 
-    for (ii = 0; ii < RESEED; ++ii) {
-        carry = rdrand(&word);
-        if (carry) {
-            ++count;
-        }
+    words = (uint32_t *)malloc(RESEED * sizeof(uint32_t));
+    if (words == (uint32_t *)0) {
+        return 0;
     }
 
-    lverbosef("%s: reseeded     %d\n", program, count);
+    PROBE1(reseed__start, RESEED);
+    bytes = source_read(sp, words, RESEED * sizeof(uint32_t));
+    PROBE1(reseed__end, bytes);
+
+    memset(words, 0, RESEED * sizeof(uint32_t));
+    free(words);
+
+    service_verbosef("%s: reseeded     %zd\n", program, (bytes > 0) ? (bytes / (ssize_t)sizeof(uint32_t)) : 0);
 
-    return (count == RESEED);
+    return (bytes == (RESEED * sizeof(uint32_t)));
 }
 
 /**
@@ -292,33 +193,28 @@ int main(int argc, char * argv[])
 {
     int xc = 1;
     int error = 0;
-    unsigned int unit = 0;
-    size_t written = 0;
-    char * end = (char *)0;
     int rc = 0;
-    FILE * fp = stdout;
-    uintptr_t offset = 0;
-    struct sigaction sigpipe = { 0 };
-    struct sigaction sighup = { 0 };
-    struct sigaction sigint = { 0 };
-    struct timespec request = { 0 };
-    size_t tries = 0;
-    size_t total = 0;
-    size_t reads = 0;
-    size_t consecutive = 0;
-    const char * path = (const char *)0;
+    int count = 0;
+    ssize_t bytes = 0;
+    uint32_t * wp = (uint32_t *)0;
+    size_t words = 0;
+    size_t batches = 0;
+    const char * path = "-";
+    const char * name = (const char *)0;
+    char * end = (char *)0;
+    mode_t permissions = RING_MODE;
+    struct source source = { 0 };
+    struct sink sink = { 0 };
+    struct iovec vector[SOURCE_VECTOR];
     enum mode mode = FAIL;
+    int daemonize = 0;
     int doreseed = 0;
     int docheck = 0;
     int doexit = 0;
     int opt;
     extern char * optarg;
-    uint32_t word;
-    uint8_t carry;
-    static const uint32_t CAFEBEEF = 0xCAFEBEEF;
+    int ii;
     static const uint32_t DEADCODE = 0xDEADC0DE;
-    static const uint32_t NANOSECONDS = 1000000;
-    static const size_t CONSECUTIVE = 10;
 
     /*
      * Crack open the command line argument vector.
@@ -326,7 +222,10 @@ int main(int argc, char * argv[])
 
     program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
 
-    while ((opt = getopt(argc, argv, "dvDo:i:hRrScx")) >= 0) {
+    source.fd = -1;
+    sink.fd = -1;
+
+    while ((opt = getopt(argc, argv, "dvDo:m:M:i:hRrScx")) >= 0) {
 
         switch (opt) {
 
@@ -335,7 +234,7 @@ int main(int argc, char * argv[])
             break;
 
         case 'v':
-            verbose = !0;
+            service_verbose = !0;
             break;
 
         case 'D':
@@ -346,6 +245,19 @@ int main(int argc, char * argv[])
             path = optarg;
             break;
 
+        case 'm':
+            name = optarg;
+            break;
+
+        case 'M':
+            permissions = strtoul(optarg, &end, 8);
+            if ((*end != '\0') || (permissions > 0777)) {
+                errno = EINVAL;
+                service_error(optarg);
+                error = !0;
+            }
+            break;
+
         case 'i':
             ident = optarg;
             break;
@@ -396,12 +308,11 @@ int main(int argc, char * argv[])
         }
 
         if (daemonize) {
-            if (daemon(0, 0) < 0) {
+            if (service_daemonize(ident) < 0) {
                 perror("daemon");
                 break;
             }
-            openlog(ident, LOG_CONS | LOG_PID, LOG_DAEMON);
-            lverbosef("%s: pid          %d\n", program, getpid());
+            service_verbosef("%s: pid          %d\n", program, getpid());
         }
 
         if (docheck) {  
@@ -422,45 +333,43 @@ int main(int argc, char * argv[])
          * Install our signal handlers.
          */
 
-        sigpipe.sa_handler = handler;
-        sigpipe.sa_flags = 0;
-        rc = sigaction(SIGPIPE, &sigpipe, (struct sigaction *)0);
-        if (rc < 0) {
-            lerror("sigaction");
+        if (service_signals() < 0) {
+            service_error("sigaction");
             break;
         }
 
-        sighup.sa_handler = handler;
-        sighup.sa_flags = SA_RESTART;
-        rc = sigaction(SIGHUP, &sighup, (struct sigaction *)0);
-        if (rc < 0) {
-            lerror("sigaction");
-            break;
-        }
+        /*
+         * Switch from stdout to SINK or to the ring NAME if so configured.
+         */
 
-        sigint.sa_handler = handler;
-        sigint.sa_flags = 0;
-        rc = sigaction(SIGINT, &sighup, (struct sigaction *)0);
-        if (rc < 0) {
-            lerror("sigaction");
+        if (name != (const char *)0) {
+            service_verbosef("%s: ring         \"%s\"\n", program, name);
+            rc = sink_ring(&sink, name);
+            sink.mode = permissions;
+            sink.cancel = &service_done;
+        } else {
+            service_verbosef("%s: path         \"%s\"\n", program, path);
+            rc = sink_parse(&sink, path);
+        }
+        if ((rc < 0) || (sink_open(&sink) < 0)) {
+            service_error((name != (const char *)0) ? name : path);
             break;
         }
 
-        /*
-         * Switch from stdout to PATH if so configured.
-         */
+        service_verbosef("%s: mode         %s\n", program, MODE[mode]);
+        service_verbosef("%s: sink         %s\n", program, SINK_KINDS[sink.kind]);
 
-        if (path != (const char *)0) {
-            lverbosef("%s: path         \"%s\"\n", program, path);
-            fp = fopen(path, "a");
-            if (fp == (FILE *)0) {
-                lerror(path);
+        if (mode != FAIL) {
+            if (source_parse(&source, MODE[mode]) < 0) {
+                service_error(MODE[mode]);
+                break;
+            }
+            if (source_open(&source) < 0) {
+                service_error(MODE[mode]);
                 break;
             }
         }
 
-        lverbosef("%s: mode         %s\n", program, MODE[mode]);
-
         /*
          * Force a reseed if requested and if using rdrand.
          */
@@ -469,79 +378,81 @@ int main(int argc, char * argv[])
             /* Do nothing. */
         } else if (mode != RDRAND) {
             /* Do nothing. */
-        } else if (reseed()) {
+        } else if (reseed(&source)) {
             /* Do nothing. */
         } else {
             errno = EBUSY;
-            lerror("reseed");
+            service_error("reseed");
             break;
         }
 
         /*
-         * Enter our work loop.
+         * Enter our work loop. Each batch is read into buffers the sink
+         * provides, which for a ring are the shared memory itself.
          */
 
-        request.tv_sec = NANOSECONDS / 1000000000;
-        request.tv_nsec = NANOSECONDS % 1000000000;
-
         xc = 0;
 
-        while (!done) {
+        while (!service_done) {
 
-            if (report) {
-                lprintf("%s: tries=%zu size=%zu reads=%zu total=%zu\n", program, tries, sizeof(word), reads, total);
-                report = 0;
+            if (service_report) {
+                service_printf("%s: batches=%zu size=%zu reads=%zu total=%zu writes=%zu\n", program, batches, sizeof(uint32_t), source.reads, sink.total, sink.writes);
+                service_report = 0;
             }
 
-            ++tries;
-
-            if (mode == RDRAND) {
-                word = CAFEBEEF;
-                carry = rdrand(&word);
-            } else if (mode == RDSEED) {
-                word = CAFEBEEF;
-                carry = rdseed(&word);
-            } else {
-                word = DEADCODE;
-                carry = 1;
-            }
-
-            if (carry) {
-                consecutive = 0;
-            } else if ((++consecutive) >= CONSECUTIVE) {
-                errno = EBUSY;
-                lerror("carry");
-                xc = 2;
-                break;
-            } else if ((rc = nanosleep(&request, (struct timespec *)0)) >= 0) {
-                continue;
-            } else if (errno == EINTR) {
+            count = sink_reserve(&sink, vector, SOURCE_VECTOR, BUFFER);
+            if (count > 0) {
+                /* Do nothing. */
+            } else if ((errno == EAGAIN) || (errno == EINTR)) {
                 continue;
             } else {
-                lerror("nanosleep");
+                service_error("sink_reserve");
                 xc = 2;
                 break;
             }
 
-            ++reads;
-            total += sizeof(word);
+            if (mode == FAIL) {
+                bytes = 0;
+                for (ii = 0; ii < count; ++ii) {
+                    wp = (uint32_t *)vector[ii].iov_base;
+                    for (words = vector[ii].iov_len / sizeof(uint32_t); words > 0; --words) {
+                        *(wp++) = DEADCODE;
+                    }
+                    bytes += (uint8_t *)wp - (uint8_t *)vector[ii].iov_base;
+                }
+            } else {
+                PROBE1(read__start, count);
+                bytes = source_readv(&source, vector, count);
+                PROBE1(read__end, bytes);
+                if (bytes <= 0) {
+                    if (bytes == 0) { errno = EBUSY; }
+                    service_error("carry");
+                    xc = 2;
+                    break;
+                }
+            }
+
+            ++batches;
+
+            PROBE1(write__start, bytes);
+            rc = sink_commit(&sink, bytes);
+            PROBE1(write__end, rc);
 
-            written = fwrite(&word, sizeof(word), 1, fp);
-            if (written >= 1) {
+            if (rc == 0) {
                 /* Do nothing: nominal. */
-            } else if (!ferror(fp)) {
-                break;
             } else if (errno == EPIPE) {
-                lerror("fwrite");
+                service_error("write");
+                break;
+            } else if (service_done) {
                 break;
             } else {
-                lerror("fwrite");
+                service_error("write");
                 xc = 2;
                 break;
             }
 
             if (debug) {
-                lprintf("%s: tries=%zu size=%zu reads=%zu total=%zu\n", program, tries, sizeof(word), reads, total);
+                service_printf("%s: batches=%zu size=%zu reads=%zu total=%zu writes=%zu\n", program, batches, sizeof(uint32_t), source.reads, sink.total, sink.writes);
             }
 
         }
@@ -552,11 +463,10 @@ int main(int argc, char * argv[])
      * Clean up after ourselves.
      */
 
-    if (fp != (FILE *)0) {
-        fclose(fp);
-    }
+    sink_close(&sink);
+    source_close(&source);
 
-    lverbosef("%s: tries=%zu size=%zu reads=%zu total=%zu\n", program, tries, sizeof(word), reads, total);
+    service_verbosef("%s: batches=%zu size=%zu reads=%zu total=%zu writes=%zu\n", program, batches, sizeof(uint32_t), source.reads, sink.total, sink.writes);
 
     return xc;
 }
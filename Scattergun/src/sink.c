@@ -0,0 +1,365 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Sink<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "pool.h"
+#include "sink.h"
+
+const char * SINK_KINDS[] = { "none", "stdout", "fifo", "file", "pool", "unix", "tcp", "ring", };
+
+/**
+ * This is the size of the buffer for the host part of a TCP specification.
+ */
+#define HOST 256
+
+int sink_parse(struct sink * sp, const char * name)
+{
+    struct stat status = { 0 };
+    char * end = (char *)0;
+
+    memset(sp, 0, sizeof(*sp));
+    sp->name = name;
+    sp->fd = -1;
+
+    if (strcmp(name, "-") == 0) {
+        sp->kind = SINK_STDOUT;
+    } else if (strcmp(name, "pool") == 0) {
+        sp->kind = SINK_POOL;
+        sp->bits = 8;
+    } else if (strncmp(name, "pool:", 5) == 0) {
+        sp->kind = SINK_POOL;
+        sp->bits = strtol(name + 5, &end, 0);
+        if ((*end != '\0') || (sp->bits < 0) || (sp->bits > 8)) {
+            errno = EINVAL;
+            return -1;
+        }
+    } else if (strncmp(name, "unix:", 5) == 0) {
+        sp->name = name + 5;
+        sp->kind = SINK_UNIX;
+        if (strlen(sp->name) >= sizeof(((struct sockaddr_un *)0)->sun_path)) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+    } else if (strncmp(name, "tcp:", 4) == 0) {
+        sp->name = name + 4;
+        sp->kind = SINK_TCP;
+        end = strrchr(sp->name, ':');
+        if ((end == (char *)0) || (end == sp->name) || (end[1] == '\0') || ((end - sp->name) >= HOST)) {
+            errno = EINVAL;
+            return -1;
+        }
+    } else if (strncmp(name, "ring:", 5) == 0) {
+        return sink_ring(sp, name + 5);
+    } else if ((stat(name, &status) == 0) && S_ISFIFO(status.st_mode)) {
+        sp->kind = SINK_FIFO;
+    } else {
+        sp->kind = SINK_FILE;
+    }
+
+    return 0;
+}
+
+int sink_ring(struct sink * sp, const char * name)
+{
+    memset(sp, 0, sizeof(*sp));
+    sp->name = name;
+    sp->fd = -1;
+    sp->kind = SINK_RING;
+    sp->mode = RING_MODE;
+
+    if (*name == '\0') {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Connect to a TCP server named by a HOST:PORT specification.
+ * @param name is the specification.
+ * @return an open socket, or <0 with errno set for failure.
+ */
+static int connecttcp(const char * name)
+{
+    struct addrinfo hints = { 0 };
+    struct addrinfo * list = (struct addrinfo *)0;
+    struct addrinfo * ap = (struct addrinfo *)0;
+    const char * port = (const char *)0;
+    char host[HOST];
+    int fd = -1;
+    int rc = 0;
+
+    port = strrchr(name, ':');
+    memcpy(host, name, port - name);
+    host[port - name] = '\0';
+    ++port;
+
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    rc = getaddrinfo(host, port, &hints, &list);
+    if (rc != 0) {
+        errno = (rc == EAI_SYSTEM) ? errno : EHOSTUNREACH;
+        return -1;
+    }
+
+    for (ap = list; ap != (struct addrinfo *)0; ap = ap->ai_next) {
+        fd = socket(ap->ai_family, ap->ai_socktype, ap->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        if (connect(fd, ap->ai_addr, ap->ai_addrlen) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+
+    freeaddrinfo(list);
+
+    return fd;
+}
+
+/**
+ * Connect to a Unix domain stream socket.
+ * @param path is the path of the socket.
+ * @return an open socket, or <0 with errno set for failure.
+ */
+static int connectunix(const char * path)
+{
+    struct sockaddr_un address = { 0 };
+    int fd = -1;
+    int error = 0;
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+
+    return fd;
+}
+
+int sink_open(struct sink * sp)
+{
+    int rc = -1;
+
+    switch (sp->kind) {
+
+    case SINK_STDOUT:
+        sp->fd = STDOUT_FILENO;
+        rc = 0;
+        break;
+
+    case SINK_FIFO:
+    case SINK_FILE:
+        sp->fd = open(sp->name, O_WRONLY | O_CREAT | O_APPEND, 0666);
+        rc = (sp->fd < 0) ? -1 : 0;
+        break;
+
+    case SINK_POOL:
+        sp->fd = open("/dev/random", O_WRONLY);
+        rc = (sp->fd < 0) ? -1 : 0;
+        break;
+
+    case SINK_UNIX:
+        sp->fd = connectunix(sp->name);
+        rc = (sp->fd < 0) ? -1 : 0;
+        break;
+
+    case SINK_TCP:
+        sp->fd = connecttcp(sp->name);
+        rc = (sp->fd < 0) ? -1 : 0;
+        break;
+
+    case SINK_RING:
+        rc = ring_create(&(sp->ring), sp->name, RING_SLOTS, RING_SLOTSIZE, sp->mode);
+        ring_cancel(&(sp->ring), sp->cancel);
+        break;
+
+    default:
+        errno = EINVAL;
+        break;
+
+    }
+
+    if (rc == 0) {
+        ++(sp->opens);
+    }
+
+    return rc;
+}
+
+void sink_close(struct sink * sp)
+{
+    ring_detach(&(sp->ring));
+    if ((sp->fd >= 0) && (sp->fd != STDOUT_FILENO)) {
+        close(sp->fd);
+    }
+    sp->fd = -1;
+    if (sp->staging != (uint8_t *)0) {
+        memset(sp->staging, 0, sp->capacity);
+        free(sp->staging);
+        sp->staging = (uint8_t *)0;
+    }
+    sp->capacity = 0;
+}
+
+int sink_reserve(struct sink * sp, struct iovec * vector, int count, size_t size)
+{
+    uint8_t * here = (uint8_t *)0;
+    uint8_t * staging = (uint8_t *)0;
+    size_t length = 0;
+    int ii;
+
+    if ((count <= 0) || (size == 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (sp->kind == SINK_RING) {
+        here = (uint8_t *)ring_reserve(&(sp->ring), &length, SINK_TIMEOUT);
+        if (here == (uint8_t *)0) {
+            return -1;
+        }
+    } else {
+        length = count * size;
+        if (sp->capacity < length) {
+            staging = (uint8_t *)realloc(sp->staging, length);
+            if (staging == (uint8_t *)0) {
+                return -1;
+            }
+            sp->staging = staging;
+            sp->capacity = length;
+        }
+        here = sp->staging;
+    }
+
+    for (ii = 0; (ii < count) && (length > 0); ++ii) {
+        vector[ii].iov_base = here;
+        vector[ii].iov_len = (length < size) ? length : size;
+        here += vector[ii].iov_len;
+        length -= vector[ii].iov_len;
+    }
+
+    return ii;
+}
+
+int sink_commit(struct sink * sp, size_t size)
+{
+    struct iovec vector;
+
+    if (sp->kind == SINK_RING) {
+        ring_commit(&(sp->ring), size);
+        ++(sp->writes);
+        sp->total += size;
+        return 0;
+    }
+
+    vector.iov_base = sp->staging;
+    vector.iov_len = size;
+
+    return (sink_writev(sp, &vector, 1) == size) ? 0 : -1;
+}
+
+size_t sink_writev(struct sink * sp, const struct iovec * vector, int count)
+{
+    struct iovec pending[SINK_VECTOR];
+    size_t total = 0;
+    size_t length = 0;
+    ssize_t bytes = 0;
+    int first = 0;
+    int nn = 0;
+    int ii;
+
+    if (sp->kind == SINK_RING) {
+        for (ii = 0; ii < count; ++ii) {
+            length = ring_publish(&(sp->ring), vector[ii].iov_base, vector[ii].iov_len, SINK_TIMEOUT);
+            ++(sp->writes);
+            sp->total += length;
+            total += length;
+            if (length < vector[ii].iov_len) {
+                break;
+            }
+        }
+        return total;
+    }
+
+    if (sp->kind == SINK_POOL) {
+        for (ii = 0; ii < count; ++ii) {
+            if (pool_inject(sp->fd, vector[ii].iov_base, vector[ii].iov_len, vector[ii].iov_len * sp->bits) < 0) {
+                break;
+            }
+            ++(sp->writes);
+            sp->total += vector[ii].iov_len;
+            total += vector[ii].iov_len;
+        }
+        return total;
+    }
+
+    /*
+     * Everything else is a file descriptor that takes as many buffers as it
+     * can with each system call, picking up where a short write left off.
+     */
+
+    for (ii = 0; ii < count; ii += nn) {
+
+        nn = count - ii;
+        if (nn > SINK_VECTOR) { nn = SINK_VECTOR; }
+        memcpy(pending, vector + ii, nn * sizeof(pending[0]));
+
+        for (first = 0; first < nn; ) {
+            if (pending[first].iov_len == 0) {
+                ++first;
+                continue;
+            }
+            bytes = writev(sp->fd, pending + first, nn - first);
+            if (bytes < 0) {
+                return total;
+            }
+            ++(sp->writes);
+            sp->total += bytes;
+            total += bytes;
+            while ((first < nn) && (bytes >= pending[first].iov_len)) {
+                bytes -= pending[first].iov_len;
+                ++first;
+            }
+            if (first < nn) {
+                pending[first].iov_base = (uint8_t *)pending[first].iov_base + bytes;
+                pending[first].iov_len -= bytes;
+            }
+        }
+
+    }
+
+    return total;
+}
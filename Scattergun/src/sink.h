@@ -0,0 +1,152 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+#ifndef _H_COM_DIAG_SCATTERGUN_SINK_
+#define _H_COM_DIAG_SCATTERGUN_SINK_
+
+/**
+ * @file
+ * Sink<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * Writes entropy to any of the places Scattergun knows how to deliver it:
+ * standard output, a FIFO (to be read by a program like rngd), a file, the
+ * kernel entropy pool with credit, a Unix domain or TCP socket, or a shared
+ * memory ring (see ring.h). A sink is named by a specification that is "-",
+ * "pool" or "pool:BITS" (BITS being the bits of entropy credited to each
+ * byte, eight by default), "unix:PATH", "tcp:HOST:PORT", "ring:NAME", or a
+ * PATH. A producer asks the sink for a vector of buffers, fills them (see
+ * source_readv), and commits what it filled. For a ring the buffers are the
+ * unused space in a slot of the shared memory itself, so the entropy is
+ * never copied; for anything else they are a staging buffer owned by the
+ * sink that is written with a single system call. This is part of the
+ * Scattergun project.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include "ring.h"
+
+/**
+ * This is the most buffers a FIFO, file, or socket takes in one system call.
+ */
+#define SINK_VECTOR 16
+
+/**
+ * This is the most milliseconds a sink waits for a slot in a ring.
+ */
+#define SINK_TIMEOUT 1000
+
+enum sink_kind {
+    SINK_NONE = 0,
+    SINK_STDOUT = 1,
+    SINK_FIFO = 2,
+    SINK_FILE = 3,
+    SINK_POOL = 4,
+    SINK_UNIX = 5,
+    SINK_TCP = 6,
+    SINK_RING = 7,
+};
+
+/**
+ * These are the names of the kinds of sinks indexed by kind.
+ */
+extern const char * SINK_KINDS[];
+
+/**
+ * This describes an open or closed sink and counts its use.
+ */
+struct sink {
+    const char * name;
+    enum sink_kind kind;
+    int fd;
+    int bits;
+    mode_t mode;
+    const volatile sig_atomic_t * cancel;
+    struct ring ring;
+    uint8_t * staging;
+    size_t capacity;
+    size_t opens;
+    size_t writes;
+    size_t total;
+};
+
+/**
+ * Parse a sink specification into a closed sink descriptor. A PATH that
+ * names a FIFO is a FIFO; anything else is a file, created if need be.
+ * @param sp points to the sink descriptor.
+ * @param name is the sink specification, which must outlive the sink.
+ * @return 0 for success, <0 with errno set for failure.
+ */
+extern int sink_parse(struct sink * sp, const char * name);
+
+/**
+ * Initialize a closed sink descriptor for a shared memory ring, which will be
+ * created with the permissions RING_MODE unless its mode is changed before it
+ * is opened. If its cancel flag is set before it is opened, waits for the
+ * ring give up as soon as the flag is (see ring_cancel).
+ * @param sp points to the sink descriptor.
+ * @param name is the name of the ring, which must outlive the sink.
+ * @return 0 for success, <0 with errno set for failure.
+ */
+extern int sink_ring(struct sink * sp, const char * name);
+
+/**
+ * Open a sink. A FIFO or file is opened for appending, a ring is created
+ * or attached to, and a socket is connected.
+ * @param sp points to the sink descriptor.
+ * @return 0 for success, <0 with errno set for failure.
+ */
+extern int sink_open(struct sink * sp);
+
+/**
+ * Close a sink, publishing a partially filled slot of a ring and wiping
+ * the staging buffer. Closing a sink that is already closed has no effect.
+ * @param sp points to the sink descriptor.
+ */
+extern void sink_close(struct sink * sp);
+
+/**
+ * Return a vector of buffers into which a producer may place data to be
+ * committed to the sink.
+ * @param sp points to the sink descriptor.
+ * @param vector points to the vector to be filled in.
+ * @param count is the most buffers the vector can describe.
+ * @param size is the most bytes any one buffer may hold.
+ * @return the number of buffers, or <0 with errno set for failure (EAGAIN if
+ * a ring had no free slot within SINK_TIMEOUT milliseconds, EINTR if the
+ * wait for one was cancelled).
+ */
+extern int sink_reserve(struct sink * sp, struct iovec * vector, int count, size_t size);
+
+/**
+ * Commit the data a producer placed in the buffers returned by the last
+ * sink_reserve, which must fill those buffers in order.
+ * @param sp points to the sink descriptor.
+ * @param size is the number of bytes placed in the buffers.
+ * @return 0 for success, <0 with errno set for failure.
+ */
+extern int sink_commit(struct sink * sp, size_t size);
+
+/**
+ * Write a vector of buffers to an open sink. A FIFO, file, or socket is
+ * written with writev(2), picking up where a short write left off.
+ * @param sp points to the sink descriptor.
+ * @param vector points to the vector of buffers.
+ * @param count is the number of buffers in the vector.
+ * @return the number of bytes written, which is less than requested only if
+ * the write failed (errno set) or a ring had no free slot within
+ * SINK_TIMEOUT milliseconds (errno is EAGAIN) or the wait for one was
+ * cancelled (errno is EINTR).
+ */
+extern size_t sink_writev(struct sink * sp, const struct iovec * vector, int count);
+
+#endif
@@ -0,0 +1,412 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Source<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#if defined(SCATTERGUN_HAS_RDRAND_INLINE) || defined(SCATTERGUN_HAS_RDRAND_INTRINSIC)
+#   define __RDRND__
+#   include <immintrin.h>
+#endif
+#include "tty.h"
+#include "source.h"
+#include "probes.h"
+
+const char * SOURCE_KINDS[] = { "none", "rdrand", "rdseed", "quantis", "device", "tty", "file", };
+
+#if defined(__i386__) || defined(__x86_64__)
+
+/**
+ * Run the rdrand instruction.
+ * @param wp points to the result word.
+ * @return the carry bit indicating success.
+ */
+static inline uint8_t rdrand(uint32_t * wp)
+{
+#if defined(SCATTERGUN_HAS_RDRAND_INLINE)
+    return _rdrand32_step(wp);
+#elif defined(SCATTERGUN_HAS_RDRAND_INTRINSIC)
+    return __builtin_ia32_rdrand32_step(wp);
+#elif defined(SCATTERGUN_HAS_RDRAND_MNEMONIC)
+    uint8_t carry = 1;
+    asm volatile ("rdrand %0; setc %1" : "=r" (*wp), "=qm" (carry));
+    return carry;
+#else
+    uint8_t carry = 1;
+    asm volatile (".byte 0x0f,0xc7,0xf0; setc %0" : "=qm" (carry), "=a" (*wp));
+    return carry;
+#endif
+}
+
+/**
+ * Run the rdseed instruction.
+ * @param wp points to the result word.
+ * @return the carry bit indicating success.
+ */
+static inline uint8_t rdseed(uint32_t * wp)
+{
+#if defined(SCATTERGUN_HAS_RDSEED_INTRINSIC)
+    return __builtin_ia32_rdseed32_step(wp);
+#elif defined(SCATTERGUN_HAS_RDSEED_MNEMONIC)
+    uint8_t carry = 1;
+    asm volatile ("rdseed %0; setc %1" : "=r" (*wp), "=qm" (carry));
+    return carry;
+#else
+    uint8_t carry = 1;
+    asm volatile (".byte 0x0f,0xc7,0xf8; setc %0" : "=qm" (carry), "=a" (*wp));
+    return carry;
+#endif
+}
+
+#endif
+
+int source_parse(struct source * sp, const char * name)
+{
+    struct stat status = { 0 };
+#if defined(SCATTERGUN_HAS_QUANTIS)
+    char * end = (char *)0;
+#endif
+
+    memset(sp, 0, sizeof(*sp));
+    sp->name = name;
+    sp->fd = -1;
+
+    if (strcmp(name, "rdrand") == 0) {
+#if defined(__i386__) || defined(__x86_64__)
+        sp->kind = SOURCE_RDRAND;
+#else
+        errno = ENOTSUP;
+        return -1;
+#endif
+    } else if (strcmp(name, "rdseed") == 0) {
+#if defined(__i386__) || defined(__x86_64__)
+        sp->kind = SOURCE_RDSEED;
+#else
+        errno = ENOTSUP;
+        return -1;
+#endif
+    } else if ((strncmp(name, "usb:", 4) == 0) || (strncmp(name, "pci:", 4) == 0)) {
+#if defined(SCATTERGUN_HAS_QUANTIS)
+        sp->kind = SOURCE_QUANTIS;
+        sp->type = (name[0] == 'u') ? QUANTIS_DEVICE_USB : QUANTIS_DEVICE_PCI;
+        sp->unit = strtoul(name + 4, &end, 0);
+        if (*end != '\0') {
+            errno = EINVAL;
+            return -1;
+        }
+#else
+        errno = ENOTSUP;
+        return -1;
+#endif
+    } else if (strncmp(name, "onerng:", 7) == 0) {
+        sp->name = name + 7;
+        sp->kind = SOURCE_TTY;
+        sp->onerng = !0;
+    } else if (stat(name, &status) < 0) {
+        return -1;
+    } else if (S_ISCHR(status.st_mode)) {
+        sp->kind = SOURCE_DEVICE;
+    } else if (S_ISFIFO(status.st_mode)) {
+        sp->kind = SOURCE_DEVICE;
+    } else {
+        sp->kind = SOURCE_FILE;
+    }
+
+    return 0;
+}
+
+int source_open(struct source * sp)
+{
+    int rc = -1;
+
+    sp->status = 0;
+
+    switch (sp->kind) {
+
+    case SOURCE_RDRAND:
+    case SOURCE_RDSEED:
+        rc = 0;
+        break;
+
+#if defined(SCATTERGUN_HAS_QUANTIS)
+    case SOURCE_QUANTIS:
+        rc = QuantisOpen(sp->type, sp->unit, &(sp->handle));
+        if (rc < QUANTIS_SUCCESS) {
+            sp->status = rc;
+            sp->handle = (QuantisDeviceHandle *)0;
+            errno = EIO;
+            rc = -1;
+        } else {
+            rc = 0;
+        }
+        break;
+#endif
+
+    case SOURCE_DEVICE:
+    case SOURCE_TTY:
+    case SOURCE_FILE:
+        sp->fd = open(sp->name, (sp->onerng ? O_RDWR : O_RDONLY) | O_NOCTTY);
+        if (sp->fd < 0) {
+            break;
+        }
+        if (!isatty(sp->fd)) {
+            rc = 0;
+            break;
+        }
+        sp->kind = SOURCE_TTY;
+        if (tty_raw(sp->fd, TTY_VMIN, TTY_VTIME) < 0) {
+            break;
+        }
+        if (sp->onerng && (tty_onerng(sp->fd) < 0)) {
+            break;
+        }
+        if (sp->staging == (uint8_t *)0) {
+            sp->staging = (uint8_t *)malloc(TTY_READ);
+            if (sp->staging == (uint8_t *)0) {
+                break;
+            }
+        }
+        sp->staged = 0;
+        sp->offset = 0;
+        rc = 0;
+        break;
+
+    default:
+        errno = EINVAL;
+        break;
+
+    }
+
+    if (rc == 0) {
+        ++(sp->opens);
+    }
+
+    return rc;
+}
+
+void source_close(struct source * sp)
+{
+#if defined(SCATTERGUN_HAS_QUANTIS)
+    if (sp->handle != (QuantisDeviceHandle *)0) {
+        QuantisClose(sp->handle);
+        sp->handle = (QuantisDeviceHandle *)0;
+    }
+#endif
+    if (sp->fd >= 0) {
+        close(sp->fd);
+        sp->fd = -1;
+    }
+    if (sp->staging != (uint8_t *)0) {
+        memset(sp->staging, 0, TTY_READ);
+        free(sp->staging);
+        sp->staging = (uint8_t *)0;
+    }
+    sp->staged = 0;
+    sp->offset = 0;
+}
+
+/**
+ * Fill a buffer from an open source unless it ends, is interrupted, or fails
+ * first.
+ * @param sp points to the source descriptor.
+ * @param buffer points to the buffer.
+ * @param size is the size of the buffer in bytes.
+ * @return the number of bytes read, which is short if the source ended or a
+ * signal interrupted it part way, 0 for end of file, <0 with errno set for
+ * failure (EINTR if a signal interrupted it before anything was read).
+ */
+static ssize_t fill(struct source * sp, void * buffer, size_t size)
+{
+    static const size_t CONSECUTIVE = 10;
+    static const struct timespec request = { 0, 1000000 };
+    uint8_t * here = (uint8_t *)buffer;
+    size_t remaining = size;
+    size_t consecutive = 0;
+    ssize_t bytes = 0;
+#if defined(__i386__) || defined(__x86_64__)
+    uint32_t word = 0;
+    uint8_t carry = 0;
+#endif
+#if defined(SCATTERGUN_HAS_QUANTIS)
+    int rc = 0;
+#endif
+
+    while (remaining > 0) {
+
+        switch (sp->kind) {
+
+#if defined(__i386__) || defined(__x86_64__)
+        case SOURCE_RDRAND:
+        case SOURCE_RDSEED:
+            carry = (sp->kind == SOURCE_RDRAND) ? rdrand(&word) : rdseed(&word);
+            if (carry) {
+                consecutive = 0;
+                bytes = (remaining < sizeof(word)) ? remaining : sizeof(word);
+                memcpy(here, &word, bytes);
+            } else if ((++consecutive) >= CONSECUTIVE) {
+                PROBE2(carry__failure, sp->kind, consecutive);
+                errno = EBUSY;
+                return -1;
+            } else {
+                PROBE2(carry__failure, sp->kind, consecutive);
+                nanosleep(&request, (struct timespec *)0);
+                continue;
+            }
+            break;
+#endif
+
+#if defined(SCATTERGUN_HAS_QUANTIS)
+        case SOURCE_QUANTIS:
+            rc = QuantisReadHandled(sp->handle, here, remaining);
+            if (rc < QUANTIS_SUCCESS) {
+                sp->status = rc;
+                errno = EIO;
+                return -1;
+            }
+            bytes = remaining;
+            break;
+#endif
+
+        case SOURCE_TTY:
+            if (sp->offset >= sp->staged) {
+                bytes = read(sp->fd, sp->staging, TTY_READ);
+                if (bytes > 0) {
+                    /* Do nothing. */
+                } else if (bytes == 0) {
+                    return size - remaining;
+                } else if ((errno == EINTR) && (remaining < size)) {
+                    return size - remaining;
+                } else {
+                    return -1;
+                }
+                ++(sp->reads);
+                sp->total += bytes;
+                sp->staged = bytes;
+                sp->offset = 0;
+            }
+            bytes = sp->staged - sp->offset;
+            if (bytes > remaining) { bytes = remaining; }
+            memcpy(here, sp->staging + sp->offset, bytes);
+            sp->offset += bytes;
+            here += bytes;
+            remaining -= bytes;
+            continue;
+
+        case SOURCE_DEVICE:
+        case SOURCE_FILE:
+            bytes = read(sp->fd, here, remaining);
+            if (bytes > 0) {
+                /* Do nothing. */
+            } else if (bytes == 0) {
+                return size - remaining;
+            } else if ((errno == EINTR) && (remaining < size)) {
+                return size - remaining;
+            } else {
+                return -1;
+            }
+            break;
+
+        default:
+            errno = EINVAL;
+            return -1;
+
+        }
+
+        ++(sp->reads);
+        sp->total += bytes;
+        here += bytes;
+        remaining -= bytes;
+
+    }
+
+    return size;
+}
+
+ssize_t source_read(struct source * sp, void * buffer, size_t size)
+{
+    struct iovec vector;
+
+    vector.iov_base = buffer;
+    vector.iov_len = size;
+
+    return source_readv(sp, &vector, 1);
+}
+
+ssize_t source_readv(struct source * sp, const struct iovec * vector, int count)
+{
+    struct iovec pending[SOURCE_VECTOR];
+    ssize_t total = 0;
+    ssize_t bytes = 0;
+    int first = 0;
+    int nn = 0;
+    int ii;
+
+    if ((sp->kind != SOURCE_DEVICE) && (sp->kind != SOURCE_FILE)) {
+        for (ii = 0; ii < count; ++ii) {
+            bytes = fill(sp, vector[ii].iov_base, vector[ii].iov_len);
+            if (bytes < 0) {
+                return (total > 0) ? total : bytes;
+            }
+            total += bytes;
+            if ((size_t)bytes < vector[ii].iov_len) {
+                break;
+            }
+        }
+        return total;
+    }
+
+    /*
+     * Devices, FIFOs, and files fill as many buffers as they can with each
+     * system call, picking up where a short read left off.
+     */
+
+    for (ii = 0; ii < count; ii += nn) {
+
+        nn = count - ii;
+        if (nn > SOURCE_VECTOR) { nn = SOURCE_VECTOR; }
+        memcpy(pending, vector + ii, nn * sizeof(pending[0]));
+
+        for (first = 0; first < nn; ) {
+            bytes = readv(sp->fd, pending + first, nn - first);
+            if (bytes > 0) {
+                /* Do nothing. */
+            } else if (bytes == 0) {
+                return total;
+            } else if ((errno == EINTR) && (total > 0)) {
+                return total;
+            } else {
+                return -1;
+            }
+            ++(sp->reads);
+            sp->total += bytes;
+            total += bytes;
+            while ((first < nn) && (bytes >= pending[first].iov_len)) {
+                bytes -= pending[first].iov_len;
+                ++first;
+            }
+            if (first < nn) {
+                pending[first].iov_base = (uint8_t *)pending[first].iov_base + bytes;
+                pending[first].iov_len -= bytes;
+            }
+        }
+
+    }
+
+    return total;
+}
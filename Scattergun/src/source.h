@@ -0,0 +1,131 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+#ifndef _H_COM_DIAG_SCATTERGUN_SOURCE_
+#define _H_COM_DIAG_SCATTERGUN_SOURCE_
+
+/**
+ * @file
+ * Source<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * Reads entropy from any of the sources Scattergun knows about: the Intel
+ * rdrand and rdseed instructions, an ID Quantique Quantis (if compiled with
+ * SCATTERGUN_HAS_QUANTIS and linked with the Quantis library), a serial
+ * device like the TrueRNG, TrueRNGpro, or OneRNG, a character device like
+ * /dev/hwrng, a FIFO, or a file. A source is named by a specification that
+ * is "rdrand", "rdseed", "usb:UNIT", "pci:UNIT", "onerng:PATH", or a PATH.
+ * This is part of the Scattergun project.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#if defined(SCATTERGUN_HAS_QUANTIS)
+#   include "Quantis.h"
+#endif
+
+/**
+ * This is the most buffers a device, FIFO, or file fills in one system call.
+ */
+#define SOURCE_VECTOR 16
+
+enum source_kind {
+    SOURCE_NONE = 0,
+    SOURCE_RDRAND = 1,
+    SOURCE_RDSEED = 2,
+    SOURCE_QUANTIS = 3,
+    SOURCE_DEVICE = 4,
+    SOURCE_TTY = 5,
+    SOURCE_FILE = 6,
+};
+
+/**
+ * These are the names of the kinds of sources indexed by kind.
+ */
+extern const char * SOURCE_KINDS[];
+
+/**
+ * This describes an open or closed source and counts its use.
+ */
+struct source {
+    const char * name;
+    enum source_kind kind;
+    int fd;
+#if defined(SCATTERGUN_HAS_QUANTIS)
+    QuantisDeviceType type;
+    QuantisDeviceHandle * handle;
+#endif
+    unsigned int unit;
+    int onerng;
+    int status;
+    uint8_t * staging;
+    size_t staged;
+    size_t offset;
+    size_t opens;
+    size_t reads;
+    size_t total;
+};
+
+/**
+ * Parse a source specification into a closed source descriptor. A PATH that
+ * names a character device or a FIFO is a device; anything else is a file.
+ * @param sp points to the source descriptor.
+ * @param name is the source specification, which must outlive the source.
+ * @return 0 for success, <0 with errno set for failure.
+ */
+extern int source_parse(struct source * sp, const char * name);
+
+/**
+ * Open a source. A device that turns out to be a serial device is placed
+ * into raw low latency mode (and a OneRNG initialized) and given a staging
+ * buffer so that it can be read in large blocks. If a Quantis fails, its
+ * library error code is left in the status field.
+ * @param sp points to the source descriptor.
+ * @return 0 for success, <0 with errno set for failure.
+ */
+extern int source_open(struct source * sp);
+
+/**
+ * Close a source, wiping its staging buffer. Closing a source that is
+ * already closed has no effect.
+ * @param sp points to the source descriptor.
+ */
+extern void source_close(struct source * sp);
+
+/**
+ * Read exactly the requested number of bytes from an open source unless it
+ * ends, is interrupted by a signal, or fails first. Interrupted system calls
+ * are not restarted, so that a caller can check for a request to stop.
+ * @param sp points to the source descriptor.
+ * @param buffer points to the buffer.
+ * @param size is the size of the buffer in bytes.
+ * @return the number of bytes read, which is short if the source ended or a
+ * signal interrupted it part way, 0 for end of file, <0 with errno set for
+ * failure (EINTR if a signal interrupted it before anything was read).
+ */
+extern ssize_t source_read(struct source * sp, void * buffer, size_t size);
+
+/**
+ * Fill each of a vector of buffers in turn from an open source unless it
+ * ends or fails first. A device, FIFO, or file is read with readv(2), so that
+ * many buffers are filled with a single system call; a Quantis is read once
+ * per buffer, so no buffer should exceed the Quantis maximum read size.
+ * Interrupted system calls are not restarted.
+ * @param sp points to the source descriptor.
+ * @param vector points to the vector of buffers.
+ * @param count is the number of buffers in the vector.
+ * @return the number of bytes read, which is short if the source ended or a
+ * signal interrupted it part way, 0 for end of file, <0 with errno set for
+ * failure (EINTR if a signal interrupted it before anything was read).
+ */
+extern ssize_t source_readv(struct source * sp, const struct iovec * vector, int count);
+
+#endif
@@ -0,0 +1,329 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Timeline<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * timeline [ -h ] [ -o FILE ] [ -s STAGE ] [ -n STEP ] [ -f PATH ] [ -C DIRECTORY ] COMMAND [ ARGUMENT ... ]
+ *
+ * OPTIONS
+ *
+ * -C DIRECTORY    Run COMMAND in DIRECTORY.
+ * -f PATH         Report the size of PATH afterwards as the bytes of the step.
+ * -h              Display this menu.
+ * -n STEP         Name the step STEP (default the name of COMMAND).
+ * -o FILE         Append the record to FILE (default standard output).
+ * -s STAGE        Name the stage STAGE (default "none").
+ *
+ * EXAMPLES
+ *
+ * timeline -o timeline.csv -s ent -n capture -f ent.dat dd of=ent.dat bs=1024 count=4096 iflag=fullblock
+ *
+ * timeline -o timeline.csv -s ent -n test -f ent.dat ent ent.dat
+ *
+ * timeline -o timeline.csv -s sp800 -n iid -C ${NISTPATH} python iid_main.py sp800.dat 8 1000 -v
+ *
+ * ABSTRACT
+ *
+ * Runs COMMAND as a child process, waits for it with wait4(2), and appends
+ * one comma separated value (CSV) record describing it to FILE: the stage
+ * and step names, the UTC start and end times, the elapsed wall clock, user,
+ * and system times in seconds, the maximum resident set size in kilobytes,
+ * the size of PATH in bytes (if -f is given), the exit status, and COMMAND
+ * itself. The CPU times and resident set size include those of any of its
+ * descendants that COMMAND waited for, so a shell pipeline can be measured by
+ * running it under "bash -c". A header line is written first if FILE is
+ * empty. The record is also displayed on standard error in key=value form.
+ * The exit status of timeline is that of COMMAND, or 128 plus the signal
+ * number if COMMAND was killed, so it can be dropped in wherever the shell's
+ * time keyword was used. This is part of the Scattergun project.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+static const char * program = "timeline";
+
+static const char HEADER[] = "stage,step,start,end,wall,user,system,maxrss,bytes,status,command\n";
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [ -h ] [ -o FILE ] [ -s STAGE ] [ -n STEP ] [ -f PATH ] [ -C DIRECTORY ] COMMAND [ ARGUMENT ... ]\n", program);
+    fprintf(stderr, "       -C DIRECTORY    Run COMMAND in DIRECTORY.\n");
+    fprintf(stderr, "       -f PATH         Report the size of PATH afterwards as the bytes of the step.\n");
+    fprintf(stderr, "       -h              Display this menu.\n");
+    fprintf(stderr, "       -n STEP         Name the step STEP (default the name of COMMAND).\n");
+    fprintf(stderr, "       -o FILE         Append the record to FILE (default standard output).\n");
+    fprintf(stderr, "       -s STAGE        Name the stage STAGE (default \"none\").\n");
+}
+
+/**
+ * Return the value of the monotonic clock in seconds.
+ * @return the value of the monotonic clock in seconds.
+ */
+static double now(void)
+{
+    struct timespec ts = { 0 };
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+}
+
+/**
+ * Format the current UTC time in ISO8601 form to the millisecond.
+ * @param buffer points to the buffer.
+ * @param size is the size of the buffer in bytes.
+ */
+static void stamp(char * buffer, size_t size)
+{
+    struct timespec ts = { 0 };
+    struct tm tm = { 0 };
+    size_t length = 0;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    gmtime_r(&ts.tv_sec, &tm);
+    length = strftime(buffer, size, "%Y-%m-%dT%H:%M:%S", &tm);
+    snprintf(buffer + length, size - length, ".%03ld", ts.tv_nsec / 1000000L);
+}
+
+/**
+ * Convert a time value into seconds.
+ * @param tvp points to the time value.
+ * @return the time value in seconds.
+ */
+static double seconds(const struct timeval * tvp)
+{
+    return tvp->tv_sec + (tvp->tv_usec / 1000000.0);
+}
+
+/**
+ * Append a command line to a buffer as a single quoted CSV field, doubling
+ * any quotes that it contains.
+ * @param buffer points to the buffer.
+ * @param size is the size of the buffer in bytes.
+ * @param argc is the count of arguments.
+ * @param argv is the vector of arguments.
+ * @return the length of the resulting string.
+ */
+static size_t quote(char * buffer, size_t size, int argc, char ** argv)
+{
+    size_t length = 0;
+    const char * pp = (const char *)0;
+    int ii = 0;
+
+    if (length < (size - 1)) { buffer[length++] = '"'; }
+    for (ii = 0; ii < argc; ++ii) {
+        if ((ii > 0) && (length < (size - 1))) { buffer[length++] = ' '; }
+        for (pp = argv[ii]; *pp != '\0'; ++pp) {
+            if ((*pp == '"') && (length < (size - 1))) { buffer[length++] = '"'; }
+            if (length < (size - 1)) { buffer[length++] = *pp; }
+        }
+    }
+    if (length < (size - 1)) { buffer[length++] = '"'; }
+    buffer[length] = '\0';
+
+    return length;
+}
+
+/**
+ * This is the main program.
+ * @param argc is the count of command line arguments.
+ * @param argv is a vector of pointers to the command line arguments.
+ */
+int main(int argc, char * argv[])
+{
+    int xc = 127;
+    int error = 0;
+    int fd = STDOUT_FILENO;
+    int status = 0;
+    pid_t pid = 0;
+    double epoch = 0.0;
+    double wall = 0.0;
+    ssize_t length = 0;
+    const char * file = (const char *)0;
+    const char * stage = "none";
+    const char * step = (const char *)0;
+    const char * path = (const char *)0;
+    const char * directory = (const char *)0;
+    struct rusage resources = { { 0 } };
+    struct stat statbuf = { 0 };
+    struct sigaction ignore = { { 0 } };
+    struct sigaction oldint = { { 0 } };
+    struct sigaction oldquit = { { 0 } };
+    char start[sizeof("YYYY-MM-DDTHH:MM:SS.mmm")];
+    char end[sizeof(start)];
+    char bytes[sizeof("18446744073709551615")] = "";
+    char command[1024];
+    char record[sizeof(command) + 512];
+    extern char * optarg;
+    extern int optind;
+    int opt;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    /*
+     * The leading plus stops option processing at COMMAND, so that its own
+     * options are left alone.
+     */
+
+    while ((opt = getopt(argc, argv, "+C:f:hn:o:s:")) >= 0) {
+        switch (opt) {
+        case 'C':
+            directory = optarg;
+            break;
+        case 'f':
+            path = optarg;
+            break;
+        case 'h':
+            usage();
+            return 0;
+            break;
+        case 'n':
+            step = optarg;
+            break;
+        case 'o':
+            file = optarg;
+            break;
+        case 's':
+            stage = optarg;
+            break;
+        default:
+            error = !0;
+            break;
+        }
+    }
+
+    if (optind >= argc) {
+        error = !0;
+    }
+
+    if (error) {
+        usage();
+        return 1;
+    }
+
+    if (step == (const char *)0) {
+        step = ((step = strrchr(argv[optind], '/')) == (char *)0) ? argv[optind] : step + 1;
+    }
+
+    do {
+
+        if (file == (const char *)0) {
+            /* Do nothing. */
+        } else if ((fd = open(file, O_WRONLY | O_APPEND | O_CREAT, 0666)) < 0) {
+            perror(file);
+            break;
+        } else if (fstat(fd, &statbuf) < 0) {
+            perror(file);
+            break;
+        } else if (statbuf.st_size > 0) {
+            /* Do nothing. */
+        } else if (write(fd, HEADER, sizeof(HEADER) - 1) < 0) {
+            perror(file);
+            break;
+        } else {
+            /* Do nothing. */
+        }
+
+        /*
+         * Like system(3), let the child alone decide what to do about an
+         * interrupt from the terminal, so that its record is still written.
+         */
+
+        ignore.sa_handler = SIG_IGN;
+        sigaction(SIGINT, &ignore, &oldint);
+        sigaction(SIGQUIT, &ignore, &oldquit);
+
+        stamp(start, sizeof(start));
+        epoch = now();
+
+        if ((pid = fork()) < 0) {
+            perror("fork");
+            break;
+        }
+
+        if (pid == 0) {
+            sigaction(SIGINT, &oldint, (struct sigaction *)0);
+            sigaction(SIGQUIT, &oldquit, (struct sigaction *)0);
+            if (fd != STDOUT_FILENO) { close(fd); }
+            if ((directory != (const char *)0) && (chdir(directory) < 0)) {
+                perror(directory);
+                _exit(127);
+            }
+            execvp(argv[optind], &argv[optind]);
+            perror(argv[optind]);
+            _exit(127);
+        }
+
+        while (wait4(pid, &status, 0, &resources) < 0) {
+            if (errno != EINTR) {
+                perror("wait4");
+                break;
+            }
+        }
+
+        wall = now() - epoch;
+        stamp(end, sizeof(end));
+
+        if (WIFEXITED(status)) {
+            xc = WEXITSTATUS(status);
+        } else if (WIFSIGNALED(status)) {
+            xc = 128 + WTERMSIG(status);
+        } else {
+            /* Do nothing. */
+        }
+
+        if (path == (const char *)0) {
+            /* Do nothing. */
+        } else if (stat(path, &statbuf) < 0) {
+            /* Do nothing. */
+        } else {
+            snprintf(bytes, sizeof(bytes), "%llu", (unsigned long long)statbuf.st_size);
+        }
+
+        quote(command, sizeof(command), argc - optind, &argv[optind]);
+
+        fprintf(stderr, "%s: stage=\"%s\" step=\"%s\" wall=%.3f user=%.3f system=%.3f maxrss=%ld bytes=%s status=%d\n", program, stage, step, wall, seconds(&resources.ru_utime), seconds(&resources.ru_stime), resources.ru_maxrss, (bytes[0] != '\0') ? bytes : "-", xc);
+
+        /*
+         * The record goes out in a single write so that steps run at the
+         * same time can share a timeline without their lines interleaving.
+         */
+
+        length = snprintf(record, sizeof(record), "%s,%s,%s,%s,%.3f,%.3f,%.3f,%ld,%s,%d,%s\n", stage, step, start, end, wall, seconds(&resources.ru_utime), seconds(&resources.ru_stime), resources.ru_maxrss, bytes, xc, command);
+        if (length >= (ssize_t)sizeof(record)) {
+            length = sizeof(record) - 1;
+            record[length - 1] = '\n';
+        }
+        if (write(fd, record, length) < 0) {
+            perror((file != (const char *)0) ? file : "write");
+        }
+
+    } while (0);
+
+    if ((fd != STDOUT_FILENO) && (fd >= 0)) {
+        close(fd);
+    }
+
+    return xc;
+}
@@ -0,0 +1,551 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * Toeplitz<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * toeplitz [ -h ] [ -v ] -k PATH [ -i BYTES ] [ -o BYTES | -r MINENTROPY ]
+ *
+ * OPTIONS
+ *
+ * -h              Display this menu.
+ * -i BYTES        Extract from input blocks of BYTES (default 1024).
+ * -k PATH         Read the seed of the matrix from PATH.
+ * -o BYTES        Extract output blocks of BYTES (default 512).
+ * -r MINENTROPY   Size the output for MINENTROPY bits of min-entropy per input bit.
+ * -v              Display verbose output to stderr.
+ *
+ * EXAMPLES
+ *
+ * dd if=/dev/random of=toeplitz.seed bs=1536 count=1 iflag=fullblock
+ *
+ * quantistool -U 0 | toeplitz -k toeplitz.seed -r 0.9 | rngtest
+ *
+ * toeplitz -v -k toeplitz.seed -i 4096 -o 2048 < raw.dat > extracted.dat
+ *
+ * ABSTRACT
+ *
+ * Reads blocks of N bits from standard input, multiplies each by an M by N
+ * Toeplitz matrix over GF(2), and writes the resulting M bits to standard
+ * output. Toeplitz hashing is a two-universal family, so by the leftover
+ * hash lemma, if each input block has at least K bits of min-entropy the
+ * output is within 2^-((K - M) / 2) of uniform; this is the post-processing
+ * ID Quantique recommends for the Quantis. Given the min-entropy per input
+ * bit, the output size is chosen to leave a security margin of 128 bits,
+ * for a distance from uniform of no more than 2^-64. The matrix is defined
+ * by N + M - 1 seed bits that are read from a file, which should come from
+ * a good source once, be kept, and be the same for every use, so that the
+ * extraction is reproducible; the seed need not be secret, but must not
+ * depend on the input. The product of a Toeplitz matrix and a vector is
+ * the middle M bits of the carry-less product of the seed and the input,
+ * which is computed sixty-four bits at a time: with the PCLMULQDQ
+ * instruction in toeplitz-pclmul for processors that have it, or otherwise
+ * with tables of the multiples of each seed word built once at startup.
+ * A partial input block at the end is discarded. When done the throughput
+ * is displayed on standard error. This is part of the Scattergun project.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <endian.h>
+#include <unistd.h>
+#if defined(SCATTERGUN_HAS_PCLMUL)
+#   include <emmintrin.h>
+#   include <wmmintrin.h>
+#endif
+
+enum {
+    MARGIN = 128,       /* Bits of min-entropy left over for security. */
+};
+
+/**
+ * This is the matrix, defined by its seed, and the scratch space for the
+ * product.
+ */
+struct matrix {
+    size_t inbits;
+    size_t outbits;
+    size_t seedwords;
+    size_t inwords;
+    size_t outwords;
+    size_t first;       /* First sum of word indices needed. */
+    size_t last;        /* Last sum of word indices needed. */
+    uint64_t * seed;
+    uint64_t * product;
+#if !defined(SCATTERGUN_HAS_PCLMUL)
+    uint64_t (* low)[16];
+    uint64_t (* high)[16];
+#endif
+};
+
+static const char * program = "toeplitz";
+static int done = 0;
+
+static void handler(int signum)
+{
+    if (signum == SIGPIPE) {
+        done = !0;
+    } else if (signum == SIGINT) {
+        done = !0;
+    } else if (signum == SIGTERM) {
+        done = !0;
+    } else {
+        /* Do nothing. */
+    }
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s [ -h ] [ -v ] -k PATH [ -i BYTES ] [ -o BYTES | -r MINENTROPY ]\n", program);
+    fprintf(stderr, "       -h              Display this menu.\n");
+    fprintf(stderr, "       -i BYTES        Extract from input blocks of BYTES (default 1024).\n");
+    fprintf(stderr, "       -k PATH         Read the seed of the matrix from PATH.\n");
+    fprintf(stderr, "       -o BYTES        Extract output blocks of BYTES (default 512).\n");
+    fprintf(stderr, "       -r MINENTROPY   Size the output for MINENTROPY bits of min-entropy per input bit.\n");
+    fprintf(stderr, "       -v              Display verbose output to stderr.\n");
+}
+
+/**
+ * Return the value of the monotonic clock in seconds.
+ * @return the value of the monotonic clock in seconds.
+ */
+static double now(void)
+{
+    struct timespec ts = { 0 };
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+}
+
+/**
+ * Read exactly the specified number of bytes unless the input ends.
+ * @param fd is the file descriptor.
+ * @param buffer points to the buffer.
+ * @param size is the number of bytes.
+ * @return the number of bytes read.
+ */
+static size_t fill(int fd, void * buffer, size_t size)
+{
+    size_t length = 0;
+    ssize_t rc = 0;
+
+    while (length < size) {
+        rc = read(fd, (uint8_t *)buffer + length, size - length);
+        if (rc > 0) {
+            length += rc;
+        } else if ((rc < 0) && (errno == EINTR) && (!done)) {
+            /* Do nothing. */
+        } else {
+            if (rc < 0) { perror("read"); }
+            break;
+        }
+    }
+
+    return length;
+}
+
+/**
+ * Read the seed and set up the matrix.
+ * @param mp points to the matrix.
+ * @param path is the path of the seed file.
+ * @return 0 for success, <0 for failure.
+ */
+static int setup(struct matrix * mp, const char * path)
+{
+    size_t seedbits = mp->inbits + mp->outbits - 1;
+    size_t bytes = (seedbits + 7) / 8;
+    size_t ii;
+    int fd = -1;
+    int rc = -1;
+
+    mp->seedwords = (seedbits + 63) / 64;
+    mp->inwords = mp->inbits / 64;
+    mp->outwords = mp->outbits / 64;
+
+    /*
+     * Output bit I is bit N - 1 + I of the product, so only the words of
+     * the product from (N - 1) / 64 to (N + M - 2) / 64 are needed, and
+     * each gets the low half of the products of word pairs whose indices
+     * sum to it and the high half of those whose indices sum to one less.
+     */
+
+    mp->first = ((mp->inbits - 1) / 64);
+    mp->first = (mp->first > 0) ? (mp->first - 1) : 0;
+    mp->last = (mp->inbits + mp->outbits - 2) / 64;
+
+    mp->seed = (uint64_t *)calloc(mp->seedwords, sizeof(uint64_t));
+    mp->product = (uint64_t *)calloc(mp->last - mp->first + 2, sizeof(uint64_t));
+    if ((mp->seed == (uint64_t *)0) || (mp->product == (uint64_t *)0)) {
+        perror("calloc");
+        return -1;
+    }
+
+    do {
+
+        fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            perror(path);
+            break;
+        }
+
+        if (fill(fd, mp->seed, bytes) < bytes) {
+            errno = EINVAL;
+            perror(path);
+            break;
+        }
+
+        rc = 0;
+
+    } while (0);
+
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    if (rc < 0) {
+        return rc;
+    }
+
+    for (ii = 0; ii < mp->seedwords; ++ii) {
+        mp->seed[ii] = le64toh(mp->seed[ii]);
+    }
+    if ((seedbits % 64) != 0) {
+        mp->seed[mp->seedwords - 1] &= (1ULL << (seedbits % 64)) - 1;
+    }
+
+#if !defined(SCATTERGUN_HAS_PCLMUL)
+    {
+        uint64_t word = 0;
+        int kk;
+        int jj;
+
+        /*
+         * Each seed word times each four bit number is at most sixty-seven
+         * bits long.
+         */
+
+        mp->low = (uint64_t (*)[16])calloc(mp->seedwords, sizeof(mp->low[0]));
+        mp->high = (uint64_t (*)[16])calloc(mp->seedwords, sizeof(mp->high[0]));
+        if ((mp->low == (uint64_t (*)[16])0) || (mp->high == (uint64_t (*)[16])0)) {
+            perror("calloc");
+            return -1;
+        }
+        for (ii = 0; ii < mp->seedwords; ++ii) {
+            word = mp->seed[ii];
+            for (kk = 0; kk < 16; ++kk) {
+                for (jj = 0; jj < 4; ++jj) {
+                    if (kk & (1 << jj)) {
+                        mp->low[ii][kk] ^= word << jj;
+                        mp->high[ii][kk] ^= (jj > 0) ? (word >> (64 - jj)) : 0;
+                    }
+                }
+            }
+        }
+    }
+#endif
+
+    return 0;
+}
+
+/**
+ * Multiply the matrix by an input block.
+ * @param mp points to the matrix.
+ * @param in points to the input block.
+ * @param out points to the output block.
+ */
+static void multiply(struct matrix * mp, const uint64_t * in, uint64_t * out)
+{
+    uint64_t * product = mp->product;
+    size_t sum;
+    size_t lo;
+    size_t hi;
+    size_t bb;
+    size_t ii;
+    size_t word;
+    int shift;
+
+    memset(product, 0, (mp->last - mp->first + 2) * sizeof(uint64_t));
+
+    for (sum = mp->first; sum <= mp->last; ++sum) {
+
+        /*
+         * Input word BB pairs with seed word SUM - BB.
+         */
+
+        lo = (sum >= mp->seedwords) ? (sum - mp->seedwords + 1) : 0;
+        hi = (sum < mp->inwords) ? sum : (mp->inwords - 1);
+
+#if defined(SCATTERGUN_HAS_PCLMUL)
+        {
+            __m128i accumulator = _mm_setzero_si128();
+
+            for (bb = lo; bb <= hi; ++bb) {
+                accumulator = _mm_xor_si128(accumulator, _mm_clmulepi64_si128(_mm_cvtsi64_si128(mp->seed[sum - bb]), _mm_cvtsi64_si128(in[bb]), 0x00));
+            }
+            product[sum - mp->first] ^= (uint64_t)_mm_cvtsi128_si64(accumulator);
+            product[sum - mp->first + 1] ^= (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(accumulator, accumulator));
+        }
+#else
+        {
+            uint64_t low = 0;
+            uint64_t high = 0;
+            uint64_t rl;
+            uint64_t rh;
+            uint64_t value;
+            const uint64_t * tl;
+            const uint64_t * th;
+            int nibble;
+
+            for (bb = lo; bb <= hi; ++bb) {
+                value = in[bb];
+                tl = mp->low[sum - bb];
+                th = mp->high[sum - bb];
+                rl = 0;
+                rh = 0;
+                for (nibble = 60; nibble >= 0; nibble -= 4) {
+                    rh = (rh << 4) | (rl >> 60);
+                    rl = (rl << 4) ^ tl[(value >> nibble) & 0xf];
+                    rh ^= th[(value >> nibble) & 0xf];
+                }
+                low ^= rl;
+                high ^= rh;
+            }
+            product[sum - mp->first] ^= low;
+            product[sum - mp->first + 1] ^= high;
+        }
+#endif
+
+    }
+
+    /*
+     * Shift the middle of the product down into the output.
+     */
+
+    word = (mp->inbits - 1) / 64 - mp->first;
+    shift = (mp->inbits - 1) % 64;
+    for (ii = 0; ii < mp->outwords; ++ii) {
+        out[ii] = (shift == 0) ? product[word + ii] : ((product[word + ii] >> shift) | (product[word + ii + 1] << (64 - shift)));
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int verbose = 0;
+    const char * path = (const char *)0;
+    size_t inbytes = 1024;
+    size_t outbytes = 512;
+    double minentropy = 0.0;
+    size_t length = 0;
+    size_t written = 0;
+    size_t ii;
+    ssize_t rc = 0;
+    uint64_t * input = (uint64_t *)0;
+    uint64_t * output = (uint64_t *)0;
+    struct matrix matrix;
+    unsigned long long blocks = 0;
+    unsigned long long total = 0;
+    unsigned long long extracted = 0;
+    struct sigaction action = { 0 };
+    double start = 0.0;
+    double seconds = 0.0;
+    char * end = (char *)0;
+    int opt;
+    extern char * optarg;
+    extern int optind;
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    while ((opt = getopt(argc, argv, "hi:k:o:r:v")) >= 0) {
+
+        switch (opt) {
+
+        case 'h':
+            usage();
+            return 0;
+
+        case 'i':
+            inbytes = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (inbytes == 0)) {
+                error = !0;
+            }
+            break;
+
+        case 'k':
+            path = optarg;
+            break;
+
+        case 'o':
+            outbytes = strtoul(optarg, &end, 0);
+            if ((*end != '\0') || (outbytes == 0)) {
+                error = !0;
+            }
+            break;
+
+        case 'r':
+            minentropy = strtod(optarg, &end);
+            if ((*end != '\0') || (minentropy <= 0.0) || (minentropy > 1.0)) {
+                error = !0;
+            }
+            break;
+
+        case 'v':
+            verbose = !0;
+            break;
+
+        default:
+            error = !0;
+            break;
+
+        }
+
+    }
+
+    /*
+     * Blocks are whole words so that the product can be computed a word at
+     * a time.
+     */
+
+    if (minentropy > 0.0) {
+        outbytes = ((minentropy * inbytes * 8) > MARGIN) ? ((size_t)((minentropy * inbytes * 8) - MARGIN) / 64) * 8 : 0;
+    }
+
+    if ((inbytes % 8) != 0) {
+        error = !0;
+    } else if ((outbytes == 0) || ((outbytes % 8) != 0) || (outbytes > inbytes)) {
+        error = !0;
+    } else if (path == (const char *)0) {
+        error = !0;
+    } else {
+        /* Do nothing. */
+    }
+
+    if ((optind < argc) || error) {
+        usage();
+        return 1;
+    }
+
+    memset(&matrix, 0, sizeof(matrix));
+    matrix.inbits = inbytes * 8;
+    matrix.outbits = outbytes * 8;
+
+    do {
+
+        action.sa_handler = handler;
+        action.sa_flags = 0;
+        if (sigaction(SIGPIPE, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+        if (sigaction(SIGINT, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+        if (sigaction(SIGTERM, &action, (struct sigaction *)0) < 0) {
+            perror("sigaction");
+            break;
+        }
+
+        if (setup(&matrix, path) < 0) {
+            break;
+        }
+
+        input = (uint64_t *)malloc(inbytes);
+        output = (uint64_t *)malloc(outbytes);
+        if ((input == (uint64_t *)0) || (output == (uint64_t *)0)) {
+            perror("malloc");
+            break;
+        }
+
+        if (verbose) {
+            fprintf(stderr, "%s: seed         \"%s\"\n", program, path);
+            fprintf(stderr, "%s: input        %zu\n", program, matrix.inbits);
+            fprintf(stderr, "%s: output       %zu\n", program, matrix.outbits);
+            fprintf(stderr, "%s: seedbits     %zu\n", program, matrix.inbits + matrix.outbits - 1);
+#if defined(SCATTERGUN_HAS_PCLMUL)
+            fprintf(stderr, "%s: kernel       \"%s\"\n", program, "pclmul");
+#else
+            fprintf(stderr, "%s: kernel       \"%s\"\n", program, "table");
+#endif
+        }
+
+        start = now();
+        while (!done) {
+            length = fill(STDIN_FILENO, input, inbytes);
+            total += length;
+            if (length < inbytes) {
+                break;
+            }
+            for (ii = 0; ii < matrix.inwords; ++ii) {
+                input[ii] = le64toh(input[ii]);
+            }
+            multiply(&matrix, input, output);
+            for (ii = 0; ii < matrix.outwords; ++ii) {
+                output[ii] = htole64(output[ii]);
+            }
+            ++blocks;
+            for (written = 0; written < outbytes; written += rc) {
+                rc = write(STDOUT_FILENO, (uint8_t *)output + written, outbytes - written);
+                if (rc > 0) {
+                    /* Do nothing. */
+                } else if ((rc < 0) && (errno == EINTR) && (!done)) {
+                    rc = 0;
+                } else {
+                    break;
+                }
+            }
+            extracted += written;
+            if (written < outbytes) {
+                if ((rc < 0) && (errno != EPIPE)) { perror("write"); }
+                break;
+            }
+        }
+        seconds = now() - start;
+
+        fprintf(stderr, "%s: input=%zu output=%zu blocks=%llu bytes=%llu extracted=%llu seconds=%.6f rate=%.0f\n", program,
+            matrix.inbits, matrix.outbits, blocks, total, extracted, seconds,
+            (seconds > 0.0) ? (total / seconds) : 0.0);
+
+        xc = 0;
+
+    } while (0);
+
+#if !defined(SCATTERGUN_HAS_PCLMUL)
+    if (matrix.high != (uint64_t (*)[16])0) {
+        free(matrix.high);
+    }
+    if (matrix.low != (uint64_t (*)[16])0) {
+        free(matrix.low);
+    }
+#endif
+    if (matrix.product != (uint64_t *)0) {
+        free(matrix.product);
+    }
+    if (matrix.seed != (uint64_t *)0) {
+        free(matrix.seed);
+    }
+    if (output != (uint64_t *)0) {
+        free(output);
+    }
+    if (input != (uint64_t *)0) {
+        free(input);
+    }
+
+    return xc;
+}
@@ -0,0 +1,801 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * TrueRNGd<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * USAGE
+ *
+ * truerngd [ -h ] [ -d ] [ -v ] [ -D ] [ SOURCE [ SINK [ RUNDIR [ ETCDIR ] ] ] ]
+ *
+ * EXAMPLES
+ *
+ * truerngd -D
+ *
+ * truerngd -v /dev/TrueRNGpro /dev/random /tmp /tmp
+ *
+ * ABSTRACT
+ *
+ * A compiled replacement for truerngd.sh on Linux. Reads the ubld.it TrueRNG
+ * or TrueRNGpro at SOURCE (default /dev/TrueRNG) in large blocks with the
+ * serial device in raw low latency mode, runs the FIPS 140-2 statistical tests
+ * on each block of 20,000 bits, and adds the blocks that pass to the kernel
+ * entropy pool at SINK (default /dev/random) using the RNDADDENTROPY ioctl,
+ * crediting CREDIT bits of entropy per byte. Unlike truerngd.sh, which runs dd
+ * forever, it only reads the device while the pool wants entropy: it stops
+ * when entropy_avail reaches the HIGH watermark and resumes when it falls
+ * below the LOW watermark, stirring a single batch into the pool every STIR
+ * seconds while idle. If SINK is not the kernel entropy pool (a file, a
+ * FIFO, or a socket named unix:PATH or tcp:HOST:PORT, see sink.h) the
+ * blocks that pass are written to it continuously with no credit. The process identifier is written to RUNDIR/truerngd.pid
+ * (default /var/run) and a second instance refuses to start. Throughput and
+ * duty cycle (the fraction of the time spent reading the device) are
+ * reported every REPORT seconds, on SIGHUP, and at exit. This is part of the
+ * Scattergun project. Adding entropy to the kernel pool requires the
+ * CAP_SYS_ADMIN capability.
+ *
+ * CONFIGURATION
+ *
+ * Like truerngd.sh, the settings in ETCDIR/truerngd.conf (default
+ * /etc/default) override those on the command line. The file is a series of
+ * NAME=VALUE lines; blank lines and lines beginning with # are ignored, and
+ * names that are not recognized are ignored so that the file can be shared
+ * with truerngd.sh.
+ *
+ * SOURCE=PATH      is the TrueRNG serial device.
+ * SINK=PATH        is the kernel entropy pool or an output file.
+ * RUNDIR=PATH      is the directory for the pid file.
+ * BLOCKSIZE=BYTES  is the size of each read (default 65536).
+ * CREDIT=BITS      is the entropy credited per byte, 0..8 (default 8).
+ * LOW=BITS         resumes reading below this level (default half the pool).
+ * HIGH=BITS        stops reading at this level (default 3/4 of the pool).
+ * STIR=SECONDS     is the idle time after which a batch is added anyway (60).
+ * PERIOD=MILLISECONDS is how often the pool level is checked while idle (100).
+ * REPORT=SECONDS   is the time between reports, or 0 for none (default 0).
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <linux/random.h>
+#include "service.h"
+#include "sink.h"
+#include "tty.h"
+#include "fips.h"
+#include "pool.h"
+
+static const char * program = "truerngd";
+static int debug = 0;
+
+enum state { FEEDING=0, IDLE=1, };
+static const char * STATE[] = { "feeding", "idle", };
+
+/**
+ * These are the settings, from the command line and the configuration file.
+ */
+struct config {
+    char source[PATH_MAX];
+    char sink[PATH_MAX];
+    char rundir[PATH_MAX];
+    size_t blocksize;
+    double credit;
+    int low;
+    int high;
+    int stir;
+    int period;
+    int report;
+};
+
+/**
+ * These are the statistics reported on SIGHUP, every REPORT seconds, and at
+ * exit.
+ */
+struct statistics {
+    double start;
+    double mark;
+    double active;
+    size_t reads;
+    size_t total;
+    size_t injected;
+    size_t credited;
+    size_t discarded;
+    size_t wakeups;
+    size_t stirs;
+};
+
+/**
+ * Emit a usage message to standard error.
+ * @param nomenu if true supresses the printing of the menu.
+ */
+static void usage(int nomenu)
+{
+    service_printf("usage: %s [ -h ] [ -d ] [ -v ] [ -D ] [ SOURCE [ SINK [ RUNDIR [ ETCDIR ] ] ] ]\n", program);
+    if (nomenu) { return; }
+    service_printf("       -d            Enable debug mode\n");
+    service_printf("       -v            Enable verbose mode\n");
+    service_printf("       -D            Run as a daemon\n");
+    service_printf("       -h            Print help menu\n");
+}
+
+/**
+ * Return the value of the monotonic clock in seconds.
+ * @return the value of the monotonic clock in seconds.
+ */
+static double now(void)
+{
+    struct timespec ts = { 0 };
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+}
+
+/**
+ * Convert the value of an integer setting.
+ * @param name is the name of the setting.
+ * @param value is the value of the setting.
+ * @param minimum is the smallest valid value.
+ * @param maximum is the largest valid value.
+ * @param result points to where the value is stored.
+ * @return 0 for success, <0 for failure.
+ */
+static int integer(const char * name, const char * value, long minimum, long maximum, long * result)
+{
+    char * end = (char *)0;
+    long number = 0;
+
+    number = strtol(value, &end, 0);
+    if ((end == value) || (*end != '\0') || (number < minimum) || (number > maximum)) {
+        errno = EINVAL;
+        service_error(name);
+        return -1;
+    }
+
+    *result = number;
+
+    return 0;
+}
+
+/**
+ * Read the configuration file in the manner of a shell script sourcing it:
+ * each NAME=VALUE line sets the named setting, with optional quotes around
+ * the value.
+ * @param path is the path of the configuration file.
+ * @param cp points to the settings.
+ * @return 0 if the file was read, >0 if it does not exist, <0 for failure.
+ */
+static int configure(const char * path, struct config * cp)
+{
+    FILE * fp = (FILE *)0;
+    char line[PATH_MAX + 64];
+    char * name = (char *)0;
+    char * value = (char *)0;
+    char * here = (char *)0;
+    size_t length = 0;
+    long number = 0;
+    double real = 0.0;
+    int rc = 0;
+
+    fp = fopen(path, "r");
+    if (fp != (FILE *)0) {
+        /* Do nothing. */
+    } else if (errno == ENOENT) {
+        return 1;
+    } else {
+        service_error(path);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp) != (char *)0) {
+
+        for (name = line; isspace(*name); ++name) { }
+        if ((*name == '\0') || (*name == '#')) {
+            continue;
+        }
+        if (strncmp(name, "export ", 7) == 0) {
+            name += 7;
+        }
+
+        value = strchr(name, '=');
+        if (value == (char *)0) {
+            continue;
+        }
+        *(value++) = '\0';
+
+        length = strlen(value);
+        while ((length > 0) && isspace(value[length - 1])) {
+            value[--length] = '\0';
+        }
+        if ((length >= 2) && ((value[0] == '"') || (value[0] == '\'')) && (value[length - 1] == value[0])) {
+            value[--length] = '\0';
+            ++value;
+        }
+
+        service_verbosef("%s: %s=\"%s\"\n", program, name, value);
+
+        if (strcmp(name, "SOURCE") == 0) {
+            here = cp->source;
+        } else if (strcmp(name, "SINK") == 0) {
+            here = cp->sink;
+        } else if (strcmp(name, "RUNDIR") == 0) {
+            here = cp->rundir;
+        } else if (strcmp(name, "BLOCKSIZE") == 0) {
+            if ((rc = integer(name, value, FIPS_BYTES, 16 * 1024 * 1024, &number)) < 0) { break; }
+            cp->blocksize = number;
+            continue;
+        } else if (strcmp(name, "CREDIT") == 0) {
+            real = strtod(value, &here);
+            if ((here == value) || (*here != '\0') || (real < 0.0) || (real > 8.0)) {
+                errno = EINVAL;
+                service_error(name);
+                rc = -1;
+                break;
+            }
+            cp->credit = real;
+            continue;
+        } else if (strcmp(name, "LOW") == 0) {
+            if ((rc = integer(name, value, 0, INT_MAX, &number)) < 0) { break; }
+            cp->low = number;
+            continue;
+        } else if (strcmp(name, "HIGH") == 0) {
+            if ((rc = integer(name, value, 0, INT_MAX, &number)) < 0) { break; }
+            cp->high = number;
+            continue;
+        } else if (strcmp(name, "STIR") == 0) {
+            if ((rc = integer(name, value, 0, INT_MAX, &number)) < 0) { break; }
+            cp->stir = number;
+            continue;
+        } else if (strcmp(name, "PERIOD") == 0) {
+            if ((rc = integer(name, value, 1, INT_MAX, &number)) < 0) { break; }
+            cp->period = number;
+            continue;
+        } else if (strcmp(name, "REPORT") == 0) {
+            if ((rc = integer(name, value, 0, INT_MAX, &number)) < 0) { break; }
+            cp->report = number;
+            continue;
+        } else {
+            continue;
+        }
+
+        if (length >= PATH_MAX) {
+            errno = ENAMETOOLONG;
+            service_error(name);
+            rc = -1;
+            break;
+        }
+        strcpy(here, value);
+
+    }
+
+    fclose(fp);
+
+    return rc;
+}
+
+/**
+ * Return the process identifier recorded in a pid file if that process is
+ * still running.
+ * @param path is the path of the pid file.
+ * @return the process identifier, or 0 if no such process is running.
+ */
+static pid_t running(const char * path)
+{
+    FILE * fp = (FILE *)0;
+    long pid = 0;
+
+    fp = fopen(path, "r");
+    if (fp == (FILE *)0) {
+        return 0;
+    }
+
+    if (fscanf(fp, "%ld", &pid) != 1) {
+        pid = 0;
+    } else if (pid <= 0) {
+        pid = 0;
+    } else if (kill(pid, 0) == 0) {
+        /* Do nothing. */
+    } else if (errno == EPERM) {
+        /* Do nothing. */
+    } else {
+        pid = 0;
+    }
+
+    fclose(fp);
+
+    return pid;
+}
+
+/**
+ * Add a batch of blocks that have passed their tests to the kernel entropy
+ * pool with credit, or write them to the sink if it is not the pool.
+ * @param sink points to the open sink.
+ * @param pooled is true if the sink is the kernel entropy pool.
+ * @param credit is the number of bits of entropy credited per byte.
+ * @param data points to the blocks.
+ * @param size is the size of the blocks in bytes.
+ * @param sp points to the statistics.
+ * @return 0 for success, <0 for failure.
+ */
+static int emit(struct sink * sink, int pooled, double credit, const uint8_t * data, size_t size, struct statistics * sp)
+{
+    struct iovec vector;
+    size_t length = 0;
+    int bits = 0;
+
+    if (size == 0) {
+        /* Do nothing. */
+    } else if (pooled) {
+        bits = credit * size;
+        if (pool_inject(sink->fd, data, size, bits) < 0) {
+            service_error("ioctl(RNDADDENTROPY)");
+            return -1;
+        }
+        if (debug) {
+            service_printf("%s: inject bytes=%zu bits=%d\n", program, size, bits);
+        }
+        sp->injected += size;
+        sp->credited += bits;
+    } else {
+        vector.iov_base = (void *)data;
+        vector.iov_len = size;
+        while (vector.iov_len > 0) {
+            length = sink_writev(sink, &vector, 1);
+            vector.iov_base = (uint8_t *)vector.iov_base + length;
+            vector.iov_len -= length;
+            if (vector.iov_len == 0) {
+                /* Do nothing. */
+            } else if (errno != EINTR) {
+                service_error(sink->name);
+                return -1;
+            } else if (service_done) {
+                return -1;
+            } else {
+                /* Do nothing. */
+            }
+        }
+        sp->injected += size;
+    }
+
+    return 0;
+}
+
+/**
+ * Emit the statistics.
+ * @param sp points to the statistics.
+ * @param fp points to the FIPS 140-2 test state.
+ * @param state is the current state.
+ * @param level is the last entropy level read from the kernel, or <0.
+ */
+static void statistics(const struct statistics * sp, const struct fips * fp, enum state state, int level)
+{
+    double elapsed = 0.0;
+    double active = 0.0;
+    int ii;
+
+    elapsed = now() - sp->start;
+    active = sp->active;
+    if (state == FEEDING) {
+        active += now() - sp->mark;
+    }
+
+    service_printf("%s: state=%s level=%d elapsed=%.3f active=%.3f duty=%.3f reads=%zu total=%zu yield=%.1f throughput=%.0f average=%.0f blocks=%zu failures=%zu discarded=%zu injected=%zu credited=%zu wakeups=%zu stirs=%zu\n", program, STATE[state], level, elapsed, active, (elapsed > 0.0) ? (active / elapsed) : 0.0, sp->reads, sp->total, (sp->reads > 0) ? ((double)sp->total / sp->reads) : 0.0, (active > 0.0) ? (sp->total / active) : 0.0, (elapsed > 0.0) ? (sp->injected / elapsed) : 0.0, fp->blocks, fp->failures, sp->discarded, sp->injected, sp->credited, sp->wakeups, sp->stirs);
+    for (ii = 0; ii < FIPS_TESTS; ++ii) {
+        if (fp->failed[ii] > 0) {
+            service_printf("%s: %s=%zu\n", program, FIPS_NAMES[ii], fp->failed[ii]);
+        }
+    }
+}
+
+/**
+ * Run the program.
+ * @param argc is the number of command line arguments.
+ * @param argv is a vector of pointers to the command line arguments.
+ */
+int main(int argc, char * argv[])
+{
+    int xc = 1;
+    int error = 0;
+    int rc = 0;
+    ssize_t bytes = 0;
+    int source = -1;
+    int daemonize = 0;
+    static struct sink sink;
+    int pooled = 0;
+    int size = 0;
+    int level = -1;
+    int stirring = 0;
+    enum state state = FEEDING;
+    struct config config = { { 0 } };
+    static struct statistics stats;
+    static struct fips fips;
+    struct pollfd pfd = { 0 };
+    const char * etcdir = "/etc/default";
+    char path[PATH_MAX];
+    char pidfile[PATH_MAX];
+    int written = 0;
+    FILE * fp = (FILE *)0;
+    uint8_t * buffer = (uint8_t *)0;
+    size_t used = 0;
+    size_t offset = 0;
+    size_t first = 0;
+    size_t length = 0;
+    double last = 0.0;
+    double next = 0.0;
+    double current = 0.0;
+    pid_t pid = 0;
+    int mask = 0;
+    int opt;
+    extern char * optarg;
+    extern int optind;
+
+    /*
+     * Crack open the command line argument vector.
+     */
+
+    program = ((program = strrchr(argv[0], '/')) == (char *)0) ? argv[0] : program + 1;
+
+    strcpy(config.source, "/dev/TrueRNG");
+    strcpy(config.sink, "/dev/random");
+    strcpy(config.rundir, "/var/run");
+    config.blocksize = TTY_READ;
+    config.credit = 8.0;
+    config.low = -1;
+    config.high = -1;
+    config.stir = 60;
+    config.period = 100;
+    config.report = 0;
+
+    sink.fd = -1;
+
+    while ((opt = getopt(argc, argv, "dvDh")) >= 0) {
+
+        switch (opt) {
+
+        case 'd':
+            debug = !0;
+            break;
+
+        case 'v':
+            service_verbose = !0;
+            break;
+
+        case 'D':
+            daemonize = !0;
+            break;
+
+        case 'h':
+            xc = 0;
+            error = !0;
+            break;
+
+        default:
+            error = !0;
+            break;
+
+        }
+
+        if (error) {
+            break;
+        }
+
+    }
+
+    if (error) {
+        /* Do nothing. */
+    } else if ((argc - optind) > 4) {
+        error = !0;
+    } else {
+        if (optind < argc) { snprintf(config.source, sizeof(config.source), "%s", argv[optind++]); }
+        if (optind < argc) { snprintf(config.sink, sizeof(config.sink), "%s", argv[optind++]); }
+        if (optind < argc) { snprintf(config.rundir, sizeof(config.rundir), "%s", argv[optind++]); }
+        if (optind < argc) { etcdir = argv[optind++]; }
+    }
+
+    do {
+
+        if (error) {
+            usage(xc);
+            break;
+        }
+
+        /*
+         * Read the configuration file, whose settings override those on the
+         * command line just as they do for truerngd.sh.
+         */
+
+        snprintf(path, sizeof(path), "%s/%s.conf", etcdir, program);
+        service_verbosef("%s: config       \"%s\"\n", program, path);
+        if (configure(path, &config) < 0) {
+            break;
+        }
+
+        snprintf(pidfile, sizeof(pidfile), "%s/%s.pid", config.rundir, program);
+
+        if ((pid = running(pidfile)) > 0) {
+            service_printf("%s: %d: already running\n", program, pid);
+            xc = 2;
+            break;
+        }
+
+        /*
+         * Open the source. A serial device is placed into raw mode and
+         * configured for large low latency reads.
+         */
+
+        source = open(config.source, O_RDONLY);
+        if (source < 0) {
+            service_error(config.source);
+            xc = 2;
+            break;
+        }
+
+        if (!isatty(source)) {
+            /* Do nothing. */
+        } else if (tty_raw(source, TTY_VMIN, TTY_VTIME) < 0) {
+            service_error("tty_raw");
+            break;
+        } else {
+            service_verbosef("%s: lowlatency   %d\n", program, tty_lowlatency(source));
+        }
+
+        /*
+         * Open the sink. If it answers the RNDGETENTCNT ioctl, it is the
+         * kernel entropy pool.
+         */
+
+        if ((sink_parse(&sink, config.sink) < 0) || (sink_open(&sink) < 0)) {
+            service_error(config.sink);
+            xc = 2;
+            break;
+        }
+
+        pooled = (ioctl(sink.fd, RNDGETENTCNT, &level) == 0);
+
+        if (!pooled) {
+            /* Do nothing. */
+        } else if ((size = pool_size()) < 0) {
+            service_error(POOL_SIZE);
+            break;
+        } else {
+            if (config.high < 0) { config.high = (size * 3) / 4; }
+            if (config.low < 0) { config.low = size / 2; }
+            if (config.low > config.high) { config.low = config.high; }
+        }
+
+        buffer = (uint8_t *)malloc(config.blocksize + FIPS_BYTES);
+        if (buffer == (uint8_t *)0) {
+            service_error("malloc");
+            break;
+        }
+
+        service_verbosef("%s: source       \"%s\"\n", program, config.source);
+        service_verbosef("%s: sink         \"%s\"\n", program, config.sink);
+        service_verbosef("%s: pooled       %d\n", program, pooled);
+        service_verbosef("%s: pidfile      \"%s\"\n", program, pidfile);
+        service_verbosef("%s: blocksize    %zu\n", program, config.blocksize);
+        service_verbosef("%s: credit       %.3f\n", program, config.credit);
+        service_verbosef("%s: poolsize     %d\n", program, size);
+        service_verbosef("%s: low          %d\n", program, config.low);
+        service_verbosef("%s: high         %d\n", program, config.high);
+        service_verbosef("%s: stir         %d\n", program, config.stir);
+        service_verbosef("%s: period       %d\n", program, config.period);
+        service_verbosef("%s: report       %d\n", program, config.report);
+
+        /*
+         * Daemonize if so configured, and record our process identifier.
+         */
+
+        if (!daemonize) {
+            /* Do nothing. */
+        } else if (service_daemonize(program) < 0) {
+            perror("daemon");
+            break;
+        } else {
+            service_verbosef("%s: pid          %d\n", program, getpid());
+        }
+
+        fp = fopen(pidfile, "w");
+        if (fp == (FILE *)0) {
+            service_error(pidfile);
+            break;
+        }
+        fprintf(fp, "%d\n", getpid());
+        fclose(fp);
+        written = !0;
+
+        /*
+         * Install our signal handlers.
+         */
+
+        if (service_signals() < 0) {
+            service_error("sigaction");
+            break;
+        }
+
+        /*
+         * Enter our work loop. While feeding, read the device in large
+         * blocks, test each block of 20,000 bits, and add each contiguous
+         * run of blocks that pass in a single batch. While idle, leave the
+         * device unread (so that it stalls) and watch the pool level.
+         */
+
+        stats.start = now();
+        stats.mark = stats.start;
+        state = pooled ? IDLE : FEEDING;
+        last = stats.start;
+        next = stats.start + config.report;
+        pfd.fd = sink.fd;
+        pfd.events = POLLOUT;
+
+        xc = 0;
+
+        while (!service_done) {
+
+            current = now();
+
+            if (service_report) {
+                statistics(&stats, &fips, state, level);
+                service_report = 0;
+            }
+
+            if ((config.report > 0) && (current >= next)) {
+                statistics(&stats, &fips, state, level);
+                next = current + config.report;
+            }
+
+            if (state == IDLE) {
+
+                level = pool_available();
+                if (level < 0) {
+                    service_error(POOL_AVAILABLE);
+                    xc = 1;
+                    break;
+                }
+
+                if (level < config.low) {
+                    service_verbosef("%s: wakeup       %d\n", program, level);
+                    ++stats.wakeups;
+                    stirring = 0;
+                } else if ((config.stir > 0) && ((current - last) >= config.stir)) {
+                    if (debug) {
+                        service_printf("%s: stir level=%d\n", program, level);
+                    }
+                    ++stats.stirs;
+                    stirring = !0;
+                } else {
+                    /*
+                     * The pool reports itself writable when its level falls
+                     * below write_wakeup_threshold, which may be above LOW;
+                     * in that case wait out the period rather than spin.
+                     */
+                    rc = poll(&pfd, 1, config.period);
+                    if ((rc < 0) && (errno != EINTR)) {
+                        service_error("poll");
+                        xc = 1;
+                        break;
+                    } else if ((rc > 0) && (pool_available() >= config.low)) {
+                        poll((struct pollfd *)0, 0, config.period);
+                    } else {
+                        /* Do nothing. */
+                    }
+                    continue;
+                }
+
+                state = FEEDING;
+                stats.mark = now();
+
+            }
+
+            bytes = read(source, buffer + used, config.blocksize);
+            if (bytes > 0) {
+                /* Do nothing. */
+            } else if (bytes == 0) {
+                service_verbosef("%s: end          \"%s\"\n", program, config.source);
+                break;
+            } else if (errno == EINTR) {
+                continue;
+            } else {
+                service_error(config.source);
+                xc = 1;
+                break;
+            }
+
+            ++stats.reads;
+            stats.total += bytes;
+            used += bytes;
+
+            first = 0;
+            length = 0;
+            for (offset = 0; (used - offset) >= FIPS_BYTES; offset += FIPS_BYTES) {
+                mask = fips_test(&fips, buffer + offset);
+                if (mask == 0) {
+                    if (length == 0) { first = offset; }
+                    length += FIPS_BYTES;
+                    continue;
+                }
+                service_verbosef("%s: fail         0x%x\n", program, mask);
+                stats.discarded += FIPS_BYTES;
+                if (emit(&sink, pooled, config.credit, buffer + first, length, &stats) < 0) {
+                    break;
+                }
+                length = 0;
+            }
+            if ((used - offset) >= FIPS_BYTES) {
+                xc = 1;
+                break;
+            }
+            if (emit(&sink, pooled, config.credit, buffer + first, length, &stats) < 0) {
+                xc = 1;
+                break;
+            }
+            if (length > 0) {
+                last = now();
+            }
+
+            used -= offset;
+            memmove(buffer, buffer + offset, used);
+
+            if (!pooled) {
+                continue;
+            }
+
+            level = pool_available();
+            if (level < 0) {
+                service_error(POOL_AVAILABLE);
+                xc = 1;
+                break;
+            }
+
+            if ((level >= config.high) || (stirring && (length > 0))) {
+                if (!stirring) {
+                    service_verbosef("%s: idle         %d\n", program, level);
+                }
+                stirring = 0;
+                state = IDLE;
+                stats.active += now() - stats.mark;
+            }
+
+        }
+
+        statistics(&stats, &fips, state, level);
+
+    } while (0);
+
+    if (written) {
+        unlink(pidfile);
+    }
+
+    if (buffer != (uint8_t *)0) {
+        memset(buffer, 0, config.blocksize + FIPS_BYTES);
+        free(buffer);
+    }
+
+    sink_close(&sink);
+
+    if (source >= 0) {
+        close(source);
+    }
+
+    service_verbosef("%s: exit         %d\n", program, xc);
+
+    return xc;
+}
@@ -0,0 +1,92 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+/**
+ * @file
+ * TTY<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+#include "tty.h"
+
+int tty_raw(int fd, int vmin, int vtime)
+{
+    struct termios tios = { 0 };
+    struct serial_struct serial = { 0 };
+
+    if (tcgetattr(fd, &tios) < 0) {
+        return -1;
+    }
+
+    cfmakeraw(&tios);
+    tios.c_cflag |= CLOCAL | CREAD;
+    tios.c_cflag &= ~CRTSCTS;
+    tios.c_iflag &= ~(IXON | IXOFF | IXANY);
+    tios.c_cc[VMIN] = vmin;
+    tios.c_cc[VTIME] = vtime;
+#if defined(B3000000)
+    cfsetispeed(&tios, B3000000);
+    cfsetospeed(&tios, B3000000);
+#endif
+
+    if (tcsetattr(fd, TCSANOW, &tios) < 0) {
+        return -1;
+    }
+
+    if (ioctl(fd, TIOCGSERIAL, &serial) < 0) {
+        /* Do nothing: not all drivers support this. */
+    } else if (serial.flags & ASYNC_LOW_LATENCY) {
+        /* Do nothing: already set. */
+    } else {
+        serial.flags |= ASYNC_LOW_LATENCY;
+        (void)ioctl(fd, TIOCSSERIAL, &serial);
+    }
+
+    return 0;
+}
+
+int tty_lowlatency(int fd)
+{
+    struct serial_struct serial = { 0 };
+
+    if (ioctl(fd, TIOCGSERIAL, &serial) < 0) {
+        return 0;
+    }
+
+    return ((serial.flags & ASYNC_LOW_LATENCY) != 0);
+}
+
+int tty_onerng(int fd)
+{
+    static const char * COMMANDS[] = { "cmd0\n", "cmdO\n", };
+    size_t length = 0;
+    int ii;
+
+    for (ii = 0; ii < (sizeof(COMMANDS) / sizeof(COMMANDS[0])); ++ii) {
+        length = strlen(COMMANDS[ii]);
+        if (write(fd, COMMANDS[ii], length) != length) {
+            if (errno == 0) { errno = EIO; }
+            return -1;
+        }
+    }
+
+    if (tcdrain(fd) < 0) {
+        return -1;
+    }
+
+    if (tcflush(fd, TCIFLUSH) < 0) {
+        return -1;
+    }
+
+    return 0;
+}
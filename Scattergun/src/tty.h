@@ -0,0 +1,74 @@
+/* vi: set ts=4 expandtab shiftwidth=4: */
+#ifndef _H_COM_DIAG_SCATTERGUN_TTY_
+#define _H_COM_DIAG_SCATTERGUN_TTY_
+
+/**
+ * @file
+ * TTY<BR>
+ * Copyright 2016 Digital Aggregates Corporation, Colorado, USA.<BR>
+ * "Digital Aggregates Corporation" is a registered trademark.<BR>
+ * Licensed under the terms of the Scattergun license.<BR>
+ * author:Chip Overclock<BR>
+ * mailto:coverclock@diag.com<BR>
+ * http://www.diag.com/nagivation/downloads/Scattergun.html<BR>
+ * http://github.com/coverclock/com-diag-scattergun<BR>
+ *
+ * ABSTRACT
+ *
+ * Configures the serial (CDC-ACM) device exposed by USB entropy generators
+ * like the ubld.it TrueRNG and TrueRNGpro and the Moonbase Otago OneRNG so
+ * that they can be read in large blocks with low latency. This replaces the
+ * stty in the udev rules and the echos in onernginit.sh. This is part of the
+ * Scattergun project.
+ */
+
+#include <stddef.h>
+
+/**
+ * This is the default VMIN: the read blocks until at least this many bytes
+ * are available (it is the largest value a cc_t can hold).
+ */
+#define TTY_VMIN 255
+
+/**
+ * This is the default VTIME: after the first byte arrives, the read returns
+ * what it has if no more arrives within this many tenths of a second.
+ */
+#define TTY_VTIME 1
+
+/**
+ * This is the default read size, large enough to amortize the system call
+ * over many USB bulk transfers.
+ */
+#define TTY_READ (64 * 1024)
+
+/**
+ * Place a serial device into raw mode with no echo, no flow control, and the
+ * maximum speed (which a CDC-ACM device ignores), set its VMIN and VTIME, and
+ * set the ASYNC_LOW_LATENCY flag so that the driver pushes received data to
+ * the line discipline immediately instead of on a timer. Not all drivers
+ * support the latter, so failing to set it is not an error.
+ * @param fd is the open file descriptor of the serial device.
+ * @param vmin is the value of VMIN (0..255).
+ * @param vtime is the value of VTIME in tenths of a second (0..255).
+ * @return 0 for success, <0 with errno set for failure.
+ */
+extern int tty_raw(int fd, int vmin, int vtime);
+
+/**
+ * Return true if the ASYNC_LOW_LATENCY flag is set on a serial device.
+ * @param fd is the open file descriptor of the serial device.
+ * @return true if the low latency flag is set, false otherwise.
+ */
+extern int tty_lowlatency(int fd);
+
+/**
+ * Initialize a Moonbase Otago OneRNG by selecting the avalanche noise
+ * generator with whitening ("cmd0") and enabling its output ("cmdO"), as
+ * onernginit.sh does, then discarding whatever was received beforehand.
+ * @param fd is the open file descriptor of the serial device.
+ * @return 0 for success, <0 with errno set for failure.
+ */
+extern int tty_onerng(int fd);
+
+#endif